@@ -68,16 +68,23 @@ SOURCES += megachatapi.cpp \
             megachatapi_impl.cpp \
             async_utils.cpp \
             strongvelope/strongvelope.cpp \
+            strongvelope/decryptWorkerPool.cpp \
             presenced.cpp \
             base64url.cpp \
             chatClient.cpp \
             chatd.cpp \
+            chatdCapture.cpp \
+            chatdMsgArena.cpp \
+            chatdUrlScan.cpp \
             url.cpp \
             karereCommon.cpp \
             userAttrCache.cpp \
+            messageSearchIndex.cpp \
+            chatRoomIndex.cpp \
             sfu.cpp \
             base/logger.cpp \
             base/cservices.cpp \
+            base/timerWheel.cpp \
             net/websocketsIO.cpp \
             karereDbSchema.cpp \
             net/libwebsocketsIO.cpp \
@@ -97,6 +104,10 @@ HEADERS  += async_utils.h \
             presenced.h \
             autoHandle.h \
             chatdMsg.h \
+            chatdMsgArena.h \
+            chatdUrlScan.h \
+            chatdIdxMap.h \
+            chatdCapture.h \
             megachatapi.h  \
             rtcCrypto.h \
             stringUtils.h \
@@ -107,6 +118,8 @@ HEADERS  += async_utils.h \
             megachatapi_impl.h \
             sdkApi.h \
             userAttrCache.h \
+            messageSearchIndex.h \
+            chatRoomIndex.h \
             ../bindings/qt/QTMegaChatEvent.h \
             ../bindings/qt/QTMegaChatListener.h \
             ../bindings/qt/QTMegaChatRoomListener.h \
@@ -121,13 +134,16 @@ HEADERS  += async_utils.h \
             base/cservices-thread.h \
             base/cservices.h \
             base/gcmpp.h \
+            base/instrumentedMutex.h \
             base/logger.h \
             base/loggerFile.h \
             base/loggerConsole.h \
+            base/mpscQueue.h \
             base/retryHandler.h \
             base/promise.h \
             base/services.h \
             base/timers.hpp \
+            base/timerWheel.h \
             base/trackDelete.h \
             net/libwebsocketsIO.h \
             net/websocketsIO.h \
@@ -138,10 +154,12 @@ HEADERS  += async_utils.h \
             rtcModule/webrtcAdapter.h \
             rtcModule/webrtcPrivate.h \
             rtcModule/rtcStats.h \
+            rtcModule/audioLevelMeter.h \
             sfu.h \
             strongvelope/tlvstore.h \
             strongvelope/strongvelope.h \
             strongvelope/cryptofunctions.h \
+            strongvelope/decryptWorkerPool.h \
             waiter/libuvWaiter.h \
             chatclientDb.h
 
@@ -161,7 +179,8 @@ CONFIG(USE_WEBRTC) {
     SOURCES += rtcCrypto.cpp \
              rtcModule/webrtc.cpp \
              rtcModule/webrtcAdapter.cpp \
-             rtcModule/rtcStats.cpp
+             rtcModule/rtcStats.cpp \
+             rtcModule/audioLevelMeter.cpp
 }
 else {
     DEFINES += KARERE_DISABLE_WEBRTC=1 SVC_DISABLE_STROPHE
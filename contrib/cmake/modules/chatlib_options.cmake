@@ -5,6 +5,8 @@ if(UNIX AND NOT APPLE) # Linux
 else()
     option(USE_WEBRTC "Support for voice and/or video calls" OFF)
 endif()
+option(ENABLE_CHATLIB_BENCHMARKS "Offline benchmarks and unit tests (chatd capture replay, event queue, timer wheel...) are built if enabled" OFF)
+option(ENABLE_CHATD_FRAME_CAPTURE "Frames received from chatd are recorded if KRCHATD_CAPTURE is set. Never enable it in release builds" OFF)
 if (ENABLE_CHATLIB_QTAPP)
     option(ENABLE_QT_BINDINGS "Enable the target to build the Qt Bindings" ON)
 else()
@@ -242,6 +242,28 @@ public:
      */
     virtual void onPresenceLastGreenUpdated(karere::Id userid, uint16_t lastGreen) = 0;
 
+    /**
+     * @brief Called with the changes of presence and last-green of several users at once,
+     * a single entry per user. Apps can implement it to update the GUI only once per batch.
+     * The default implementation notifies every change separately.
+     *
+     * @param updates Changes of presence and/or last-green (in minutes) of the users
+     */
+    virtual void onPresenceBatch(const std::vector<presenced::PresenceUpdate>& updates)
+    {
+        for (const presenced::PresenceUpdate& update: updates)
+        {
+            if (update.presenceChanged)
+            {
+                onPresenceChanged(update.userid, update.pres, false);
+            }
+            if (update.lastGreenChanged)
+            {
+                onPresenceLastGreenUpdated(update.userid, update.lastGreen);
+            }
+        }
+    }
+
     /** @brief Called when the karere::Client changes its initialization or termination state.
      * Look at karere::Client::InitState for the possible values of the client init
      * state and their meaning.
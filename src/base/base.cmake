@@ -6,20 +6,24 @@ set(CHATLIB_BASE_HEADERS
     base/cservices-thread.h
     base/gcm.h
     base/gcmpp.h
+    base/instrumentedMutex.h
     base/loggerChannelConfig.h
     base/loggerConsole.h
     base/loggerFile.h
     base/logger.h
+    base/mpscQueue.h
     base/promise.h
     base/retryHandler.h
     base/services.h
     base/timers.hpp
+    base/timerWheel.h
     base/trackDelete.h
 )
 
 set(CHATLIB_BASE_SOURCES
     base/logger.cpp
     base/cservices.cpp
+    base/timerWheel.cpp
 )
 
 target_sources(CHATlib
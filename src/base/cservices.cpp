@@ -12,11 +12,6 @@
 #include <sys/time.h>
 #endif
 
-namespace karere
-{
-    std::recursive_mutex timerMutex;
-}
-
 extern "C"
 {
 MEGA_GCM_DLLEXPORT GcmPostFunc megaPostMessageToGui = NULL;
@@ -75,7 +70,7 @@ MEGAIO_EXPORT int services_hstore_remove_handle(unsigned short type, megaHandle
     if (it == gHandleStore.end())
     {
 #ifndef NDEBUG
-        fprintf(stderr, "ERROR: services_hstore_remove_handle: Handle not found (id=%u, type=%u)\n", handle, type);
+        fprintf(stderr, "ERROR: services_hstore_remove_handle: Handle not found (id=%llu, type=%u)\n", static_cast<unsigned long long>(handle), type);
 #endif
         return 0;
     }
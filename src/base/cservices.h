@@ -45,7 +45,7 @@ extern "C" {
 enum {SVC_OPTIONS_LOGFLAGS = 0x000000ff};
 
 //Handle store
-typedef unsigned int megaHandle; //invalid handle value is 0
+typedef uint64_t megaHandle; //invalid handle value is 0
 
 enum
 {
@@ -46,12 +46,16 @@ typedef void(*megaMessageFunc)(megaMessage*);
 struct megaMessage
 {
     megaMessageFunc func;
+    /** Link used by the queue of the thread that receives the message, so queueing it
+     * doesn't require additional allocations. It must not be used by the posting side
+     */
+    struct megaMessage* next;
     /** If we don't provide an initializing constructor, operator new() will initialize
      * func to NULL, and then we will overwrite it, which is inefficient. That's why we
      * implement a constructor in case we are included in C++ code
      */
      #ifdef __cplusplus
-         megaMessage(megaMessageFunc aFunc): func(aFunc){}
+         megaMessage(megaMessageFunc aFunc): func(aFunc), next(nullptr){}
          virtual ~megaMessage() = default;
      #endif
 };
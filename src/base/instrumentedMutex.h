@@ -0,0 +1,97 @@
+#ifndef INSTRUMENTEDMUTEX_H
+#define INSTRUMENTEDMUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace karere
+{
+/**
+ * @brief Wrapper of a mutex that measures how often, and for how long, threads have to
+ * wait to lock it.
+ *
+ * It meets the Lockable requirements, so it can be used with std::unique_lock and
+ * std::lock_guard. An uncontended lock() costs a single try_lock() on the wrapped mutex;
+ * only when it fails, the waiting time is measured. Statistics are updated with relaxed
+ * atomics, so they are approximate while other threads are locking the mutex.
+ */
+template <class M>
+class InstrumentedMutex
+{
+public:
+    struct Stats
+    {
+        uint64_t acquisitions = 0;      // calls to lock() and successful calls to try_lock()
+        uint64_t contended = 0;         // calls to lock() that had to wait
+        uint64_t waitUs = 0;            // total time waited, in microseconds
+        uint64_t maxWaitUs = 0;         // longest single wait, in microseconds
+    };
+
+    void lock()
+    {
+        mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (mMutex.try_lock())
+        {
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        mMutex.lock();
+        uint64_t waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                    std::chrono::steady_clock::now() - start).count());
+
+        mContended.fetch_add(1, std::memory_order_relaxed);
+        mWaitUs.fetch_add(waited, std::memory_order_relaxed);
+        uint64_t maxWait = mMaxWaitUs.load(std::memory_order_relaxed);
+        while (waited > maxWait && !mMaxWaitUs.compare_exchange_weak(maxWait, waited, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    bool try_lock()
+    {
+        if (!mMutex.try_lock())
+        {
+            return false;
+        }
+
+        mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void unlock()
+    {
+        mMutex.unlock();
+    }
+
+    Stats stats() const
+    {
+        Stats stats;
+        stats.acquisitions = mAcquisitions.load(std::memory_order_relaxed);
+        stats.contended = mContended.load(std::memory_order_relaxed);
+        stats.waitUs = mWaitUs.load(std::memory_order_relaxed);
+        stats.maxWaitUs = mMaxWaitUs.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /** @brief Returns the statistics collected since the previous call, and resets them */
+    Stats takeStats()
+    {
+        Stats stats;
+        stats.acquisitions = mAcquisitions.exchange(0, std::memory_order_relaxed);
+        stats.contended = mContended.exchange(0, std::memory_order_relaxed);
+        stats.waitUs = mWaitUs.exchange(0, std::memory_order_relaxed);
+        stats.maxWaitUs = mMaxWaitUs.exchange(0, std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    M mMutex;
+    std::atomic<uint64_t> mAcquisitions{0};
+    std::atomic<uint64_t> mContended{0};
+    std::atomic<uint64_t> mWaitUs{0};
+    std::atomic<uint64_t> mMaxWaitUs{0};
+};
+}
+#endif // INSTRUMENTEDMUTEX_H
@@ -0,0 +1,109 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+namespace karere
+{
+/**
+ * @brief Intrusive lock-free multi-producer/single-consumer queue.
+ *
+ * Items are linked through their member \c Next, so pushing an item doesn't allocate
+ * memory. Producers push onto an atomic stack with a CAS loop. The consumer takes the
+ * whole stack in a single atomic exchange, reverses it into a private FIFO batch, and
+ * pops items from that batch without any further synchronization.
+ *
+ * Only one thread at a time can act as the consumer, calling pop(), isEmpty(), size()
+ * or forEach(). push() can be called from any thread, at any time.
+ *
+ * The queue doesn't own the items: the ones still queued when it's destroyed are leaked.
+ */
+template <class T, T* T::*Next>
+class MpscQueue
+{
+public:
+    /** @brief Adds an item at the end of the queue. Returns true if the queue was empty
+     * (from the producers' point of view), so the consumer may need to be woken up */
+    bool push(T* item)
+    {
+        T* head = mHead.load(std::memory_order_relaxed);
+        do
+        {
+            item->*Next = head;
+        }
+        while (!mHead.compare_exchange_weak(head, item, std::memory_order_release, std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    /** @brief Removes the first item of the queue, or returns nullptr if it's empty */
+    T* pop()
+    {
+        if (!mBatch && !takeAll())
+        {
+            return nullptr;
+        }
+
+        T* item = mBatch;
+        mBatch = item->*Next;
+        item->*Next = nullptr;
+        return item;
+    }
+
+    bool isEmpty() const
+    {
+        return !mBatch && !mHead.load(std::memory_order_acquire);
+    }
+
+    /** @brief Number of queued items. It walks the whole queue, don't use it in hot paths */
+    size_t size() const
+    {
+        size_t count = 0;
+        forEach([&count](T*) { count++; });
+        return count;
+    }
+
+    /** @brief Calls \c f for every queued item. The items pushed meanwhile may be skipped */
+    template <class F>
+    void forEach(F&& f) const
+    {
+        for (T* item = mBatch; item; item = item->*Next)
+        {
+            f(item);
+        }
+        for (T* item = mHead.load(std::memory_order_acquire); item; item = item->*Next)
+        {
+            f(item);
+        }
+    }
+
+protected:
+    // stack of the items pushed by the producers, newest first
+    std::atomic<T*> mHead{nullptr};
+
+    // items taken by the consumer from the stack, oldest first
+    T* mBatch = nullptr;
+
+    // moves all the pushed items into the consumer's batch. Returns false if there were none
+    bool takeAll()
+    {
+        T* item = mHead.exchange(nullptr, std::memory_order_acquire);
+        if (!item)
+        {
+            return false;
+        }
+
+        T* reversed = nullptr;
+        while (item)
+        {
+            T* next = item->*Next;
+            item->*Next = reversed;
+            reversed = item;
+            item = next;
+        }
+        mBatch = reversed;
+        return true;
+    }
+};
+}
+#endif // MPSCQUEUE_H
@@ -120,7 +120,7 @@ protected:
     size_t mMaxSingleWaitTime;
     unsigned short mDelayRandPct = 20;
     promise::Promise<RetType> mPromise;
-    unsigned long mTimer = 0;
+    megaHandle mTimer = 0;
     unsigned short mInitialWaitTime;
     unsigned mRestart = 0;
     void *appCtx;
@@ -307,7 +307,7 @@ protected:
     {
         if (!mTimer)
             return;
-        cancelTimeout(static_cast<megaHandle>(mTimer), appCtx);
+        cancelTimeout(mTimer, appCtx);
         mTimer = 0;
     }
 
@@ -0,0 +1,401 @@
+#include "timerWheel.h"
+#include <algorithm>
+#include <assert.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace karere
+{
+// returns the distance (1..kSlots) from slot \c cur to the next slot set in \c bitmap
+static inline unsigned nextSlotDistance(uint64_t bitmap, unsigned cur)
+{
+    unsigned shift = (cur + 1) & 63;
+    uint64_t rotated = shift ? ((bitmap >> shift) | (bitmap << (64 - shift))) : bitmap;
+    assert(rotated);
+#ifdef _MSC_VER
+    unsigned long pos;
+    _BitScanForward64(&pos, rotated);
+    return static_cast<unsigned>(pos) + 1;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(rotated)) + 1;
+#endif
+}
+
+TimerWheel::ServiceMsg::ServiceMsg(TimerWheel* aWheel)
+    : megaMessage([](megaMessage* msg) { static_cast<ServiceMsg*>(msg)->wheel->service(); }),
+      wheel(aWheel)
+{
+}
+
+TimerWheel::TimerWheel(uv_loop_t* loop, void* appCtx)
+    : mLoop(loop),
+      mAppCtx(appCtx),
+      mStart(std::chrono::steady_clock::now()),
+      mServiceMsg(this)
+{
+    for (Link& list: mLists)
+    {
+        list.prev = list.next = &list;
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (std::unique_ptr<Timer[]>& chunk: mChunks)
+    {
+        for (unsigned i = 0; i < kChunkSize; i++)
+        {
+            if (chunk[i].handle)
+            {
+                chunk[i].destroy(&chunk[i]);
+            }
+        }
+    }
+
+    if (mUvTimer)
+    {
+        uv_timer_stop(mUvTimer);
+        uv_close((uv_handle_t *)mUvTimer, [](uv_handle_t* handle)
+        {
+            delete (uv_timer_t*)handle;
+        });
+    }
+}
+
+bool TimerWheel::cancel(megaHandle handle)
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+    uint32_t index = handle & kIndexMask;
+    Timer* timer = (index < mChunks.size() * kChunkSize) ? timerAt(index) : nullptr;
+    if (!timer || timer->handle != handle)
+    {
+        return false; //not valid anymore
+    }
+
+    if (timer->running)
+    {
+        // it's released once its callback returns
+        timer->canceled = true;
+        return true;
+    }
+
+    unlink(timer);
+    releaseTimer(timer);
+    return true;
+}
+
+uint64_t TimerWheel::nowTick() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now() - mStart).count());
+}
+
+TimerWheel::Timer* TimerWheel::timerAt(uint32_t index) const
+{
+    return &mChunks[index / kChunkSize][index % kChunkSize];
+}
+
+TimerWheel::Timer* TimerWheel::allocTimer()
+{
+    if (mFreeHead == kNoIndex)
+    {
+        growPool();
+    }
+
+    Timer* timer = timerAt(mFreeHead);
+    mFreeHead = timer->nextFree;
+    if (mFreeHead == kNoIndex)
+    {
+        mFreeTail = kNoIndex;
+    }
+
+    // the sequence tells apart the handles of the successive timers that use this entry. Apps keep
+    // handles of timers that already fired, so they must not repeat: 2^46 handles never wrap around
+    timer->handle = (static_cast<megaHandle>(++mHandleSeq) << kIndexBits) | timer->index;
+    timer->nextFree = kNoIndex;
+    timer->running = false;
+    timer->canceled = false;
+    return timer;
+}
+
+void TimerWheel::releaseTimer(Timer* timer)
+{
+    timer->destroy(timer);
+    timer->handle = 0;
+    timer->invoke = nullptr;
+    timer->destroy = nullptr;
+
+    // free entries are reused in FIFO order
+    if (mFreeTail == kNoIndex)
+    {
+        mFreeHead = timer->index;
+    }
+    else
+    {
+        timerAt(mFreeTail)->nextFree = timer->index;
+    }
+    mFreeTail = timer->index;
+}
+
+void TimerWheel::growPool()
+{
+    size_t count = mChunks.size() * kChunkSize;
+    if (count + kChunkSize > static_cast<size_t>(kIndexMask) + 1)
+    {
+        SVC_LOG_ERROR("TimerWheel: too many timers (%zu)", count);
+        abort();
+    }
+
+    mChunks.emplace_back(new Timer[kChunkSize]);
+    Timer* chunk = mChunks.back().get();
+    for (unsigned i = 0; i < kChunkSize; i++)
+    {
+        chunk[i].index = static_cast<uint32_t>(count + i);
+        chunk[i].nextFree = (i + 1 < kChunkSize) ? static_cast<uint32_t>(count + i + 1) : kNoIndex;
+    }
+
+    if (mFreeTail == kNoIndex)
+    {
+        mFreeHead = static_cast<uint32_t>(count);
+    }
+    else
+    {
+        timerAt(mFreeTail)->nextFree = static_cast<uint32_t>(count);
+    }
+    mFreeTail = static_cast<uint32_t>(count + kChunkSize - 1);
+}
+
+void TimerWheel::arm(Timer* timer, unsigned timeMs, bool repeat)
+{
+    timer->period = repeat ? std::max(timeMs, 1u) : 0;
+
+    // the callback is never called synchronously, even for zero timeouts
+    uint64_t expires = std::max(nowTick() + timeMs, mNow + 1);
+    schedule(timer, expires);
+
+    if (expires >= mArmedTick)
+    {
+        return; // the libuv timer fires earlier, and it will be rearmed then
+    }
+
+    if (mUvTimer && mLoopThread == std::this_thread::get_id())
+    {
+        rearm();
+    }
+    else
+    {
+        // libuv can only be used from the thread of the loop
+        postService();
+    }
+}
+
+void TimerWheel::schedule(Timer* timer, uint64_t expires)
+{
+    timer->expires = expires;
+    if (expires <= mNow)
+    {
+        link(timer, kListExpired);
+        return;
+    }
+
+    // lowest level where the timer is less than a turn away
+    unsigned level = 0;
+    unsigned shift = 0;
+    while (level < kLevels - 1 && (expires >> shift) - (mNow >> shift) >= kSlots)
+    {
+        level++;
+        shift += kSlotBits;
+    }
+
+    uint64_t pos = expires >> shift;
+    if (pos - (mNow >> shift) >= kSlots)
+    {
+        // beyond the last level: park it in the furthest slot, it's rescheduled when it cascades
+        pos = (mNow >> shift) + kSlots - 1;
+    }
+    link(timer, static_cast<uint16_t>(level * kSlots + (pos & kSlotMask)));
+}
+
+void TimerWheel::link(Timer* timer, uint16_t list)
+{
+    Link& head = mLists[list];
+    timer->prev = head.prev;
+    timer->next = &head;
+    head.prev->next = timer;
+    head.prev = timer;
+    timer->list = list;
+    if (list < kListExpired)
+    {
+        mOccupied[list / kSlots] |= uint64_t(1) << (list % kSlots);
+    }
+}
+
+void TimerWheel::unlink(Timer* timer)
+{
+    if (timer->list == kListNone)
+    {
+        return;
+    }
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    Link& head = mLists[timer->list];
+    if (timer->list < kListExpired && head.next == &head)
+    {
+        mOccupied[timer->list / kSlots] &= ~(uint64_t(1) << (timer->list % kSlots));
+    }
+    timer->list = kListNone;
+}
+
+void TimerWheel::cascade(unsigned level, unsigned slot)
+{
+    Link& head = mLists[level * kSlots + slot];
+    while (head.next != &head)
+    {
+        Timer* timer = static_cast<Timer*>(head.next);
+        unlink(timer);
+        schedule(timer, timer->expires);
+    }
+}
+
+uint64_t TimerWheel::nextEventTick() const
+{
+    uint64_t next = UINT64_MAX;
+    unsigned shift = 0;
+    for (unsigned level = 0; level < kLevels; level++, shift += kSlotBits)
+    {
+        if (mOccupied[level])
+        {
+            // level 0 slots expire, the other ones cascade, when the wheel reaches them
+            uint64_t pos = mNow >> shift;
+            uint64_t tick = (pos + nextSlotDistance(mOccupied[level], pos & kSlotMask)) << shift;
+            next = std::min(next, tick);
+        }
+    }
+    return next;
+}
+
+void TimerWheel::advance(uint64_t tick)
+{
+    while (mNow < tick)
+    {
+        uint64_t next = nextEventTick();
+        if (next > tick)
+        {
+            mNow = tick;   // nothing happens in between
+            break;
+        }
+
+        mNow = next;
+        for (unsigned level = kLevels - 1; level > 0; level--)
+        {
+            unsigned shift = level * kSlotBits;
+            if (!(mNow & ((uint64_t(1) << shift) - 1)))
+            {
+                cascade(level, (mNow >> shift) & kSlotMask);
+            }
+        }
+
+        Link& head = mLists[mNow & kSlotMask];
+        while (head.next != &head)
+        {
+            Timer* timer = static_cast<Timer*>(head.next);
+            unlink(timer);
+            link(timer, kListExpired);
+        }
+    }
+}
+
+void TimerWheel::service()
+{
+    std::unique_lock<std::recursive_mutex> lock(mMutex);
+    mServicePosted = false;
+    if (!mUvTimer)
+    {
+        mLoopThread = std::this_thread::get_id();
+        mUvTimer = new uv_timer_t();
+        mUvTimer->data = this;
+        uv_timer_init(mLoop, mUvTimer);
+    }
+
+    runExpired(lock, nowTick());
+    rearm();
+}
+
+void TimerWheel::runExpired(std::unique_lock<std::recursive_mutex>& lock, uint64_t tick)
+{
+    advance(tick);
+
+    Link& expired = mLists[kListExpired];
+    while (expired.next != &expired)
+    {
+        Timer* timer = static_cast<Timer*>(expired.next);
+        unlink(timer);
+        timer->running = true;
+
+        lock.unlock();
+        if (!gCatchException)
+        {
+            timer->invoke(timer);
+        }
+        else
+        {
+            try
+            {
+                timer->invoke(timer);
+            }
+            catch (std::exception& e)
+            {
+                KR_LOG_ERROR("ERROR: Exception in a timer callback: %s\n", e.what());
+            }
+        }
+        lock.lock();
+
+        timer->running = false;
+        if (timer->period && !timer->canceled)
+        {
+            schedule(timer, mNow + timer->period);
+        }
+        else
+        {
+            releaseTimer(timer);
+        }
+    }
+}
+
+void TimerWheel::postService()
+{
+    if (!mServicePosted.exchange(true))
+    {
+        megaPostMessageToGui(&mServiceMsg, mAppCtx);
+    }
+}
+
+void TimerWheel::rearm()
+{
+    uint64_t next = nextEventTick();
+    if (next == mArmedTick)
+    {
+        return;
+    }
+
+    mArmedTick = next;
+    if (next == UINT64_MAX)
+    {
+        uv_timer_stop(mUvTimer);
+        return;
+    }
+
+    uint64_t now = nowTick();
+    uv_timer_start(mUvTimer, onUvTimer, next > now ? next - now : 0, 0);
+}
+
+void TimerWheel::onUvTimer(uv_timer_t* handle)
+{
+    TimerWheel* wheel = static_cast<TimerWheel*>(handle->data);
+    std::lock_guard<std::recursive_mutex> lock(wheel->mMutex);
+    wheel->mArmedTick = UINT64_MAX;
+    wheel->postService();
+}
+}
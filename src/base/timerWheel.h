@@ -0,0 +1,162 @@
+#ifndef _MEGA_BASE_TIMERWHEEL_INCLUDED
+#define _MEGA_BASE_TIMERWHEEL_INCLUDED
+
+#include "cservices.h"
+#include "gcmpp.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+namespace karere
+{
+/**
+ * @brief Hierarchical timer wheel that runs all the timers of an app context (see
+ * setTimeout()/setInterval() in timers.hpp) on top of a single libuv timer.
+ *
+ * Timers are kept in kLevels wheels of kSlots slots, with a resolution of 1 ms. Every
+ * slot of level 0 is a millisecond, and every slot of level N spans a whole turn of level
+ * N-1. A timer is placed in the lowest level that its expiration fits in, and it moves
+ * down (cascades) when the wheel reaches its slot, so arming and canceling are O(1).
+ * The libuv timer is armed for the next slot that has timers, not for every tick.
+ *
+ * Timers are allocated from a pool and identified by handles that combine their index in
+ * the pool with a sequence number that is never reused, so stale handles (i.e. of timers
+ * that already fired) are detected without a lookup table.
+ * Callbacks up to kInlineCallbackSize bytes are stored inside the timer, without allocations.
+ *
+ * Timers can be armed and canceled from any thread. Callbacks are called in the app thread,
+ * as a marshalled call (see gcm.h) posted when the libuv timer fires.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel(uv_loop_t* loop, void* appCtx);
+    virtual ~TimerWheel();
+
+    /** @brief Arms a timer that calls \c callback after \c timeMs, and every \c timeMs
+     * afterwards if \c repeat is true. Returns the handle of the timer (never zero) */
+    template <class CB>
+    megaHandle add(CB&& callback, unsigned timeMs, bool repeat)
+    {
+        typedef typename std::decay<CB>::type F;
+        std::lock_guard<std::recursive_mutex> lock(mMutex);
+        Timer* timer = allocTimer();
+        if (sizeof(F) <= kInlineCallbackSize && alignof(F) <= alignof(std::max_align_t))
+        {
+            new (timer->storage) F(std::forward<CB>(callback));
+            timer->invoke = [](Timer* t) { (*reinterpret_cast<F*>(t->storage))(); };
+            timer->destroy = [](Timer* t) { reinterpret_cast<F*>(t->storage)->~F(); };
+        }
+        else
+        {
+            *reinterpret_cast<F**>(timer->storage) = new F(std::forward<CB>(callback));
+            timer->invoke = [](Timer* t) { (**reinterpret_cast<F**>(t->storage))(); };
+            timer->destroy = [](Timer* t) { delete *reinterpret_cast<F**>(t->storage); };
+        }
+        arm(timer, timeMs, repeat);
+        return timer->handle;
+    }
+
+    /** @brief Cancels a timer. Returns false if the handle is not valid anymore, which is
+     * normal if it was a one-shot timer that already fired */
+    bool cancel(megaHandle handle);
+
+protected:
+    enum: unsigned
+    {
+        kSlotBits = 6,
+        kSlots = 1 << kSlotBits,
+        kSlotMask = kSlots - 1,
+        kLevels = 6,                            // up to 2^36 ms (~2 years)
+        kIndexBits = 18,                        // up to 256K simultaneous timers, 2^46 handles
+        kIndexMask = (1 << kIndexBits) - 1,
+        kChunkSize = 256,                       // timers allocated at once when the pool is full
+        kInlineCallbackSize = 64,
+        kNoIndex = 0xffffffff
+    };
+
+    enum: uint16_t
+    {
+        kListExpired = kLevels * kSlots,        // expired timers, waiting for their callback
+        kListNone = 0xffff                      // not linked in any list
+    };
+
+    struct Link
+    {
+        Link* prev;
+        Link* next;
+    };
+
+    struct Timer: public Link
+    {
+        uint64_t expires = 0;                   // in ms since the wheel was created
+        unsigned period = 0;                    // in ms, zero for one-shot timers
+        megaHandle handle = 0;                  // zero while the timer is free
+        uint32_t index = 0;                     // position in the pool
+        uint32_t nextFree = kNoIndex;
+        uint16_t list = kListNone;
+        bool running = false;                   // its callback is being called
+        bool canceled = false;                  // canceled from its own callback
+        void (*invoke)(Timer*) = nullptr;
+        void (*destroy)(Timer*) = nullptr;
+        alignas(std::max_align_t) unsigned char storage[kInlineCallbackSize];
+    };
+
+    // message posted to the app thread to run the expired timers
+    struct ServiceMsg: public megaMessage
+    {
+        TimerWheel* wheel;
+        ServiceMsg(TimerWheel* aWheel);
+    };
+
+    // protects everything but the callbacks, which are called without holding it
+    std::recursive_mutex mMutex;
+    uv_loop_t* mLoop;
+    void* mAppCtx;
+    uv_timer_t* mUvTimer = nullptr;
+    std::thread::id mLoopThread;
+    std::chrono::steady_clock::time_point mStart;
+
+    uint64_t mNow = 0;                          // current tick of the wheel
+    uint64_t mArmedTick = UINT64_MAX;           // tick for which the libuv timer is armed
+    Link mLists[kLevels * kSlots + 1];          // slots of all the levels, plus kListExpired
+    uint64_t mOccupied[kLevels] = {};           // bitmap of non-empty slots, per level
+
+    std::vector<std::unique_ptr<Timer[]>> mChunks;
+    uint32_t mFreeHead = kNoIndex;
+    uint32_t mFreeTail = kNoIndex;
+    uint64_t mHandleSeq = 0;                    // sequence number of the last handle
+
+    ServiceMsg mServiceMsg;
+    std::atomic<bool> mServicePosted{false};
+
+    // virtual so tests can drive the clock of the wheel
+    virtual uint64_t nowTick() const;
+    Timer* timerAt(uint32_t index) const;
+    Timer* allocTimer();
+    void releaseTimer(Timer* timer);
+    void growPool();
+
+    void arm(Timer* timer, unsigned timeMs, bool repeat);
+    void schedule(Timer* timer, uint64_t expires);
+    void link(Timer* timer, uint16_t list);
+    void unlink(Timer* timer);
+    void cascade(unsigned level, unsigned slot);
+    uint64_t nextEventTick() const;
+    void advance(uint64_t tick);
+
+    void service();
+    void runExpired(std::unique_lock<std::recursive_mutex>& lock, uint64_t tick);
+    void postService();
+    void rearm();
+    static void onUvTimer(uv_timer_t* handle);
+};
+}
+#endif
@@ -793,6 +793,10 @@ void Client::heartbeat()
     }
 
     mPresencedClient.heartbeat();
+    if (time(NULL) - mTsPresenceSnapshotSaved >= kPresenceSnapshotInterval)
+    {
+        savePresenceSnapshot();
+    }
     if (mChatdClient)
     {
         mChatdClient->heartbeat();
@@ -1374,6 +1378,10 @@ void Client::initWithDbSession(const char* sid)
         mContactList->loadFromDb();
         mChatdClient.reset(new chatd::Client(this));
         chats->loadFromDb();
+        loadPresenceSnapshot();
+
+        // continue indexing the history if the index was enabled in a previous session
+        messageSearchIndex().resume();
 
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
         if (websocketIO && websocketIO->hasSessionCache())
@@ -1705,6 +1713,7 @@ void Client::onRequestFinish(::mega::MegaApi* /*apiObj*/, ::mega::MegaRequest *r
 //be in that dir, and it is in use
 void Client::wipeDb(const std::string& sid)
 {
+    mSearchIndex.reset();
     db.close();
     std::string path = dbPath(sid);
     int removed = remove(path.c_str());
@@ -1714,6 +1723,15 @@ void Client::wipeDb(const std::string& sid)
         throw std::runtime_error("wipeDb: Could not delete old database file in "+mAppDir);
 }
 
+MessageSearchIndex& Client::messageSearchIndex()
+{
+    if (!mSearchIndex)
+    {
+        mSearchIndex.reset(new MessageSearchIndex(db, appCtx));
+    }
+    return *mSearchIndex;
+}
+
 void Client::createDb()
 {
     KR_LOG_DEBUG("Karere log debug: wipeDb() from Client::createDb()");
@@ -2002,6 +2020,32 @@ bool Client::loadOwnKeysFromApi()
     return true;
 }
 
+void Client::loadPresenceSnapshot()
+{
+    SqliteStmt stmt(db, "select value from vars where name='presence_snapshot'");
+    if (!stmt.step() || !stmt.hasBlobCol(0))
+    {
+        return;
+    }
+
+    Buffer snapshot;
+    stmt.blobCol(0, snapshot);
+    mPresencedClient.restoreSnapshot(snapshot);
+}
+
+void Client::savePresenceSnapshot()
+{
+    Buffer snapshot;
+    if (!db.isOpen() || !mPresencedClient.exportSnapshot(snapshot))
+    {
+        return;
+    }
+
+    db.query("insert or replace into vars(name,value) values('presence_snapshot', ?)", snapshot);
+    mTsPresenceSnapshotSaved = time(NULL);
+    KR_LOG_DEBUG("Saved presence snapshot (%zu bytes)", snapshot.dataSize());
+}
+
 void Client::loadOwnKeysFromDb()
 {
     SqliteStmt stmt(db, "select value from vars where name=?");
@@ -2042,13 +2086,51 @@ void Client::onPresenceLastGreenUpdated(Id userid)
     updateAndNotifyLastGreen(userid.val);
 }
 
+void Client::onPresenceBatch(const std::vector<presenced::PresenceUpdate>& updates)
+{
+    if (isTerminated())
+    {
+        return;
+    }
+
+    std::vector<presenced::PresenceUpdate> changes;
+    changes.reserve(updates.size());
+    for (const presenced::PresenceUpdate& update: updates)
+    {
+        changes.push_back(update);
+        presenced::PresenceUpdate& change = changes.back();
+        if (change.lastGreenChanged)
+        {
+            change.lastGreenChanged = updateLastGreen(change.userid, change.lastGreen);
+        }
+        if (!change.presenceChanged && !change.lastGreenChanged)
+        {
+            changes.pop_back();
+        }
+    }
+
+    if (!changes.empty())
+    {
+        app.onPresenceBatch(changes);
+    }
+}
+
 void Client::updateAndNotifyLastGreen(const Id& userid)
+{
+    uint16_t lastGreenMinutes = 0;
+    if (updateLastGreen(userid, lastGreenMinutes))
+    {
+        app.onPresenceLastGreenUpdated(userid, lastGreenMinutes);
+    }
+}
+
+bool Client::updateLastGreen(const Id& userid, uint16_t& lastGreenMinutes)
 {
     mega::m_time_t lastGreenTs = mPresencedClient.getLastGreen(userid);
     if (!lastGreenTs)
     {
         KR_LOG_DEBUG("Skip notification, last-green not received yet");
-        return;
+        return false;
     }
 
     mega::m_time_t lastMsgTs = mChatdClient->getLastMsgTs(userid);
@@ -2056,18 +2138,23 @@ void Client::updateAndNotifyLastGreen(const Id& userid)
     // check what is newer: ts from chatd (messages) or ts from presenced (last-green response)
     mega::m_time_t lastGreen = (lastGreenTs >= lastMsgTs) ? lastGreenTs : lastMsgTs;
 
-    // Update last green and notify apps, if required
-    bool changed = mPresencedClient.updateLastGreen(userid.val, lastGreen);
-    if (changed)
+    // Update last green, apps are notified only if it has changed
+    if (!mPresencedClient.updateLastGreen(userid.val, lastGreen))
     {
-        uint16_t lastGreenMinutes = static_cast<uint16_t>((time(NULL) - lastGreen) / 60);
-        app.onPresenceLastGreenUpdated(userid, lastGreenMinutes);
+        return false;
     }
+
+    lastGreenMinutes = static_cast<uint16_t>((time(NULL) - lastGreen) / 60);
+    return true;
 }
 
-void Client::onConnStateChange(presenced::Client::ConnState /*state*/)
+void Client::onConnStateChange(presenced::Client::ConnState state)
 {
-
+    // save the presences before they are reset to unknown
+    if (state == presenced::Client::kDisconnected)
+    {
+        savePresenceSnapshot();
+    }
 }
 
 void Client::terminate(bool deleteDb)
@@ -2117,6 +2204,9 @@ void Client::terminate(bool deleteDb)
         mPresencedClient.disconnect();
     }
 
+    // stop indexing the history before closing the DB
+    mSearchIndex.reset();
+
     // close or delete MEGAchat's DB file
     try
     {
@@ -2355,9 +2445,20 @@ ChatRoom::ChatRoom(ChatRoomList& aParent, const uint64_t& chatid, bool aIsGroup,
     mOwnPriv(aOwnPriv), mCreationTs(ts), mIsArchived(aIsArchived), mTitleString(aTitle), mHasTitle(false)
 {}
 
+void ChatRoom::updateListIndex()
+{
+    // rooms are indexed once they are added to the list, with the chatd chat already created
+    auto it = parent.find(mChatid);
+    if (mChat && it != parent.end() && it->second == this)
+    {
+        parent.mIndex.update(*this);
+    }
+}
+
 //chatd::Listener
 void ChatRoom::onLastMessageTsUpdated(uint32_t ts)
 {
+    updateListIndex();
     callAfterInit(this, [this, ts]()
     {
         auto display = roomGui();
@@ -2366,6 +2467,11 @@ void ChatRoom::onLastMessageTsUpdated(uint32_t ts)
     }, parent.mKarereClient.appCtx);
 }
 
+void ChatRoom::onLastMessageTsLoaded(uint32_t /*ts*/)
+{
+    updateListIndex();
+}
+
 ApiPromise ChatRoom::requestGrantAccess(mega::MegaNode *node, mega::MegaHandle userHandle)
 {
     return parent.mKarereClient.api.call(&::mega::MegaApi::grantAccessInChat, chatid(), node, userHandle);
@@ -2887,6 +2993,7 @@ bool ChatRoom::syncOwnPriv(chatd::Priv newPriv)
 
     mOwnPriv = newPriv;
     parent.mKarereClient.db.query("update chats set own_priv = ? where chatid = ?", mOwnPriv, mChatid);
+    updateListIndex();
     return true;
 }
 
@@ -2897,6 +3004,7 @@ bool ChatRoom::syncArchive(bool aIsArchived)
 
     mIsArchived = aIsArchived;
     parent.mKarereClient.db.query("update chats set archived = ? where chatid = ?", mIsArchived, mChatid);
+    updateListIndex();
 
     return true;
 }
@@ -2956,6 +3064,7 @@ promise::Promise<void> GroupChatRoom::addMember(uint64_t userid, chatd::Priv pri
         parent.mKarereClient.db.query("insert or replace into chat_peers(chatid, userid, priv) values(?,?,?)",
             mChatid, userid, priv);
     }
+    updateListIndex();
 
     return mPeers[userid]->nameResolved();
 }
@@ -2976,6 +3085,7 @@ bool GroupChatRoom::removeMember(uint64_t userid)
     delete it->second;
     mPeers.erase(it);
     parent.mKarereClient.db.query("delete from chat_peers where chatid=? and userid=?", mChatid, userid);
+    updateListIndex();
     return true;
 }
 
@@ -3072,6 +3182,22 @@ ChatRoomList::ChatRoomList(Client& aClient)
 :mKarereClient(aClient)
 {}
 
+std::pair<ChatRoomList::iterator, bool> ChatRoomList::emplace(uint64_t chatid, ChatRoom* room)
+{
+    auto ret = std::map<uint64_t, ChatRoom*>::emplace(chatid, room);
+    if (ret.second)
+    {
+        mIndex.update(*room);
+    }
+    return ret;
+}
+
+ChatRoomList::iterator ChatRoomList::erase(iterator it)
+{
+    mIndex.remove(it->first);
+    return std::map<uint64_t, ChatRoom*>::erase(it);
+}
+
 void ChatRoomList::loadFromDb()
 {
     auto db = mKarereClient.db;
@@ -3867,6 +3993,7 @@ void PeerChatRoom::onUserLeave(Id userid)
 
 void ChatRoom::onLastTextMessageUpdated(const chatd::LastTextMsg& msg)
 {
+    updateListIndex();
     if (mIsInitializing)
     {
         auto wptr = weakHandle();
@@ -3992,6 +4119,7 @@ void ChatRoom::onMessageStatusChange(chatd::Idx idx, chatd::Message::Status stat
 
 void ChatRoom::onUnreadChanged()
 {
+    updateListIndex();
     IApp::IChatListItem *room = roomGui();
     if (room)
     {
@@ -4046,6 +4174,7 @@ void ChatRoom::notifyTitleChanged()
 
 void ChatRoom::notifyChatModeChanged()
 {
+    updateListIndex();
     callAfterInit(this, [this]
     {
         auto display = roomGui();
@@ -4081,6 +4210,7 @@ void GroupChatRoom::enablePreview(uint64_t ph)
 
     mChat->setPublicHandle(ph);
     chat().disable(false);
+    updateListIndex();
     connect();
 }
 
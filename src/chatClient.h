@@ -8,6 +8,8 @@
 #include <type_traits>
 #include "base/retryHandler.h"
 #include "userAttrCache.h"
+#include "messageSearchIndex.h"
+#include "chatRoomIndex.h"
 #include <db.h>
 #include "chatd.h"
 #include "presenced.h"
@@ -106,6 +108,7 @@ protected:
     bool syncOwnPriv(chatd::Priv newPriv);
     bool syncArchive(bool aIsArchived);
     void onMessageTimestamp(uint32_t ts);
+    void updateListIndex();
     ApiPromise requestGrantAccess(mega::MegaNode *node, mega::MegaHandle userHandle);
     ApiPromise requestRevokeAccess(mega::MegaNode *node, mega::MegaHandle userHandle);
     bool isChatdChatInitialized();
@@ -230,6 +233,7 @@ public:
     virtual void init(chatd::Chat& messages, chatd::DbInterface *&dbIntf);
     virtual void onLastTextMessageUpdated(const chatd::LastTextMsg& msg);
     virtual void onLastMessageTsUpdated(uint32_t ts);
+    virtual void onLastMessageTsLoaded(uint32_t ts);
     virtual void onExcludedFromRoom() {}
     virtual void onOnlineStateChange(chatd::ChatState state);
     virtual void onMsgOrderVerificationFail(const chatd::Message& msg, chatd::Idx idx, const std::string& errmsg);
@@ -600,6 +604,12 @@ class ChatRoomList: public std::map<uint64_t, ChatRoom*> //don't use shared_ptr
 /** @cond PRIVATE */
 public:
     Client& mKarereClient;
+    ChatRoomIndex mIndex;   // indexes to filter and sort the chat list, see ChatRoom::updateListIndex()
+
+    // hide the ones of std::map, so the rooms are added to and removed from mIndex
+    std::pair<iterator, bool> emplace(uint64_t chatid, ChatRoom* room);
+    iterator erase(iterator it);
+
     void addMissingRoomsFromApi(const mega::MegaTextChatList& rooms, karere::SetOfIds& chatids);
     ChatRoom* addRoom(const mega::MegaTextChat &room);
     void removeRoomPreview(Id chatid);
@@ -1001,7 +1011,8 @@ public:
 
     enum
     {
-        kHeartbeatTimeout = 10000     /// Timeout for heartbeats (ms)
+        kHeartbeatTimeout = 10000,    /// Timeout for heartbeats (ms)
+        kPresenceSnapshotInterval = 60  /// Minimum interval between saves of the presence snapshot (s)
     };
 
     /** @brief Convenience aliases for the \c force flag in \c setPresence() */
@@ -1047,6 +1058,7 @@ protected:
     std::string mMyEmail;
     uint64_t mMyIdentity = 0; // seed for CLIENTID
     std::unique_ptr<UserAttrCache> mUserAttrCache;
+    std::unique_ptr<MessageSearchIndex> mSearchIndex;
     UserAttrCache::Handle mOwnNameAttrHandle;
     UserAttrCache::Handle mAliasAttrHandle;
 
@@ -1064,6 +1076,9 @@ protected:
     megaHandle mHeartbeatTimer = 0;
     InitStats mInitStats;
 
+    /** Timestamp of the last save of the presence snapshot in the db */
+    time_t mTsPresenceSnapshotSaved = 0;
+
     // Maps uhBin to user alias encoded in B64
     AliasesMap mAliasesMap;
     bool mIsInBackground = false;
@@ -1101,6 +1116,10 @@ public:
     UserAttrCache& userAttrCache() const { return *mUserAttrCache; }
     bool isUserAttrCacheReady() const { return mUserAttrCache.get(); }
 
+    /** @brief Local full-text index of the history of all chats. It's not enabled until
+     * the first search, see MessageSearchIndex::enable() */
+    MessageSearchIndex& messageSearchIndex();
+
     ConnState connState() const { return mConnState; }
     bool connected() const { return mConnState == kConnected; }
 
@@ -1293,6 +1312,9 @@ public:
     bool anonymousMode() const;
     bool isChatRoomOpened(const Id& chatid);
     void updateAndNotifyLastGreen(const Id& userid);
+    /** @brief Updates the last-green of the user with the most recent of presenced's and chatd's.
+     * Returns true and the elapsed minutes in \c lastGreenMinutes if it has changed */
+    bool updateLastGreen(const Id& userid, uint16_t& lastGreenMinutes);
     InitStats &initStats();
     void sendStats();
     void resetMyIdentity();
@@ -1328,6 +1350,10 @@ protected:
     bool loadOwnKeysFromApi();
     void loadOwnKeysFromDb();
 
+    // snapshot of the presence and last-green of the peers, see presenced::Client::restoreSnapshot()
+    void loadPresenceSnapshot();
+    void savePresenceSnapshot();
+
     strongvelope::ProtocolHandler* newStrongvelope(const karere::Id& chatid, bool isPublic,
             std::shared_ptr<std::string> unifiedKey, int isUnifiedKeyEncrypted, const karere::Id& ph);
 
@@ -1365,6 +1391,7 @@ protected:
     virtual void onPresenceChange(Id userid, Presence pres, bool inProgress = false);
     virtual void onPresenceConfigChanged(const presenced::Config& state, bool pending);
     virtual void onPresenceLastGreenUpdated(karere::Id userid);
+    virtual void onPresenceBatch(const std::vector<presenced::PresenceUpdate>& updates);
 
     //==
     friend class ChatRoom;
@@ -0,0 +1,322 @@
+#include "chatRoomIndex.h"
+#include "chatClient.h"
+
+#include <algorithm>
+
+namespace karere
+{
+uint8_t ChatRoomIndex::flagsOf(const ChatRoom& room)
+{
+    uint8_t flags = 0;
+    if (room.isGroup())
+    {
+        flags |= kGroup;
+    }
+    if (room.publicChat())
+    {
+        flags |= kPublic;
+    }
+    if (room.isMeeting())
+    {
+        flags |= kMeeting;
+    }
+    if (room.isArchived())
+    {
+        flags |= kArchived;
+    }
+    if (room.isActive())
+    {
+        flags |= kActive;
+    }
+    if (room.chat().unreadMsgCount())
+    {
+        flags |= kUnread;
+    }
+    if (room.previewMode())
+    {
+        flags |= kPreview;
+    }
+    return flags;
+}
+
+bool ChatRoomIndex::update(ChatRoom& room)
+{
+    Entry entry;
+    entry.flags = flagsOf(room);
+    entry.lastTs = room.chat().lastMessageTs();
+    if (room.isGroup())
+    {
+        for (const auto& member: static_cast<GroupChatRoom&>(room).peers())
+        {
+            entry.peers.push_back(member.first);    // MemberMap is sorted by userid
+        }
+    }
+    else
+    {
+        entry.peers.push_back(static_cast<PeerChatRoom&>(room).peer());
+    }
+    return update(room.chatid(), std::move(entry));
+}
+
+bool ChatRoomIndex::update(uint64_t chatid, Entry&& entry)
+{
+    auto it = mEntries.find(chatid);
+    if (it == mEntries.end())
+    {
+        addKeys(chatid, entry);
+        mEntries.emplace(chatid, std::move(entry));
+        return true;
+    }
+
+    Entry& current = it->second;
+    if (current.flags == entry.flags && current.lastTs == entry.lastTs && current.peers == entry.peers)
+    {
+        return false;
+    }
+
+    removeKeys(chatid, current);
+    current = std::move(entry);
+    addKeys(chatid, current);
+    return true;
+}
+
+void ChatRoomIndex::remove(uint64_t chatid)
+{
+    auto it = mEntries.find(chatid);
+    if (it == mEntries.end())
+    {
+        return;
+    }
+
+    removeKeys(chatid, it->second);
+    mEntries.erase(it);
+}
+
+void ChatRoomIndex::clear()
+{
+    mEntries.clear();
+    mByActivity.clear();
+    mByPeer.clear();
+    mArchived.clear();
+    mUnread.clear();
+    mInactive.clear();
+}
+
+const ChatRoomIndex::Entry* ChatRoomIndex::find(uint64_t chatid) const
+{
+    auto it = mEntries.find(chatid);
+    return (it != mEntries.end()) ? &it->second : nullptr;
+}
+
+void ChatRoomIndex::addKeys(uint64_t chatid, const Entry& entry)
+{
+    mByActivity.emplace(entry.lastTs, chatid);
+    for (uint64_t peer: entry.peers)
+    {
+        mByPeer[peer].insert(chatid);
+    }
+    if (entry.flags & kArchived)
+    {
+        mArchived.insert(chatid);
+    }
+    if (entry.flags & kUnread)
+    {
+        mUnread.insert(chatid);
+    }
+    if (!(entry.flags & kActive))
+    {
+        mInactive.insert(chatid);
+    }
+}
+
+void ChatRoomIndex::removeKeys(uint64_t chatid, const Entry& entry)
+{
+    mByActivity.erase(ActivityKey(entry.lastTs, chatid));
+    for (uint64_t peer: entry.peers)
+    {
+        auto it = mByPeer.find(peer);
+        if (it != mByPeer.end())
+        {
+            it->second.erase(chatid);
+            if (it->second.empty())
+            {
+                mByPeer.erase(it);
+            }
+        }
+    }
+    mArchived.erase(chatid);
+    mUnread.erase(chatid);
+    mInactive.erase(chatid);
+}
+
+const std::unordered_set<uint64_t>* ChatRoomIndex::candidates(uint8_t mask, uint8_t value) const
+{
+    const std::unordered_set<uint64_t>* best = nullptr;
+    auto consider = [&best](const std::unordered_set<uint64_t>& set)
+    {
+        if (!best || set.size() < best->size())
+        {
+            best = &set;
+        }
+    };
+
+    if ((mask & kArchived) && (value & kArchived))
+    {
+        consider(mArchived);
+    }
+    if ((mask & kUnread) && (value & kUnread))
+    {
+        consider(mUnread);
+    }
+    if ((mask & kActive) && !(value & kActive))
+    {
+        consider(mInactive);
+    }
+    return best;
+}
+
+void ChatRoomIndex::sortByActivity(std::vector<uint64_t>& chatids) const
+{
+    std::vector<ActivityKey> keys;
+    keys.reserve(chatids.size());
+    for (uint64_t chatid: chatids)
+    {
+        keys.emplace_back(mEntries.at(chatid).lastTs, chatid);
+    }
+    std::sort(keys.begin(), keys.end(), std::greater<ActivityKey>());
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        chatids[i] = keys[i].second;
+    }
+}
+
+std::vector<uint64_t> ChatRoomIndex::select(uint8_t mask, uint8_t value, size_t offset, size_t count) const
+{
+    std::vector<uint64_t> chatids;
+    if ((value & ~mask) || !count)
+    {
+        return chatids;
+    }
+
+    const std::unordered_set<uint64_t>* set = candidates(mask, value);
+    if (!set)
+    {
+        // walk the rooms in order, and stop as soon as the window is complete
+        for (const ActivityKey& key: mByActivity)
+        {
+            if ((mEntries.at(key.second).flags & mask) != value)
+            {
+                continue;
+            }
+            if (offset)
+            {
+                offset--;
+                continue;
+            }
+
+            chatids.push_back(key.second);
+            if (chatids.size() == count)
+            {
+                break;
+            }
+        }
+        return chatids;
+    }
+
+    for (uint64_t chatid: *set)
+    {
+        if ((mEntries.at(chatid).flags & mask) == value)
+        {
+            chatids.push_back(chatid);
+        }
+    }
+
+    sortByActivity(chatids);
+    if (offset >= chatids.size())
+    {
+        chatids.clear();
+        return chatids;
+    }
+    chatids.erase(chatids.begin(), chatids.begin() + static_cast<std::ptrdiff_t>(offset));
+    if (chatids.size() > count)
+    {
+        chatids.resize(count);
+    }
+    return chatids;
+}
+
+size_t ChatRoomIndex::count(uint8_t mask, uint8_t value) const
+{
+    if (value & ~mask)
+    {
+        return 0;
+    }
+    if (!mask)
+    {
+        return mEntries.size();
+    }
+
+    size_t count = 0;
+    const std::unordered_set<uint64_t>* set = candidates(mask, value);
+    if (set)
+    {
+        for (uint64_t chatid: *set)
+        {
+            count += ((mEntries.at(chatid).flags & mask) == value);
+        }
+    }
+    else
+    {
+        for (const auto& entry: mEntries)
+        {
+            count += ((entry.second.flags & mask) == value);
+        }
+    }
+    return count;
+}
+
+std::vector<uint64_t> ChatRoomIndex::selectByPeers(const std::vector<uint64_t>& peers) const
+{
+    std::vector<uint64_t> chatids;
+    if (peers.empty())
+    {
+        // only groups can be left without peers
+        for (const auto& entry: mEntries)
+        {
+            if (entry.second.peers.empty())
+            {
+                chatids.push_back(entry.first);
+            }
+        }
+        sortByActivity(chatids);
+        return chatids;
+    }
+
+    auto it = mByPeer.find(peers.front());
+    if (it == mByPeer.end())
+    {
+        return chatids;
+    }
+
+    for (uint64_t chatid: it->second)
+    {
+        const std::vector<uint64_t>& roomPeers = mEntries.at(chatid).peers;
+        if (roomPeers.size() != peers.size())
+        {
+            continue;
+        }
+
+        bool samePeers = std::all_of(peers.begin(), peers.end(), [&roomPeers](uint64_t peer)
+        {
+            return std::binary_search(roomPeers.begin(), roomPeers.end(), peer);
+        });
+        if (samePeers)
+        {
+            chatids.push_back(chatid);
+        }
+    }
+    sortByActivity(chatids);
+    return chatids;
+}
+}
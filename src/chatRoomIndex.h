@@ -0,0 +1,99 @@
+#ifndef CHATROOMINDEX_H
+#define CHATROOMINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace karere
+{
+class ChatRoom;
+
+/**
+ * @brief Secondary indexes over the rooms of a ChatRoomList, so the chat list can be
+ * filtered, sorted and paginated without visiting every room
+ *
+ * Every room has an entry with the properties used to filter the chat list, packed as
+ * flags, the timestamp of its last activity (last message, or creation of the chat) and
+ * its peers. The entries are ordered by last activity, and the rooms that are archived,
+ * inactive or have unread messages, which are usually a small part of the list, are also
+ * kept in their own sets.
+ *
+ * ChatRoomList updates the entries when rooms are added or removed, and ChatRoom when
+ * any of the indexed properties changes (see ChatRoom::updateListIndex()).
+ */
+class ChatRoomIndex
+{
+public:
+    enum: uint8_t
+    {
+        kGroup      = 0x01,
+        kPublic     = 0x02,
+        kMeeting    = 0x04,
+        kArchived   = 0x08,
+        kActive     = 0x10,
+        kUnread     = 0x20,
+        kPreview    = 0x40
+    };
+
+    struct Entry
+    {
+        uint8_t flags = 0;
+        int64_t lastTs = 0;
+        std::vector<uint64_t> peers;    // sorted, without our own user
+    };
+
+    /** @brief Returns the flags of the current state of the room */
+    static uint8_t flagsOf(const ChatRoom& room);
+
+    /** @brief Adds the room to the indexes, or updates its entry.
+     * Returns true if the entry has changed */
+    bool update(ChatRoom& room);
+    bool update(uint64_t chatid, Entry&& entry);
+    void remove(uint64_t chatid);
+    void clear();
+
+    const Entry* find(uint64_t chatid) const;
+    size_t size() const { return mEntries.size(); }
+
+    /**
+     * @brief Selects the rooms whose flags, masked by \c mask, are equal to \c value
+     *
+     * Rooms are sorted by last activity, the most recent first, and the first \c offset
+     * rooms that match are skipped.
+     *
+     * @return Chatids of up to \c count rooms
+     */
+    std::vector<uint64_t> select(uint8_t mask, uint8_t value, size_t offset = 0,
+                                 size_t count = std::numeric_limits<size_t>::max()) const;
+
+    /** @brief Returns the number of rooms that select() would return without offset nor count */
+    size_t count(uint8_t mask, uint8_t value) const;
+
+    /** @brief Returns the chatids of the rooms whose peers are exactly \c peers, sorted by last activity */
+    std::vector<uint64_t> selectByPeers(const std::vector<uint64_t>& peers) const;
+
+protected:
+    typedef std::pair<int64_t, uint64_t> ActivityKey;     // (lastTs, chatid)
+
+    std::unordered_map<uint64_t, Entry> mEntries;
+    std::set<ActivityKey, std::greater<ActivityKey>> mByActivity;
+    std::unordered_map<uint64_t, std::unordered_set<uint64_t>> mByPeer;
+    std::unordered_set<uint64_t> mArchived;
+    std::unordered_set<uint64_t> mUnread;
+    std::unordered_set<uint64_t> mInactive;
+
+    void addKeys(uint64_t chatid, const Entry& entry);
+    void removeKeys(uint64_t chatid, const Entry& entry);
+
+    // smallest set that contains all the rooms that match, or nullptr if there isn't any
+    const std::unordered_set<uint64_t>* candidates(uint8_t mask, uint8_t value) const;
+    void sortByActivity(std::vector<uint64_t>& chatids) const;
+};
+}
+#endif // CHATROOMINDEX_H
@@ -1,8 +1,10 @@
 #include "chatd.h"
 #include "chatClient.h"
 #include "chatdICrypto.h"
+#include "chatdUrlScan.h"
 #include "base64url.h"
 #include <algorithm>
+#include <limits>
 #include <random>
 #include <regex>
 
@@ -169,6 +171,23 @@ Client::Client(karere::Client *aKarereClient) :
        });
     }
 
+#ifdef KARERE_ENABLE_FRAME_CAPTURE
+    const char* capturePath = getenv(FrameCapture::kEnvVarName);
+    if (capturePath && *capturePath)
+    {
+        mFrameCapture.reset(new FrameCapture(capturePath));
+        if (mFrameCapture->isOpen())
+        {
+            CHATD_LOG_WARNING("Recording frames received from chatd into %s", capturePath);
+        }
+        else
+        {
+            CHATD_LOG_ERROR("Failed to open capture file %s", capturePath);
+            mFrameCapture.reset();
+        }
+    }
+#endif
+
     // initialize the most recent message for each user
     SqliteStmt stmt1(mKarereClient->db, "SELECT DISTINCT userid FROM history");
     while (stmt1.step())
@@ -215,6 +234,13 @@ Chat& Client::createChat(const Id& chatid, int shardNo,
     // map chatid to this shard
     mConnectionForChatId[chatid] = conn;
 
+#ifdef KARERE_ENABLE_FRAME_CAPTURE
+    if (mFrameCapture)
+    {
+        mFrameCapture->addChat(shardNo, chatid, isGroup, chatCreationTs);
+    }
+#endif
+
     // always update the URL to give the API an opportunity to migrate chat shards between hosts
     Chat* chat = new Chat(*conn, chatid, listener, users, chatCreationTs, crypto, isGroup);
     // add chatid to the connection's chatids
@@ -481,14 +507,18 @@ void Chat::connect()
     }
 }
 
-void Chat::login()
+void Chat::login(const ChatDbInfo* dbInfo)
 {
     assert(mConnection.isOnline());
     setOnlineState(kChatStateJoining);
     // In both cases (join/joinrangehist), don't block history messages being sent to app
     mServerOldHistCbEnabled = false;
 
-    ChatDbInfo&& info = getDbHistInfoAndInitOldestKnownMsgId();
+    ChatDbInfo info = dbInfo ? *dbInfo : getDbHistInfoAndInitOldestKnownMsgId();
+    if (dbInfo)
+    {
+        initOldestKnownMsgId(info);
+    }
     sendReactionSn();
 
     if (previewMode())
@@ -785,6 +815,9 @@ void Connection::setState(State state)
         {
             mSendPromise.reject("Failed to send. Socket was closed");
         }
+
+        // all chats are rejoined upon the next connection
+        mPendingRejoins.clear();
     }
     else if (mState == kStateConnected)
     {
@@ -1266,6 +1299,84 @@ void Client::heartbeat()
     {
         conn.second->heartbeat();
     }
+
+    // messages received since the last check also count against the budgets
+    trimHistories();
+}
+
+void Client::setHistoryMemoryBudget(size_t chatBudget, size_t totalBudget)
+{
+    CHATD_LOG_DEBUG("History memory budget set to %zu bytes per chat, %zu bytes in total", chatBudget, totalBudget);
+    mChatHistoryMemoryBudget = chatBudget;
+    mHistoryMemoryBudget = totalBudget;
+    trimHistories();
+}
+
+size_t Client::updateHistoryMemory()
+{
+    for (auto& it: mChatForChatId)
+    {
+        it.second->updateHistoryMemory();
+    }
+    return mHistoryMemory;
+}
+
+void Client::trimHistories(Chat* chat)
+{
+    if (!mChatHistoryMemoryBudget && !mHistoryMemoryBudget)
+    {
+        return;
+    }
+
+    // the memory of the chats is kept up to date by them, it's not recalculated here
+    if (chat)
+    {
+        if (mChatHistoryMemoryBudget)
+        {
+            chat->trimHistory(mChatHistoryMemoryBudget);
+        }
+    }
+    else
+    {
+        if (mChatHistoryMemoryBudget)
+        {
+            for (auto& it: mChatForChatId)
+            {
+                it.second->trimHistory(mChatHistoryMemoryBudget);
+            }
+        }
+    }
+
+    if (!mHistoryMemoryBudget || mHistoryMemory <= mHistoryMemoryBudget)
+    {
+        return;
+    }
+
+    // evict from the chats whose history was requested least recently
+    std::vector<Chat*> chats;
+    chats.reserve(mChatForChatId.size());
+    for (auto& it: mChatForChatId)
+    {
+        chats.push_back(it.second.get());
+    }
+    std::sort(chats.begin(), chats.end(), [](const Chat* a, const Chat* b)
+    {
+        return a->mHistoryAccessSeq < b->mHistoryAccessSeq;
+    });
+
+    size_t before = mHistoryMemory;
+    for (Chat* lruChat: chats)
+    {
+        size_t excess = mHistoryMemory - mHistoryMemoryBudget;
+        size_t usage = lruChat->historyMemory();
+        lruChat->trimHistory(usage > excess ? usage - excess : 0);
+        if (mHistoryMemory <= mHistoryMemoryBudget)
+        {
+            break;
+        }
+    }
+    CHATD_LOG_DEBUG("History memory over budget: evicted %zu bytes, %zu bytes in use (budget: %zu)",
+                    before - mHistoryMemory, mHistoryMemory, mHistoryMemoryBudget);
 }
 
 bool Connection::sendBuf(Buffer&& buf)
@@ -1273,6 +1384,23 @@ bool Connection::sendBuf(Buffer&& buf)
     if (!isOnline())
         return false;
 
+    if (mPackingCommands)
+    {
+        // chatd parses every command in a frame, so they are sent together by endPackCommands()
+        if (!mPackedCommands.empty() && mPackedCommands.dataSize() + buf.dataSize() > kMaxPackedFrameSize)
+        {
+            sendPackedCommands();   // leaves mPackedCommands empty
+        }
+        mPackedCommands.append(buf.buf(), buf.dataSize());
+        buf.free();
+        return true;
+    }
+
+    return sendFrame(std::move(buf));
+}
+
+bool Connection::sendFrame(Buffer&& buf)
+{
     // if several data are written to the output buffer to be sent all together, wait for all of them
     if (mSendPromise.done())
     {
@@ -1611,26 +1739,148 @@ string KeyCommand::toString() const
     tmpString.append(to_string(mLocalKeyid));
     return tmpString;
 }
+void Connection::beginPackCommands()
+{
+    assert(!mPackingCommands);
+    mPackingCommands = true;
+}
+
+bool Connection::endPackCommands()
+{
+    mPackingCommands = false;
+    if (mPackedCommands.empty())
+    {
+        return true;
+    }
+
+    return isOnline() && sendPackedCommands();
+}
+
+bool Connection::sendPackedCommands()
+{
+    // commands are only packed by rejoinPendingChats(), so every packed frame is a rejoin frame
+    mRejoinFrames++;
+    Buffer packed(std::move(mPackedCommands));
+    return sendFrame(std::move(packed));
+}
+
 // rejoin all open chats after reconnection (this is mandatory)
 bool Connection::rejoinExistingChats()
 {
-    for (auto& chatid: mChatIds)
+    // chats opened by the app first, then the most recently active ones
+    std::vector<std::pair<int64_t, karere::Id>> order;
+    order.reserve(mChatIds.size());
+    for (const karere::Id& chatid: mChatIds)
+    {
+        int64_t priority = 0;
+        auto it = mChatdClient.mChatForChatId.find(chatid);
+        if (it != mChatdClient.mChatForChatId.end())
+        {
+            priority = it->second->lastMessageTs();
+        }
+
+        auto roomIt = mChatdClient.mKarereClient->chats->find(chatid);
+        if (roomIt != mChatdClient.mKarereClient->chats->end() && roomIt->second->hasChatHandler())
+        {
+            priority = std::numeric_limits<int64_t>::max();
+        }
+        order.emplace_back(priority, chatid);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<int64_t, karere::Id>& a, const std::pair<int64_t, karere::Id>& b)
+    {
+        return a.first > b.first;
+    });
+
+    mPendingRejoins.clear();
+    for (const auto& entry: order)
+    {
+        mPendingRejoins.push_back(entry.second);
+    }
+
+    mRejoinStartTs = karere::timestampMs();
+    mRejoinPendingOnline.clear();
+    mRejoinChats = 0;
+    mRejoinFrames = 0;
+    return rejoinPendingChats();
+}
+
+// JOIN/JOINRANGEHIST of every chat are sent while the output queue is not backpressured,
+// the remaining ones are sent as soon as it drains (see wsBackpressureCb). Chats are
+// rejoined in batches: the db info of the whole batch is loaded with a single query, and
+// their commands are packed in as few frames as possible
+bool Connection::rejoinPendingChats()
+{
+    while (!mPendingRejoins.empty() && isOnline() && !wsIsBackpressured())
     {
         try
         {
-            Chat& chat = mChatdClient.chats(chatid);
-            if (!chat.isDisabled())
-                chat.login();
+            std::vector<Chat*> batch;
+            std::vector<karere::Id> chatids;
+            while (!mPendingRejoins.empty() && batch.size() < kRejoinBatchSize)
+            {
+                karere::Id chatid = mPendingRejoins.front();
+                mPendingRejoins.pop_front();
+                if (mChatIds.find(chatid) == mChatIds.end())
+                {
+                    continue;   // the chat has been removed from this connection in the meantime
+                }
+
+                Chat& chat = mChatdClient.chats(chatid);
+                // skip chats that have already logged in by themselves (i.e. Chat::connect())
+                if (!chat.isDisabled() && chat.onlineState() < kChatStateJoining)
+                {
+                    batch.push_back(&chat);
+                    chatids.push_back(chatid);
+                }
+            }
+
+            if (batch.empty())
+            {
+                continue;
+            }
+
+            std::map<karere::Id, ChatDbInfo> infos;
+            batch.front()->mDbInterface->getHistoryInfos(chatids, infos);
+
+            beginPackCommands();
+            for (Chat* chat: batch)
+            {
+                auto it = infos.find(chat->chatId());
+                chat->login(it != infos.end() ? &it->second : nullptr);
+                mRejoinPendingOnline.insert(chat->chatId());
+            }
+            mRejoinChats += batch.size();
+            endPackCommands();
         }
         catch(std::exception& e)
         {
             CHATDS_LOG_ERROR("rejoinExistingChats: Exception: %s", e.what());
+            mPackingCommands = false;
+            mPackedCommands.clear();
+            mPendingRejoins.clear();
             return false;
         }
     }
+
+    if (!mPendingRejoins.empty() && isOnline())
+    {
+        CHATDS_LOG_DEBUG("Output queue is backpressured, %lu chats will be rejoined later", mPendingRejoins.size());
+    }
     return true;
 }
 
+// reports the time-to-online of the shard when the last rejoined chat is online
+void Connection::onChatOnline(const karere::Id& chatid)
+{
+    if (!mRejoinPendingOnline.erase(chatid) || !mRejoinPendingOnline.empty() || !mPendingRejoins.empty())
+    {
+        return;
+    }
+
+    CHATDS_LOG_DEBUG("Rejoin completed: %zu chats online in %lld ms, %zu frames sent",
+                     mRejoinChats, static_cast<long long>(karere::timestampMs() - mRejoinStartTs), mRejoinFrames);
+}
+
 // send JOIN
 void Chat::join()
 {
@@ -1734,6 +1984,7 @@ void Chat::onDisconnect()
 
 HistSource Chat::getHistory(unsigned count)
 {
+    mHistoryAccessSeq = ++mChatdClient.mHistoryAccessSeq;
     if (isNotifyingOldHistFromServer())
     {
         return kHistSourceServer;
@@ -1773,6 +2024,7 @@ HistSource Chat::getHistory(unsigned count)
                 }
 
                 CALL_LISTENER(onRecvHistoryMessage, i, msg, getMsgStatus(msg, i), true);
+                updateMsgMemory(msg);   // the app may have built its snapshot
             }
             countSoFar = mNextHistFetchIdx - fetchEnd;
             mNextHistFetchIdx -= countSoFar;
@@ -1784,6 +2036,20 @@ HistSource Chat::getHistory(unsigned count)
         }
     }
 
+    if (hasEvictedHistory())
+    {
+        countSoFar += getEvictedHistoryFromDb(count - countSoFar);
+        if (countSoFar >= (int)count)
+        {
+            CALL_LISTENER(onHistoryDone, kHistSourceDb);
+            return kHistSourceDb;
+        }
+
+        // the oldest history in db has been notified: the history buffer must be contiguous again
+        // for the messages that will be fetched from server
+        reloadEvictedHistory();
+    }
+
     // more than what is available in RAM is requested
     auto nextSource = getHistoryFromDbOrServer(count - countSoFar);
     if (nextSource == kHistSourceNone) //no history in db and server
@@ -1926,6 +2192,7 @@ Chat::Chat(Connection& conn, const Id& chatid, Listener* listener,
       mListener(listener), mUsers(initialUsers), mCrypto(crypto),
       mLastMsgTs(chatCreationTs), mIsGroup(isGroup)
 {
+    mMsgArena = new MessageArena(sizeof(Message));
     assert(mChatId);
     assert(mListener);
     assert(mCrypto);
@@ -1985,6 +2252,7 @@ Chat::Chat(Connection& conn, const Id& chatid, Listener* listener,
         loadAndProcessUnsent();
         getHistoryFromDb(initialHistoryFetchCount); // ensure we have a minimum set of messages loaded and ready
     }
+    loadLastMsgTs();
 
     calculateUnreadCount();
 }
@@ -2000,6 +2268,9 @@ Chat::~Chat()
     catch(std::exception& e)
     { CHATID_LOG_ERROR("EXCEPTION from DbInterface destructor: %s", e.what()); }
     mDbInterface = nullptr;
+    // the messages that are still alive keep it until they are deleted
+    mMsgArena->release();
+    mMsgArena = nullptr;
 }
 
 void Chat::disable(bool state)
@@ -2016,22 +2287,82 @@ void Chat::disable(bool state)
     }
 }
 
-Idx Chat::getHistoryFromDb(unsigned count)
+void Chat::fetchDbMessages(Idx highIdx, unsigned count, std::vector<Message*>& messages)
 {
-    assert(mHasMoreHistoryInDb); //we are within the db range
+    CALL_DB(fetchDbHistory, highIdx, count, messages);
+
+    // Load the reactions of the whole page from cache at once, instead of one query per message
+    std::map<karere::Id, std::vector<std::pair<std::string, karere::Id>>> reactions;
+    if (!messages.empty())
+    {
+        CALL_DB(getReactionsInRange, highIdx - static_cast<Idx>(messages.size()) + 1, highIdx, reactions);
+    }
+    for (auto msg: messages)
+    {
+        auto it = reactions.find(msg->id());
+        if (it != reactions.end())
+        {
+            for (auto& reaction : it->second)
+            {
+                // Add reaction to confirmed reactions queue in message
+                msg->addReaction(reaction.first, reaction.second);
+            }
+        }
+    }
+}
+
+bool Chat::hasEvictedHistory() const
+{
+    return mNextHistFetchIdx != CHATD_IDX_INVALID && !empty() && mNextHistFetchIdx < lownum() - 1;
+}
+
+// messages older than the evicted range are notified straight from db, since they can't be
+// added to the history buffer until the evicted range is loaded back
+Idx Chat::getEvictedHistoryFromDb(unsigned count)
+{
+    CHATID_LOG_DEBUG("Fetching history(%u) from db, below the evicted range [%d, %d]...", count, mNextHistFetchIdx + 1, lownum() - 1);
     std::vector<Message*> messages;
-    CALL_DB(fetchDbHistory, lownum()-1, count, messages);
+    fetchDbMessages(mNextHistFetchIdx, count, messages);
     for (auto msg: messages)
     {
-        // Load msg reactions from cache
-        std::vector<std::pair<std::string, karere::Id>> reactions;
-        CALL_DB(getReactions, msg->id(), reactions);
-        for (auto& reaction : reactions)
+        Idx idx = mNextHistFetchIdx--;
+        if (msg->type == Message::Type::kMsgAttachment)
         {
-            // Add reaction to confirmed reactions queue in message
-            msg->addReaction(reaction.first, reaction.second);
+            mAttachmentNodes->addMessage(*(new Message(*msg)), false, true);
         }
+        if (msg->backRefId)
+        {
+            mRefidToIdxMap.emplace(msg->backRefId, idx);
+        }
+        CALL_LISTENER(onRecvHistoryMessage, idx, *msg, getMsgStatus(*msg, idx), true);
+        delete msg;
+    }
+    return static_cast<Idx>(messages.size());
+}
 
+void Chat::reloadEvictedHistory()
+{
+    Idx highIdx = lownum() - 1;
+    unsigned count = static_cast<unsigned>(highIdx - mNextHistFetchIdx);
+    CHATID_LOG_DEBUG("Loading back %u evicted messages from db", count);
+
+    std::vector<Message*> messages;
+    fetchDbMessages(highIdx, count, messages);
+    mReloadingEvictedHistory = true;    // they have been notified already
+    for (auto msg: messages)
+    {
+        msgIncoming(false, msg, true);
+    }
+    mReloadingEvictedHistory = false;
+}
+
+Idx Chat::getHistoryFromDb(unsigned count)
+{
+    assert(mHasMoreHistoryInDb); //we are within the db range
+    std::vector<Message*> messages;
+    fetchDbMessages(lownum() - 1, count, messages);
+    for (auto msg: messages)
+    {
         msgIncoming(false, msg, true); //increments mLastHistFetch/DecryptCount, may reset mHasMoreHistoryInDb if this msgid == mLastKnownMsgid
     }
     if (mNextHistFetchIdx == CHATD_IDX_INVALID)
@@ -2043,13 +2374,17 @@ Idx Chat::getHistoryFromDb(unsigned count)
         mNextHistFetchIdx -= static_cast<Idx>(messages.size());
     }
 
-    // Load all pending reactions stored in cache
-    std::vector<PendingReaction> pendingReactions;
-    CALL_DB(getPendingReactions, pendingReactions);
-    for (auto &auxReaction : pendingReactions)
+    // Load all pending reactions stored in cache, only once per chat
+    if (!mPendingReactionsLoaded)
     {
-        // Add pending reaction to queue in chat
-        addPendingReaction(auxReaction.mReactionString, auxReaction.mReactionStringEnc, auxReaction.mMsgId, auxReaction.mStatus);
+        mPendingReactionsLoaded = true;
+        std::vector<PendingReaction> pendingReactions;
+        CALL_DB(getPendingReactions, pendingReactions);
+        for (auto &auxReaction : pendingReactions)
+        {
+            // Add pending reaction to queue in chat
+            addPendingReaction(auxReaction.mReactionString, auxReaction.mReactionStringEnc, auxReaction.mMsgId, auxReaction.mStatus);
+        }
     }
 
     CALL_LISTENER(onHistoryDone, kHistSourceDb);
@@ -2073,6 +2408,7 @@ Idx Chat::getHistoryFromDb(unsigned count)
         }
     }
 
+    mChatdClient.trimHistories(this);
     return static_cast<Idx>(messages.size());
 }
 
@@ -2091,7 +2427,37 @@ Idx Chat::getHistoryFromDb(unsigned count)
 void Connection::wsHandleMsgCb(char *data, size_t len)
 {
     mTsLastRecv = time(NULL);
+#ifdef KARERE_ENABLE_FRAME_CAPTURE
+    if (mChatdClient.mFrameCapture)
+    {
+        mChatdClient.mFrameCapture->addFrame(mShardNo, data, len);
+    }
+#endif
     execCommand(StaticBuffer(data, len));
+    endDbBatches();
+}
+
+void Connection::endDbBatches()
+{
+    for (const karere::Id& chatid: mDbBatchChats)
+    {
+        auto it = mChatdClient.mChatForChatId.find(chatid);
+        if (it == mChatdClient.mChatForChatId.end())
+        {
+            continue;
+        }
+
+        // out of the try/catch of execCommand(): an error must not prevent the other chats from being written
+        try
+        {
+            it->second->endDbBatch();
+        }
+        catch (std::exception& e)
+        {
+            CHATD_LOG_ERROR("chatid %s: failed to write batched history: %s", it->first.toString().c_str(), e.what());
+        }
+    }
+    mDbBatchChats.clear();
 }
 
 void Connection::wsSendMsgCb(const char *, size_t)
@@ -2100,6 +2466,34 @@ void Connection::wsSendMsgCb(const char *, size_t)
     mSendPromise.resolve();
 }
 
+void Connection::wsBackpressureCb(bool backpressured)
+{
+    if (backpressured)
+    {
+        return;
+    }
+
+    if (!mPendingRejoins.empty())
+    {
+        rejoinPendingChats();
+    }
+
+    // resume the output queues paused by flushOutputQueue()
+    for (const karere::Id& chatid: mChatIds)
+    {
+        if (!isOnline() || wsIsBackpressured())
+        {
+            break;
+        }
+
+        auto it = mChatdClient.mChatForChatId.find(chatid);
+        if (it != mChatdClient.mChatForChatId.end())
+        {
+            it->second->flushOutputQueue();
+        }
+    }
+}
+
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
 bool Connection::wsSSLsessionUpdateCb(const CachedSession &sess)
 {
@@ -2185,9 +2579,11 @@ void Connection::execCommand(const StaticBuffer& buf)
                     ID_CSTR(chatid), Command::opcodeToStr(opcode), ID_CSTR(msgid),
                     ID_CSTR(userid), keyid, ts, updated);
 
-                std::unique_ptr<Message> msg(new Message(msgid, userid, ts, updated, msgdata, msglen, false, keyid));
-                msg->setEncrypted(Message::kEncryptedPending);
                 Chat& chat = mChatdClient.chats(chatid);
+                std::unique_ptr<Message> msg(mChatdClient.mMsgArenaEnabled
+                        ? new (chat.msgArena()) Message(msgid, userid, ts, updated, msgdata, msglen, false, keyid)
+                        : new Message(msgid, userid, ts, updated, msgdata, msglen, false, keyid));
+                msg->setEncrypted(Message::kEncryptedPending);
                 if (opcode == OP_MSGUPD)
                 {
                     chat.onMsgUpdated(msg.release());
@@ -2196,6 +2592,7 @@ void Connection::execCommand(const StaticBuffer& buf)
                 {
                     if (!chat.isFetchingNodeHistory() || opcode == OP_NEWMSG)
                     {
+                        chat.beginDbBatch();
                         chat.msgIncoming((opcode == OP_NEWMSG), msg.release(), false);
                     }
                     else
@@ -2753,8 +3150,35 @@ void Chat::onNewKeys(StaticBuffer&& keybuf)
     }
 }
 
+void Chat::beginDbBatch()
+{
+    if (mDbBatchActive)
+    {
+        return;
+    }
+
+    CALL_DB(beginBatch);
+    mDbBatchActive = true;
+    mConnection.mDbBatchChats.insert(mChatId);
+}
+
+void Chat::endDbBatch()
+{
+    if (!mDbBatchActive)
+    {
+        return;
+    }
+
+    mDbBatchActive = false;
+    CALL_DB(endBatch);
+}
+
 void Chat::onHistDone()
 {
+    // the history chunk is complete, write it before processing the HISTDONE
+    endDbBatch();
+    CALL_CRYPTO(msgDecryptFlush);
+
     FetchType fetchType = mFetchRequest.front();
     mFetchRequest.pop();
     if (fetchType == FetchType::kFetchMessages)
@@ -3088,6 +3512,7 @@ void Chat::onReactionReject(const karere::Id &msgId)
             if (message)
             {
                 CALL_LISTENER(onReactionUpdate, msgId, reaction.mReactionString.c_str(), message->getReactionCount(reaction.mReactionString));
+                updateMsgMemory(*message);
             }
         }
     }
@@ -3124,6 +3549,7 @@ void Chat::flushChatPendingReactions()
         {
             const Message &message = at(index);
             CALL_LISTENER(onReactionUpdate, message.mId, reaction.mReactionString.c_str(), message.getReactionCount(reaction.mReactionString));
+            updateMsgMemory(message);
         }
         CALL_DB(cleanPendingReactions, reaction.mMsgId);
     }
@@ -3231,8 +3657,7 @@ uint64_t Chat::generateRefId(const ICrypto* aCrypto)
 
 void Chat::initChat()
 {
-    mBackwardList.clear();
-    mForwardList.clear();
+    clear();
     mIdToIndexMap.clear();
     if (mAttachmentNodes)
     {
@@ -3444,6 +3869,7 @@ void Chat::removeMessageReactions(Idx idx, bool cleanPrevious)
     if (msg)
     {
         msg->cleanReactions();
+        updateMsgMemory(*msg);
 
         (cleanPrevious)
                 ? cleanPendingReactionsOlderThan(idx)
@@ -3834,6 +4260,7 @@ Message* Chat::msgModify(Message& msg, const char* newdata, size_t newlen, void*
         // update original content+delta of the message being edited...
         msg.updated = static_cast<uint16_t>(age);
         msg.assign((void*)newdata, newlen);
+        updateMsgMemory(msg);
         // ...and also for all messages with same msgid in the sending queue , trying to avoid sending the original content
         int count = 0;
         for (auto& it: mSending)
@@ -3988,6 +4415,7 @@ void Chat::onLastReceived(const Id& msgid)
         if (msg.userid == mChatdClient.mMyHandle)
         {
             CALL_LISTENER(onMessageStatusChange, i, Message::kDelivered, msg);
+            updateMsgMemory(msg);
         }
     }
 }
@@ -4089,6 +4517,7 @@ void Chat::onLastSeen(const Id& msgid, bool resend)
             if (msg.userid != mChatdClient.mMyHandle)
             {
                 CALL_LISTENER(onMessageStatusChange, i, Message::kSeen, msg);
+                updateMsgMemory(msg);
             }
         }
     }
@@ -4145,6 +4574,7 @@ bool Chat::setMessageSeen(Idx idx)
             if (m.userid != mChatdClient.mMyHandle)
             {
                 CALL_LISTENER(onMessageStatusChange, i, Message::kSeen, m);
+                updateMsgMemory(m);
             }
         }
         mLastSeenId = id;
@@ -4183,6 +4613,14 @@ void Chat::flushOutputQueue(bool fromStart)
 
     while (mNextUnsent != mSending.end())
     {
+        // after a reconnect the whole queue is resent: it's paced like the rejoins, or the send
+        // queue may reach its hard limit and close the socket. The rest is sent once it drains
+        if (mConnection.wsIsBackpressured())
+        {
+            CHATID_LOG_DEBUG("flushOutputQueue: output queue is backpressured, pending messages will be sent later");
+            return;
+        }
+
         //kickstart encryption
         //return true if we encrypted at least one message
         if (!msgEncryptAndSend(mNextUnsent++))
@@ -4246,6 +4684,20 @@ void Chat::handlejoinRangeHist(const ChatDbInfo& dbInfo)
     sendCommand(comm + dbInfo.getOldestDbId() + at(highnum()).id());
 }
 
+void Client::replayFrame(int shardNo, const char* data, size_t len)
+{
+    auto it = mConnections.find(shardNo);
+    if (it == mConnections.end())
+    {
+        CHATD_LOG_WARNING("replayFrame: no connection for shard %d", shardNo);
+        return;
+    }
+
+    Connection& conn = *it->second;
+    conn.execCommand(StaticBuffer(data, len));
+    conn.endDbBatches();
+}
+
 Client::~Client()
 {
     cancelSeenTimers();
@@ -4376,7 +4828,8 @@ Idx Chat::msgConfirm(const Id& msgxid, const Id& msgid, uint32_t timestamp)
 
     // add message to history
     push_forward(msg);
-    auto idx = mIdToIndexMap[msgid] = highnum();
+    Idx idx = highnum();
+    mIdToIndexMap.set(msgid, idx);
     if (msg->type == Message::kMsgAttachment)
     {
         mAttachmentNodes->addMessage(*msg, true, false);
@@ -4418,6 +4871,7 @@ Idx Chat::msgConfirm(const Id& msgxid, const Id& msgid, uint32_t timestamp)
     }
 
     CALL_LISTENER(onMessageConfirmed, msgxid, *msg, idx, tsUpdated);
+    updateMsgMemory(*msg);
 
     // if first message is own msg we need to init mNextHistFetchIdx to avoid loading own messages twice
     if (mNextHistFetchIdx == CHATD_IDX_INVALID && size() == 1)
@@ -4777,6 +5231,7 @@ void Chat::onMsgUpdatedAfterDecrypt(time_t updateTs, bool richLinkRemoved, Messa
         {
             CHATID_LOG_DEBUG("onMessageEdited() skipped for not-loaded-yet (by the app) message");
         }
+        updateMsgMemory(histmsg);
 
         if (msg->isDeleted())
         {
@@ -4830,6 +5285,19 @@ void Chat::onMsgUpdatedAfterDecrypt(time_t updateTs, bool richLinkRemoved, Messa
         {
             //update in db
             CALL_DB(updateMsgInHistory, msg->id(), *msg);
+
+            // the message may have been notified to the app, and evicted later (see trimHistory())
+            Idx evictedIdx = hasEvictedHistory() ? mDbInterface->getIdxOfMsgidFromHistory(msg->id()) : CHATD_IDX_INVALID;
+            if (evictedIdx != CHATD_IDX_INVALID && evictedIdx > mNextHistFetchIdx && evictedIdx < lownum())
+            {
+                std::vector<Message*> messages;
+                fetchDbMessages(evictedIdx, 1, messages);
+                if (!messages.empty())
+                {
+                    CALL_LISTENER(onMessageEdited, *messages.front(), evictedIdx);
+                    delete messages.front();
+                }
+            }
         }
 
         if (msg->isDeleted()) // previous type is unknown, so cannot check for attachment type here
@@ -5064,9 +5532,14 @@ ChatDbInfo Chat::getDbHistInfoAndInitOldestKnownMsgId()
 {
     ChatDbInfo info;
     mDbInterface->getHistoryInfo(info);
+    initOldestKnownMsgId(info);
+    return info;
+}
+
+void Chat::initOldestKnownMsgId(const ChatDbInfo& info)
+{
     mOldestKnownMsgId = info.getOldestDbId(); // if no db history, getHistoryInfo stores Id::null() at ChatDbInfo::oldestDbId
     mOldestIdxInDb = info.getOldestDbIdx();   // if no db history, getHistoryInfo stores CHATD_IDX_INVALID at ChatDbInfo::oldestDbIdx
-    return info;
 }
 
 bool Chat::hasMoreHistoryInDb() const
@@ -5091,6 +5564,10 @@ void Chat::deleteOlderMessagesIncluding(Idx idx)
     if (idx >= mForwardStart)
     {
         // clear backward list
+        for (const auto& msg: mBackwardList)
+        {
+            accountMsgMemory(*msg, 0);
+        }
         mBackwardList.clear();
 
         auto endOffset = idx - mForwardStart + 1; // increment 1 to include own idx
@@ -5103,6 +5580,10 @@ void Chat::deleteOlderMessagesIncluding(Idx idx)
         }
 
         // remove messages from mForwardList
+        for (auto it = itStart; it != itEnd; it++)
+        {
+            accountMsgMemory(**it, 0);
+        }
         mForwardList.erase(itStart, itEnd);
         mForwardStart += endOffset;
     }
@@ -5125,18 +5606,101 @@ void Chat::deleteOlderMessagesIncluding(Idx idx)
         }
 
         // remove messages from mBackwardList
+        for (auto it = itStart; it != itEnd; it++)
+        {
+            accountMsgMemory(**it, 0);
+        }
         mBackwardList.erase(itStart, itEnd);
     }
 
     // remove all entries whose idx is <= than idx provided as param
-    for (auto it = mIdToIndexMap.begin(); it != mIdToIndexMap.end();)
+    mIdToIndexMap.eraseUpTo(idx);
+}
+
+void Chat::clear()
+{
+    mBackwardList.clear();
+    mForwardList.clear();
+    mChatdClient.mHistoryMemory -= mHistoryMemory;
+    mHistoryMemory = 0;
+}
+
+void Chat::accountMsgMemory(const Message& msg, size_t usage)
+{
+    mChatdClient.mHistoryMemory = mChatdClient.mHistoryMemory - msg.historyMemory + usage;
+    mHistoryMemory = mHistoryMemory - msg.historyMemory + usage;
+    msg.historyMemory = usage;
+}
+
+void Chat::updateMsgMemory(const Message& msg)
+{
+    if (msg.historyMemory)
     {
-        auto auxit = it++;
-        if (auxit->second <= idx)
+        accountMsgMemory(msg, msg.memoryUsage());
+    }
+}
+
+size_t Chat::updateHistoryMemory()
+{
+    for (const auto& msg: mBackwardList)
+    {
+        accountMsgMemory(*msg, msg->memoryUsage());
+    }
+    for (const auto& msg: mForwardList)
+    {
+        accountMsgMemory(*msg, msg->memoryUsage());
+    }
+    return mHistoryMemory;
+}
+
+bool Chat::canEvictHistory() const
+{
+    // messages being fetched or decrypted are referenced from outside of the history buffer
+    return !empty()
+            && !isFetchingFromServer()
+            && mDecryptOldHaltedAt == CHATD_IDX_INVALID
+            && mDecryptNewHaltedAt == CHATD_IDX_INVALID;
+}
+
+size_t Chat::trimHistory(size_t budget)
+{
+    if (mHistoryMemory <= budget || !canEvictHistory())
+    {
+        return 0;
+    }
+
+    // keep the newest messages. Those already notified to the app are kept too, unless the app has
+    // older history to load from db (the evicted range is loaded back before fetching from server)
+    Idx last = highnum() - kMinHistoryInRam;
+    if (mNextHistFetchIdx != CHATD_IDX_INVALID && mNextHistFetchIdx < last
+            && (mOldestIdxInDb == CHATD_IDX_INVALID || mNextHistFetchIdx < mOldestIdxInDb))
+    {
+        last = mNextHistFetchIdx;
+    }
+
+    size_t released = 0;
+    Idx idx = lownum();
+    for (; idx <= last && mHistoryMemory - released > budget; idx++)
+    {
+        const Message& msg = at(idx);
+        if (msg.isPendingToDecrypt() || msg.isEncrypted() == Message::kEncryptedNoType)
         {
-            mIdToIndexMap.erase(auxit);
+            // still being decrypted, see msgIncomingAfterAdd()
+            break;
         }
+        released += msg.memoryUsage();
     }
+    if (idx == lownum())
+    {
+        return 0;
+    }
+
+    CHATID_LOG_DEBUG("trimHistory: evicting %d messages [%d, %d] from RAM (%zu bytes)", idx - lownum(), lownum(), idx - 1, released);
+    deleteOlderMessagesIncluding(idx - 1);  // updates the memory accounting
+
+    // evicted messages are in db, so they will be loaded by getHistoryFromDb()
+    mHasMoreHistoryInDb = hasMoreHistoryInDb();
+    return released;
 }
 
 Message::Status Chat::getMsgStatus(const Message& msg, Idx idx) const
@@ -5198,7 +5762,7 @@ Idx Chat::msgIncoming(bool isNew, Message* message, bool isLocal)
 
         push_forward(message);
         idx = highnum();
-        mIdToIndexMap[msgid] = idx;
+        mIdToIndexMap.set(msgid, idx);
 
         if (!mOldestKnownMsgId)
             mOldestKnownMsgId = msgid;
@@ -5229,7 +5793,7 @@ Idx Chat::msgIncoming(bool isNew, Message* message, bool isLocal)
                 //all history is in RAM, determine the index from RAM
                 push_back(message);
                 idx = lownum();
-                mIdToIndexMap[msgid] = idx;
+                mIdToIndexMap.set(msgid, idx);
             }
             //shouldn't we update this only after we save the msg to db?
             mOldestKnownMsgId = msgid;
@@ -5238,7 +5802,7 @@ Idx Chat::msgIncoming(bool isNew, Message* message, bool isLocal)
         {
             push_back(message);
             idx = lownum();
-            mIdToIndexMap[msgid] = idx;
+            mIdToIndexMap.set(msgid, idx);
             if (msgid == mOldestKnownMsgId)
             //we have just processed the oldest message from the db
                 mHasMoreHistoryInDb = false;
@@ -5340,6 +5904,7 @@ bool Chat::msgIncomingAfterAdd(bool isNew, bool isLocal, Message& msg, Idx idx)
         if (mDecryptNewHaltedAt != CHATD_IDX_INVALID)
         {
             CHATID_LOG_DEBUG("Decryption of new messages is halted, message queued for decryption");
+            mCrypto->msgDecryptPrefetch(msg);
             return false;
         }
     }
@@ -5348,6 +5913,7 @@ bool Chat::msgIncomingAfterAdd(bool isNew, bool isLocal, Message& msg, Idx idx)
         if (mDecryptOldHaltedAt != CHATD_IDX_INVALID)
         {
             CHATID_LOG_DEBUG("Decryption of old messages is halted, message queued for decryption");
+            mCrypto->msgDecryptPrefetch(msg);
             return false;
         }
     }
@@ -5559,9 +6125,14 @@ void Chat::msgIncomingAfterDecrypt(bool isNew, bool isLocal, Message& msg, Idx i
         mAttachmentNodes->addMessage(!isNew && isLocal ? *(new Message(msg)): msg, isNew, isLocal);
     }
 
-    if (msg.backRefId && !mRefidToIdxMap.emplace(msg.backRefId, idx).second)
+    if (msg.backRefId)
     {
-        CALL_LISTENER(onMsgOrderVerificationFail, msg, idx, "A message with that backrefId "+std::to_string(msg.backRefId)+" already exists");
+        // the refids of evicted messages are kept, so a message reloaded from DB finds its own entry
+        auto ret = mRefidToIdxMap.emplace(msg.backRefId, idx);
+        if (!ret.second && ret.first->second != idx)
+        {
+            CALL_LISTENER(onMsgOrderVerificationFail, msg, idx, "A message with that backrefId "+std::to_string(msg.backRefId)+" already exists");
+        }
     }
 
     if (isPublic() && msg.userid != mChatdClient.mMyHandle)
@@ -5587,11 +6158,12 @@ void Chat::msgIncomingAfterDecrypt(bool isNew, bool isLocal, Message& msg, Idx i
         // local messages are obtained on-demand, so if isLocal,
         // then always send to app
         bool isChatRoomOpened = mChatdClient.mKarereClient->isChatRoomOpened(mChatId);
-        if (isLocal || (mServerOldHistCbEnabled && isChatRoomOpened))
+        if ((isLocal && !mReloadingEvictedHistory) || (!isLocal && mServerOldHistCbEnabled && isChatRoomOpened))
         {
             CALL_LISTENER(onRecvHistoryMessage, idx, msg, status, isLocal);
         }
     }
+    updateMsgMemory(msg);   // decrypted content, and the snapshot the app may have built
     if (msg.type == Message::kMsgTruncate)
     {
         if (isNew)
@@ -6036,6 +6608,9 @@ void Chat::resetGetHistory()
 {
     mNextHistFetchIdx = CHATD_IDX_INVALID;
     mServerOldHistCbEnabled = false;
+
+    // the history loaded by the app can be evicted now
+    mChatdClient.trimHistories(this);
 }
 
 void Chat::setOnlineState(ChatState state)
@@ -6051,6 +6626,7 @@ void Chat::setOnlineState(ChatState state)
 
     if (state == kChatStateOnline)
     {
+        mConnection.onChatOnline(mChatId);
         if (mChatdClient.areAllChatsLoggedIn(connection().shardNo()))
         {
             mChatdClient.mKarereClient->initStats().shardEnd(InitStats::kStatsLoginChatd, static_cast<uint8_t>(connection().shardNo()));
@@ -6171,8 +6747,39 @@ uint8_t Chat::lastTextMessage(LastTextMsg*& msg)
     return mLastTextMsg.state();
 }
 
+void Chat::loadLastMsgTs()
+{
+    // the chat list is sorted by this ts, and the room is indexed before its last message is
+    // looked for (by findLastTextMsg(), which corrects it if needed)
+    for (auto it = mSending.rbegin(); it != mSending.rend(); it++)
+    {
+        if (it->msg->isValidLastMessage())
+        {
+            mLastMsgTs = it->msg->ts;
+            return;
+        }
+    }
+
+    uint32_t ts = mDbInterface->getLastTextMessageTs();
+    if (ts)
+    {
+        mLastMsgTs = ts;
+    }
+}
+
 bool Chat::findLastTextMsg()
 {
+    // the last message ts may change below (even if no message is found), and the chat list needs it
+    uint32_t lastMsgTs = mLastMsgTs;
+    auto done = [this, lastMsgTs](bool result)
+    {
+        if (mLastMsgTs != lastMsgTs)
+        {
+            CALL_LISTENER(onLastMessageTsLoaded, mLastMsgTs);
+        }
+        return result;
+    };
+
     if (!mSending.empty())
     {
         for (auto it = mSending.rbegin(); it!= mSending.rend(); it++)
@@ -6184,7 +6791,7 @@ bool Chat::findLastTextMsg()
                 mLastTextMsg.assign(msg, CHATD_IDX_INVALID);
                 mLastMsgTs = msg.ts;
                 CHATID_LOG_DEBUG("lastTextMessage: Text message found in send queue");
-                return true;
+                return done(true);
             }
         }
     }
@@ -6200,7 +6807,7 @@ bool Chat::findLastTextMsg()
                 mLastTextMsg.assign(msg, i);
                 mLastMsgTs = msg.ts;
                 CHATID_LOG_DEBUG("lastTextMessage: Text message found in RAM");
-                return true;
+                return done(true);
             }
         }
         //check in db
@@ -6208,13 +6815,13 @@ bool Chat::findLastTextMsg()
         if (mLastTextMsg.isValid())
         {
             CHATID_LOG_DEBUG("lastTextMessage: Text message found in DB");
-            return true;
+            return done(true);
         }
     }
     if (mHaveAllHistory)
     {
         assert(!mLastTextMsg.isValid());
-        return true;
+        return done(true);
     }
 
     CHATID_LOG_DEBUG("lastTextMessage: No text message found locally");
@@ -6246,7 +6853,7 @@ bool Chat::findLastTextMsg()
 
     }, mChatdClient.mKarereClient->appCtx);
 
-    return false;
+    return done(false);
 }
 
 void Chat::findAndNotifyLastTextMsg()
@@ -6384,92 +6991,19 @@ const char* Message::statusNames[] =
 
 bool Message::hasUrl(const string &text, string &url)
 {
-    std::string::size_type position = 0;
-    std::string partialString;
-    while (position < text.size())
+    std::string_view found = findUrl(text);
+    if (found.empty())
     {
-        char character = text[position];
-        if ((character >= 33 && character <= 126)
-                && character != '"'
-                && character != '\''
-                && character != '\\'
-                && character != '<'
-                && character != '>'
-                && character != '{'
-                && character != '}'
-                && character != '|')
-        {
-            partialString.push_back(character);
-        }
-        else
-        {
-            if (!partialString.empty())
-            {
-                removeUnnecessaryFirstCharacters(partialString);
-                removeUnnecessaryLastCharacters(partialString);
-                if (parseUrl(partialString))
-                {
-                    url = partialString;
-                    return true;
-                }
-            }
-
-            partialString.clear();
-        }
-
-        position ++;
-    }
-
-    if (!partialString.empty())
-    {
-        removeUnnecessaryFirstCharacters(partialString);
-        removeUnnecessaryLastCharacters(partialString);
-        if (parseUrl(partialString))
-        {
-            url = partialString;
-            return true;
-        }
+        return false;
     }
 
-    return false;
+    url.assign(found.data(), found.size());
+    return true;
 }
 
 bool Message::parseUrl(const std::string &url)
 {
-    if (url.find('.') == std::string::npos)
-    {
-        return false;
-    }
-
-    if (isValidEmail(url))
-    {
-        return false;
-    }
-
-    std::string urlToParse = url;
-    std::string::size_type position = urlToParse.find("://");
-    if (position != std::string::npos)
-    {
-        std::regex expresion("^(http://|https://)(.+)");
-        if (regex_match(urlToParse, expresion))
-        {
-            urlToParse = urlToParse.substr(position + 3);
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    std::regex megaUrlExpression("((WWW.|www.)?mega.+(nz/|co.nz/)).*((#F!|#!|C!|chat/|file/|folder/)[a-z0-9A-Z-._~:/?#!$&'()*+,;= \\-@]+)$");
-    if (regex_match(urlToParse, megaUrlExpression))
-    {
-        return false;
-    }
-
-    std::regex regularExpresion("((^([0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}))|((^(WWW.|www.))?([a-z0-9A-Z]+)([a-z0-9A-Z-._~?#!$&'()*+,;=])*([a-z0-9A-Z]+)([.]{1}[a-zA-Z]{2,5}){1,2}))([:]{1}[0-9]{1,5})?([/]{1}[a-z0-9A-Z-._~:?#/@!$&'()*+,;=]*)?$");
-
-    return regex_match(urlToParse, regularExpresion);
+    return chatd::parseUrl(url);
 }
 
 Chat::SendingItem::SendingItem(uint8_t aOpcode, Message *aMsg, const SetOfIds &aRcpts, uint64_t aRowid)
@@ -6544,8 +7078,7 @@ void Message::removeUnnecessaryFirstCharacters(string &buf)
 
 bool Message::isValidEmail(const string &buf)
 {
-    std::regex regularExpresion("^[a-z0-9A-Z._%+-]+@[a-z0-9A-Z.-]+[.][a-zA-Z]{2,6}");
-    return regex_match(buf, regularExpresion);
+    return chatd::isValidEmail(buf);
 }
 
 FilteredHistory::FilteredHistory(DbInterface &db, Chat &chat)
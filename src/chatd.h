@@ -12,6 +12,8 @@
 #include <base/timers.hpp>
 #include <base/trackDelete.h>
 #include <chatdMsg.h>
+#include <chatdIdxMap.h>
+#include <chatdCapture.h>
 #include <url.h>
 #include <net/websocketsIO.h>
 #include <userAttrCache.h>
@@ -317,6 +319,15 @@ public:
      */
     virtual void onLastMessageTsUpdated(uint32_t /*ts*/) {}
 
+    /**
+     * @brief Called when the timestamp of the last message has changed because the last
+     * text message has been looked up (see Chat::lastTextMessage()). The app is not notified
+     * with onLastMessageTsUpdated(), since it gets the new timestamp with the message it
+     * asked for, but the timestamp may be needed to keep the chat list in order.
+     * @param ts The new timestamp of the last message
+     */
+    virtual void onLastMessageTsLoaded(uint32_t /*ts*/) {}
+
     /**
      * @brief Called when the number of users that reacted to a message with a
      * specific reaction has changed.
@@ -413,7 +424,9 @@ public:
         kIdleTimeout = 64,              // (in seconds) chatd closes connection after 48-64s of not receiving a response
         kEchoTimeout = 1,               // (in seconds) echo to check connection is alive when back to foreground
         kConnectTimeout = 30,           // (in seconds) timeout reconnection to succeeed
-        kMaxConnSucceededTimeframe = 30 // (in seconds) timeout after we will re-fetch a fresh URL if successful connections has exceeded kMaxConnSuceeded
+        kMaxConnSucceededTimeframe = 30,// (in seconds) timeout after we will re-fetch a fresh URL if successful connections has exceeded kMaxConnSuceeded
+        kRejoinBatchSize = 256,         // chats rejoined together: their db info is loaded at once and their commands are packed
+        kMaxPackedFrameSize = 16384     // (in bytes) maximum size of a frame of packed commands
     };
 
     /* Limit of successful connections established during the last kMaxConnSucceededTimeframe seconds
@@ -441,6 +454,23 @@ protected:
     /** When enabled, hearbeat() method is called periodically */
     bool mHeartbeatEnabled = false;
 
+    /** Chats with db writes batched while processing the current frame */
+    std::set<karere::Id> mDbBatchChats;
+
+    /** Chats waiting to be rejoined after a reconnection, until the send queue is not backpressured.
+     * Chats opened by the app go first, and then the most recently active ones */
+    std::deque<karere::Id> mPendingRejoins;
+
+    /** When enabled, commands are packed into mPackedCommands instead of sending a frame for each one */
+    bool mPackingCommands = false;
+    Buffer mPackedCommands;
+
+    /** Metrics of the last rejoin: start (in ms), chats pending to be online, chats and frames sent */
+    int64_t mRejoinStartTs = 0;
+    std::set<karere::Id> mRejoinPendingOnline;
+    size_t mRejoinChats = 0;
+    size_t mRejoinFrames = 0;
+
     /** Target IP address being used for the reconnection in-flight */
     std::string mTargetIp;
 
@@ -481,6 +511,7 @@ protected:
     void wsCloseCb(int errcode, int errtype, const char *preason, size_t preason_len) override;
     void wsHandleMsgCb(char *data, size_t len) override;
     void wsSendMsgCb(const char *, size_t) override;
+    void wsBackpressureCb(bool backpressured) override;
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
     bool wsSSLsessionUpdateCb(const CachedSession &sess) override;
 #endif
@@ -492,12 +523,19 @@ protected:
     void doConnect();
 // Destroys the buffer content
     bool sendBuf(Buffer&& buf);
+    bool sendFrame(Buffer&& buf);
+    void beginPackCommands();
+    bool endPackCommands();
+    bool sendPackedCommands();
     bool rejoinExistingChats();
+    bool rejoinPendingChats();
+    void onChatOnline(const karere::Id& chatid);
     void resendPending();
     void join(const karere::Id& chatid);
     void hist(const karere::Id& chatid, long count);
     bool sendCommand(Command&& cmd); // used internally only for OP_HELLO
     void execCommand(const StaticBuffer& buf);
+    void endDbBatches();
     promise::Promise<void> sendKeepalive();
     void sendEcho();
 
@@ -780,9 +818,12 @@ protected:
     std::unique_ptr<FilteredHistory> mAttachmentNodes;
     OutputQueue mSending;
     PendingReactions mPendingReactions;
+    // pending reactions are loaded from db along with the first page of history, they are
+    // kept in sync with the db afterwards
+    bool mPendingReactionsLoaded = false;
     OutputQueue::iterator mNextUnsent;
     bool mIsFirstJoin = true;
-    std::map<karere::Id, Idx> mIdToIndexMap;
+    IdxMap<karere::Id, Idx> mIdToIndexMap;
     karere::Id mLastReceivedId;
     Idx mLastReceivedIdx = CHATD_IDX_INVALID;
     karere::Id mLastSeenId;
@@ -820,7 +861,19 @@ protected:
     bool mIsDisabled = false;
     Idx mNextHistFetchIdx = CHATD_IDX_INVALID;
     Idx mOldestIdxInDb = CHATD_IDX_INVALID;
+    /** Estimated RAM used by the messages of the history buffer, updated as they are added,
+     * updated and removed (see updateMsgMemory()). Also accounted in Client::mHistoryMemory */
+    size_t mHistoryMemory = 0;
+    /** True while the messages evicted after being notified to the app are loaded back, so
+     * they are not notified again. See reloadEvictedHistory() */
+    bool mReloadingEvictedHistory = false;
+    /** Value of Client::mHistoryAccessSeq when the app requested history the last time, to evict LRU chats first */
+    uint64_t mHistoryAccessSeq = 0;
     DbInterface* mDbInterface = nullptr;
+    /** True while history writes are being collected by the DbInterface, see \c beginDbBatch() */
+    bool mDbBatchActive = false;
+    /** Allocator of the messages received from chatd, released (not deleted) in the destructor */
+    MessageArena* mMsgArena = nullptr;
     // last text message stuff
     LastTextMsgState mLastTextMsg;
     // crypto stuff
@@ -878,16 +931,17 @@ protected:
     uint32_t mRetentionTime = 0;
     // ====
     std::map<karere::Id, Message*> mPendingEdits;
-    std::map<BackRefId, Idx> mRefidToIdxMap;
+    IdxMap<BackRefId, Idx> mRefidToIdxMap;
     Chat(Connection& conn, const karere::Id& chatid, Listener* listener,
     const karere::SetOfIds& users, uint32_t chatCreationTs, ICrypto* crypto, bool isGroup);
-    void push_forward(Message* msg) { mForwardList.emplace_back(msg); }
-    void push_back(Message* msg) { mBackwardList.emplace_back(msg); }
-    void clear()
-    {
-        mBackwardList.clear();
-        mForwardList.clear();
-    }
+    void push_forward(Message* msg) { mForwardList.emplace_back(msg); accountMsgMemory(*msg, msg->memoryUsage()); }
+    void push_back(Message* msg) { mBackwardList.emplace_back(msg); accountMsgMemory(*msg, msg->memoryUsage()); }
+    void clear();
+    /** Sets the RAM accounted for \c msg, which is in the history buffer (zero when it's removed) */
+    void accountMsgMemory(const Message& msg, size_t usage);
+    /** Updates the RAM accounted for \c msg after it has changed in place (content, reactions,
+     * snapshot built by the app...). Messages that are not in the history buffer are ignored */
+    void updateMsgMemory(const Message& msg);
     // msgid can be 0 in case of rejections
     Idx msgConfirm(const karere::Id& msgxid, const karere::Id& msgid, uint32_t timestamp = 0);
     bool msgAlreadySent(const karere::Id& msgxid, const karere::Id& msgid);
@@ -909,6 +963,12 @@ protected:
     void requestHistoryFromServer(int32_t count);
     Idx getHistoryFromDb(unsigned count);
     HistSource getHistoryFromDbOrServer(unsigned count);
+    // loads up to \c count messages from db, from \c highIdx backwards, with their reactions
+    void fetchDbMessages(Idx highIdx, unsigned count, std::vector<Message*>& messages);
+    // true if messages already notified to the app have been evicted (see trimHistory())
+    bool hasEvictedHistory() const;
+    Idx getEvictedHistoryFromDb(unsigned count);
+    void reloadEvictedHistory();
     void onLastReceived(const karere::Id& msgid);
     void onLastSeen(const karere::Id& msgid, bool resend = true);
     void handleLastReceivedSeen(const karere::Id& msgid);
@@ -920,8 +980,11 @@ protected:
     karere::Id makeRandomId();
     void resetOldestKnownMsgId();
     bool hasMoreHistoryInDb() const;
+    bool canEvictHistory() const;
     ChatDbInfo getDbHistInfoAndInitOldestKnownMsgId();
-    void login();
+    void initOldestKnownMsgId(const ChatDbInfo& info);
+    // dbInfo may have been loaded together with other chats, otherwise it's loaded from db
+    void login(const ChatDbInfo* dbInfo = nullptr);
     void join();
     void handlejoin();
     void handleleave();
@@ -929,6 +992,8 @@ protected:
     void handlejoinRangeHist(const ChatDbInfo& dbInfo);
     void onDisconnect();
     void onHistDone(); //called upont receipt of HISTDONE from server
+    void beginDbBatch(); //history received until endDbBatch() is written to db at once
+    void endDbBatch();
     void onFetchHistDone(); //called by onHistDone() if we are receiving old history (not new, and not via JOINRANGEHIST)
     void onNewKeys(StaticBuffer&& keybuf);
     void logSend(const Command& cmd) const;
@@ -958,6 +1023,8 @@ public:
     /** @brief The chatd client */
     Client& client() const { return mChatdClient; }
     Connection& connection() const { return mConnection; }
+    /** @brief Allocator of the messages received in this chat */
+    MessageArena& msgArena() const { return *mMsgArena; }
     /** @brief The lowest index of a message in the RAM history buffer */
     Idx lownum() const { return mForwardStart - static_cast<Idx>(mBackwardList.size()); }
     /** @brief The highest index of a message in the RAM history buffer */
@@ -1169,6 +1236,32 @@ public:
      */
     void resetGetHistory();
 
+    /** @brief Minimum number of the newest messages that are always kept in the history buffer */
+    static const Idx kMinHistoryInRam = 32;
+
+    /** @brief Estimated RAM used by the messages of the history buffer */
+    size_t historyMemory() const { return mHistoryMemory; }
+
+    /** @brief Recalculates the RAM used by the messages of the history buffer, and returns it.
+     * It walks the whole buffer: the estimation is kept up to date without it, except for the
+     * snapshots built by the app outside of the notifications of the messages */
+    size_t updateHistoryMemory();
+
+    /**
+     * @brief Evicts the oldest messages of the history buffer until the RAM they use is
+     * within \c budget. Evicted messages remain in the history db, and they are loaded
+     * again by getHistory() when the app requests them.
+     *
+     * Messages notified to the app since the last resetGetHistory() are evicted too while
+     * the app has older history to load from db: the next pages are loaded from db without
+     * adding them to RAM, and the updates of the evicted messages are notified from db. The
+     * evicted range is loaded back before fetching history from server. Otherwise they are
+     * kept. The newest kMinHistoryInRam messages are always kept.
+     *
+     * @return The estimated RAM released, in bytes
+     */
+    size_t trimHistory(size_t budget);
+
     /**
      * @brief setMessageSeen Move the last-seen-by-us pointer to the message with the
      * specified index.
@@ -1479,6 +1572,9 @@ protected:
     void replayUnsentNotifications();
     void onLastTextMsgUpdated(const Message& msg, Idx idx=CHATD_IDX_INVALID);
     bool findLastTextMsg();
+    /** Sets the last message ts from the send queue or the db, without looking for the message
+     * itself, so the chat list is sorted correctly from the start */
+    void loadLastMsgTs();
     /**
      * @brief Initiates loading of the queue with messages that require user
      * approval for re-sending */
@@ -1502,6 +1598,16 @@ protected:
     // maps a chatid to the handling Shard connection
     std::map<karere::Id, Connection*> mConnectionForChatId;
 
+    /** Maximum RAM for the history buffer of each chat and for all of them, in bytes (zero means unlimited) */
+    size_t mChatHistoryMemoryBudget = 0;
+    size_t mHistoryMemoryBudget = 0;
+
+    /** Sum of Chat::historyMemory() of all chats. Declared before mChatForChatId, since chats update it upon destruction */
+    size_t mHistoryMemory = 0;
+
+    /** Incremented every time the app requests history of any chat (see Chat::mHistoryAccessSeq) */
+    uint64_t mHistoryAccessSeq = 0;
+
     // maps chatids to the Chat object
     std::map<karere::Id, std::shared_ptr<Chat>> mChatForChatId;
 
@@ -1535,6 +1641,14 @@ protected:
     /** Timestamp of the next check of retention history for all chats, or zero (disabled) */
     uint32_t mRetentionCheckTs;
 
+#ifdef KARERE_ENABLE_FRAME_CAPTURE
+    /** Recorder of the frames received from chatd, only if enabled by env var (see FrameCapture) */
+    std::unique_ptr<FrameCapture> mFrameCapture;
+#endif
+
+    /** See setMessageArena() */
+    bool mMsgArenaEnabled = true;
+
 public:
     // Chatd Version:
     // - Version 0: initial version
@@ -1630,6 +1744,21 @@ public:
      */
     void cancelRetentionTimer(bool resetTs = true);
 
+    /**
+     * @brief Processes a frame as if it had been received from chatd on the given shard.
+     *
+     * Used to replay frames recorded by FrameCapture. The chats referenced by the frame
+     * must have been created with createChat().
+     */
+    void replayFrame(int shardNo, const char* data, size_t len);
+
+    /**
+     * @brief Enables or disables allocating the messages received from chatd in the arena of
+     * their chat (see MessageArena). Enabled by default, it's disabled only to compare both modes.
+     */
+    void setMessageArena(bool enable) { mMsgArenaEnabled = enable; }
+    bool messageArena() const { return mMsgArenaEnabled; }
+
     /**
      * @brief Sets a new retention history timer.
      * When timer expires, this method will iterate through all chats,
@@ -1642,6 +1771,30 @@ public:
      */
     void setRetentionTimer();
 
+    /**
+     * @brief Sets the maximum RAM for the history buffer of each chat, and for the history
+     * buffers of all chats, and evicts history as needed to honor them.
+     * When the global budget is exceeded, history is evicted from the chats whose history
+     * has been requested least recently. See Chat::trimHistory().
+     *
+     * @param chatBudget Maximum RAM per chat, in bytes. Zero means unlimited
+     * @param totalBudget Maximum RAM for all chats, in bytes. Zero means unlimited
+     */
+    void setHistoryMemoryBudget(size_t chatBudget, size_t totalBudget);
+
+    /** @brief Estimated RAM used by the history buffers of all chats, in bytes */
+    size_t historyMemory() const { return mHistoryMemory; }
+
+    /** @brief Recalculates the RAM used by the history buffers of all chats, and returns it.
+     * See Chat::updateHistoryMemory() */
+    size_t updateHistoryMemory();
+
+    /**
+     * @brief Evicts history to honor the memory budgets, if any. If \c chat is provided, only its
+     * own budget is checked, together with the global one.
+     */
+    void trimHistories(Chat* chat = nullptr);
+
     friend class Connection;
     friend class Chat;
 };
@@ -1794,6 +1947,8 @@ public:
     virtual Idx getIdxOfMsgidFromHistory(const karere::Id& msgid) = 0;
     virtual Idx getUnreadMsgCountAfterIdx(Idx idx) = 0;
     virtual void getLastTextMessage(Idx from, chatd::LastTextMsgState& msg, uint32_t& lastTs) = 0;
+    /** Returns the ts of the newest candidate for last-message in db, or 0 if there isn't any */
+    virtual uint32_t getLastTextMessageTs() = 0;
     virtual void getMessageDelta(const karere::Id& msgid, uint16_t *updated) = 0;
     virtual void getMessageUserKeyId(const karere::Id &msgid, karere::Id &userid, uint32_t &keyid) = 0;
     virtual bool isValidReactedMessage(const karere::Id &msgid, chatd::Idx &idx) = 0;
@@ -1814,12 +1969,34 @@ public:
     virtual void delReaction(const karere::Id& msgId, const karere::Id& userId, const std::string &reaction) = 0;
     virtual void delPendingReaction(const karere::Id& msgId, const std::string &reaction) = 0;
     virtual void getReactions(const karere::Id& msgId,std::vector<std::pair<std::string, karere::Id>> &reactions) const = 0;
+    /** @brief Gets the confirmed reactions of all messages with idx in [lowIdx, highIdx] with a single query.
+     * The reactions of each message keep the order returned by \c getReactions */
+    virtual void getReactionsInRange(Idx lowIdx, Idx highIdx, std::map<karere::Id, std::vector<std::pair<std::string, karere::Id>>> &reactions) const = 0;
     virtual void getPendingReactions(std::vector<chatd::Chat::PendingReaction>& reactions) const = 0;
     virtual bool hasPendingReactions() = 0;
 
     //  <<<--- Retention history methods --->>>
     virtual chatd::Idx getIdxByRetentionTime(time_t) = 0;
     virtual void retentionHistoryTruncate(const chatd::Idx idx) = 0;
+
+    //  <<<--- Batched writes --->>>
+
+    /**
+     * @brief Starts collecting the messages added by \c addMsgToHistory and the updates of
+     * last-seen/last-received pointers, so they can be written all at once by \c endBatch.
+     * Any other call that reads or modifies the history writes the collected changes first.
+     */
+    virtual void beginBatch() {}
+
+    /// writes the changes collected since \c beginBatch and goes back to immediate writes
+    virtual void endBatch() {}
+
+    /**
+     * @brief Gets the same info than \c getHistoryInfo for several chats with a single query,
+     * so all the chats of a shard can be rejoined without a query per chat. Chats that aren't
+     * added to \c infos are queried by \c getHistoryInfo.
+     */
+    virtual void getHistoryInfos(const std::vector<karere::Id>& /*chatids*/, std::map<karere::Id, ChatDbInfo>& /*infos*/) {}
 };
 
 }
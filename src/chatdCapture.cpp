@@ -0,0 +1,115 @@
+#include "chatdCapture.h"
+#include <string.h>
+
+namespace chatd
+{
+FrameCapture::FrameCapture(const std::string& path)
+    : mStart(std::chrono::steady_clock::now())
+{
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile && fwrite(kSignature, 1, kSignatureLen, mFile) != kSignatureLen)
+    {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    if (mFile)
+    {
+        fclose(mFile);
+    }
+}
+
+void FrameCapture::addChat(int shard, const karere::Id& chatid, bool isGroup, uint32_t creationTs)
+{
+    char data[13];
+    memcpy(data, &chatid.val, 8);
+    data[8] = isGroup ? 1 : 0;
+    memcpy(data + 9, &creationTs, 4);
+    addRecord(kRecordChat, shard, data, sizeof(data));
+}
+
+void FrameCapture::addFrame(int shard, const char* data, size_t len)
+{
+    addRecord(kRecordFrame, shard, data, len);
+}
+
+void FrameCapture::addRecord(uint8_t type, int shard, const char* data, size_t len)
+{
+    if (!mFile)
+    {
+        return;
+    }
+
+    char header[kRecordHeaderLen];
+    int32_t shard32 = static_cast<int32_t>(shard);
+    uint64_t usec = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - mStart).count());
+    uint32_t len32 = static_cast<uint32_t>(len);
+    header[0] = static_cast<char>(type);
+    memcpy(header + 1, &shard32, 4);
+    memcpy(header + 5, &usec, 8);
+    memcpy(header + 13, &len32, 4);
+
+    if (fwrite(header, 1, sizeof(header), mFile) != sizeof(header)
+            || fwrite(data, 1, len, mFile) != len)
+    {
+        // don't leave a truncated record in the middle of the file
+        fclose(mFile);
+        mFile = nullptr;
+        return;
+    }
+}
+
+bool FrameCapture::parseChat(const Record& record, karere::Id& chatid, bool& isGroup, uint32_t& creationTs)
+{
+    if (record.type != kRecordChat || record.data.size() != 13)
+    {
+        return false;
+    }
+
+    memcpy(&chatid.val, record.data.data(), 8);
+    isGroup = record.data[8] != 0;
+    memcpy(&creationTs, record.data.data() + 9, 4);
+    return true;
+}
+
+FrameCaptureReader::FrameCaptureReader(const std::string& path)
+{
+    mFile = fopen(path.c_str(), "rb");
+    char signature[FrameCapture::kSignatureLen];
+    if (mFile && (fread(signature, 1, sizeof(signature), mFile) != sizeof(signature)
+                  || memcmp(signature, FrameCapture::kSignature, sizeof(signature)) != 0))
+    {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+FrameCaptureReader::~FrameCaptureReader()
+{
+    if (mFile)
+    {
+        fclose(mFile);
+    }
+}
+
+bool FrameCaptureReader::next(FrameCapture::Record& record)
+{
+    char header[FrameCapture::kRecordHeaderLen];
+    if (!mFile || fread(header, 1, sizeof(header), mFile) != sizeof(header))
+    {
+        return false;
+    }
+
+    uint32_t len = 0;
+    record.type = static_cast<uint8_t>(header[0]);
+    memcpy(&record.shard, header + 1, 4);
+    memcpy(&record.usec, header + 5, 8);
+    memcpy(&len, header + 13, 4);
+    record.data.resize(len);
+    return !len || fread(&record.data[0], 1, len, mFile) == len;
+}
+}
@@ -0,0 +1,78 @@
+#ifndef __CHATD_CAPTURE_H__
+#define __CHATD_CAPTURE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include "karereId.h"
+
+namespace chatd
+{
+/** @brief Records the frames received from chatd into a file, so they can be replayed
+ * offline (see tests/chatd_replay).
+ *
+ * Recording is available only in builds configured with ENABLE_CHATD_FRAME_CAPTURE (off by
+ * default), since captures contain ciphertext, keys and ids of the account. It is enabled by
+ * setting the environment variable KRCHATD_CAPTURE to the path of the capture file before the
+ * chatd client is created. The file is flushed when the client is destroyed.
+ *
+ * The file starts with the 8-byte signature "KRCHDCAP", followed by a sequence of records:
+ *  <type.1> <shard.4> <usec.8> <len.4> <data.len>
+ * where usec is the time elapsed since the capture started. Integers are little-endian,
+ * like in the chatd protocol. The record types are:
+ *  - kRecordChat: <chatid.8> <isGroup.1> <creationTs.4>, added for every chat created in
+ *    chatd::Client, so the same chats can be created before replaying the frames.
+ *  - kRecordFrame: a websocket frame received from chatd, as is.
+ *
+ * @note The capture contains the encrypted messages and keys of the recording account,
+ * as well as ids of users and chats. Don't share it.
+ */
+class FrameCapture
+{
+public:
+    enum: uint8_t { kRecordChat = 1, kRecordFrame = 2 };
+    static constexpr const char* kEnvVarName = "KRCHATD_CAPTURE";
+    static constexpr const char* kSignature = "KRCHDCAP";
+    static constexpr size_t kSignatureLen = 8;
+    static constexpr size_t kRecordHeaderLen = 17;
+
+    struct Record
+    {
+        uint8_t type = 0;
+        int32_t shard = 0;
+        uint64_t usec = 0;
+        std::string data;
+    };
+
+    explicit FrameCapture(const std::string& path);
+    ~FrameCapture();
+    bool isOpen() const { return mFile != nullptr; }
+    void addChat(int shard, const karere::Id& chatid, bool isGroup, uint32_t creationTs);
+    void addFrame(int shard, const char* data, size_t len);
+
+    /** @brief Extracts the fields of a kRecordChat record. Returns false if it's malformed */
+    static bool parseChat(const Record& record, karere::Id& chatid, bool& isGroup, uint32_t& creationTs);
+
+protected:
+    FILE* mFile = nullptr;
+    std::chrono::steady_clock::time_point mStart;
+    void addRecord(uint8_t type, int shard, const char* data, size_t len);
+};
+
+/** @brief Reads the records of a file written by \c FrameCapture */
+class FrameCaptureReader
+{
+public:
+    explicit FrameCaptureReader(const std::string& path);
+    ~FrameCaptureReader();
+    bool isOpen() const { return mFile != nullptr; }
+
+    /** @brief Reads the next record. Returns false at the end of the file, or if it's truncated */
+    bool next(FrameCapture::Record& record);
+
+protected:
+    FILE* mFile = nullptr;
+};
+}
+#endif
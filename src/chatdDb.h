@@ -12,11 +12,150 @@ protected:
     chatd::Chat& mChat;
     std::string mSendingTblName;
     std::string mHistTblName;
+
+    // Batched writes (see beginBatch()): rows of history and pointers pending to be written
+    struct PendingHistoryRow
+    {
+        chatd::Idx idx;
+        karere::Id msgid;
+        chatd::KeyId keyid;
+        unsigned char type;
+        karere::Id userid;
+        uint32_t ts;
+        uint16_t updated;
+        std::string data;
+        bool nullData;      // the message has no buffer at all (stored as NULL, not as an empty blob)
+        chatd::BackRefId backRefId;
+        uint8_t isEncrypted;
+    };
+    // 11 parameters per row, keeps the statement below the default SQLITE_MAX_VARIABLE_NUMBER (999)
+    static constexpr size_t kMaxRowsPerInsert = 64;
+    // chats whose history info is queried at once by getHistoryInfos()
+    static constexpr size_t kMaxChatsPerInfoQuery = 256;
+    bool mBatching = false;
+    std::vector<PendingHistoryRow> mPendingHistory;
+    bool mHasPendingLastSeen = false;
+    karere::Id mPendingLastSeen;
+    bool mHasPendingLastRecv = false;
+    karere::Id mPendingLastRecv;
+
 public:
     ChatdSqliteDb(chatd::Chat& chat, SqliteDb& db, const std::string& sendingTblName="sending", const std::string& histTblName="history")
         :mDb(db), mChat(chat), mSendingTblName(sendingTblName), mHistTblName(histTblName){}
+    ~ChatdSqliteDb() override
+    {
+        try
+        {
+            flushBatch();
+        }
+        catch (std::exception& e)
+        {
+            CHATD_LOG_ERROR("chatid %s: failed to write batched history on destruction: %s", mChat.chatId().toString().c_str(), e.what());
+        }
+    }
+
+    void beginBatch() override
+    {
+        mBatching = true;
+    }
+
+    void endBatch() override
+    {
+        mBatching = false;
+        flushBatch();
+    }
+
+    // Writes the rows and pointers collected while batching. Called before any access to
+    // history, so readers never miss a batched message
+    void flushBatch()
+    {
+        if (!mPendingHistory.empty())
+        {
+            // the db of karere works in transactional mode, so all rows go into the current transaction.
+            // Rows stay pending until they have been tried, so an exception doesn't lose the rest of the batch
+            size_t pos = 0;
+            while (pos < mPendingHistory.size())
+            {
+                // the remaining rows reuse the (cached) single-row statement instead of creating a new one per size
+                size_t count = (mPendingHistory.size() - pos >= kMaxRowsPerInsert) ? kMaxRowsPerInsert : 1;
+                if (!insertHistoryRows(pos, count) && count > 1)
+                {
+                    // a failed statement is rolled back as a whole: retry its rows one by one,
+                    // so only the offending ones are lost, as when they were added individually
+                    for (size_t i = pos; i < pos + count; i++)
+                    {
+                        insertHistoryRows(i, 1);
+                    }
+                }
+                pos += count;
+            }
+            mPendingHistory.clear();
+        }
+
+        if (mHasPendingLastSeen)
+        {
+            mHasPendingLastSeen = false;
+            writeLastSeen(mPendingLastSeen);
+        }
+        if (mHasPendingLastRecv)
+        {
+            mHasPendingLastRecv = false;
+            writeLastReceived(mPendingLastRecv);
+        }
+    }
+
+    // Returns false if the rows couldn't be inserted (the error is logged)
+    bool insertHistoryRows(size_t first, size_t count)
+    {
+        std::string query = "insert into history (idx, chatid, msgid, keyid, type, userid, ts, updated, data, backrefid, is_encrypted) values";
+        for (size_t i = 0; i < count; i++)
+        {
+            query.append(i ? ",(?,?,?,?,?,?,?,?,?,?,?)" : "(?,?,?,?,?,?,?,?,?,?,?)");
+        }
+
+        SqliteStmt stmt(mDb, query);
+        for (size_t i = 0; i < count; i++)
+        {
+            const PendingHistoryRow& row = mPendingHistory[first + i];
+            int col = static_cast<int>(i * 11);
+            stmt.bind(col + 1, row.idx)
+                .bind(col + 2, mChat.chatId().val)
+                .bind(col + 3, row.msgid.val)
+                .bind(col + 4, row.keyid)
+                .bind(col + 5, row.type)
+                .bind(col + 6, row.userid.val)
+                .bind(col + 7, row.ts)
+                .bind(col + 8, row.updated)
+                .bind(col + 9, row.nullData ? nullptr : static_cast<const void*>(row.data.data()), row.data.size())
+                .bind(col + 10, row.backRefId)
+                .bind(col + 11, row.isEncrypted);
+        }
+        try
+        {
+            stmt.step();
+        }
+        catch (std::exception& e)
+        {
+            if (count == 1)
+            {
+                CHATD_LOG_ERROR("chatid %s: failed to add msgid %s (idx %d) to history: %s",
+                                mChat.chatId().toString().c_str(), mPendingHistory[first].msgid.toString().c_str(),
+                                mPendingHistory[first].idx, e.what());
+            }
+            else
+            {
+                CHATD_LOG_WARNING("chatid %s: failed to add %zu messages to history, retrying one by one: %s",
+                                  mChat.chatId().toString().c_str(), count, e.what());
+            }
+            return false;
+        }
+        assertAffectedRowCount(static_cast<int>(count), "insertHistoryRows");
+        return true;
+    }
+
     void getHistoryInfo(chatd::ChatDbInfo& info) override
     {
+        flushBatch();
         SqliteStmt stmt(mDb, "select min(idx), max(idx) from history where chatid=?1");
         stmt.bind(mChat.chatId()).step(); //will always return a row, even if table empty
         chatd::Idx minIdx = stmt.integralCol<chatd::Idx>(0);
@@ -46,6 +185,53 @@ public:
         info.setLastSeenId(stmt3.integralCol<uint64_t>(0));
         info.setLastRecvId(stmt3.integralCol<uint64_t>(1));
     }
+    void getHistoryInfos(const std::vector<karere::Id>& chatids, std::map<karere::Id, chatd::ChatDbInfo>& infos) override
+    {
+        // batched writes of other chats are written at the end of every chatd frame, so only ours may be pending
+        flushBatch();
+
+        // every subquery is a lookup in the (chatid, idx) index of history, like the queries of getHistoryInfo()
+        const std::string oldest = " from " + mHistTblName + " h where h.chatid = c.chatid order by h.idx asc limit 1)";
+        const std::string newest = " from " + mHistTblName + " h where h.chatid = c.chatid order by h.idx desc limit 1)";
+        for (size_t pos = 0; pos < chatids.size(); pos += kMaxChatsPerInfoQuery)
+        {
+            size_t count = std::min(kMaxChatsPerInfoQuery, chatids.size() - pos);
+            std::string query = "select c.chatid, c.last_seen, c.last_recv, (select h.idx" + oldest + ", (select h.msgid" + oldest
+                    + ", (select h.idx" + newest + ", (select h.msgid" + newest + " from chats c where c.chatid in (?";
+            for (size_t i = 1; i < count; i++)
+            {
+                query.append(",?");
+            }
+            query.append(")");
+
+            SqliteStmt stmt(mDb, query);
+            for (size_t i = 0; i < count; i++)
+            {
+                stmt << chatids[pos + i];
+            }
+
+            while (stmt.step())
+            {
+                chatd::ChatDbInfo info;     // no db history by default
+                if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+                {
+                    info.setOldestDbIdx(stmt.integralCol<chatd::Idx>(3));
+                    info.setOldestDbId(stmt.integralCol<uint64_t>(4));
+                    info.setNewestDbIdx(stmt.integralCol<chatd::Idx>(5));
+                    info.setNewestDbId(stmt.integralCol<uint64_t>(6));
+                    if (info.getNewestDbId().isNull())
+                    {
+                        assert(false);
+                        CHATD_LOG_WARNING("Db: Newest msgid in db is null, telling chatd we don't have local history");
+                        info.setOldestDbId(karere::Id::null());
+                    }
+                    info.setLastSeenId(stmt.integralCol<uint64_t>(1));
+                    info.setLastRecvId(stmt.integralCol<uint64_t>(2));
+                }
+                infos.emplace(karere::Id(stmt.integralCol<uint64_t>(0)), std::move(info));
+            }
+        }
+    }
     void assertAffectedRowCount(int count, const char* opname=nullptr)
     {
         auto actual = sqlite3_changes(mDb);
@@ -150,10 +336,43 @@ public:
     }
     void addMsgToHistory(const chatd::Message& msg, chatd::Idx idx) override
     {
-        addMessage(msg, idx, "history");
+        if (!mBatching)
+        {
+            addMessage(msg, idx, "history");
+            return;
+        }
+
+#ifndef NDEBUG
+        // same check as addMessage(), taking into account the rows not written yet
+        SqliteStmt stmt(mDb, "select min(idx), max(idx), count(*) from history where chatid = ?");
+        stmt << mChat.chatId();
+        stmt.step();
+        int count = stmt.integralCol<int>(2);
+        chatd::Idx low = count ? stmt.integralCol<chatd::Idx>(0) : CHATD_IDX_INVALID;
+        chatd::Idx high = count ? stmt.integralCol<chatd::Idx>(1) : CHATD_IDX_INVALID;
+        for (const PendingHistoryRow& row: mPendingHistory)
+        {
+            low = (low == CHATD_IDX_INVALID || row.idx < low) ? row.idx : low;
+            high = (high == CHATD_IDX_INVALID || row.idx > high) ? row.idx : high;
+        }
+        if ((low != CHATD_IDX_INVALID) && (idx != low-1) && (idx != high+1))
+        {
+            CHATD_LOG_ERROR("chatid %s: addMsgToHistory: history discontinuity detected: "
+                "index of added msg %s is not adjacent to neither end of db history: "
+                "add idx=%d, histlow=%d, histhigh=%d, pending=%zu",
+                mChat.chatId().toString().c_str(), msg.id().toString().c_str(),
+                idx, low, high, mPendingHistory.size());
+            assert(false);
+        }
+#endif
+        bool nullData = (msg.buf() == nullptr);
+        mPendingHistory.push_back({idx, msg.id(), msg.keyid, msg.type, msg.userid, msg.ts, msg.updated,
+                                   nullData ? std::string() : std::string(msg.buf(), msg.dataSize()), nullData,
+                                   msg.backRefId, msg.isEncrypted()});
     }
     void updateMsgInHistory(karere::Id msgid, const chatd::Message& msg) override
     {
+        flushBatch();
         if (msg.type == chatd::Message::kMsgTruncate)
         {
             mDb.query("update history set type = ?, data = ?, ts = ?, updated = 0, userid = ?, keyid = ? where chatid = ? and msgid = ?",
@@ -169,6 +388,7 @@ public:
 
     void getMessageDelta(const karere::Id& msgid, uint16_t *updated) override
     {
+        flushBatch();
         SqliteStmt stmt3(mDb, "select updated from history where chatid = ? and msgid = ?");
         stmt3 << mChat.chatId() << msgid;
         stmt3.stepMustHaveData();
@@ -177,6 +397,7 @@ public:
 
     void getMessageUserKeyId(const karere::Id &msgid, karere::Id &userid, uint32_t &keyid) override
     {
+        flushBatch();
         SqliteStmt stmt(mDb, "select userid, keyid from history where msgid = ?");
         stmt << msgid;
         stmt.stepMustHaveData("getMessageUserKeyId");
@@ -255,6 +476,7 @@ public:
     }
     void fetchDbHistory(chatd::Idx idx, unsigned count, std::vector<chatd::Message*>& messages) override
     {
+        flushBatch();
         loadMessages(count, idx, messages, "history");
     }
 
@@ -268,10 +490,12 @@ public:
 
     chatd::Idx getIdxOfMsgidFromHistory(const karere::Id& msgid) override
     {
+        flushBatch();
         return getIdxOfMsgid(msgid, "history");
     }
     chatd::Idx getUnreadMsgCountAfterIdx(chatd::Idx idx) override
     {
+        flushBatch();
         // get the unread messages count --> conditions should match the ones in Message::isValidUnread()
         std::string sql = "select count(*) from history where (chatid = ?1)"
                 "and (userid != ?2)"
@@ -373,6 +597,7 @@ public:
     }
     void truncateHistory(const chatd::Message& msg) override
     {
+        flushBatch();
         auto idx = getIdxOfMsgidFromHistory(msg.id());
         if (idx == CHATD_IDX_INVALID)
             throw std::runtime_error("dbInterface::truncateHistory: msgid "+msg.id().toString()+" does not exist in db");
@@ -391,6 +616,7 @@ public:
     }
     chatd::Idx getOldestIdx() override
     {
+        flushBatch();
         SqliteStmt stmt(mDb, "select min(idx) from history where chatid = ?");
         stmt << mChat.chatId();
         stmt.stepMustHaveData(__FUNCTION__);
@@ -399,6 +625,7 @@ public:
 
     uint32_t getOldestMsgTs() override
     {
+        flushBatch();
         SqliteStmt stmt(mDb, "select min(ts) from history where chatid = ?");
         stmt << mChat.chatId();
         stmt.stepMustHaveData(__FUNCTION__);
@@ -406,11 +633,32 @@ public:
     }
 
     void setLastSeen(const karere::Id& msgid) override
+    {
+        if (mBatching)
+        {
+            // only the last value of the batch needs to be written
+            mPendingLastSeen = msgid;
+            mHasPendingLastSeen = true;
+            return;
+        }
+        writeLastSeen(msgid);
+    }
+    void setLastReceived(const karere::Id& msgid) override
+    {
+        if (mBatching)
+        {
+            mPendingLastRecv = msgid;
+            mHasPendingLastRecv = true;
+            return;
+        }
+        writeLastReceived(msgid);
+    }
+    void writeLastSeen(const karere::Id& msgid)
     {
         mDb.query("update chats set last_seen=? where chatid=?", msgid, mChat.chatId());
         assertAffectedRowCount(1, "setLastSeen");
     }
-    void setLastReceived(const karere::Id& msgid) override
+    void writeLastReceived(const karere::Id& msgid)
     {
         mDb.query("update chats set last_recv=? where chatid=?", msgid, mChat.chatId());
         assertAffectedRowCount(1);
@@ -433,6 +681,7 @@ public:
 
     void getLastTextMessage(chatd::Idx from, chatd::LastTextMsgState& msg, uint32_t& lastTs) override
     {
+        flushBatch();
         SqliteStmt stmt(mDb,
             "select type, idx, data, msgid, userid, ts from history where chatid=?1 and "
             "(length(data) > 0 OR type = ?2) and type != ?3  and type != ?4 and (idx <= ?5)"
@@ -462,6 +711,21 @@ public:
         lastTs = stmt.integralCol<uint32_t>(5);
     }
 
+    uint32_t getLastTextMessageTs() override
+    {
+        flushBatch();
+        // same candidates as getLastTextMessage(), but the message is not loaded
+        SqliteStmt stmt(mDb,
+            "select ts from history where chatid=?1 and "
+            "(length(data) > 0 OR type = ?2) and type != ?3  and type != ?4 "
+            "order by idx desc limit 1");
+        stmt << mChat.chatId()
+             << chatd::Message::kMsgTruncate
+             << chatd::Message::kMsgRevokeAttachment
+             << chatd::Message::kMsgInvalid;
+        return stmt.step() ? stmt.integralCol<uint32_t>(0) : 0;
+    }
+
     //Insert a new chat var related to a chat. This function receives as parameters the var name and it's value
     void setChatVar(const char *name, bool value) override
     {
@@ -493,6 +757,7 @@ public:
 
     void clearHistory() override
     {
+        flushBatch();
         mDb.query("delete from history where chatid = ?", mChat.chatId());
         setHaveAllHistory(false);
     }
@@ -520,6 +785,7 @@ public:
 
     bool isValidReactedMessage(const karere::Id &msgid, chatd::Idx &idx) override
     {
+        flushBatch();
         SqliteStmt stmt(mDb, "select type, userid, keyid, idx from history where msgid = ?");
         stmt << msgid;
         if (!stmt.step())
@@ -615,6 +881,7 @@ public:
 
     void cleanReactions(const karere::Id& msgId) override
     {
+        flushBatch();
         mDb.query("delete from chat_reactions where chatid = ? and msgId = ?", mChat.chatId(), msgId);
     }
 
@@ -625,12 +892,14 @@ public:
 
     void addReaction(const karere::Id& msgId, const karere::Id& userId, const std::string &reaction) override
     {
+        flushBatch();
         mDb.query("insert or replace into chat_reactions(chatid, msgid, userid, reaction)"
                   "values(?,?,?,?)", mChat.chatId(), msgId, userId, reaction);
     }
 
     void addPendingReaction(const karere::Id& msgId, const std::string &reaction, const std::string &encReaction, uint8_t status) override
     {
+        flushBatch();
         mDb.query("insert or replace into chat_pending_reactions(chatid, msgid, reaction, encReaction, status)"
                   "values(?,?,?,?,?)", mChat.chatId(), msgId, reaction, encReaction, status);
     }
@@ -658,6 +927,20 @@ public:
         }
     }
 
+    void getReactionsInRange(chatd::Idx lowIdx, chatd::Idx highIdx, std::map<karere::Id, std::vector<std::pair<std::string, karere::Id>>> &reactions) const override
+    {
+        // the history range is resolved with the (chatid, idx) index, and the reactions of each
+        // message with the (chatid, msgid, ...) one
+        SqliteStmt stmt(mDb, "select r.msgid, r.reaction, r.userid from history h"
+                             " join chat_reactions r on r.chatid = h.chatid and r.msgid = h.msgid"
+                             " where h.chatid = ?1 and h.idx between ?2 and ?3 ORDER BY r.`_rowid_` ASC");
+        stmt << mChat.chatId() << lowIdx << highIdx;
+        while (stmt.step())
+        {
+            reactions[karere::Id(stmt.integralCol<uint64_t>(0))].emplace_back(stmt.stringCol(1), karere::Id(stmt.integralCol<uint64_t>(2)));
+        }
+    }
+
     void getPendingReactions(std::vector<chatd::Chat::PendingReaction>& reactions) const override
     {
         SqliteStmt stmt(mDb, "select _rowid_, reaction, encReaction, msgid, status from chat_pending_reactions where chatid = ? ORDER BY `_rowid_` ASC");
@@ -678,6 +961,7 @@ public:
 
     chatd::Idx getIdxByRetentionTime(const time_t ts) override
     {
+        flushBatch();
         // Find the most recent msg affected by retention time if any
         SqliteStmt stmt(mDb, "select MAX(ts), MAX(idx) from history where chatid = ? and ts <= ?");
         stmt << mChat.chatId() << static_cast<uint32_t>(ts);
@@ -686,6 +970,7 @@ public:
 
     void retentionHistoryTruncate(const chatd::Idx idx) override
     {
+        flushBatch();
         if (idx != CHATD_IDX_INVALID)
         {
             // reactions and pending reactions in DB are removed along with messages (FK delete on cascade)
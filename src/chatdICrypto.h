@@ -20,6 +20,7 @@ enum
 class Chat;
 class ICrypto
 {
+protected:
     void *appCtx;
     
 public:
@@ -77,6 +78,21 @@ public:
      */
     virtual promise::Promise<Message*> msgDecrypt(Message* src) = 0;
 
+    /**
+     * @brief Called by the client for received messages that are queued for decryption,
+     * behind a message whose decryption is still in progress. The crypto module may start
+     * decrypting \c msg in background, so that the later call to \c msgDecrypt() for the
+     * same message completes sooner. The message object itself must not be modified.
+     */
+    virtual void msgDecryptPrefetch(const Message& /*msg*/) {}
+
+    /**
+     * @brief Called by the client when a chunk of history has been received (HISTDONE).
+     * The crypto module may collect the messages passed to \c msgDecryptPrefetch() and
+     * process them together. Any message still being collected must be started now.
+     */
+    virtual void msgDecryptFlush() {}
+
     /**
      * @brief The chatroom connection (to the chatd server shard) state state has changed.
      */
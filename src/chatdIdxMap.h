@@ -0,0 +1,298 @@
+#ifndef __CHATD_IDXMAP_H__
+#define __CHATD_IDXMAP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <vector>
+#include <deque>
+#include <utility>
+
+namespace chatd
+{
+/** @brief Maps a 64-bit id (msgid, backrefid) to the index of its message in the
+ * history buffer.
+ *
+ * The entries are stored in an open-addressing hash table with linear probing. The null
+ * id marks empty slots, so it can't be used as a key. The ids are also kept in a deque
+ * ordered by their index, so \c eraseUpTo() only touches the entries that it removes.
+ * Several ids may have the same index, like in a std::map: the ids whose index is already
+ * used by another id (not expected in the history buffer) are kept in a small overflow list.
+ *
+ * The interface mimics the subset of std::map used by chatd. Iterators are invalidated
+ * by any modification of the map.
+ */
+template <class K, class V>
+class IdxMap
+{
+public:
+    struct Entry
+    {
+        K first;
+        V second;
+    };
+    typedef const Entry* const_iterator;
+
+    IdxMap() { clear(); }
+    size_t size() const { return mCount; }
+    bool empty() const { return mCount == 0; }
+    const_iterator end() const { return nullptr; }
+
+    const_iterator find(K key) const
+    {
+        if (isNullKey(key))
+            return nullptr;
+
+        size_t mask = mSlots.size() - 1;
+        for (size_t i = slotFor(key); ; i = (i + 1) & mask)
+        {
+            const Entry& entry = mSlots[i];
+            if (isNullKey(entry.first))
+                return nullptr;
+            if (entry.first == key)
+                return &entry;
+        }
+    }
+
+    /** Adds the entry only if \c key is not present, like std::map::emplace */
+    std::pair<const_iterator, bool> emplace(K key, V value)
+    {
+        assert(!isNullKey(key));
+        const_iterator it = find(key);
+        if (it)
+        {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(insertNew(key, value), true);
+    }
+
+    /** Sets the index of \c key, adding the entry if it's not present */
+    void set(K key, V value)
+    {
+        assert(!isNullKey(key));
+        const_iterator it = find(key);
+        if (it)
+        {
+            if (it->second == value)
+            {
+                return;
+            }
+            erase(key);
+        }
+        insertNew(key, value);
+    }
+
+    void erase(K key)
+    {
+        const_iterator it = find(key);
+        if (!it)
+        {
+            return;
+        }
+        unlinkOrder(key, it->second);
+        eraseSlot(key);
+    }
+
+    /** Removes all entries whose index is <= \c idx */
+    void eraseUpTo(V idx)
+    {
+        for (size_t i = 0; i < mOverflow.size();)
+        {
+            if (mOverflow[i].second <= idx)
+            {
+                eraseSlot(mOverflow[i].first);
+                mOverflow[i] = mOverflow.back();
+                mOverflow.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        while (!mOrder.empty() && mFirstIdx <= idx)
+        {
+            K key = mOrder.front();
+            if (!isNullKey(key))
+            {
+                eraseSlot(key);
+            }
+            mOrder.pop_front();
+            mFirstIdx++;
+        }
+    }
+
+    void clear()
+    {
+        mSlots.assign(kMinSlots, Entry{K(), V()});
+        mCount = 0;
+        mOrder.clear();
+        mOverflow.clear();
+        mFirstIdx = V();
+    }
+
+protected:
+    enum { kMinSlots = 64 }; // must be a power of 2
+    std::vector<Entry> mSlots;
+    size_t mCount = 0;
+    /** Ids ordered by index. mOrder[i] is the id with index (mFirstIdx + i), or the null id */
+    std::deque<K> mOrder;
+    V mFirstIdx = V();
+    /** Ids whose index was already used by the id in mOrder, and their indexes */
+    std::vector<std::pair<K, V>> mOverflow;
+
+    static bool isNullKey(const K& key) { return static_cast<uint64_t>(key) == 0; }
+    size_t slotFor(const K& key) const
+    {
+        // msgids are random, but backrefids carry a timestamp in the low bits, so mix them
+        uint64_t h = static_cast<uint64_t>(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h) & (mSlots.size() - 1);
+    }
+
+    const_iterator insertNew(K key, V value)
+    {
+        linkOrder(key, value);
+        if ((mCount + 1) * 2 > mSlots.size())
+        {
+            rehash(mSlots.size() * 2);
+        }
+        size_t mask = mSlots.size() - 1;
+        size_t i = slotFor(key);
+        while (!isNullKey(mSlots[i].first))
+        {
+            i = (i + 1) & mask;
+        }
+        mSlots[i].first = key;
+        mSlots[i].second = value;
+        mCount++;
+        return &mSlots[i];
+    }
+
+    void rehash(size_t newSize)
+    {
+        std::vector<Entry> old(newSize, Entry{K(), V()});
+        old.swap(mSlots);
+        size_t mask = mSlots.size() - 1;
+        for (const Entry& entry: old)
+        {
+            if (isNullKey(entry.first))
+                continue;
+
+            size_t i = slotFor(entry.first);
+            while (!isNullKey(mSlots[i].first))
+            {
+                i = (i + 1) & mask;
+            }
+            mSlots[i] = entry;
+        }
+    }
+
+    /** Removes \c key from the hash table only, using backward-shift deletion */
+    void eraseSlot(K key)
+    {
+        size_t mask = mSlots.size() - 1;
+        size_t i = slotFor(key);
+        while (!(mSlots[i].first == key))
+        {
+            if (isNullKey(mSlots[i].first))
+                return;
+            i = (i + 1) & mask;
+        }
+
+        size_t j = i;
+        for (;;)
+        {
+            j = (j + 1) & mask;
+            if (isNullKey(mSlots[j].first))
+                break;
+
+            // the entry at j can fill the hole at i if i is within its probe sequence
+            size_t home = slotFor(mSlots[j].first);
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+                mSlots[i] = mSlots[j];
+                i = j;
+            }
+        }
+        mSlots[i].first = K();
+        mCount--;
+    }
+
+    void linkOrder(K key, V idx)
+    {
+        if (mOrder.empty())
+        {
+            mFirstIdx = idx;
+            mOrder.push_back(key);
+            return;
+        }
+
+        if (idx < mFirstIdx)
+        {
+            mOrder.insert(mOrder.begin(), static_cast<size_t>(int64_t(mFirstIdx) - idx), K());
+            mFirstIdx = idx;
+        }
+        size_t pos = static_cast<size_t>(int64_t(idx) - mFirstIdx);
+        if (pos >= mOrder.size())
+        {
+            mOrder.resize(pos + 1, K());
+        }
+
+        if (isNullKey(mOrder[pos]))
+        {
+            mOrder[pos] = key;
+        }
+        else
+        {
+            mOverflow.emplace_back(key, idx);
+        }
+    }
+
+    void unlinkOrder(K key, V idx)
+    {
+        for (size_t i = 0; i < mOverflow.size(); i++)
+        {
+            if (mOverflow[i].first == key)
+            {
+                mOverflow[i] = mOverflow.back();
+                mOverflow.pop_back();
+                return;
+            }
+        }
+
+        if (mOrder.empty() || idx < mFirstIdx)
+            return;
+
+        size_t pos = static_cast<size_t>(int64_t(idx) - mFirstIdx);
+        if (pos >= mOrder.size() || !(mOrder[pos] == key))
+            return;
+
+        // another id with the same index takes its place
+        for (size_t i = 0; i < mOverflow.size(); i++)
+        {
+            if (mOverflow[i].second == idx)
+            {
+                mOrder[pos] = mOverflow[i].first;
+                mOverflow[i] = mOverflow.back();
+                mOverflow.pop_back();
+                return;
+            }
+        }
+
+        mOrder[pos] = K();
+        while (!mOrder.empty() && isNullKey(mOrder.front()))
+        {
+            mOrder.pop_front();
+            mFirstIdx++;
+        }
+        while (!mOrder.empty() && isNullKey(mOrder.back()))
+        {
+            mOrder.pop_back();
+        }
+    }
+};
+}
+#endif
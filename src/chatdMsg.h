@@ -7,6 +7,7 @@
 #include <memory>
 #include <map>
 #include "karereId.h"
+#include "chatdMsgArena.h"
 #include <megaapi.h>
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
@@ -1102,6 +1103,16 @@ public:
     mutable uint8_t userFlags = 0;
     bool richLinkRemoved = 0;
 
+    /** @brief Representation of the message built by the app (ie. the immutable part of a
+     * MegaChatMessage), cached so it's built only once and shared by all the objects that
+     * expose this message. The app must check it still matches the message before using it */
+    mutable std::shared_ptr<const void> appSnapshot;
+    /** @brief Estimation of the RAM used by appSnapshot, set by the app, see memoryUsage() */
+    mutable size_t appSnapshotSize = 0;
+    /** @brief RAM of the message accounted in the history memory of its chat, see
+     * Chat::updateMsgMemory(). Zero while the message is not in the history buffer */
+    mutable size_t historyMemory = 0;
+
     const karere::Id& id() const { return mId; }
     void setId(const karere::Id& aId, bool isXid) { mId = aId; mIdIsXid = isXid; }
     bool isSending() const { return mIdIsXid; }
@@ -1114,6 +1125,13 @@ public:
     bool isUndecryptable() const { return (mIsEncrypted == kEncryptedMalformed || mIsEncrypted == kEncryptedSignature); }
     void setEncrypted(uint8_t encrypted) { mIsEncrypted = encrypted; }
 
+    /** @brief The messages received from chatd are allocated in the arena of their chat
+     * (see MessageArena), the rest in the heap */
+    static void* operator new(size_t size) { return MessageArena::allocate(size, nullptr); }
+    static void* operator new(size_t size, MessageArena& arena) { return MessageArena::allocate(size, &arena); }
+    static void operator delete(void* p) { MessageArena::deallocate(p); }
+    static void operator delete(void* p, MessageArena&) { MessageArena::deallocate(p); }
+
     explicit Message(const karere::Id& aMsgid, const karere::Id& aUserid, uint32_t aTs, uint16_t aUpdated,
           Buffer&& buf, bool aIsSending=false, KeyId aKeyid=CHATD_KEYID_INVALID,
           unsigned char aType=kMsgNormal, void* aUserp=nullptr)
@@ -1130,7 +1148,8 @@ public:
     Message(const Message& msg)
         : Buffer(msg.buf(), msg.dataSize()), mId(msg.id()), mIdIsXid(msg.mIdIsXid), mIsEncrypted(msg.mIsEncrypted),
           userid(msg.userid), ts(msg.ts), updated(msg.updated), keyid(msg.keyid), type(msg.type), backRefId(msg.backRefId),
-          backRefs(msg.backRefs), userp(msg.userp), userFlags(msg.userFlags), richLinkRemoved(msg.richLinkRemoved)
+          backRefs(msg.backRefs), userp(msg.userp), userFlags(msg.userFlags), richLinkRemoved(msg.richLinkRemoved),
+          appSnapshot(msg.appSnapshot), appSnapshotSize(msg.appSnapshotSize)
     {}
 
     /** @brief Returns the ManagementInfo structure contained within the message
@@ -1329,6 +1348,19 @@ public:
         return mReactions;
     }
 
+    /** @brief Returns an estimation of the RAM used by the message: the object, its buffer,
+     * its backrefs, its reactions and the snapshot built by the app (see appSnapshot) **/
+    size_t memoryUsage() const
+    {
+        size_t usage = sizeof(Message) + bufSize() + backRefs.capacity() * sizeof(BackRefId)
+                + (appSnapshot ? appSnapshotSize : 0);
+        for (const Reaction& reaction: mReactions)
+        {
+            usage += sizeof(Reaction) + reaction.mReaction.capacity() + reaction.mUsers.capacity() * sizeof(karere::Id);
+        }
+        return usage;
+    }
+
     /** @brief Returns true if the user has reacted to this message with the specified reaction **/
     bool hasReacted(std::string reaction, karere::Id uh) const
     {
@@ -0,0 +1,160 @@
+#include "chatdMsgArena.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <cstddef>
+#include <new>
+
+namespace chatd
+{
+struct MessageArena::Chunk
+{
+    MessageArena* arena;
+    size_t capacity;    // blocks
+    size_t used;        // blocks served so far
+    size_t live;        // blocks not freed yet
+};
+
+struct alignas(alignof(std::max_align_t)) MessageArena::BlockHeader
+{
+    Chunk* chunk;       // null for blocks allocated in the heap
+};
+
+namespace
+{
+constexpr size_t alignedSize(size_t size)
+{
+    return (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+}
+
+MessageArena::MessageArena(size_t blockSize)
+    : mBlockSize(blockSize)
+    , mBlockStride(sizeof(BlockHeader) + alignedSize(blockSize))
+{
+}
+
+void* MessageArena::allocate(size_t size, MessageArena* arena)
+{
+    if (arena && size <= arena->mBlockSize)
+    {
+        return arena->allocBlock();
+    }
+
+    BlockHeader* header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + size));
+    if (!header)
+    {
+        throw std::bad_alloc();
+    }
+    header->chunk = nullptr;
+    return header + 1;
+}
+
+void MessageArena::deallocate(void* p)
+{
+    if (!p)
+    {
+        return;
+    }
+
+    BlockHeader* header = static_cast<BlockHeader*>(p) - 1;
+    Chunk* chunk = header->chunk;
+    if (!chunk)
+    {
+        free(header);
+        return;
+    }
+
+    MessageArena* arena = chunk->arena;
+    bool deleteArena = false;
+    {
+        std::lock_guard<std::mutex> lock(arena->mMutex);
+        assert(chunk->live);
+        if (--chunk->live == 0 && chunk != arena->mCurrent)
+        {
+            deleteArena = arena->freeChunk(chunk);
+        }
+    }
+
+    // the arena was released by its chat, and this was its last block
+    if (deleteArena)
+    {
+        delete arena;
+    }
+}
+
+void* MessageArena::allocBlock()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    assert(!mReleased);
+    if (!mCurrent || mCurrent->used == mCurrent->capacity)
+    {
+        Chunk* full = mCurrent;
+        size_t blocks = mNextChunkBlocks;
+        mCurrent = static_cast<Chunk*>(malloc(alignedSize(sizeof(Chunk)) + blocks * mBlockStride));
+        if (!mCurrent)
+        {
+            mCurrent = full;
+            throw std::bad_alloc();
+        }
+        mCurrent->arena = this;
+        mCurrent->capacity = blocks;
+        mCurrent->used = 0;
+        mCurrent->live = 0;
+        mChunks++;
+        if (mNextChunkBlocks < kMaxChunkBlocks)
+        {
+            mNextChunkBlocks *= 2;
+        }
+
+        // the full chunk is freed by its last block, unless they have all been freed already
+        // (the arena is not released yet, so it's not deleted)
+        if (full && !full->live)
+        {
+            freeChunk(full);
+        }
+    }
+
+    char* block = reinterpret_cast<char*>(mCurrent) + alignedSize(sizeof(Chunk)) + mCurrent->used * mBlockStride;
+    mCurrent->used++;
+    mCurrent->live++;
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+    header->chunk = mCurrent;
+    return header + 1;
+}
+
+bool MessageArena::freeChunk(Chunk* chunk)
+{
+    assert(!chunk->live);
+    free(chunk);
+    mChunks--;
+    return mReleased && !mChunks;
+}
+
+void MessageArena::release()
+{
+    bool deleteArena = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        assert(!mReleased);
+        mReleased = true;
+        Chunk* current = mCurrent;
+        mCurrent = nullptr;
+        if (current && !current->live)
+        {
+            freeChunk(current);
+        }
+        deleteArena = !mChunks;
+    }
+
+    if (deleteArena)
+    {
+        delete this;
+    }
+}
+
+size_t MessageArena::chunkCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mChunks;
+}
+}
@@ -0,0 +1,67 @@
+#ifndef __CHATD_MSG_ARENA_H__
+#define __CHATD_MSG_ARENA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+
+namespace chatd
+{
+/** @brief Allocator of the messages received in a chat.
+ *
+ * Blocks of a fixed size are carved out of chunks, so a chunk is allocated every several
+ * messages instead of one allocation per message. The messages received together (ie. a page
+ * of history) share a chunk and are usually evicted from the history buffer together, so
+ * blocks are not reused one by one: a chunk serves new blocks until it's full, and it's freed
+ * once all its blocks have been freed.
+ *
+ * Every block, also the ones allocated in the heap when there is no arena, starts with a
+ * header that points to its chunk, so deallocate() doesn't need to know where it came from.
+ *
+ * The arena belongs to its chat, which calls release() when it's destroyed. Since messages
+ * may outlive their chat, the arena is deleted when the last of its chunks is freed.
+ *
+ * Blocks are allocated from the thread of the chat, but messages can be deleted from any
+ * thread (ie. by the decryption workers or by the app), so the state of the arena and of its
+ * chunks is protected by a mutex.
+ */
+class MessageArena
+{
+public:
+    explicit MessageArena(size_t blockSize);
+
+    /** @brief Allocates \c size bytes from \c arena, or from the heap if \c arena is null
+     * or \c size exceeds its block size. Throws std::bad_alloc if out of memory */
+    static void* allocate(size_t size, MessageArena* arena);
+
+    /** @brief Frees a block returned by allocate() */
+    static void deallocate(void* p);
+
+    /** @brief Called by the owner instead of deleting the arena */
+    void release();
+
+    size_t chunkCount() const;
+
+protected:
+    struct Chunk;
+    struct BlockHeader;
+
+    static constexpr size_t kFirstChunkBlocks = 4;
+    static constexpr size_t kMaxChunkBlocks = 64;
+
+    size_t mBlockSize;
+    size_t mBlockStride;
+    mutable std::mutex mMutex;
+    Chunk* mCurrent = nullptr;
+    size_t mChunks = 0;
+    size_t mNextChunkBlocks = kFirstChunkBlocks;
+    bool mReleased = false;
+
+    ~MessageArena() = default;
+    void* allocBlock();
+    // frees the chunk, and returns true if the arena has to be deleted. Requires mMutex
+    bool freeChunk(Chunk* chunk);
+};
+}
+
+#endif
@@ -0,0 +1,273 @@
+#include "chatdUrlScan.h"
+#include <stdint.h>
+#include <string.h>
+#include <regex>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHATD_URL_SCAN_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CHATD_URL_SCAN_NEON 1
+#endif
+
+namespace chatd
+{
+namespace
+{
+constexpr size_t kBlockSize = 16;
+
+// characters that can be part of a URL candidate, any other one splits the text into tokens
+struct UrlCharTable
+{
+    bool isUrlChar[256];
+    UrlCharTable()
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            isUrlChar[c] = (c >= 33 && c <= 126)
+                    && c != '"'
+                    && c != '\''
+                    && c != '\\'
+                    && c != '<'
+                    && c != '>'
+                    && c != '{'
+                    && c != '}'
+                    && c != '|';
+        }
+    }
+};
+
+const UrlCharTable gUrlCharTable;
+
+// bit i of urlChars (dots) is set if the byte i of the block is a URL character (a '.')
+struct BlockMasks
+{
+    uint32_t urlChars;
+    uint32_t dots;
+};
+
+BlockMasks classifyBlockScalar(const char* block)
+{
+    BlockMasks masks = { 0, 0 };
+    for (size_t i = 0; i < kBlockSize; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(block[i]);
+        masks.urlChars |= static_cast<uint32_t>(gUrlCharTable.isUrlChar[c]) << i;
+        masks.dots |= static_cast<uint32_t>(c == '.') << i;
+    }
+    return masks;
+}
+
+#if defined(CHATD_URL_SCAN_SSE2)
+BlockMasks classifyBlockVectorized(const char* block)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+
+    // signed comparisons: bytes >= 0x80 are negative, so they are out of [33, 126]
+    __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(32)),
+                                    _mm_cmplt_epi8(v, _mm_set1_epi8(127)));
+    __m128i excluded = _mm_or_si128(
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\''))),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(v, _mm_set1_epi8('<')))),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('>')), _mm_cmpeq_epi8(v, _mm_set1_epi8('{'))),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('}')), _mm_cmpeq_epi8(v, _mm_set1_epi8('|')))));
+
+    BlockMasks masks;
+    masks.urlChars = static_cast<uint32_t>(_mm_movemask_epi8(_mm_andnot_si128(excluded, inRange)));
+    masks.dots = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+    return masks;
+}
+#elif defined(CHATD_URL_SCAN_NEON)
+uint32_t movemask(uint8x16_t v)
+{
+    // every byte is 0x00 or 0xff: keep one bit per byte and add them up by halves
+    static const uint8_t kBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t bits = vandq_u8(v, vld1q_u8(kBits));
+    return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits)))
+            | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+
+BlockMasks classifyBlockVectorized(const char* block)
+{
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(block));
+    uint8x16_t inRange = vandq_u8(vcgtq_u8(v, vdupq_n_u8(32)), vcltq_u8(v, vdupq_n_u8(127)));
+    uint8x16_t excluded = vorrq_u8(
+                vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\''))),
+                         vorrq_u8(vceqq_u8(v, vdupq_n_u8('\\')), vceqq_u8(v, vdupq_n_u8('<')))),
+                vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('>')), vceqq_u8(v, vdupq_n_u8('{'))),
+                         vorrq_u8(vceqq_u8(v, vdupq_n_u8('}')), vceqq_u8(v, vdupq_n_u8('|')))));
+
+    BlockMasks masks;
+    masks.urlChars = movemask(vbicq_u8(inRange, excluded));
+    masks.dots = movemask(vceqq_u8(v, vdupq_n_u8('.')));
+    return masks;
+}
+#else
+BlockMasks classifyBlockVectorized(const char* block)
+{
+    return classifyBlockScalar(block);
+}
+#endif
+
+// index of the lowest bit set in \c mask, which can't be 0
+inline unsigned lowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long pos;
+    _BitScanForward(&pos, mask);
+    return static_cast<unsigned>(pos);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// same as Message::removeUnnecessaryFirstCharacters() / removeUnnecessaryLastCharacters(), without copying
+std::string_view trimUrlCandidate(std::string_view token)
+{
+    static const char* trimmedChars = ".,:?!;";
+    std::string_view::size_type first = token.find_first_not_of(trimmedChars);
+    if (first == std::string_view::npos)
+    {
+        return std::string_view();
+    }
+    std::string_view::size_type last = token.find_last_not_of(trimmedChars);
+    return token.substr(first, last - first + 1);
+}
+
+bool regexMatch(std::string_view text, const std::regex& expression)
+{
+    return std::regex_match(text.data(), text.data() + text.size(), expression);
+}
+
+template <BlockMasks (*classifyBlock)(const char*)>
+std::string_view findUrlInBlocks(std::string_view text)
+{
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t tokenStart = 0;
+    bool inToken = false;
+    bool tokenHasDot = false;
+
+    // the last block is padded with zeros, which aren't URL characters, so it ends any
+    // token in progress (even if the text fills the previous blocks completely)
+    for (size_t base = 0; base <= size; base += kBlockSize)
+    {
+        BlockMasks masks;
+        if (size - base >= kBlockSize)
+        {
+            masks = classifyBlock(data + base);
+        }
+        else
+        {
+            char tail[kBlockSize] = {};
+            memcpy(tail, data + base, size - base);
+            masks = classifyBlock(tail);
+        }
+
+        // bit i of 'previous' is set if the byte before the byte i is a URL character
+        uint32_t previous = ((masks.urlChars << 1) | (inToken ? 1u : 0u)) & 0xffff;
+        uint32_t starts = masks.urlChars & ~previous;
+        uint32_t ends = ~masks.urlChars & previous;
+
+        // bits of the current token in this block, up to the end of the block
+        uint32_t tokenBits = 0xffff;
+        for (uint32_t events = starts | ends; events; events &= events - 1)
+        {
+            unsigned i = lowestBit(events);
+            uint32_t bit = 1u << i;
+            if (starts & bit)
+            {
+                tokenStart = base + i;
+                inToken = true;
+                tokenHasDot = false;
+                tokenBits = 0xffff & ~(bit - 1);
+                continue;
+            }
+
+            inToken = false;
+            tokenHasDot = tokenHasDot || (masks.dots & tokenBits & (bit - 1));
+
+            // any URL contains a '.', so the tokens without one are not parsed
+            if (tokenHasDot)
+            {
+                std::string_view token = trimUrlCandidate(text.substr(tokenStart, base + i - tokenStart));
+                if (!token.empty() && parseUrl(token))
+                {
+                    return token;
+                }
+            }
+        }
+
+        if (inToken)
+        {
+            tokenHasDot = tokenHasDot || (masks.dots & tokenBits);
+        }
+    }
+
+    return std::string_view();
+}
+}
+
+std::string_view findUrl(std::string_view text, bool vectorized)
+{
+    // most messages don't contain any '.', so they are discarded by a single (vectorized) memchr
+    if (text.find('.') == std::string_view::npos)
+    {
+        return std::string_view();
+    }
+
+    return vectorized ? findUrlInBlocks<classifyBlockVectorized>(text)
+                      : findUrlInBlocks<classifyBlockScalar>(text);
+}
+
+bool isValidEmail(std::string_view buf)
+{
+    // the regular expression requires an '@'
+    if (buf.find('@') == std::string_view::npos)
+    {
+        return false;
+    }
+
+    static const std::regex regularExpresion("^[a-z0-9A-Z._%+-]+@[a-z0-9A-Z.-]+[.][a-zA-Z]{2,6}");
+    return regexMatch(buf, regularExpresion);
+}
+
+bool parseUrl(std::string_view url)
+{
+    if (url.find('.') == std::string_view::npos)
+    {
+        return false;
+    }
+
+    if (isValidEmail(url))
+    {
+        return false;
+    }
+
+    std::string_view urlToParse = url;
+    std::string_view::size_type position = urlToParse.find("://");
+    if (position != std::string_view::npos)
+    {
+        // only http:// and https:// URLs (with something after the scheme) are accepted
+        std::string_view scheme = urlToParse.substr(0, position);
+        if ((scheme != "http" && scheme != "https") || urlToParse.size() == position + 3)
+        {
+            return false;
+        }
+        urlToParse = urlToParse.substr(position + 3);
+    }
+
+    static const std::regex megaUrlExpression("((WWW.|www.)?mega.+(nz/|co.nz/)).*((#F!|#!|C!|chat/|file/|folder/)[a-z0-9A-Z-._~:/?#!$&'()*+,;= \\-@]+)$");
+    if (regexMatch(urlToParse, megaUrlExpression))
+    {
+        return false;
+    }
+
+    static const std::regex regularExpresion("((^([0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}))|((^(WWW.|www.))?([a-z0-9A-Z]+)([a-z0-9A-Z-._~?#!$&'()*+,;=])*([a-z0-9A-Z]+)([.]{1}[a-zA-Z]{2,5}){1,2}))([:]{1}[0-9]{1,5})?([/]{1}[a-z0-9A-Z-._~:?#/@!$&'()*+,;=]*)?$");
+    return regexMatch(urlToParse, regularExpresion);
+}
+}
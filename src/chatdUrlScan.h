@@ -0,0 +1,24 @@
+#ifndef __CHATD_URL_SCAN_H__
+#define __CHATD_URL_SCAN_H__
+
+#include <string_view>
+
+namespace chatd
+{
+/** @brief Returns the first URL found in \c text, or an empty view if there is none.
+ *
+ * The text is split into tokens at the characters that can't be part of a URL, and the
+ * leading and trailing punctuation of every token is trimmed. Only the tokens that contain
+ * a '.' are checked with \c parseUrl(), and nothing is allocated. The text is classified in
+ * blocks of 16 bytes with SSE2 or NEON when they are available, otherwise (or if
+ * \c vectorized is false) with a lookup table.
+ */
+std::string_view findUrl(std::string_view text, bool vectorized = true);
+
+/** @brief Returns true if \c url is an http(s) URL that isn't an email address nor a MEGA link */
+bool parseUrl(std::string_view url);
+
+bool isValidEmail(std::string_view buf);
+}
+
+#endif
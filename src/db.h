@@ -3,6 +3,8 @@
 
 #include <sqlite3.h>
 #include <assert.h>
+#include <list>
+#include <unordered_map>
 #include "buffer.h"
 #include "karereCommon.h"
 
@@ -24,17 +26,42 @@ struct SqliteString
 };
 class SqliteStmt;
 
+/** @brief Counters of the prepared-statement cache of a SqliteDb */
+struct SqliteStmtCacheStats
+{
+    uint64_t hits = 0;          // statements served from the cache
+    uint64_t misses = 0;        // statements that had to be prepared
+    uint64_t evictions = 0;     // statements finalized to keep the cache within its size
+    uint64_t prepareTimeUs = 0; // accumulated time spent in sqlite3_prepare_v2(), in microseconds
+};
+
 class SqliteDb
 {
+public:
+    static constexpr size_t kDefaultStmtCacheSize = 64;
 protected:
     friend class SqliteStmt;
+    typedef std::list<std::pair<std::string, sqlite3_stmt*>> StmtLruList;
     karere::IApp &mApp;
     sqlite3* mDb = nullptr;
     bool mCommitEach = true;
     bool mHasOpenTransaction = false;
     uint16_t mCommitInterval = 20;
     time_t mLastCommitTs = 0;
+
+    // LRU cache of idle prepared statements, keyed by SQL text (most recently used first).
+    // A statement used by a SqliteStmt is taken out of the cache, and it's returned to it
+    // (reset and without bindings) when the SqliteStmt is destroyed
+    StmtLruList mStmtLru;
+    std::unordered_map<std::string, StmtLruList::iterator> mStmtCache;
+    size_t mStmtCacheSize = kDefaultStmtCacheSize;
+    SqliteStmtCacheStats mStmtCacheStats;
+
     inline int step(SqliteStmt& stmt);
+    sqlite3_stmt* acquireStmt(const std::string& sql);
+    void releaseStmt(sqlite3_stmt* stmt, std::string&& sql);
+    void clearStmtCache();
+    void trimStmtCache();
     void beginTransaction()
     {
         assert(!mHasOpenTransaction);
@@ -122,6 +149,7 @@ public:
             return;
         if (!mCommitEach)
             commitTransaction();
+        clearStmtCache();
         sqlite3_close(mDb);
         mDb = nullptr;
         mLastCommitTs = 0;
@@ -145,6 +173,10 @@ public:
     bool commitEach() { return mCommitEach; }   // false for transactional
     void setCommitInterval(uint16_t sec) { mCommitInterval = sec; }
     bool hasOpenTransaction() const { return !mHasOpenTransaction; }
+    /** @brief Sets the max number of idle prepared statements kept by the cache. Zero disables the cache */
+    void setStmtCacheSize(size_t size);
+    size_t stmtCacheSize() const { return mStmtCacheSize; }
+    const SqliteStmtCacheStats& stmtCacheStats() const { return mStmtCacheStats; }
     operator sqlite3*() { return mDb; }
     operator const sqlite3*() const { return mDb; }
     template <class... Args>
@@ -179,6 +211,7 @@ class SqliteStmt
 protected:
     sqlite3_stmt* mStmt;
     SqliteDb& mDb;
+    std::string mSql;   // key of the statement in the cache of mDb
     int mLastBindCol = 0;
     void retCheck(int code, const char* opname)
     {
@@ -204,9 +237,10 @@ protected:
         return msg;
     }
 public:
-    SqliteStmt(SqliteDb& db, const char* sql):mDb(db)
+    SqliteStmt(SqliteDb& db, const char* sql):mDb(db), mSql(sql)
     {
-        if (sqlite3_prepare_v2(db, sql, -1, &mStmt, nullptr) != SQLITE_OK)
+        mStmt = db.acquireStmt(mSql);
+        if (!mStmt)
         {
             const char* errMsg = sqlite3_errmsg(mDb);
             if (!errMsg)
@@ -218,10 +252,12 @@ public:
     }
     SqliteStmt(SqliteDb& db, const std::string& sql)
         :SqliteStmt(db, sql.c_str()){}
+    SqliteStmt(const SqliteStmt&) = delete;
+    SqliteStmt& operator=(const SqliteStmt&) = delete;
     ~SqliteStmt()
     {
         if (mStmt)
-            sqlite3_finalize(mStmt);
+            mDb.releaseStmt(mStmt, std::move(mSql));
     }
     operator sqlite3_stmt*() { return mStmt; }
     operator const sqlite3_stmt*() const {return mStmt; }
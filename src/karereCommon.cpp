@@ -41,8 +41,8 @@ void globalCleanup()
 #endif
 }
 
-void init_uv_timer(void *ctx, uv_timer_t *timer)
+TimerWheel& getTimerWheel(void *ctx)
 {
-    uv_timer_init(((::mega::LibuvWaiter *)(((megachat::MegaChatApiImpl *)ctx)->waiter))->eventloop(), timer);
+    return ((megachat::MegaChatApiImpl *)ctx)->timerWheel();
 }
 }
@@ -1,5 +1,6 @@
 #include "db.h"
 #include "IGui.h"
+#include <chrono>
 
 void SqliteDb::simpleQuery(const char *sql)
 {
@@ -22,3 +23,91 @@ void SqliteDb::simpleQuery(const char *sql)
 
     throw std::runtime_error(msg);
 }
+
+sqlite3_stmt* SqliteDb::acquireStmt(const std::string& sql)
+{
+    auto it = mStmtCache.find(sql);
+    if (it != mStmtCache.end())
+    {
+        // take the statement out of the cache while it's in use
+        sqlite3_stmt* stmt = it->second->second;
+        mStmtLru.erase(it->second);
+        mStmtCache.erase(it);
+        mStmtCacheStats.hits++;
+        return stmt;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    auto start = std::chrono::steady_clock::now();
+    int ret = sqlite3_prepare_v2(mDb, sql.c_str(), -1, &stmt, nullptr);
+    mStmtCacheStats.prepareTimeUs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                               std::chrono::steady_clock::now() - start).count());
+    mStmtCacheStats.misses++;
+    if (ret != SQLITE_OK)
+    {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    return stmt;
+}
+
+void SqliteDb::releaseStmt(sqlite3_stmt* stmt, std::string&& sql)
+{
+    if (!mDb || !mStmtCacheSize)
+    {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    // the key is the SQL passed to acquireStmt(), which may differ from the one stored by
+    // sqlite (see sqlite3_sql()), ie. if it has trailing characters after the statement
+    if (mStmtCache.find(sql) != mStmtCache.end())
+    {
+        // the same query was used by nested statements, keep only one of them
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    mStmtLru.emplace_front(std::move(sql), stmt);
+    mStmtCache.emplace(mStmtLru.front().first, mStmtLru.begin());
+    trimStmtCache();
+}
+
+void SqliteDb::clearStmtCache()
+{
+    if (!mStmtLru.empty())
+    {
+        KR_LOG_DEBUG("Karere log debug: statement cache cleared (%zu statements). Hits: %llu, misses: %llu, evictions: %llu, prepare time: %llu us",
+                     mStmtLru.size(),
+                     static_cast<unsigned long long>(mStmtCacheStats.hits),
+                     static_cast<unsigned long long>(mStmtCacheStats.misses),
+                     static_cast<unsigned long long>(mStmtCacheStats.evictions),
+                     static_cast<unsigned long long>(mStmtCacheStats.prepareTimeUs));
+    }
+
+    for (auto& entry: mStmtLru)
+    {
+        sqlite3_finalize(entry.second);
+    }
+    mStmtLru.clear();
+    mStmtCache.clear();
+}
+
+void SqliteDb::setStmtCacheSize(size_t size)
+{
+    mStmtCacheSize = size;
+    trimStmtCache();
+}
+
+void SqliteDb::trimStmtCache()
+{
+    while (mStmtLru.size() > mStmtCacheSize)
+    {
+        mStmtCache.erase(mStmtLru.back().first);
+        sqlite3_finalize(mStmtLru.back().second);
+        mStmtLru.pop_back();
+        mStmtCacheStats.evictions++;
+    }
+}
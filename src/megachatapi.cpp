@@ -145,6 +145,11 @@ bool MegaChatSession::isAudioDetected() const
     return false;
 }
 
+int MegaChatSession::getAudioLevel() const
+{
+    return AUDIO_LEVEL_SILENCE;
+}
+
 bool MegaChatSession::canRecvVideoHiRes() const
 {
     return false;
@@ -379,6 +384,11 @@ const MegaHandleList* MegaChatCall::getRaiseHandsList() const
     return NULL;
 }
 
+const MegaHandleList* MegaChatCall::getActiveSpeakers() const
+{
+    return NULL;
+}
+
 int MegaChatCall::getNumParticipants() const
 {
     return 0;
@@ -609,6 +619,11 @@ int MegaChatApi::getUserOnlineStatus(MegaChatHandle userhandle)
     return pImpl->getUserOnlineStatus(userhandle);
 }
 
+bool MegaChatApi::isUserOnlineStatusStale(MegaChatHandle userhandle)
+{
+    return pImpl->isUserOnlineStatusStale(userhandle);
+}
+
 void MegaChatApi::setBackgroundStatus(bool background, MegaChatRequestListener *listener)
 {
     pImpl->setBackgroundStatus(background, listener);
@@ -744,6 +759,16 @@ MegaChatListItemList* MegaChatApi::getChatListItems(const int mask, const int fi
     return pImpl->getChatListItems(mask, filter);
 }
 
+MegaChatListItemList* MegaChatApi::getChatListItemsPage(const int mask, const int filter, unsigned int offset, unsigned int count) const
+{
+    return pImpl->getChatListItemsPage(mask, filter, offset, count);
+}
+
+unsigned int MegaChatApi::getChatListItemsCount(const int mask, const int filter) const
+{
+    return pImpl->getChatListItemsCount(mask, filter);
+}
+
 MegaChatListItemList* MegaChatApi::getChatListItems()
 {
     return pImpl->getChatListItems();
@@ -1011,6 +1036,16 @@ bool MegaChatApi::isFullHistoryLoaded(MegaChatHandle chatid)
     return pImpl->isFullHistoryLoaded(chatid);
 }
 
+void MegaChatApi::setHistoryMemoryBudget(int64_t chatBudget, int64_t totalBudget)
+{
+    pImpl->setHistoryMemoryBudget(chatBudget, totalBudget);
+}
+
+int64_t MegaChatApi::getHistoryMemoryUsage(MegaChatHandle chatid)
+{
+    return pImpl->getHistoryMemoryUsage(chatid);
+}
+
 MegaChatMessage *MegaChatApi::getMessage(MegaChatHandle chatid, MegaChatHandle msgid)
 {
     return pImpl->getMessage(chatid, msgid);
@@ -1021,6 +1056,11 @@ MegaChatMessage *MegaChatApi::getMessageFromNodeHistory(MegaChatHandle chatid, M
     return pImpl->getMessageFromNodeHistory(chatid, msgid);
 }
 
+void MegaChatApi::searchMessages(MegaChatHandle chatid, const char *query, int limit, long long cursor, MegaChatRequestListener *listener)
+{
+    pImpl->searchMessages(chatid, query, limit, cursor, listener);
+}
+
 MegaChatMessage *MegaChatApi::getManualSendingMessage(MegaChatHandle chatid, MegaChatHandle rowid)
 {
     return pImpl->getManualSendingMessage(chatid, rowid);
@@ -1505,6 +1545,11 @@ void MegaChatApi::removeChatRemoteVideoListener(MegaChatHandle chatid, MegaChatH
     pImpl->removeChatVideoListener(chatid, clientId, hiRes ? rtcModule::VideoResolution::kHiRes : rtcModule::VideoResolution::kLowRes, TYPE_CAPTURER_UNKNOWN, listener);
 }
 
+void MegaChatApi::releaseVideoBuffer(const char *buffer)
+{
+    pImpl->releaseVideoBuffer(buffer);
+}
+
 void MegaChatApi::setSFUid(int sfuid)
 {
     pImpl->setSFUid(sfuid);
@@ -1526,6 +1571,11 @@ void MegaChatApi::setCatchException(bool enable)
     MegaChatApiImpl::setCatchException(enable);
 }
 
+void MegaChatApi::setDecryptionThreads(unsigned int numThreads)
+{
+    MegaChatApiImpl::setDecryptionThreads(numThreads);
+}
+
 bool MegaChatApi::hasUrl(const char *text)
 {
     return MegaChatApiImpl::hasUrl(text);
@@ -1727,6 +1777,11 @@ MegaHandleList *MegaChatRequest::getMegaHandleListByChat(MegaChatHandle)
     return NULL;
 }
 
+MegaStringMap *MegaChatRequest::getMegaStringMap() const
+{
+    return NULL;
+}
+
 MegaChatScheduledMeetingList* MegaChatRequest::getMegaChatScheduledMeetingList() const
 {
     return NULL;
@@ -1974,6 +2029,76 @@ void MegaChatVideoListener::onChatVideoData(MegaChatApi * /*api*/, MegaChatHandl
 
 }
 
+bool MegaChatVideoListener::holdsVideoBuffers()
+{
+    return false;
+}
+
+bool MegaChatVideoListener::wantsI420Frames()
+{
+    return false;
+}
+
+void MegaChatVideoListener::onChatVideoFrameI420(MegaChatApi * /*api*/, MegaChatHandle /*chatid*/, MegaChatVideoFrameI420 * /*frame*/)
+{
+
+}
+
+MegaChatVideoFrameI420::~MegaChatVideoFrameI420()
+{
+
+}
+
+MegaChatVideoFrameI420 *MegaChatVideoFrameI420::copy() const
+{
+    return NULL;
+}
+
+int MegaChatVideoFrameI420::getWidth() const
+{
+    return 0;
+}
+
+int MegaChatVideoFrameI420::getHeight() const
+{
+    return 0;
+}
+
+const unsigned char *MegaChatVideoFrameI420::getDataY() const
+{
+    return NULL;
+}
+
+const unsigned char *MegaChatVideoFrameI420::getDataU() const
+{
+    return NULL;
+}
+
+const unsigned char *MegaChatVideoFrameI420::getDataV() const
+{
+    return NULL;
+}
+
+int MegaChatVideoFrameI420::getStrideY() const
+{
+    return 0;
+}
+
+int MegaChatVideoFrameI420::getStrideU() const
+{
+    return 0;
+}
+
+int MegaChatVideoFrameI420::getStrideV() const
+{
+    return 0;
+}
+
+int MegaChatVideoFrameI420::getRotation() const
+{
+    return 0;
+}
+
 
 void MegaChatCallListener::onChatCallUpdate(MegaChatApi * /*api*/, MegaChatCall * /*call*/)
 {
@@ -2025,6 +2150,21 @@ void MegaChatListener::onChatPresenceLastGreen(MegaChatApi * /*api*/, MegaChatHa
 
 }
 
+void MegaChatListener::onChatPresenceBatch(MegaChatApi *api, MegaChatPresenceList *presences)
+{
+    for (unsigned int i = 0; i < presences->size(); i++)
+    {
+        if (presences->getStatus(i) != -1)
+        {
+            onChatOnlineStatusUpdate(api, presences->getUserHandle(i), presences->getStatus(i), false);
+        }
+        if (presences->getLastGreen(i) != -1)
+        {
+            onChatPresenceLastGreen(api, presences->getUserHandle(i), presences->getLastGreen(i));
+        }
+    }
+}
+
 void MegaChatListener::onDbError(MegaChatApi * /*api*/, int /*error*/, const char* /*msg*/)
 {
 
@@ -2466,6 +2606,36 @@ bool MegaChatPresenceConfig::isLastGreenVisible() const
     return false;
 }
 
+MegaChatPresenceList *MegaChatPresenceList::copy() const
+{
+    return NULL;
+}
+
+MegaChatHandle MegaChatPresenceList::getUserHandle(unsigned int /*i*/) const
+{
+    return MEGACHAT_INVALID_HANDLE;
+}
+
+int MegaChatPresenceList::getStatus(unsigned int /*i*/) const
+{
+    return -1;
+}
+
+int MegaChatPresenceList::getLastGreen(unsigned int /*i*/) const
+{
+    return -1;
+}
+
+bool MegaChatPresenceList::isStale(unsigned int /*i*/) const
+{
+    return false;
+}
+
+unsigned int MegaChatPresenceList::size() const
+{
+    return 0;
+}
+
 void MegaChatNotificationListener::onChatNotification(MegaChatApi *, MegaChatHandle , MegaChatMessage *)
 {
 
@@ -62,6 +62,7 @@ class MegaChatVideoListener;
 class MegaChatListener;
 class MegaChatNotificationListener;
 class MegaChatListItem;
+class MegaChatPresenceList;
 class MegaChatNodeHistoryListener;
 class MegaChatScheduledRules;
 class MegaChatScheduledFlags;
@@ -115,6 +116,10 @@ public:
         SESS_TERM_CODE_NON_RECOVERABLE  = 1,    // Session has been finished by a non recoverable reason
     };
 
+    enum {
+        AUDIO_LEVEL_SILENCE = -127,             // Audio level (dBFS) of a session without audio
+    };
+
     virtual ~MegaChatSession();
 
     /**
@@ -404,6 +409,19 @@ public:
      */
     virtual bool isAudioDetected() const;
 
+    /**
+     * @brief Returns the audio level received from this session
+     *
+     * It's the RMS level of the audio in dBFS (0 is the maximum level), smoothed to be stable
+     * enough to compare participants, at the moment this MegaChatSession was created. It's
+     * MegaChatSession::AUDIO_LEVEL_SILENCE if audio level monitor is disabled or there's no audio.
+     *
+     * @see MegaChatApi::enableAudioLevelMonitor
+     *
+     * @return The audio level in dBFS, in range [MegaChatSession::AUDIO_LEVEL_SILENCE, 0]
+     */
+    virtual int getAudioLevel() const;
+
     /**
      * @brief Returns if our client is ready to receive high resolution video from the participant of this session
      *
@@ -510,6 +528,7 @@ public:
         CHANGE_TYPE_CALL_WILL_END = 0x100000,       /// Notify that call will end due to duration restrictions associated to MEGA account plan
         CHANGE_TYPE_CALL_LIMITS_UPDATED = 0x200000, /// Notify that call limits have been updated
         CHANGE_TYPE_CALL_RAISE_HAND = 0x400000,     /// Notify that an user raised/lowered hand to speak
+        CHANGE_TYPE_ACTIVE_SPEAKERS = 0x800000,     /// Active speakers list, or their order, has changed
     };
 
     enum
@@ -751,6 +770,10 @@ public:
      * - MegaChatCall:: CHANGE_TYPE_CALL_LIMITS_UPDATED = 0x200000
      * Notify that call limits have been updated
      *
+     * - MegaChatCall:: CHANGE_TYPE_ACTIVE_SPEAKERS = 0x800000
+     * Notify that active speakers list, or their order, has changed
+     * (check MegaChatCall::getActiveSpeakers to get the updated list)
+     *
      * @return a bit field with the changes of the call
      */
     virtual int getChanges() const;
@@ -845,6 +868,10 @@ public:
      * - MegaChatCall:: CHANGE_TYPE_CALL_LIMITS_UPDATED = 0x200000
      * Notify that call limits have been updated
      *
+     * - MegaChatCall:: CHANGE_TYPE_ACTIVE_SPEAKERS = 0x800000
+     * Notify that active speakers list, or their order, has changed
+     * (check MegaChatCall::getActiveSpeakers to get the updated list)
+     *
      * @return true if this call has an specific change
      */
     virtual bool hasChanged(int changeType) const;
@@ -1221,6 +1248,23 @@ public:
      */
     virtual const mega::MegaHandleList* getRaiseHandsList() const;
 
+    /**
+     * @brief Get a MegaHandleList with the client ids of the sessions where voice is detected
+     *
+     * This list is ranked by the audio level of each session (the first element is the loudest
+     * speaker). To avoid continuous reordering, a speaker only overtakes a previous one when it's
+     * clearly louder. Changes in this list are notified with MegaChatCall::CHANGE_TYPE_ACTIVE_SPEAKERS.
+     *
+     * The list is only updated while audio level monitor is enabled (@see MegaChatApi::enableAudioLevelMonitor),
+     * otherwise it's empty.
+     *
+     * This method always returns a valid instance of MegaHandleList.
+     * The MegaChatCall retains the ownership of the returned value.
+     *
+     * @return A MegaHandleList of client ids of the active speakers, loudest first
+     */
+    virtual const mega::MegaHandleList* getActiveSpeakers() const;
+
     /**
      * @brief Get the number of peers participating in the call
      *
@@ -1399,6 +1443,89 @@ public:
     virtual const ::mega::MegaHandleList* getSpeakRequestsList() const;
 };
 
+/**
+ * @brief Video frame in planar I420 (YUV 4:2:0) format
+ *
+ * The planes are not copied from the decoded video: the frame keeps a reference to the
+ * decoded buffer while it exists. The frame is not rotated, its rotation is reported by
+ * MegaChatVideoFrameI420::getRotation.
+ *
+ * @see MegaChatVideoListener::wantsI420Frames
+ */
+class MegaChatVideoFrameI420
+{
+public:
+    virtual ~MegaChatVideoFrameI420();
+
+    /**
+     * @brief Creates a copy of this MegaChatVideoFrameI420 object
+     *
+     * The planes are not copied, the new object references the same decoded buffer.
+     * The resulting object is fully independent of the source MegaChatVideoFrameI420,
+     * it contains a copy of all internal attributes, so it will be valid after
+     * the original object is deleted.
+     *
+     * You are the owner of the returned object
+     *
+     * @return Copy of the MegaChatVideoFrameI420 object
+     */
+    virtual MegaChatVideoFrameI420 *copy() const;
+
+    /**
+     * @brief Returns the width of the frame in pixels
+     * @return Width of the frame
+     */
+    virtual int getWidth() const;
+
+    /**
+     * @brief Returns the height of the frame in pixels
+     * @return Height of the frame
+     */
+    virtual int getHeight() const;
+
+    /**
+     * @brief Returns the Y plane. Its size is getStrideY() * getHeight() bytes
+     * @return Pointer to the Y plane
+     */
+    virtual const unsigned char *getDataY() const;
+
+    /**
+     * @brief Returns the U plane. Its size is getStrideU() * ((getHeight() + 1) / 2) bytes
+     * @return Pointer to the U plane
+     */
+    virtual const unsigned char *getDataU() const;
+
+    /**
+     * @brief Returns the V plane. Its size is getStrideV() * ((getHeight() + 1) / 2) bytes
+     * @return Pointer to the V plane
+     */
+    virtual const unsigned char *getDataV() const;
+
+    /**
+     * @brief Returns the number of bytes per row of the Y plane
+     * @return Stride of the Y plane
+     */
+    virtual int getStrideY() const;
+
+    /**
+     * @brief Returns the number of bytes per row of the U plane
+     * @return Stride of the U plane
+     */
+    virtual int getStrideU() const;
+
+    /**
+     * @brief Returns the number of bytes per row of the V plane
+     * @return Stride of the V plane
+     */
+    virtual int getStrideV() const;
+
+    /**
+     * @brief Returns the rotation to apply in order to display the frame
+     * @return Clockwise rotation in degrees: 0, 90, 180 or 270
+     */
+    virtual int getRotation() const;
+};
+
 /**
  * @brief Interface to get video frames from calls
  *
@@ -1424,8 +1551,54 @@ public:
      * @param size Buffer size in bytes
      *
      *  The MegaChatVideoListener retains the ownership of the buffer.
+     *
+     *  By default, the buffer is only valid until this function returns. If the listener
+     *  returns true from MegaChatVideoListener::holdsVideoBuffers, the buffer remains valid
+     *  until the app calls MegaChatApi::releaseVideoBuffer for it.
      */
     virtual void onChatVideoData(MegaChatApi *api, MegaChatHandle chatid, int width, int height, char *buffer, size_t size);
+
+    /**
+     * @brief Indicates whether this listener keeps the buffers received at onChatVideoData
+     *
+     * Buffers are reused for subsequent frames once they are released. If this function
+     * returns true, the buffer received at MegaChatVideoListener::onChatVideoData is not
+     * reused until the app calls MegaChatApi::releaseVideoBuffer for it, which must be
+     * called exactly once per received buffer. This allows the app to process the frame
+     * asynchronously without copying it.
+     *
+     * The default implementation returns false.
+     *
+     * @return True if the app will release the received buffers with MegaChatApi::releaseVideoBuffer
+     */
+    virtual bool holdsVideoBuffers();
+
+    /**
+     * @brief Indicates whether this listener receives frames in I420 format
+     *
+     * If this function returns true, frames are delivered to
+     * MegaChatVideoListener::onChatVideoFrameI420 instead of
+     * MegaChatVideoListener::onChatVideoData. They are neither converted to ARGB nor rotated.
+     *
+     * The value is checked for every frame. The default implementation returns false.
+     *
+     * @return True to receive frames in I420 format
+     */
+    virtual bool wantsI420Frames();
+
+    /**
+     * @brief This function is called when a new image is available, if
+     * MegaChatVideoListener::wantsI420Frames returns true
+     *
+     * The SDK retains the ownership of the MegaChatVideoFrameI420. It will be valid until
+     * this function returns. If you want to keep the frame, use MegaChatVideoFrameI420::copy,
+     * which doesn't copy the planes.
+     *
+     * @param api MegaChatApi connected to the account
+     * @param chatid MegaChatHandle that provides the video
+     * @param frame Frame in I420 format
+     */
+    virtual void onChatVideoFrameI420(MegaChatApi *api, MegaChatHandle chatid, MegaChatVideoFrameI420 *frame);
 };
 
 /**
@@ -2662,7 +2835,8 @@ public:
         TYPE_REJECT_CALL                            = 66,
         TYPE_SET_LIMIT_CALL                         = 67,
         TYPE_RAISE_HAND_TO_SPEAK                    = 68,
-        TOTAL_OF_REQUEST_TYPES                      = 69,
+        TYPE_SEARCH_MESSAGES                        = 69,
+        TOTAL_OF_REQUEST_TYPES                      = 70,
     };
 
     enum {  // AV flags
@@ -2740,6 +2914,7 @@ public:
      * - MegaChatApi::createChat - Creates a chat for one or more participants
      * - MegaChatApi::openChatPreview - Returns true if it's a meeting room
      * - MegaChatApi::checkChatPreview -Returns true if it's a meeting room
+     * - MegaChatApi::searchMessages - Returns true if all the local history has been indexed
      *
      * @return Flag related to the request
      */
@@ -2828,6 +3003,8 @@ public:
      * This value is valid for these requests:
      * - MegaChatApi::pushReceived - Returns the list of ids for unread messages in the chatid
      *   (you can get the list of chatids from \c getMegaHandleList)
+     * - MegaChatApi::searchMessages - Returns the list of msgids of the messages found in the chatid
+     *   (you can get the list of chatids from \c getMegaHandleList)
      *
      * @param chatid MegaChatHandle that identifies the chat room
      * @return mega::MegaHandleList of handles for a given chatid
@@ -2864,11 +3041,26 @@ public:
      * - MegaChatApi::pushReceived - Returns the list of chatids with unread messages
      * - MegaChatApi::openChatPreview - Returns a vector with one element (callid), if call doesn't exit it will be NULL
      * - MegaChatApi::checkChatPreview - Returns a vector with one element (callid), if call doesn't exit it will be NULL
+     * - MegaChatApi::searchMessages - Returns the list of chatids with messages found
      *
      * @return mega::MegaHandleList of handles for a given chatid
      */
     virtual mega::MegaHandleList *getMegaHandleList();
 
+    /**
+     * @brief Returns a map of strings related to this request
+     *
+     * The SDK retains the ownership of the returned value. It will be valid until
+     * the MegaChatRequest object is deleted.
+     *
+     * This value is valid for these requests:
+     * - MegaChatApi::searchMessages - Returns a fragment of the text of every message found,
+     *   indexed by its msgid in Base64 (see MegaApi::userHandleToBase64)
+     *
+     * @return mega::MegaStringMap related to this request
+     */
+    virtual mega::MegaStringMap *getMegaStringMap() const;
+
     /**
      * @brief Returns the type of parameter related to the request
      *
@@ -3085,6 +3277,85 @@ public:
     virtual bool isLastGreenVisible() const;
 };
 
+/**
+ * @brief List of changes of the online status and/or the last-green of users
+ *
+ * It is received by MegaChatListener::onChatPresenceBatch, with a single entry per user.
+ *
+ * Objects of this class are immutable.
+ */
+class MegaChatPresenceList
+{
+public:
+    virtual ~MegaChatPresenceList() {}
+
+    /**
+     * @brief Creates a copy of this MegaChatPresenceList object
+     *
+     * The resulting object is fully independent of the source MegaChatPresenceList,
+     * it contains a copy of all internal attributes, so it will be valid after
+     * the original object is deleted.
+     *
+     * You are the owner of the returned object
+     *
+     * @return Copy of the MegaChatPresenceList object
+     */
+    virtual MegaChatPresenceList *copy() const;
+
+    /**
+     * @brief Returns the MegaChatHandle of the user at the position i in the list
+     *
+     * If the index is >= the size of the list, this function returns MEGACHAT_INVALID_HANDLE.
+     *
+     * @param i Position of the user that we want to get from the list
+     * @return MegaChatHandle of the user at the position i in the list
+     */
+    virtual MegaChatHandle getUserHandle(unsigned int i) const;
+
+    /**
+     * @brief Returns the new online status of the user at the position i in the list
+     *
+     * See MegaChatListener::onChatOnlineStatusUpdate for the possible values.
+     *
+     * @param i Position of the user that we want to get from the list
+     * @return New online status of the user, or -1 if it has not changed (or the index is >= the size of the list)
+     */
+    virtual int getStatus(unsigned int i) const;
+
+    /**
+     * @brief Returns the last-green of the user at the position i in the list
+     *
+     * See MegaChatListener::onChatPresenceLastGreen for its meaning.
+     *
+     * @param i Position of the user that we want to get from the list
+     * @return Time elapsed (minutes) since the last time user was green, or -1 if it has not been
+     * notified (or the index is >= the size of the list)
+     */
+    virtual int getLastGreen(unsigned int i) const;
+
+    /**
+     * @brief Returns whether the online status of the user at the position i in the list is stale
+     *
+     * Right after initialization, the online status of contacts is restored from the previous
+     * session, before the presence server is reached. Those statuses may be outdated: once the
+     * server reports them, they are notified again (even if they haven't changed) as not stale.
+     * Statuses not reported by the server shortly after connecting are notified as
+     * MegaChatApi::STATUS_INVALID.
+     *
+     * The apps may use this function to show stale statuses differently.
+     *
+     * @param i Position of the user that we want to get from the list
+     * @return True if the online status of the user is stale (false if the index is >= the size of the list)
+     */
+    virtual bool isStale(unsigned int i) const;
+
+    /**
+     * @brief Returns the number of users in the list
+     * @return Number of users in the list
+     */
+    virtual unsigned int size() const;
+};
+
 /**
  * @brief Interface to receive SDK logs
  *
@@ -3840,6 +4111,19 @@ public:
      */
     int getUserOnlineStatus(MegaChatHandle userhandle);
 
+    /**
+     * @brief Check if the online status of a user is stale
+     *
+     * Right after initialization, the online status of contacts is restored from the previous
+     * session, so MegaChatApi::getUserOnlineStatus returns it before the presence server is
+     * reached. It's stale until the server reports it, which is notified by
+     * MegaChatListener::onChatPresenceBatch (see MegaChatPresenceList::isStale).
+     *
+     * @param userhandle Handle of the user
+     * @return True if the online status of the user is not confirmed by the server yet
+     */
+    bool isUserOnlineStatusStale(MegaChatHandle userhandle);
+
     /**
      * @brief Set the status of the app
      *
@@ -4228,6 +4512,9 @@ public:
      * MegaChatRoom objects, but a limited set of data that is usually displayed
      * at the list of chatrooms, like the title of the chat or the unread count.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the ownership of the returned value
      *
      * @param mask represents what filters to apply to the list of chats
@@ -4262,6 +4549,44 @@ public:
      */
     MegaChatListItemList* getChatListItems(const int mask, const int filter) const;
 
+    /**
+     * @brief Get a page of the chatrooms that match a filter, sorted by last activity
+     *
+     * This function returns the same chatrooms than MegaChatApi::getChatListItems(mask, filter),
+     * sorted by the timestamp of their last message (or their creation, if they have no messages),
+     * the most recent first. Only the chatrooms in the range [offset, offset + count) of that order
+     * are returned, so apps with many chats can build the items that are visible only.
+     *
+     * The chat list is indexed internally by the properties used in the filters, so the cost of
+     * this function depends on the size of the page rather than on the number of chats.
+     *
+     * It is needed to have successfully called \c MegaChatApi::init (the initialization
+     * state should be \c MegaChatApi::INIT_OFFLINE_SESSION or \c MegaChatApi::INIT_ONLINE_SESSION)
+     * before calling this function.
+     *
+     * You take the ownership of the returned value
+     *
+     * @param mask Filters to apply to the list of chats (see MegaChatApi::getChatListItems)
+     * @param filter Values to apply in the filters (see MegaChatApi::getChatListItems)
+     * @param offset Number of chatrooms to skip from the most recent one
+     * @param count Maximum number of chatrooms to return
+     * @return List of MegaChatListItemList objects in the requested page
+     */
+    MegaChatListItemList* getChatListItemsPage(const int mask, const int filter, unsigned int offset, unsigned int count) const;
+
+    /**
+     * @brief Get the number of chatrooms that match a filter
+     *
+     * It's the number of chatrooms that MegaChatApi::getChatListItems(mask, filter) would return,
+     * without building them, so it can be used to size a list whose pages are retrieved with
+     * MegaChatApi::getChatListItemsPage.
+     *
+     * @param mask Filters to apply to the list of chats (see MegaChatApi::getChatListItems)
+     * @param filter Values to apply in the filters (see MegaChatApi::getChatListItems)
+     * @return Number of chatrooms that match the filter, or zero if the filter is invalid
+     */
+    unsigned int getChatListItemsCount(const int mask, const int filter) const;
+
     /**
      * @brief Get all chatrooms (1on1 and groupal) with limited information
      *
@@ -4276,6 +4601,9 @@ public:
      * This function filters out archived chatrooms. You can retrieve them by using
      * the function \c getArchivedChatListItems.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the ownership of the returned value
      *
      * @deprecated use getChatListItems instead,
@@ -4297,6 +4625,9 @@ public:
      * This function filters out archived chatrooms. You can retrieve them by using
      * the function \c getArchivedChatListItems.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the ownership of the returned value
      *
      * @param type Type of the chatListItems returned by this method.
@@ -4329,6 +4660,9 @@ public:
      *
      * This function returns even archived chatrooms.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the ownership of the returned value
      *
      * @param peers MegaChatPeerList that contains the user handles of the chat participants,
@@ -4374,6 +4708,9 @@ public:
      *
      * This function filters out archived chatrooms.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the onwership of the returned value.
      *
      * @deprecated use getChatListItems instead,
@@ -4389,6 +4726,9 @@ public:
      *
      * This function filters out archived chatrooms.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the onwership of the returned value.
      *
      * @deprecated use getChatListItems instead,
@@ -4399,6 +4739,9 @@ public:
     /**
      * @brief Return the archived chatrooms
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the onwership of the returned value.
      *
      * @deprecated use getChatListItems instead,
@@ -4413,6 +4756,9 @@ public:
      *
      * This function filters out archived chatrooms.
      *
+     * The chatrooms are sorted by last activity: the timestamp of their last message (or of
+     * their creation, if they have no messages), the most recent first.
+     *
      * You take the onwership of the returned value.
      *
      * @deprecated use getChatListItems instead,
@@ -5598,6 +5944,38 @@ public:
      */
     bool isFullHistoryLoaded(MegaChatHandle chatid);
 
+    /**
+     * @brief Sets the maximum RAM used to keep the history of the chatrooms loaded
+     *
+     * Messages loaded by MegaChatApi::loadMessages are kept in RAM while the chatroom is in use.
+     * When a budget is exceeded, the oldest messages are evicted from RAM. They remain in the
+     * local cache, so they are loaded again transparently by MegaChatApi::loadMessages.
+     *
+     * Only messages that have not been loaded by the app since the chatroom was opened can be
+     * evicted, so the history of a chatroom is mostly evicted after MegaChatApi::closeChatRoom.
+     * When the global budget is exceeded, the chatrooms whose history was loaded least recently
+     * are evicted first. The newest messages of every chatroom are always kept.
+     *
+     * It is needed to have successfully called \c MegaChatApi::init (the initialization
+     * state should be \c MegaChatApi::INIT_OFFLINE_SESSION or \c MegaChatApi::INIT_ONLINE_SESSION)
+     * before calling this function. By default there is no limit.
+     *
+     * @param chatBudget Maximum RAM, in bytes, for the history of each chatroom. Zero means unlimited
+     * @param totalBudget Maximum RAM, in bytes, for the history of all chatrooms. Zero means unlimited
+     */
+    void setHistoryMemoryBudget(int64_t chatBudget, int64_t totalBudget);
+
+    /**
+     * @brief Returns an estimation of the RAM used by the history of a chatroom
+     *
+     * @param chatid MegaChatHandle that identifies the chat room, or MEGACHAT_INVALID_HANDLE to
+     * get the RAM used by the history of all chatrooms
+     *
+     * @return The RAM used by the messages kept in memory, in bytes, or -1 if the chatroom
+     * does not exist
+     */
+    int64_t getHistoryMemoryUsage(MegaChatHandle chatid);
+
     /**
      * @brief Returns the MegaChatMessage specified from the chat room.
      *
@@ -5626,6 +6004,52 @@ public:
      */
     MegaChatMessage *getMessageFromNodeHistory(MegaChatHandle chatid, MegaChatHandle msgid);
 
+    /**
+     * @brief Searches text messages in the history stored locally
+     *
+     * Messages are searched in a full-text index of the decrypted history. The index is created
+     * by the first search, and the history that was already stored is indexed progressively in
+     * background, from the most recent messages to the oldest ones. Meanwhile, the results may be
+     * incomplete (see MegaChatRequest::getFlag). Messages that have not been loaded from server
+     * are not found.
+     *
+     * A message is found when it contains all the words in \c query. The last word is matched
+     * as a prefix, so results can be updated while the user types. Results are sorted from the
+     * most recent messages to the oldest ones. To get the next page of results, call this method
+     * again with the cursor returned by MegaChatRequest::getNumber.
+     *
+     * The associated request type with this request is MegaChatRequest::TYPE_SEARCH_MESSAGES
+     * Valid data in the MegaChatRequest object received on callbacks:
+     * - MegaChatRequest::getChatHandle - Returns the chat identifier
+     * - MegaChatRequest::getText - Returns the query
+     * - MegaChatRequest::getParamType - Returns the maximum number of results
+     *
+     * Valid data in the MegaChatRequest object received in onRequestFinish when the error code
+     * is MegaError::ERROR_OK:
+     * - MegaChatRequest::getMegaHandleList - Returns the list of chatids with messages found
+     * - MegaChatRequest::getMegaHandleListByChat - Returns the list of msgids found for a given chat
+     * - MegaChatRequest::getMegaStringMap - Returns a fragment of the text of every message found,
+     *   indexed by its msgid in Base64
+     * - MegaChatRequest::getNumber - Returns the cursor for the next page of results, or zero
+     *   if there are no more results
+     * - MegaChatRequest::getFlag - Returns true if all the local history has been indexed
+     *
+     * You can get the MegaChatMessage object by using the function \c MegaChatApi::getMessage
+     *
+     * On the onRequestFinish error, the error code associated to the MegaChatError can be:
+     * - MegaChatError::ERROR_ARGS - If the query is empty or \c limit is not positive
+     * - MegaChatError::ERROR_NOENT - If the chatroom does not exist
+     * - MegaChatError::ERROR_ACCESS - If the index is not supported by the local database
+     *
+     * @param chatid MegaChatHandle that identifies the chat room, or MEGACHAT_INVALID_HANDLE for all chats
+     * @param query Words to search, separated by spaces
+     * @param limit Maximum number of results to return
+     * @param cursor Zero to get the first results, or the value of MegaChatRequest::getNumber
+     * returned by the previous search with the same query
+     * @param listener MegaChatRequestListener to track this request
+     */
+    void searchMessages(MegaChatHandle chatid, const char *query, int limit, long long cursor = 0, MegaChatRequestListener *listener = NULL);
+
     /**
      * @brief Returns the MegaChatMessage specified from manual sending queue.
      *
@@ -7332,6 +7756,8 @@ public:
      *
      * Audio level monitor detects when a peer starts or stops speaking, and triggers a callback
      * (onChatSessionUpdate with change type CHANGE_TYPE_AUDIO_LEVEL) to inform apps about that event.
+     * It also ranks the peers that are speaking by their audio level, and triggers a callback
+     * (onChatCallUpdate with change type CHANGE_TYPE_ACTIVE_SPEAKERS) when that list changes.
      *
      * It's false by default and it's app responsibility to enable it
      *
@@ -7788,6 +8214,17 @@ public:
      */
     void removeChatRemoteVideoListener(MegaChatHandle chatid, MegaChatHandle clientId, bool hiRes, MegaChatVideoListener *listener);
 
+    /**
+     * @brief Releases a video buffer held by a MegaChatVideoListener
+     *
+     * Buffers received at MegaChatVideoListener::onChatVideoData by a listener that returns
+     * true from MegaChatVideoListener::holdsVideoBuffers must be released with this function
+     * once the app doesn't need them anymore. This function can be called from any thread.
+     *
+     * @param buffer Buffer received at MegaChatVideoListener::onChatVideoData
+     */
+    void releaseVideoBuffer(const char *buffer);
+
     /**
      * @brief Change the SFU id
      *
@@ -7822,6 +8259,20 @@ public:
 
     static void setCatchException(bool enable);
 
+    /**
+     * @brief Sets the number of worker threads used to decrypt received messages
+     *
+     * Signature verification and decryption of messages are CPU-bound, and by default
+     * they are done in the karere thread, one message at a time. When this value is
+     * greater than zero, that work is moved to a pool of worker threads shared by all
+     * the chatrooms. Messages are still delivered to the app in the same order.
+     *
+     * By default, the pool is disabled (zero threads).
+     *
+     * @param numThreads Number of worker threads, or zero to disable the pool
+     */
+    static void setDecryptionThreads(unsigned int numThreads);
+
     /**
      * @brief Checks whether \c text contains a URL
      *
@@ -8547,6 +8998,25 @@ public:
      */
     virtual void onChatPresenceLastGreen(MegaChatApi* api, MegaChatHandle userhandle, int lastGreen);
 
+    /**
+     * @brief This function is called with the changes of online status and last-green of
+     * several users received together from the server
+     *
+     * Upon login, the online status of every contact is received at once. Apps that implement
+     * this callback can update the list of contacts only once per batch.
+     *
+     * The default implementation calls MegaChatListener::onChatOnlineStatusUpdate and
+     * MegaChatListener::onChatPresenceLastGreen for every change in the list, so apps that
+     * don't implement it keep receiving the changes separately.
+     *
+     * Changes of your own online status that are in progress are always notified by
+     * MegaChatListener::onChatOnlineStatusUpdate.
+     *
+     * @param api MegaChatApi connected to the account
+     * @param presences List with the changes of the users. It's only valid during the callback
+     */
+    virtual void onChatPresenceBatch(MegaChatApi* api, MegaChatPresenceList* presences);
+
     /** @brief This function is called when an error occurred in an operation with karere Db
      * Possible returned values:
      *   - MegaChatApi::DB_ERROR_IO               = 1,    /// I/O error in Data base
@@ -38,6 +38,8 @@
 #include <chatClient.h>
 #include <mega/base64.h>
 #include <chatdMsg.h>
+#include <strongvelope/decryptWorkerPool.h>
+#include <string_view>
 
 #ifdef _WIN32
 #pragma warning(push)
@@ -174,6 +176,7 @@ void MegaChatApiImpl::init(MegaChatApi *chatApi, MegaApi *megaApi)
     API_LOG_DEBUG("MegaChatApiImpl::init(): karere client is invalid");
     mTerminating = false;
     waiter = new MegaChatWaiter();
+    mTimerWheel = std::make_unique<karere::TimerWheel>(static_cast<MegaChatWaiter*>(waiter)->eventloop(), this);
     mWebsocketsIO = new MegaWebsocketsIO(sdkMutex, waiter, megaApi, this);
     reqtag = 0;
 #ifndef KARERE_DISABLE_WEBRTC
@@ -204,6 +207,7 @@ void *MegaChatApiImpl::threadEntryPoint(void *param)
 void MegaChatApiImpl::loop()
 {
     sdkMutex.lock();
+    mThreadId = std::this_thread::get_id();
     while (true)
     {
         sdkMutex.unlock();
@@ -216,6 +220,8 @@ void MegaChatApiImpl::loop()
 
         sendPendingEvents();
         sendPendingRequests();
+        publishState();
+        logLockStats();
 
         if (threadExit)
         {
@@ -231,6 +237,149 @@ void MegaChatApiImpl::loop()
     globalCleanup();
 }
 
+bool MegaChatApiImpl::usePublishedState() const
+{
+    // mPublishedMutex must be locked. The thread of MegaChatApiImpl may be notifying changes
+    // that are not published yet, so it reads the karere state instead
+    return mPublishedValid && std::this_thread::get_id() != mThreadId;
+}
+
+void MegaChatApiImpl::publishChatListItem(MegaChatHandle chatid)
+{
+    ChatRoom *room = findChatRoom(chatid);
+    int unreadChats = (mClient && !mTerminating)
+            ? static_cast<int>(mClient->chats->mIndex.count(ChatRoomIndex::kArchived | ChatRoomIndex::kPreview | ChatRoomIndex::kUnread,
+                                                            ChatRoomIndex::kUnread))
+            : 0;
+
+    // items that haven't been requested yet are not built (see getChatListItem())
+    auto it = mPublishedItems.find(chatid);
+    std::unique_ptr<MegaChatListItemPrivate> item((room && it != mPublishedItems.end() && it->second)
+                                                  ? new MegaChatListItemPrivate(*room) : nullptr);
+
+    std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+    if (room)
+    {
+        mPublishedItems[chatid] = std::move(item);
+    }
+    else
+    {
+        mPublishedItems.erase(chatid);
+    }
+    mPublishedUnreadChats = unreadChats;
+}
+
+void MegaChatApiImpl::publishChatCall(MegaChatHandle chatid)
+{
+#ifndef KARERE_DISABLE_WEBRTC
+    rtcModule::ICall *call = (mClient && !mTerminating && mClient->rtc) ? mClient->rtc->findCallByChatid(chatid) : nullptr;
+    std::unique_ptr<MegaChatCallPrivate> chatCall(call ? new MegaChatCallPrivate(*call) : nullptr);
+
+    std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+    if (chatCall)
+    {
+        mPublishedCalls[chatid] = std::move(chatCall);
+    }
+    else
+    {
+        mPublishedCalls.erase(chatid);
+    }
+    mDirtyCalls.erase(chatid);
+#endif
+}
+
+void MegaChatApiImpl::publishState()
+{
+    if (!mClient || mTerminating)
+    {
+        if (mPublishedValid)
+        {
+            std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+            mPublishedValid = false;
+            mPublishedUnreadChats = 0;
+            mPublishedItems.clear();
+#ifndef KARERE_DISABLE_WEBRTC
+            mPublishedCalls.clear();
+            mDirtyCalls.clear();
+#endif
+        }
+        return;
+    }
+
+    // the published entries are only modified with the sdkMutex locked, so they can be read without lock here
+    if (!mPublishedValid || mClient->chats->size() != mPublishedItems.size())
+    {
+        // rooms were added or removed: only their entries change. New entries are empty, and their
+        // items are built on first request (building one may require a query to the db)
+        int unreadChats = static_cast<int>(mClient->chats->mIndex.count(ChatRoomIndex::kArchived | ChatRoomIndex::kPreview | ChatRoomIndex::kUnread,
+                                                                        ChatRoomIndex::kUnread));
+        std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+        auto published = mPublishedItems.begin();
+        for (const auto& it: *mClient->chats)
+        {
+            while (published != mPublishedItems.end() && published->first < it.first)
+            {
+                published = mPublishedItems.erase(published);
+            }
+            if (published == mPublishedItems.end() || published->first != it.first)
+            {
+                published = mPublishedItems.emplace_hint(published, it.first, nullptr);
+            }
+            published++;
+        }
+        mPublishedItems.erase(published, mPublishedItems.end());
+        mPublishedUnreadChats = unreadChats;
+    }
+
+#ifndef KARERE_DISABLE_WEBRTC
+    if (mClient->rtc)
+    {
+        std::vector<karere::Id> chatids = mClient->rtc->chatsWithCall();
+        if (!mPublishedValid || chatids.size() != mPublishedCalls.size())
+        {
+            mDirtyCalls.insert(chatids.begin(), chatids.end());
+            for (const auto& it: mPublishedCalls)
+            {
+                mDirtyCalls.insert(it.first);
+            }
+        }
+    }
+
+    while (!mDirtyCalls.empty())
+    {
+        publishChatCall(*mDirtyCalls.begin());
+    }
+#endif
+
+    if (!mPublishedValid)
+    {
+        std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+        mPublishedValid = true;
+    }
+}
+
+void MegaChatApiImpl::logLockStats()
+{
+    time_t now = time(NULL);
+    if (now - mLockStatsTs < kLockStatsInterval)
+    {
+        return;
+    }
+
+    if (mLockStatsTs)
+    {
+        auto logStats = [](const char *name, const SdkMutex::Stats& stats)
+        {
+            API_LOG_DEBUG("Lock contention of %s: %llu acquisitions, %llu contended, %llu us waited (max %llu us)", name,
+                          static_cast<unsigned long long>(stats.acquisitions), static_cast<unsigned long long>(stats.contended),
+                          static_cast<unsigned long long>(stats.waitUs), static_cast<unsigned long long>(stats.maxWaitUs));
+        };
+        logStats("sdkMutex", sdkMutex.takeStats());
+        logStats("videoMutex", videoMutex.takeStats());
+    }
+    mLockStatsTs = now;
+}
+
 void MegaChatApiImpl::megaApiPostMessage(megaMessage* msg, void* ctx)
 {
     MegaChatApiImpl *megaChatApi = (MegaChatApiImpl *)ctx;
@@ -250,8 +399,11 @@ void MegaChatApiImpl::megaApiPostMessage(megaMessage* msg, void* ctx)
 
 void MegaChatApiImpl::postMessage(megaMessage* msg)
 {
-    eventQueue.push(msg);
-    waiter->notify();
+    // if the queue wasn't empty, the thread has been notified already and will process it
+    if (eventQueue.push(msg))
+    {
+        waiter->notify();
+    }
 }
 
 void MegaChatApiImpl::sendPendingRequests()
@@ -3644,6 +3796,11 @@ void MegaChatApiImpl::setCatchException(bool enable)
     karere::gCatchException = enable;
 }
 
+void MegaChatApiImpl::setDecryptionThreads(unsigned int numThreads)
+{
+    strongvelope::DecryptWorkerPool::instance().setThreadCount(numThreads);
+}
+
 bool MegaChatApiImpl::hasUrl(const char *text)
 {
     std::string url;
@@ -3903,6 +4060,7 @@ void MegaChatApiImpl::fireOnChatCallUpdate(MegaChatCallPrivate *call)
         return;
     }
 
+    publishChatCall(call->getChatid());
     for (set<MegaChatCallListener *>::iterator it = callListeners.begin(); it != callListeners.end() ; it++)
     {
         (*it)->onChatCallUpdate(mChatApi, call);
@@ -3931,6 +4089,7 @@ void MegaChatApiImpl::fireOnChatSessionUpdate(MegaChatHandle chatid, MegaChatHan
         return;
     }
 
+    publishChatCall(chatid);
     for (set<MegaChatCallListener *>::iterator it = callListeners.begin(); it != callListeners.end() ; it++)
     {
         (*it)->onChatSessionUpdate(mChatApi, chatid, callid, session);
@@ -3939,77 +4098,148 @@ void MegaChatApiImpl::fireOnChatSessionUpdate(MegaChatHandle chatid, MegaChatHan
     session->removeChanges();
 }
 
-void MegaChatApiImpl::fireOnChatVideoData(MegaChatHandle chatid, uint32_t clientId, int width, int height, int sourceType, char *buffer, rtcModule::VideoResolution videoResolution)
+const MegaChatVideoListener_set* MegaChatApiImpl::getVideoListeners(MegaChatHandle chatid, uint32_t clientId, int sourceType, rtcModule::VideoResolution videoResolution)
 {
-    std::map<MegaChatHandle, MegaChatPeerVideoListener_map>::iterator it;
-    std::map<MegaChatHandle, MegaChatPeerVideoListener_map>::iterator itEnd;
     assert(videoResolution != rtcModule::VideoResolution::kUndefined);
     if (clientId == 0)
     {
         if (sourceType != MegaChatApi::TYPE_VIDEO_SOURCE_LOCAL_CAMERA &&
             sourceType != MegaChatApi::TYPE_VIDEO_SOURCE_LOCAL_SCREEN)
         {
-            API_LOG_ERROR("fireOnChatVideoData. Invalid sourceType: %d", sourceType);
+            API_LOG_ERROR("getVideoListeners. Invalid sourceType: %d", sourceType);
             assert(false);
-            return;
+            return nullptr;
         }
 
-        const auto& listeners = sourceType == MegaChatApi::TYPE_VIDEO_SOURCE_LOCAL_CAMERA
-                                     ? mLocalCameraVideoListeners[chatid]
-                                     : mLocalScreenVideoListeners[chatid];
+        const auto& localListeners = sourceType == MegaChatApi::TYPE_VIDEO_SOURCE_LOCAL_CAMERA
+                                     ? mLocalCameraVideoListeners
+                                     : mLocalScreenVideoListeners;
+        auto it = localListeners.find(chatid);
+        return (it != localListeners.end()) ? &it->second : nullptr;
+    }
+
+    if (sourceType != MegaChatApi::TYPE_VIDEO_SOURCE_REMOTE)
+    {
+        API_LOG_ERROR("getVideoListeners. Invalid sourceType: %d", sourceType);
+        assert(false);
+        return nullptr;
+    }
+
+    const auto& remoteListeners = (videoResolution == rtcModule::VideoResolution::kHiRes)
+                                  ? mVideoListenersHiRes
+                                  : mVideoListenersLowRes;
+    auto it = remoteListeners.find(chatid);
+    if (it == remoteListeners.end())
+    {
+        return nullptr;
+    }
+
+    MegaChatPeerVideoListener_map::const_iterator peerVideoIterator = it->second.find(clientId);
+    return (peerVideoIterator != it->second.end()) ? &peerVideoIterator->second : nullptr;
+}
+
+bool MegaChatApiImpl::hasVideoListeners(MegaChatHandle chatid, uint32_t clientId, int sourceType, rtcModule::VideoResolution videoResolution, bool i420)
+{
+    SdkMutexGuard g(videoMutex);
+    const MegaChatVideoListener_set* listeners = getVideoListeners(chatid, clientId, sourceType, videoResolution);
+    if (!listeners)
+    {
+        return false;
+    }
 
-        for (const auto& listener: listeners)
+    for (MegaChatVideoListener* listener: *listeners)
+    {
+        if (listener && listener->wantsI420Frames() == i420)
         {
-            listener->onChatVideoData(mChatApi, chatid, width, height, buffer, width * height * 4);
+            return true;
         }
+    }
+    return false;
+}
 
+void MegaChatApiImpl::fireOnChatVideoData(MegaChatHandle chatid, uint32_t clientId, MegaChatVideoFrame* frame, rtcModule::VideoResolution videoResolution)
+{
+    const MegaChatVideoListener_set* listeners = getVideoListeners(chatid, clientId, frame->sourceType, videoResolution);
+    if (!listeners)
+    {
         return;
     }
 
-    if (sourceType != MegaChatApi::TYPE_VIDEO_SOURCE_REMOTE)
+    for (MegaChatVideoListener* listener: *listeners)
+    {
+        if (listener == nullptr)
+        {
+            API_LOG_WARNING("videoListener with CID %u does not exists ", clientId);
+            continue;
+        }
+
+        if (listener->wantsI420Frames())
+        {
+            continue;
+        }
+
+        holdVideoFrame(listener, frame);
+        listener->onChatVideoData(mChatApi, chatid, frame->width, frame->height, reinterpret_cast<char*>(frame->buffer), frame->size());
+    }
+}
+
+void MegaChatApiImpl::fireOnChatVideoFrameI420(MegaChatHandle chatid, uint32_t clientId, int sourceType, const rtcModule::IVideoFrameI420& frame, rtcModule::VideoResolution videoResolution)
+{
+    const MegaChatVideoListener_set* listeners = getVideoListeners(chatid, clientId, sourceType, videoResolution);
+    if (!listeners)
     {
-        API_LOG_ERROR("fireOnChatVideoData. Invalid sourceType: %d", sourceType);
-        assert(false);
         return;
     }
 
-    if (videoResolution == rtcModule::VideoResolution::kHiRes)
+    MegaChatVideoFrameI420Private megaFrame(frame.copy());
+    for (MegaChatVideoListener* listener: *listeners)
     {
-         it = mVideoListenersHiRes.find(chatid);
-         itEnd = mVideoListenersHiRes.end();
+        if (listener && listener->wantsI420Frames())
+        {
+            listener->onChatVideoFrameI420(mChatApi, chatid, &megaFrame);
+        }
     }
-    else
+}
+
+void MegaChatApiImpl::holdVideoFrame(MegaChatVideoListener* listener, MegaChatVideoFrame* frame)
+{
+    if (!listener->holdsVideoBuffers())
     {
-        assert(clientId); // local video listeners can't be un/registered into this map
-        it = mVideoListenersLowRes.find(chatid);
-        itEnd = mVideoListenersLowRes.end();
+        return;
     }
 
-    if (it != itEnd)
+    frame->refs++;
+    mHeldVideoFrames[reinterpret_cast<const char*>(frame->buffer)] = frame;
+}
+
+void MegaChatApiImpl::releaseVideoBuffer(const char* buffer)
+{
+    MegaChatVideoFrame* frame = nullptr;
     {
-        MegaChatPeerVideoListener_map::iterator peerVideoIterator = it->second.find(clientId);
-        if (peerVideoIterator != it->second.end())
+        SdkMutexGuard g(videoMutex);
+        auto it = mHeldVideoFrames.find(buffer);
+        if (it == mHeldVideoFrames.end())
         {
-            for( MegaChatVideoListener_set::iterator videoListenerIterator = peerVideoIterator->second.begin();
-                 videoListenerIterator != peerVideoIterator->second.end();
-                 videoListenerIterator++)
-            {
-                if (*videoListenerIterator == nullptr)
-                {
-                    API_LOG_WARNING("remote videoListener with CID %u does not exists ", clientId);
-                    continue;
-                }
+            API_LOG_WARNING("releaseVideoBuffer: unknown video buffer");
+            return;
+        }
 
-                (*videoListenerIterator)->onChatVideoData(mChatApi, chatid, width, height, buffer, width * height * 4);
-            }
+        if (--it->second->refs)
+        {
+            return;
         }
+        frame = it->second;
+        mHeldVideoFrames.erase(it);
     }
+    MegaChatVideoFrame::release(frame);
 }
 
 #endif  // webrtc
 
 void MegaChatApiImpl::fireOnChatListItemUpdate(MegaChatListItem *item)
 {
+    publishChatListItem(item->getChatId());
+
     for(set<MegaChatListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
     {
         (*it)->onChatListItemUpdate(mChatApi, item);
@@ -4052,6 +4282,14 @@ void MegaChatApiImpl::fireOnChatPresenceLastGreenUpdated(MegaChatHandle userhand
     }
 }
 
+void MegaChatApiImpl::fireOnChatPresenceBatch(MegaChatPresenceList *presences)
+{
+    for(set<MegaChatListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onChatPresenceBatch(mChatApi, presences);
+    }
+}
+
 void MegaChatApiImpl::fireOnChatConnectionStateUpdate(MegaChatHandle chatid, int newState)
 {
     bool allConnected = (newState == MegaChatApi::CHAT_CONNECTION_ONLINE) ? mClient->mChatdClient->areAllChatsLoggedIn() : false;
@@ -4271,6 +4509,12 @@ int MegaChatApiImpl::getUserOnlineStatus(MegaChatHandle userhandle)
     return status;
 }
 
+bool MegaChatApiImpl::isUserOnlineStatusStale(MegaChatHandle userhandle)
+{
+    SdkMutexGuard g(sdkMutex);
+    return mClient && !mTerminating && mClient->presenced().isPeerPresenceStale(userhandle);
+}
+
 void MegaChatApiImpl::setBackgroundStatus(bool background, MegaChatRequestListener *listener)
 {
     MegaChatRequestPrivate *request = new MegaChatRequestPrivate(MegaChatRequest::TYPE_SET_BACKGROUND_STATUS, listener);
@@ -4620,312 +4864,267 @@ MegaChatRoom *MegaChatApiImpl::getChatRoomByUser(MegaChatHandle userhandle)
     return chat;
 }
 
-MegaChatListItemList* MegaChatApiImpl::getChatListItems(const int mask, const int filter) const
+bool MegaChatApiImpl::chatTypeToIndexFlags(int type, uint8_t& flagsMask, uint8_t& flagsValue)
 {
-    LOG_verbose << "MegaChatApiImpl::getChatListItems with mask " << mask << " and filter " << filter;
-
-    if (mask < 0 || filter < 0)
-    {
-        LOG_warn << "getChatListItems: invalid arguments";
-        return new MegaChatListItemListPrivate();
-    }
-
-    enum BitOrder
-    {
-        IndivOrGroup = 0,
-        PubOrPriv,
-        MeetingsOrNon,
-        ArchivedOrNon,
-        ActiveOrNon,
-        ReadOrUnread,
-        TotalBits
-    };
-    constexpr std::size_t bsSize = BitOrder::TotalBits;
-    const std::bitset<bsSize> bsMask {static_cast<unsigned long long>(mask)};
-    const std::bitset<bsSize> bsFilter {static_cast<unsigned long long>(filter)};
-
-    const auto passFilter = [this, &bsMask, &bsFilter](ChatRoom* cr) -> bool
+    // adds a condition on one flag, fails if it contradicts a previous one
+    auto require = [&flagsMask, &flagsValue](uint8_t flag, bool set) -> bool
     {
-        const bool individualRequested = bsFilter[BitOrder::IndivOrGroup];
-        if (bsMask[BitOrder::IndivOrGroup] &&
-            !isChatroomFromType(*cr, individualRequested ? MegaChatApi::CHAT_TYPE_INDIVIDUAL : MegaChatApi::CHAT_TYPE_GROUP))
-        { return false; }
-
-        const bool publicRequested = bsFilter[BitOrder::PubOrPriv];
-        if (bsMask[BitOrder::PubOrPriv] &&
-            !isChatroomFromType(*cr, publicRequested ? MegaChatApi::CHAT_TYPE_GROUP_PUBLIC : MegaChatApi::CHAT_TYPE_GROUP_PRIVATE))
-        { return false; }
-
-        const bool meetingsRequested = bsFilter[BitOrder::MeetingsOrNon];
-        if (bsMask[BitOrder::MeetingsOrNon] &&
-            !isChatroomFromType(*cr, meetingsRequested ? MegaChatApi::CHAT_TYPE_MEETING_ROOM : MegaChatApi::CHAT_TYPE_NON_MEETING))
-        { return false; }
-
-        const bool archivedRequested = bsFilter[BitOrder::ArchivedOrNon];
-        if (bsMask[BitOrder::ArchivedOrNon] && archivedRequested != cr->isArchived())
-        { return false; }
-
-        const bool activeRequested = bsFilter[BitOrder::ActiveOrNon];
-        if (bsMask[BitOrder::ActiveOrNon] && activeRequested != cr->isActive())
-        { return false; }
-
-        const bool readRequested = bsFilter[BitOrder::ReadOrUnread];
-        if (bsMask[BitOrder::ReadOrUnread] && readRequested == static_cast<bool>(cr->chat().unreadMsgCount()))
-        { return false; }
-
+        if ((flagsMask & flag) && static_cast<bool>(flagsValue & flag) != set)
+        {
+            return false;
+        }
+        flagsMask |= flag;
+        flagsValue = set ? (flagsValue | flag) : (flagsValue & ~flag);
         return true;
     };
 
-    auto ret = new MegaChatListItemListPrivate();
-    std::lock_guard<std::recursive_mutex> g {sdkMutex};
-
-    if (mClient && !mTerminating)
+    switch (type)
     {
-        for (const auto& [crId, cr] : *(mClient->chats))
-        {
-            if (passFilter(cr)) { ret->addChatListItem(new MegaChatListItemPrivate(*cr)); }
-        }
+        case MegaChatApi::CHAT_TYPE_ALL:
+            return true;
+        case MegaChatApi::CHAT_TYPE_INDIVIDUAL:
+            return require(ChatRoomIndex::kGroup, false);
+        case MegaChatApi::CHAT_TYPE_GROUP:
+            return require(ChatRoomIndex::kGroup, true) && require(ChatRoomIndex::kMeeting, false);
+        case MegaChatApi::CHAT_TYPE_GROUP_PRIVATE:  // private groupchats can't be meeting rooms
+            return require(ChatRoomIndex::kGroup, true) && require(ChatRoomIndex::kPublic, false);
+        case MegaChatApi::CHAT_TYPE_GROUP_PUBLIC:
+            return require(ChatRoomIndex::kGroup, true) && require(ChatRoomIndex::kPublic, true)
+                    && require(ChatRoomIndex::kMeeting, false);
+        case MegaChatApi::CHAT_TYPE_MEETING_ROOM:
+            return require(ChatRoomIndex::kMeeting, true);
+        case MegaChatApi::CHAT_TYPE_NON_MEETING:
+            return require(ChatRoomIndex::kMeeting, false);
     }
-
-    return ret;
+    return false;
 }
 
-MegaChatListItemList *MegaChatApiImpl::getChatListItems() const
+bool MegaChatApiImpl::chatFilterToIndexFlags(int mask, int filter, uint8_t& flagsMask, uint8_t& flagsValue)
 {
-    MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
-
-    sdkMutex.lock();
-
-    if (mClient && !mTerminating)
+    if (mask < 0 || filter < 0)
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
-        {
-            if (!it->second->isArchived())
-            {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-            }
-        }
+        return false;
     }
 
-    sdkMutex.unlock();
+    flagsMask = 0;
+    flagsValue = 0;
+    bool valid = true;
+    if (mask & MegaChatApi::CHAT_FILTER_BY_INDIVIDUAL_OR_GROUP)
+    {
+        valid &= chatTypeToIndexFlags((filter & MegaChatApi::CHAT_GET_INDIVIDUAL) ? MegaChatApi::CHAT_TYPE_INDIVIDUAL : MegaChatApi::CHAT_TYPE_GROUP,
+                                      flagsMask, flagsValue);
+    }
+    if (mask & MegaChatApi::CHAT_FILTER_BY_PUBLIC_OR_PRIVATE)
+    {
+        valid &= chatTypeToIndexFlags((filter & MegaChatApi::CHAT_GET_PUBLIC) ? MegaChatApi::CHAT_TYPE_GROUP_PUBLIC : MegaChatApi::CHAT_TYPE_GROUP_PRIVATE,
+                                      flagsMask, flagsValue);
+    }
+    if (mask & MegaChatApi::CHAT_FILTER_BY_MEETING_OR_NON_MEETING)
+    {
+        valid &= chatTypeToIndexFlags((filter & MegaChatApi::CHAT_GET_MEETING) ? MegaChatApi::CHAT_TYPE_MEETING_ROOM : MegaChatApi::CHAT_TYPE_NON_MEETING,
+                                      flagsMask, flagsValue);
+    }
 
-    return items;
+    // the remaining conditions are on independent flags
+    if (mask & MegaChatApi::CHAT_FILTER_BY_ARCHIVED_OR_NON_ARCHIVED)
+    {
+        flagsMask |= ChatRoomIndex::kArchived;
+        flagsValue |= (filter & MegaChatApi::CHAT_GET_ARCHIVED) ? ChatRoomIndex::kArchived : 0;
+    }
+    if (mask & MegaChatApi::CHAT_FILTER_BY_ACTIVE_OR_NON_ACTIVE)
+    {
+        flagsMask |= ChatRoomIndex::kActive;
+        flagsValue |= (filter & MegaChatApi::CHAT_GET_ACTIVE) ? ChatRoomIndex::kActive : 0;
+    }
+    if (mask & MegaChatApi::CHAT_FILTER_BY_READ_OR_UNREAD)
+    {
+        flagsMask |= ChatRoomIndex::kUnread;
+        flagsValue |= (filter & MegaChatApi::CHAT_GET_READ) ? 0 : ChatRoomIndex::kUnread;
+    }
+    return valid;
 }
 
-MegaChatListItemList* MegaChatApiImpl::getChatListItemsByType(int type)
+MegaChatListItemList* MegaChatApiImpl::getChatListItemsFromIndex(uint8_t flagsMask, uint8_t flagsValue, size_t offset, size_t count) const
 {
     MegaChatListItemListPrivate* items = new MegaChatListItemListPrivate();
     SdkMutexGuard g(sdkMutex);
-    if (type < MegaChatApi::CHAT_TYPE_ALL || type > MegaChatApi::CHAT_TYPE_NON_MEETING)
+    if (!mClient || mTerminating)
     {
         return items;
     }
 
-    if (mClient && !mTerminating)
+    ChatRoomList& chats = *mClient->chats;
+    for (uint64_t chatid: chats.mIndex.select(flagsMask, flagsValue, offset, count))
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
-        {
-            if (!it->second->isArchived() && isChatroomFromType(*it->second, type))
-            {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-            }
-        }
+        items->addChatListItem(new MegaChatListItemPrivate(*chats.at(chatid)));
     }
 
     return items;
 }
 
-MegaChatListItemList *MegaChatApiImpl::getChatListItemsByPeers(MegaChatPeerList *peers)
+MegaChatListItemList* MegaChatApiImpl::getChatListItems(const int mask, const int filter) const
 {
-    MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
-
-    sdkMutex.lock();
+    LOG_verbose << "MegaChatApiImpl::getChatListItems with mask " << mask << " and filter " << filter;
 
-    if (mClient && !mTerminating)
+    uint8_t flagsMask;
+    uint8_t flagsValue;
+    if (!chatFilterToIndexFlags(mask, filter, flagsMask, flagsValue))
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
-        {
-            bool sameParticipants = true;
-            if (it->second->isGroup())
-            {
-                GroupChatRoom *chatroom = (GroupChatRoom*) it->second;
-                if ((int)chatroom->peers().size() != peers->size())
-                {
-                    continue;
-                }
-
-                for (int i = 0; i < peers->size(); i++)
-                {
-                    // if the peer in the list is part of the members in the chatroom...
-                    MegaChatHandle uh = peers->getPeerHandle(i);
-                    if (chatroom->peers().find(uh) == chatroom->peers().end())
-                    {
-                        sameParticipants = false;
-                        break;
-                    }
-                }
-                if (sameParticipants == true)
-                {
-                    items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-                }
-
-            }
-            else    // 1on1
-            {
-                if (peers->size() != 1)
-                {
-                    continue;
-                }
-
-                PeerChatRoom *chatroom = (PeerChatRoom*) it->second;
-                if (chatroom->peer() == peers->getPeerHandle(0))
-                {
-                    items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-                }
-            }
-        }
+        LOG_warn << "getChatListItems: invalid arguments";
+        return new MegaChatListItemListPrivate();
     }
 
-    sdkMutex.unlock();
-
-    return items;
+    return getChatListItemsFromIndex(flagsMask, flagsValue);
 }
 
-MegaChatListItem *MegaChatApiImpl::getChatListItem(MegaChatHandle chatid)
+MegaChatListItemList* MegaChatApiImpl::getChatListItemsPage(const int mask, const int filter, unsigned int offset, unsigned int count) const
 {
-    MegaChatListItemPrivate *item = NULL;
+    uint8_t flagsMask;
+    uint8_t flagsValue;
+    if (!chatFilterToIndexFlags(mask, filter, flagsMask, flagsValue))
+    {
+        LOG_warn << "getChatListItemsPage: invalid arguments";
+        return new MegaChatListItemListPrivate();
+    }
 
-    sdkMutex.lock();
+    return getChatListItemsFromIndex(flagsMask, flagsValue, offset, count);
+}
 
-    ChatRoom *chatRoom = findChatRoom(chatid);
-    if (chatRoom)
+unsigned int MegaChatApiImpl::getChatListItemsCount(const int mask, const int filter) const
+{
+    uint8_t flagsMask;
+    uint8_t flagsValue;
+    if (!chatFilterToIndexFlags(mask, filter, flagsMask, flagsValue))
     {
-        item = new MegaChatListItemPrivate(*chatRoom);
+        return 0;
     }
 
-    sdkMutex.unlock();
-
-    return item;
+    SdkMutexGuard g(sdkMutex);
+    if (!mClient || mTerminating)
+    {
+        return 0;
+    }
+    return static_cast<unsigned int>(mClient->chats->mIndex.count(flagsMask, flagsValue));
 }
 
-int MegaChatApiImpl::getUnreadChats()
+MegaChatListItemList *MegaChatApiImpl::getChatListItems() const
 {
-    int count = 0;
-
-    sdkMutex.lock();
+    return getChatListItemsFromIndex(ChatRoomIndex::kArchived, 0);
+}
 
-    if (mClient && !mTerminating)
+MegaChatListItemList* MegaChatApiImpl::getChatListItemsByType(int type)
+{
+    uint8_t flagsMask = ChatRoomIndex::kArchived;
+    uint8_t flagsValue = 0;
+    if (!chatTypeToIndexFlags(type, flagsMask, flagsValue))
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
-        {
-            ChatRoom *room = it->second;
-            if (!room->isArchived() && !room->previewMode() && room->chat().unreadMsgCount())
-            {
-                count++;
-            }
-        }
+        return new MegaChatListItemListPrivate();
     }
 
-    sdkMutex.unlock();
-
-    return count;
+    return getChatListItemsFromIndex(flagsMask, flagsValue);
 }
 
-MegaChatListItemList *MegaChatApiImpl::getActiveChatListItems()
+MegaChatListItemList *MegaChatApiImpl::getChatListItemsByPeers(MegaChatPeerList *peers)
 {
     MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
 
-    sdkMutex.lock();
+    std::vector<uint64_t> peerHandles;
+    for (int i = 0; i < peers->size(); i++)
+    {
+        peerHandles.push_back(peers->getPeerHandle(i));
+    }
 
+    SdkMutexGuard g(sdkMutex);
     if (mClient && !mTerminating)
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
+        for (uint64_t chatid: mClient->chats->mIndex.selectByPeers(peerHandles))
         {
-            if (!it->second->isArchived() && it->second->isActive())
-            {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-            }
+            items->addChatListItem(new MegaChatListItemPrivate(*mClient->chats->at(chatid)));
         }
     }
 
-    sdkMutex.unlock();
-
     return items;
 }
 
-MegaChatListItemList *MegaChatApiImpl::getInactiveChatListItems()
+MegaChatListItem *MegaChatApiImpl::getChatListItem(MegaChatHandle chatid)
 {
-    MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
-
-    sdkMutex.lock();
+    MegaChatListItemPrivate *item = NULL;
 
-    if (mClient && !mTerminating)
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
+        std::shared_lock<std::shared_mutex> lock(mPublishedMutex);
+        if (usePublishedState())
         {
-            if (!it->second->isArchived() && !it->second->isActive())
+            auto it = mPublishedItems.find(chatid);
+            if (it == mPublishedItems.end())
+            {
+                return NULL;
+            }
+            if (it->second)
             {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
+                return new MegaChatListItemPrivate(it->second.get());
             }
+            // first request of the item: it's built below and published
         }
     }
 
-    sdkMutex.unlock();
-
-    return items;
-}
-
-MegaChatListItemList *MegaChatApiImpl::getArchivedChatListItems()
-{
-    MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
-
     sdkMutex.lock();
 
-    if (mClient && !mTerminating)
+    ChatRoom *chatRoom = findChatRoom(chatid);
+    if (chatRoom)
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
+        item = new MegaChatListItemPrivate(*chatRoom);
+
+        std::unique_lock<std::shared_mutex> lock(mPublishedMutex);
+        auto it = mPublishedItems.find(chatid);
+        if (it != mPublishedItems.end() && !it->second)
         {
-            if (it->second->isArchived())
-            {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-            }
+            it->second.reset(new MegaChatListItemPrivate(item));
         }
     }
 
     sdkMutex.unlock();
 
-    return items;
+    return item;
 }
 
-MegaChatListItemList *MegaChatApiImpl::getUnreadChatListItems()
+int MegaChatApiImpl::getUnreadChats()
 {
-    MegaChatListItemListPrivate *items = new MegaChatListItemListPrivate();
-
-    sdkMutex.lock();
-
-    if (mClient && !mTerminating)
     {
-        ChatRoomList::iterator it;
-        for (it = mClient->chats->begin(); it != mClient->chats->end(); it++)
+        std::shared_lock<std::shared_mutex> lock(mPublishedMutex);
+        if (usePublishedState())
         {
-            ChatRoom *room = it->second;
-            if (!room->isArchived() && room->chat().unreadMsgCount())
-            {
-                items->addChatListItem(new MegaChatListItemPrivate(*it->second));
-            }
+            return mPublishedUnreadChats;
         }
     }
 
-    sdkMutex.unlock();
+    SdkMutexGuard g(sdkMutex);
+    if (!mClient || mTerminating)
+    {
+        return 0;
+    }
 
-    return items;
+    return static_cast<int>(mClient->chats->mIndex.count(ChatRoomIndex::kArchived | ChatRoomIndex::kPreview | ChatRoomIndex::kUnread,
+                                                         ChatRoomIndex::kUnread));
+}
+
+MegaChatListItemList *MegaChatApiImpl::getActiveChatListItems()
+{
+    return getChatListItemsFromIndex(ChatRoomIndex::kArchived | ChatRoomIndex::kActive, ChatRoomIndex::kActive);
+}
+
+MegaChatListItemList *MegaChatApiImpl::getInactiveChatListItems()
+{
+    return getChatListItemsFromIndex(ChatRoomIndex::kArchived | ChatRoomIndex::kActive, 0);
+}
+
+MegaChatListItemList *MegaChatApiImpl::getArchivedChatListItems()
+{
+    return getChatListItemsFromIndex(ChatRoomIndex::kArchived, ChatRoomIndex::kArchived);
+}
+
+MegaChatListItemList *MegaChatApiImpl::getUnreadChatListItems()
+{
+    return getChatListItemsFromIndex(ChatRoomIndex::kArchived | ChatRoomIndex::kUnread, ChatRoomIndex::kUnread);
 }
 
 MegaChatHandle MegaChatApiImpl::getChatHandleByUser(MegaChatHandle userhandle)
@@ -5386,6 +5585,40 @@ bool MegaChatApiImpl::isFullHistoryLoaded(MegaChatHandle chatid)
     return ret;
 }
 
+void MegaChatApiImpl::setHistoryMemoryBudget(int64_t chatBudget, int64_t totalBudget)
+{
+    SdkMutexGuard g(sdkMutex);
+    if (!mClient || !mClient->mChatdClient)
+    {
+        API_LOG_WARNING("setHistoryMemoryBudget: MEGAchat is not initialized");
+        return;
+    }
+
+    mClient->mChatdClient->setHistoryMemoryBudget(static_cast<size_t>(std::max<int64_t>(chatBudget, 0)),
+                                                  static_cast<size_t>(std::max<int64_t>(totalBudget, 0)));
+}
+
+int64_t MegaChatApiImpl::getHistoryMemoryUsage(MegaChatHandle chatid)
+{
+    SdkMutexGuard g(sdkMutex);
+    if (!mClient || !mClient->mChatdClient)
+    {
+        return -1;
+    }
+
+    if (chatid == MEGACHAT_INVALID_HANDLE)
+    {
+        return static_cast<int64_t>(mClient->mChatdClient->updateHistoryMemory());
+    }
+
+    ChatRoom *chatroom = findChatRoom(chatid);
+    if (!chatroom)
+    {
+        return -1;
+    }
+    return static_cast<int64_t>(chatroom->chat().updateHistoryMemory());
+}
+
 MegaChatMessage *MegaChatApiImpl::getMessage(MegaChatHandle chatid, MegaChatHandle msgid)
 {
     MegaChatMessagePrivate *megaMsg = NULL;
@@ -5430,6 +5663,85 @@ MegaChatMessage *MegaChatApiImpl::getMessage(MegaChatHandle chatid, MegaChatHand
     return megaMsg;
 }
 
+void MegaChatApiImpl::searchMessages(MegaChatHandle chatid, const char *query, int limit, long long cursor, MegaChatRequestListener *listener)
+{
+    MegaChatRequestPrivate *request = new MegaChatRequestPrivate(MegaChatRequest::TYPE_SEARCH_MESSAGES, listener);
+    request->setChatHandle(chatid);
+    request->setText(query);
+    request->setParamType(limit);
+    request->setNumber(cursor);
+    request->setPerformRequest([this, request]() { return performRequest_searchMessages(request); });
+    requestQueue.push(request);
+    waiter->notify();
+}
+
+int MegaChatApiImpl::performRequest_searchMessages(MegaChatRequestPrivate* request)
+{
+    const char *query = request->getText();
+    int limit = request->getParamType();
+    if (!query || MessageSearchIndex::toMatchExpression(query).empty() || limit <= 0 || request->getNumber() < 0)
+    {
+        API_LOG_ERROR("searchMessages: invalid query or limit");
+        return MegaChatError::ERROR_ARGS;
+    }
+
+    MegaChatHandle chatid = request->getChatHandle();
+    if (chatid != MEGACHAT_INVALID_HANDLE && !findChatRoom(chatid))
+    {
+        API_LOG_ERROR("searchMessages: chatroom not found (chatid: %s)", ID_CSTR(chatid));
+        return MegaChatError::ERROR_NOENT;
+    }
+
+    MessageSearchIndex &index = mClient->messageSearchIndex();
+    if (!index.enable())
+    {
+        return MegaChatError::ERROR_ACCESS;
+    }
+
+    std::vector<MessageSearchIndex::Result> results;
+    long long next = 0;
+    try
+    {
+        next = index.search(chatid, query, static_cast<unsigned>(limit), request->getNumber(), results);
+    }
+    catch (std::exception& e)
+    {
+        API_LOG_ERROR("searchMessages: error searching messages: %s", e.what());
+        return MegaChatError::ERROR_UNKNOWN;
+    }
+
+    // group the results by chat, keeping the order of the most recent result of every chat
+    std::vector<MegaChatHandle> chatids;
+    std::map<MegaChatHandle, std::unique_ptr<MegaHandleList>> msgidsByChat;
+    std::unique_ptr<MegaStringMap> snippets(MegaStringMap::createInstance());
+    for (const MessageSearchIndex::Result& result: results)
+    {
+        std::unique_ptr<MegaHandleList>& msgids = msgidsByChat[result.chatid];
+        if (!msgids)
+        {
+            msgids.reset(MegaHandleList::createInstance());
+            chatids.push_back(result.chatid);
+        }
+        msgids->addMegaHandle(result.msgid);
+        snippets->set(result.msgid.toString().c_str(), result.snippet.c_str());
+    }
+
+    std::unique_ptr<MegaHandleList> chatidList(MegaHandleList::createInstance());
+    for (MegaChatHandle id: chatids)
+    {
+        chatidList->addMegaHandle(id);
+        request->setMegaHandleListByChat(id, msgidsByChat[id].get());
+    }
+    request->setMegaHandleList(chatidList.get());    // always a valid list, even if empty
+    request->setMegaStringMap(snippets.get());
+    request->setNumber(next);
+    request->setFlag(index.isBackfillComplete());
+
+    MegaChatErrorPrivate *megaChatError = new MegaChatErrorPrivate(MegaChatError::ERROR_OK);
+    fireOnChatRequestFinish(request, megaChatError);
+    return MegaChatError::ERROR_OK;
+}
+
 MegaChatMessage *MegaChatApiImpl::getMessageFromNodeHistory(MegaChatHandle chatid, MegaChatHandle msgid)
 {
     MegaChatMessagePrivate *megaMsg = NULL;
@@ -6397,6 +6709,20 @@ bool MegaChatApiImpl::setIgnoredCall(MegaChatHandle chatId)
 MegaChatCall *MegaChatApiImpl::getChatCall(MegaChatHandle chatId)
 {
     MegaChatCall *chatCall = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(mPublishedMutex);
+        if (usePublishedState() && chatId != MEGACHAT_INVALID_HANDLE)
+        {
+            auto it = mPublishedCalls.find(chatId);
+            if (it == mPublishedCalls.end())
+            {
+                API_LOG_ERROR("MegaChatApiImpl::getChatCall - Failed to get the call associated to chat room");
+                return chatCall;
+            }
+            return new MegaChatCallPrivate(*it->second);
+        }
+    }
+
     if (!mClient->rtc)
     {
         API_LOG_ERROR("MegaChatApiImpl::getChatCall - WebRTC is not initialized");
@@ -7398,89 +7724,37 @@ int MegaChatApiImpl::convertDbError(int errCode)
         case SQLITE_IOERR:  return MegaChatApi::DB_ERROR_IO;
         case SQLITE_FULL:   return MegaChatApi::DB_ERROR_FULL;
         default:
-        {
-            assert (false);
-            return MegaChatApi::DB_ERROR_UNEXPECTED;
-        }
-    }
-}
-
-int MegaChatApiImpl::convertChatConnectionState(ChatState state)
-{
-    switch(state)
-    {
-    case ChatState::kChatStateOffline:
-        return MegaChatApi::CHAT_CONNECTION_OFFLINE;
-    case ChatState::kChatStateConnecting:
-        return MegaChatApi::CHAT_CONNECTION_IN_PROGRESS;
-    case ChatState::kChatStateJoining:
-        return MegaChatApi::CHAT_CONNECTION_LOGGING;
-    case ChatState::kChatStateOnline:
-        return MegaChatApi::CHAT_CONNECTION_ONLINE;
-    }
-
-    assert(false);  // check compilation warnings, new ChatState not considered
-    return state;
-}
-
-bool MegaChatApiImpl::isChatroomFromType(const ChatRoom& chat, int type) const
-{
-    switch (type)
-    {
-        case MegaChatApi::CHAT_TYPE_ALL:
-        {
-            return true;
-        }
-        case MegaChatApi::CHAT_TYPE_INDIVIDUAL:
-        {
-            if (!chat.isGroup())
-            {
-                return true;
-            }
-            break;
-        }
-        case MegaChatApi::CHAT_TYPE_GROUP:
-        {
-            if (chat.isGroup() && !chat.isMeeting())
-            {
-                return true;
-            }
-            break;
-        }
-        case MegaChatApi::CHAT_TYPE_GROUP_PRIVATE:
-        {
-            if (chat.isGroup() && !chat.publicChat()) // private groupchats can't be meeting rooms
-            {
-                return true;
-            }
-            break;
-        }
-        case MegaChatApi::CHAT_TYPE_GROUP_PUBLIC:
-        {
-            if (chat.isGroup() && chat.publicChat() && !chat.isMeeting())
-            {
-                return true;
-            }
-            break;
-        }
-        case MegaChatApi::CHAT_TYPE_MEETING_ROOM:
-        {
-            if (chat.isMeeting())
-            {
-                return true;
-            }
-            break;
-        }
-        case MegaChatApi::CHAT_TYPE_NON_MEETING:
-        {
-            if (!chat.isMeeting())
-            {
-                return true;
-            }
-            break;
+        {
+            assert (false);
+            return MegaChatApi::DB_ERROR_UNEXPECTED;
         }
     }
-    return false;
+}
+
+int MegaChatApiImpl::convertChatConnectionState(ChatState state)
+{
+    switch(state)
+    {
+    case ChatState::kChatStateOffline:
+        return MegaChatApi::CHAT_CONNECTION_OFFLINE;
+    case ChatState::kChatStateConnecting:
+        return MegaChatApi::CHAT_CONNECTION_IN_PROGRESS;
+    case ChatState::kChatStateJoining:
+        return MegaChatApi::CHAT_CONNECTION_LOGGING;
+    case ChatState::kChatStateOnline:
+        return MegaChatApi::CHAT_CONNECTION_ONLINE;
+    }
+
+    assert(false);  // check compilation warnings, new ChatState not considered
+    return state;
+}
+
+bool MegaChatApiImpl::isChatroomFromType(const ChatRoom& chat, int type) const
+{
+    uint8_t flagsMask = 0;
+    uint8_t flagsValue = 0;
+    return chatTypeToIndexFlags(type, flagsMask, flagsValue)
+            && (ChatRoomIndex::flagsOf(chat) & flagsMask) == flagsValue;
 }
 
 IApp::IGroupChatListItem *MegaChatApiImpl::addGroupChatItem(GroupChatRoom &chat)
@@ -7565,99 +7839,52 @@ void MegaChatApiImpl::onPresenceLastGreenUpdated(Id userid, uint16_t lastGreen)
     fireOnChatPresenceLastGreenUpdated(userid, lastGreen);
 }
 
-void ChatRequestQueue::push(MegaChatRequestPrivate *request)
+void MegaChatApiImpl::onPresenceBatch(const std::vector<presenced::PresenceUpdate>& updates)
 {
-    mutex.lock();
-    requests.push_back(request);
-    mutex.unlock();
+    API_LOG_INFO("Presence and/or last-green of %zu users have changed", updates.size());
+    MegaChatPresenceListPrivate presences(updates);
+    fireOnChatPresenceBatch(&presences);
 }
 
-void ChatRequestQueue::push_front(MegaChatRequestPrivate *request)
+void ChatRequestQueue::push(MegaChatRequestPrivate *request)
 {
-    mutex.lock();
-    requests.push_front(request);
-    mutex.unlock();
+    requests.push(request);
 }
 
 MegaChatRequestPrivate *ChatRequestQueue::pop()
 {
-    mutex.lock();
-    if(requests.empty())
-    {
-        mutex.unlock();
-        return NULL;
-    }
-    MegaChatRequestPrivate *request = requests.front();
-    requests.pop_front();
-    mutex.unlock();
-    return request;
+    return requests.pop();
 }
 
 void ChatRequestQueue::removeListener(MegaChatRequestListener *listener)
 {
-    mutex.lock();
-
-    deque<MegaChatRequestPrivate *>::iterator it = requests.begin();
-    while(it != requests.end())
+    requests.forEach([listener](MegaChatRequestPrivate *request)
     {
-        MegaChatRequestPrivate *request = (*it);
-        if(request->getListener()==listener)
+        if (request->getListener() == listener)
+        {
             request->setListener(NULL);
-        it++;
-    }
-
-    mutex.unlock();
-}
-
-void EventQueue::push(megaMessage* transfer)
-{
-    mutex.lock();
-    events.push_back(transfer);
-    mutex.unlock();
+        }
+    });
 }
 
-void EventQueue::push_front(megaMessage* event)
+bool EventQueue::push(megaMessage* event)
 {
-    mutex.lock();
-    events.push_front(event);
-    mutex.unlock();
+    return events.push(event);
 }
 
 megaMessage* EventQueue::pop()
 {
-    mutex.lock();
-    if(events.empty())
-    {
-        mutex.unlock();
-        return NULL;
-    }
-
-    megaMessage* event = events.front();
-    events.pop_front();
-    mutex.unlock();
-    return event;
+    return events.pop();
 }
 
 bool EventQueue::isEmpty()
 {
-    bool ret;
-
-    mutex.lock();
-    ret = events.empty();
-    mutex.unlock();
-
-    return ret;
+    return events.isEmpty();
 }
 
 size_t EventQueue::size()
 {
-    size_t ret;
-
-    mutex.lock();
-    ret = events.size();
-    mutex.unlock();
-
-    return ret;
+    return events.size();
 }
 
 MegaChatRequestPrivate::MegaChatRequestPrivate(int type, MegaChatRequestListener *listener)
@@ -7706,6 +7933,7 @@ MegaChatRequestPrivate::MegaChatRequestPrivate(MegaChatRequestPrivate &request)
     setMegaHandleList(request.getMegaHandleList());
     setMegaChatScheduledMeetingList(request.getMegaChatScheduledMeetingList());
     setMegaChatScheduledMeetingOccurrList(request.getMegaChatScheduledMeetingOccurrList());
+    setMegaStringMap(request.getMegaStringMap());
 
     if (mMegaHandleList)
     {
@@ -7810,6 +8038,7 @@ const char *MegaChatRequestPrivate::getRequestString() const
         case TYPE_SPEAKRQ_ADD_DEL: return "SPEAKRQ_ADD_DEL";
         case TYPE_REJECT_CALL: return "REJECT_CALL";
         case TYPE_SET_LIMIT_CALL: return "SET_LIMIT_CALL";
+        case TYPE_SEARCH_MESSAGES: return "SEARCH_MESSAGES";
     }
     return "UNKNOWN";
 }
@@ -8022,6 +8251,16 @@ MegaChatScheduledMeetingOccurrList* MegaChatRequestPrivate::getMegaChatScheduled
     return mScheduledMeetingOccurrList.get();
 }
 
+MegaStringMap *MegaChatRequestPrivate::getMegaStringMap() const
+{
+    return mStringMap.get();
+}
+
+void MegaChatRequestPrivate::setMegaStringMap(const MegaStringMap* stringMap)
+{
+    mStringMap.reset(stringMap ? stringMap->copy() : nullptr);
+}
+
 void MegaChatRequestPrivate::setMegaChatScheduledMeetingList(const MegaChatScheduledMeetingList* schedMeetingList)
 {
     mScheduledMeetingList.reset();
@@ -8068,6 +8307,7 @@ MegaChatSessionPrivate::MegaChatSessionPrivate(const rtcModule::ISession &sessio
     , mTermCode(convertTermCode(session.getTermcode()))
     , mChanged(CHANGE_TYPE_NO_CHANGES)
     , mAudioDetected(session.isAudioDetected())
+    , mAudioLevel(session.getAudioLevel())
     , mHasHiResTrack(session.hasHighResolutionTrack())
     , mHasLowResTrack(session.hasLowResolutionTrack())
     , mIsModerator(session.isModerator())
@@ -8082,6 +8322,7 @@ MegaChatSessionPrivate::MegaChatSessionPrivate(const MegaChatSessionPrivate &ses
     , mTermCode(session.getTermCode())
     , mChanged(session.getChanges())
     , mAudioDetected(session.isAudioDetected())
+    , mAudioLevel(session.getAudioLevel())
     , mHasHiResTrack(session.mHasHiResTrack)
     , mHasLowResTrack(session.mHasLowResTrack)
     , mIsModerator(session.isModerator())
@@ -8211,6 +8452,11 @@ bool MegaChatSessionPrivate::isAudioDetected() const
     return mAudioDetected;
 }
 
+int MegaChatSessionPrivate::getAudioLevel() const
+{
+    return mAudioLevel;
+}
+
 bool MegaChatSessionPrivate::canRecvVideoHiRes() const
 {
     return mHasHiResTrack;
@@ -8348,6 +8594,13 @@ MegaChatCallPrivate::MegaChatCallPrivate(const rtcModule::ICall &call)
         mRaiseHandsList->addMegaHandle(uh.val);
     });
 
+    // always create a valid instance of MegaHandleList
+    mActiveSpeakers.reset(::mega::MegaHandleList::createInstance());
+    for (Cid_t cid: call.getActiveSpeakers())
+    {
+        mActiveSpeakers->addMegaHandle(cid);
+    }
+
     // always create a valid instance of MegaHandleList
     mSpeakersList.reset(::mega::MegaHandleList::createInstance());
     for (const auto &speaker: call.getSpeakersList())
@@ -8401,6 +8654,7 @@ MegaChatCallPrivate::MegaChatCallPrivate(const MegaChatCallPrivate &call)
     mMegaChatWaitingRoom.reset(call.getWaitingRoom() ? call.getWaitingRoom()->copy() : nullptr);
     mModerators.reset(call.getModerators() ? call.getModerators()->copy() : nullptr);
     mRaiseHandsList.reset(call.getRaiseHandsList() ? call.getRaiseHandsList()->copy() : nullptr);
+    mActiveSpeakers.reset(call.getActiveSpeakers() ? call.getActiveSpeakers()->copy() : nullptr);
     mParticipants = call.mParticipants;
     mHandleList.reset(call.getHandleList() ? call.getHandleList()->copy() : nullptr);
     mSpeakersList.reset(call.getSpeakersList() ? call.getSpeakersList()->copy() : nullptr);
@@ -8664,6 +8918,11 @@ const MegaHandleList* MegaChatCallPrivate::getRaiseHandsList() const
     return mRaiseHandsList.get();
 }
 
+const MegaHandleList* MegaChatCallPrivate::getActiveSpeakers() const
+{
+    return mActiveSpeakers.get();
+}
+
 bool MegaChatCallPrivate::isIgnored() const
 {
     return mIgnored;
@@ -9005,12 +9264,140 @@ void MegaChatCallPrivate::setOnHold(bool onHold)
     mChanged |= MegaChatCall::CHANGE_TYPE_CALL_ON_HOLD;
 }
 
+MegaChatVideoFrameI420Private::MegaChatVideoFrameI420Private(rtcModule::IVideoFrameI420* frame)
+    : mFrame(frame)
+{
+}
+
+MegaChatVideoFrameI420* MegaChatVideoFrameI420Private::copy() const
+{
+    return new MegaChatVideoFrameI420Private(mFrame->copy());
+}
+
+int MegaChatVideoFrameI420Private::getWidth() const
+{
+    return mFrame->width();
+}
+
+int MegaChatVideoFrameI420Private::getHeight() const
+{
+    return mFrame->height();
+}
+
+const unsigned char* MegaChatVideoFrameI420Private::getDataY() const
+{
+    return mFrame->dataY();
+}
+
+const unsigned char* MegaChatVideoFrameI420Private::getDataU() const
+{
+    return mFrame->dataU();
+}
+
+const unsigned char* MegaChatVideoFrameI420Private::getDataV() const
+{
+    return mFrame->dataV();
+}
+
+int MegaChatVideoFrameI420Private::getStrideY() const
+{
+    return mFrame->strideY();
+}
+
+int MegaChatVideoFrameI420Private::getStrideU() const
+{
+    return mFrame->strideU();
+}
+
+int MegaChatVideoFrameI420Private::getStrideV() const
+{
+    return mFrame->strideV();
+}
+
+int MegaChatVideoFrameI420Private::getRotation() const
+{
+    return mFrame->rotation();
+}
+
+void MegaChatVideoFrame::release(MegaChatVideoFrame* frame)
+{
+    std::shared_ptr<MegaChatVideoFramePool> framePool = frame->pool.lock();
+    if (framePool)
+    {
+        framePool->recycle(frame);
+    }
+    else
+    {
+        delete frame;
+    }
+}
+
+MegaChatVideoFramePool::~MegaChatVideoFramePool()
+{
+    clearFreeFrames();
+}
+
+MegaChatVideoFrame* MegaChatVideoFramePool::acquire(int width, int height, int sourceType)
+{
+    MegaChatVideoFrame* frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (width != mWidth || height != mHeight)
+        {
+            // resolution has changed, buffers of the previous one won't be used anymore
+            clearFreeFrames();
+            mWidth = width;
+            mHeight = height;
+        }
+        else if (!mFreeFrames.empty())
+        {
+            frame = mFreeFrames.back();
+            mFreeFrames.pop_back();
+        }
+    }
+
+    if (!frame)
+    {
+        frame = new MegaChatVideoFrame;
+        frame->width = width;
+        frame->height = height;
+        frame->buffer = new ::mega::byte[frame->size()];
+        frame->pool = shared_from_this();
+    }
+    frame->sourceType = sourceType;
+    frame->refs = 0;
+    return frame;
+}
+
+void MegaChatVideoFramePool::recycle(MegaChatVideoFrame* frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (frame->width == mWidth && frame->height == mHeight && mFreeFrames.size() < kMaxFreeFrames)
+        {
+            mFreeFrames.push_back(frame);
+            return;
+        }
+    }
+    delete frame;
+}
+
+void MegaChatVideoFramePool::clearFreeFrames()
+{
+    for (MegaChatVideoFrame* frame: mFreeFrames)
+    {
+        delete frame;
+    }
+    mFreeFrames.clear();
+}
+
 MegaChatVideoReceiver::MegaChatVideoReceiver(MegaChatApiImpl *chatApi, const karere::Id& chatid, rtcModule::VideoResolution videoResolution, uint32_t clientId)
 {
     mChatApi = chatApi;
     mChatid = chatid;
     mVideoResolution = videoResolution;
     mClientId = clientId;
+    mFramePool = std::make_shared<MegaChatVideoFramePool>();
 }
 
 MegaChatVideoReceiver::~MegaChatVideoReceiver()
@@ -9019,23 +9406,47 @@ MegaChatVideoReceiver::~MegaChatVideoReceiver()
 
 void* MegaChatVideoReceiver::getImageBuffer(unsigned short width, unsigned short height, int sourceType, void*& userData)
 {
-    MegaChatVideoFrame *frame = new MegaChatVideoFrame;
-    frame->width = width;
-    frame->height = height;
-    frame->sourceType = sourceType;
-    frame->buffer = new ::mega::byte[width * height * 4];  // in format ARGB: 4 bytes per pixel
+    MegaChatVideoFrame *frame = mFramePool->acquire(width, height, sourceType);
     userData = frame;
     return frame->buffer;
 }
 
 void MegaChatVideoReceiver::frameComplete(void *userData)
 {
-    mChatApi->videoMutex.lock();
     MegaChatVideoFrame *frame = (MegaChatVideoFrame *)userData;
-    mChatApi->fireOnChatVideoData(mChatid, mClientId, frame->width, frame->height, frame->sourceType, (char *)frame->buffer, mClientId ? mVideoResolution : rtcModule::VideoResolution::kHiRes);
-    mChatApi->videoMutex.unlock();
-    delete [] frame->buffer;
-    delete frame;
+    bool released = false;
+    {
+        MegaChatApiImpl::SdkMutexGuard g(mChatApi->videoMutex);
+        frame->refs++;
+        mChatApi->fireOnChatVideoData(mChatid, mClientId, frame, videoResolution());
+        released = (--frame->refs == 0);
+    }
+
+    if (released)
+    {
+        MegaChatVideoFrame::release(frame);
+    }
+}
+
+bool MegaChatVideoReceiver::wantsArgbFrames(int sourceType)
+{
+    return mChatApi->hasVideoListeners(mChatid, mClientId, sourceType, videoResolution(), false);
+}
+
+bool MegaChatVideoReceiver::wantsI420Frames(int sourceType)
+{
+    return mChatApi->hasVideoListeners(mChatid, mClientId, sourceType, videoResolution(), true);
+}
+
+void MegaChatVideoReceiver::onI420Frame(const rtcModule::IVideoFrameI420& frame, int sourceType)
+{
+    MegaChatApiImpl::SdkMutexGuard g(mChatApi->videoMutex);
+    mChatApi->fireOnChatVideoFrameI420(mChatid, mClientId, sourceType, frame, videoResolution());
+}
+
+rtcModule::VideoResolution MegaChatVideoReceiver::videoResolution() const
+{
+    return mClientId ? mVideoResolution : rtcModule::VideoResolution::kHiRes;
 }
 
 void MegaChatVideoReceiver::onVideoAttach()
@@ -11047,69 +11458,25 @@ MegaChatPeerListItemHandler::MegaChatPeerListItemHandler(MegaChatApiImpl &chatAp
 
 }
 
-MegaChatMessagePrivate::MegaChatMessagePrivate(const MegaChatMessage *msg)
-{
-    mMsg = MegaApi::strdup(msg->getContent());
-    uh = msg->getUserHandle();
-    hAction = msg->getHandleOfAction();
-    msgId = msg->getMsgId();
-    mTempId = msg->getTempId();
-    mIndex = msg->getMsgIndex();
-    mStatus = msg->getStatus();
-    ts = msg->getTimestamp();
-    type = msg->getType();
-    mHasReactions = msg->hasConfirmedReactions();
-    changed = msg->getChanges();
-    edited = msg->isEdited();
-    deleted = msg->isDeleted();
-    priv = msg->getPrivilege();
-    mCode = msg->getCode();
-    rowId = msg->getRowId();
-    megaNodeList = msg->getMegaNodeList() ? msg->getMegaNodeList()->copy() : NULL;
-    megaHandleList = msg->getMegaHandleList() ? msg->getMegaHandleList()->copy() : NULL;
-    mStringList = msg->getStringList() ? unique_ptr<MegaStringList>(msg->getStringList()->copy()) : nullptr;
-    mStringListMap = msg->getStringListMap() ? unique_ptr<MegaStringListMap>(msg->getStringListMap()->copy()) : nullptr;
-    mScheduledRules = msg->getScheduledMeetingRules() ? unique_ptr<MegaChatScheduledRules>(msg->getScheduledMeetingRules()->copy()) : nullptr;
-
-    if (msg->getUsersCount() != 0)
-    {
-        megaChatUsers = new std::vector<MegaChatAttachedUser>();
-
-        for (unsigned int i = 0; i < msg->getUsersCount(); ++i)
-        {
-            MegaChatAttachedUser megaChatUser(msg->getUserHandle(i), msg->getUserEmail(i), msg->getUserName(i));
-
-            megaChatUsers->push_back(megaChatUser);
-        }
-    }
-
-    if (msg->getType() == TYPE_CONTAINS_META)
-    {
-        mContainsMeta = msg->getContainsMeta()->copy();
-    }
-}
-
-MegaChatMessagePrivate::MegaChatMessagePrivate(const Message &msg, Message::Status status, Idx index)
+MegaChatMessageSnapshot::MegaChatMessageSnapshot(const Message &msg)
+    : mSourceId(msg.id())
+    , mSourceUserid(msg.userid)
+    , mSourceIsSending(msg.isSending())
+    , mSourceTs(msg.ts)
+    , mSourceUpdated(msg.updated)
+    , mSourceType(msg.type)
+    , mSourceEncrypted(msg.isEncrypted())
+    , mSourceContent(msg.buf(), msg.dataSize())
 {
-    if (msg.type == TYPE_NORMAL || msg.type == TYPE_CHAT_TITLE)
+    if (msg.type == MegaChatMessage::TYPE_NORMAL || msg.type == MegaChatMessage::TYPE_CHAT_TITLE)
     {
         string tmp(msg.buf(), msg.size());
         mMsg = msg.size() ? MegaApi::strdup(tmp.c_str()) : NULL;
     }
-    else    // for other types, content is irrelevant
-    {
-        mMsg = NULL;
-    }
     uh = msg.userid;
     msgId = msg.isSending() ? MEGACHAT_INVALID_HANDLE : (MegaChatHandle) msg.id();
-    mTempId = msg.isSending() ? (MegaChatHandle) msg.id() : MEGACHAT_INVALID_HANDLE;
-    rowId = MEGACHAT_INVALID_HANDLE;
     type = msg.type;
-    mHasReactions = msg.hasConfirmedReactions();
     ts = msg.ts;
-    mStatus = status;
-    mIndex = index;
-    changed = 0;
     edited = msg.updated && msg.size();
     deleted = msg.updated && !msg.size();
     mCode = 0;
@@ -11273,7 +11640,7 @@ MegaChatMessagePrivate::MegaChatMessagePrivate(const Message &msg, Message::Stat
     }
 }
 
-MegaChatMessagePrivate::~MegaChatMessagePrivate()
+MegaChatMessageSnapshot::~MegaChatMessageSnapshot()
 {
     delete [] mMsg;
     delete megaChatUsers;
@@ -11282,9 +11649,56 @@ MegaChatMessagePrivate::~MegaChatMessagePrivate()
     delete megaHandleList;
 }
 
+bool MegaChatMessageSnapshot::matches(const Message &msg) const
+{
+    // every change of the message that affects the snapshot changes some of these fields
+    return mSourceId == msg.id()
+            && mSourceUserid == msg.userid
+            && mSourceIsSending == msg.isSending()
+            && mSourceTs == msg.ts
+            && mSourceUpdated == msg.updated
+            && mSourceType == msg.type
+            && mSourceEncrypted == msg.isEncrypted()
+            && std::string_view(mSourceContent) == std::string_view(msg.buf(), msg.dataSize());
+}
+
+size_t MegaChatMessageSnapshot::memoryUsage() const
+{
+    // the text, attachments and metadata are parsed from the content, so they take about as much
+    return sizeof(MegaChatMessageSnapshot) + 2 * mSourceContent.capacity();
+}
+
+std::shared_ptr<const MegaChatMessageSnapshot> MegaChatMessageSnapshot::get(const Message &msg)
+{
+    std::shared_ptr<const MegaChatMessageSnapshot> snapshot = std::static_pointer_cast<const MegaChatMessageSnapshot>(msg.appSnapshot);
+    if (!snapshot || !snapshot->matches(msg))
+    {
+        snapshot = std::make_shared<const MegaChatMessageSnapshot>(msg);
+        msg.appSnapshot = snapshot;
+        msg.appSnapshotSize = snapshot->memoryUsage();
+    }
+    return snapshot;
+}
+
+MegaChatMessagePrivate::MegaChatMessagePrivate(const Message &msg, Message::Status status, Idx index)
+    : mSnapshot(MegaChatMessageSnapshot::get(msg))
+{
+    changed = 0;
+    mStatus = status;
+    mTempId = msg.isSending() ? (MegaChatHandle) msg.id() : MEGACHAT_INVALID_HANDLE;
+    rowId = MEGACHAT_INVALID_HANDLE;
+    mIndex = index;
+    mCode = mSnapshot->mCode;
+    mHasReactions = msg.hasConfirmedReactions();
+}
+
+MegaChatMessagePrivate::~MegaChatMessagePrivate()
+{
+}
+
 MegaChatMessage *MegaChatMessagePrivate::copy() const
 {
-    return new MegaChatMessagePrivate(this);
+    return new MegaChatMessagePrivate(*this);
 }
 
 int MegaChatMessagePrivate::getStatus() const
@@ -11294,7 +11708,7 @@ int MegaChatMessagePrivate::getStatus() const
 
 MegaChatHandle MegaChatMessagePrivate::getMsgId() const
 {
-    return msgId;
+    return mSnapshot->msgId;
 }
 
 MegaChatHandle MegaChatMessagePrivate::getTempId() const
@@ -11309,12 +11723,12 @@ int MegaChatMessagePrivate::getMsgIndex() const
 
 MegaChatHandle MegaChatMessagePrivate::getUserHandle() const
 {
-    return uh;
+    return mSnapshot->uh;
 }
 
 int MegaChatMessagePrivate::getType() const
 {
-    return type;
+    return mSnapshot->type;
 }
 
 bool MegaChatMessagePrivate::hasConfirmedReactions() const
@@ -11324,55 +11738,55 @@ bool MegaChatMessagePrivate::hasConfirmedReactions() const
 
 int64_t MegaChatMessagePrivate::getTimestamp() const
 {
-    return ts;
+    return mSnapshot->ts;
 }
 
 const char *MegaChatMessagePrivate::getContent() const
 {
     // if message contains meta and is of rich-link type, return the original content
-    if (type == MegaChatMessage::TYPE_CONTAINS_META)
+    if (mSnapshot->type == MegaChatMessage::TYPE_CONTAINS_META)
     {
         return getContainsMeta()->getTextMessage();
 
     }
-    return mMsg;
+    return mSnapshot->mMsg;
 }
 
 bool MegaChatMessagePrivate::isEdited() const
 {
-    return edited;
+    return mSnapshot->edited;
 }
 
 bool MegaChatMessagePrivate::isDeleted() const
 {
-    return deleted;
+    return mSnapshot->deleted;
 }
 
 bool MegaChatMessagePrivate::isEditable() const
 {
-    return ((type == TYPE_NORMAL || type == TYPE_CONTAINS_META) && !isDeleted() && ((time(NULL) - ts) < CHATD_MAX_EDIT_AGE) && !isGiphy());
+    return ((mSnapshot->type == TYPE_NORMAL || mSnapshot->type == TYPE_CONTAINS_META) && !isDeleted() && ((time(NULL) - mSnapshot->ts) < CHATD_MAX_EDIT_AGE) && !isGiphy());
 }
 
 bool MegaChatMessagePrivate::isDeletable() const
 {
-    return ((type == TYPE_NORMAL || type == TYPE_CONTACT_ATTACHMENT || type == TYPE_NODE_ATTACHMENT || type == TYPE_CONTAINS_META || type == TYPE_VOICE_CLIP)
-            && !isDeleted() && ((time(NULL) - ts) < CHATD_MAX_EDIT_AGE));
+    return ((mSnapshot->type == TYPE_NORMAL || mSnapshot->type == TYPE_CONTACT_ATTACHMENT || mSnapshot->type == TYPE_NODE_ATTACHMENT || mSnapshot->type == TYPE_CONTAINS_META || mSnapshot->type == TYPE_VOICE_CLIP)
+            && !isDeleted() && ((time(NULL) - mSnapshot->ts) < CHATD_MAX_EDIT_AGE));
 }
 
 bool MegaChatMessagePrivate::isManagementMessage() const
 {
-    return (type >= TYPE_LOWEST_MANAGEMENT
-            && type <= TYPE_HIGHEST_MANAGEMENT);
+    return (mSnapshot->type >= TYPE_LOWEST_MANAGEMENT
+            && mSnapshot->type <= TYPE_HIGHEST_MANAGEMENT);
 }
 
 MegaChatHandle MegaChatMessagePrivate::getHandleOfAction() const
 {
-    return hAction;
+    return mSnapshot->hAction;
 }
 
 int MegaChatMessagePrivate::getPrivilege() const
 {
-    return priv;
+    return mSnapshot->priv;
 }
 
 int MegaChatMessagePrivate::getCode() const
@@ -11458,9 +11872,9 @@ int MegaChatMessagePrivate::convertEndCallTermCodeToUI(const Message::CallEndedI
 unsigned int MegaChatMessagePrivate::getUsersCount() const
 {
     unsigned int size = 0;
-    if (megaChatUsers != NULL)
+    if (mSnapshot->megaChatUsers != NULL)
     {
-        size = static_cast<unsigned int>(megaChatUsers->size());
+        size = static_cast<unsigned int>(mSnapshot->megaChatUsers->size());
     }
 
     return size;
@@ -11468,57 +11882,57 @@ unsigned int MegaChatMessagePrivate::getUsersCount() const
 
 MegaChatHandle MegaChatMessagePrivate::getUserHandle(unsigned int index) const
 {
-    if (!megaChatUsers || index >= megaChatUsers->size())
+    if (!mSnapshot->megaChatUsers || index >= mSnapshot->megaChatUsers->size())
     {
         return MEGACHAT_INVALID_HANDLE;
     }
 
-    return megaChatUsers->at(index).getHandle();
+    return mSnapshot->megaChatUsers->at(index).getHandle();
 }
 
 const char *MegaChatMessagePrivate::getUserName(unsigned int index) const
 {
-    if (!megaChatUsers || index >= megaChatUsers->size())
+    if (!mSnapshot->megaChatUsers || index >= mSnapshot->megaChatUsers->size())
     {
         return NULL;
     }
 
-    return megaChatUsers->at(index).getName();
+    return mSnapshot->megaChatUsers->at(index).getName();
 }
 
 const char *MegaChatMessagePrivate::getUserEmail(unsigned int index) const
 {
-    if (!megaChatUsers || index >= megaChatUsers->size())
+    if (!mSnapshot->megaChatUsers || index >= mSnapshot->megaChatUsers->size())
     {
         return NULL;
     }
 
-    return megaChatUsers->at(index).getEmail();
+    return mSnapshot->megaChatUsers->at(index).getEmail();
 }
 
 MegaNodeList *MegaChatMessagePrivate::getMegaNodeList() const
 {
-    return megaNodeList;
+    return mSnapshot->megaNodeList;
 }
 
 const MegaChatContainsMeta *MegaChatMessagePrivate::getContainsMeta() const
 {
-    return mContainsMeta;
+    return mSnapshot->mContainsMeta;
 }
 
 MegaHandleList *MegaChatMessagePrivate::getMegaHandleList() const
 {
-    return megaHandleList;
+    return mSnapshot->megaHandleList;
 }
 
 int MegaChatMessagePrivate::getDuration() const
 {
-    return priv;
+    return mSnapshot->priv;
 }
 
 unsigned MegaChatMessagePrivate::getRetentionTime() const
 {
-    return static_cast<unsigned>(priv);
+    return static_cast<unsigned>(mSnapshot->priv);
 }
 
 int MegaChatMessagePrivate::getTermCode() const
@@ -11528,36 +11942,36 @@ int MegaChatMessagePrivate::getTermCode() const
 
 bool MegaChatMessagePrivate::hasSchedMeetingChanged(unsigned int change) const
 {
-    if (type != TYPE_SCHED_MEETING)
+    if (mSnapshot->type != TYPE_SCHED_MEETING)
     {
         return false;
     }
 
-    KarereScheduledMeeting::sched_bs_t bs = static_cast<unsigned long>(priv);
+    KarereScheduledMeeting::sched_bs_t bs = static_cast<unsigned long>(mSnapshot->priv);
     return bs[change];
 }
 
 const MegaStringList* MegaChatMessagePrivate::getStringList() const
 {
-    return mStringList.get();
+    return mSnapshot->mStringList.get();
 }
 
 const MegaStringListMap* MegaChatMessagePrivate::getStringListMap() const
 {
-    return mStringListMap.get();
+    return mSnapshot->mStringListMap.get();
 }
 
 const MegaStringList* MegaChatMessagePrivate::getScheduledMeetingChange(const unsigned int changeType) const
 {
-    if (!mStringListMap) { return nullptr; }
+    if (!mSnapshot->mStringListMap) { return nullptr; }
 
     std::string changeStr = std::to_string(changeType);
-    return mStringListMap->get(changeStr.c_str());
+    return mSnapshot->mStringListMap->get(changeStr.c_str());
 }
 
 const MegaChatScheduledRules* MegaChatMessagePrivate::getScheduledMeetingRules() const
 {
-    return mScheduledRules.get();
+    return mSnapshot->mScheduledRules.get();
 }
 
 bool MegaChatMessagePrivate::isGiphy() const
@@ -11807,6 +12221,13 @@ void MegaChatCallHandler::onRaiseHandAddedRemoved(const rtcModule::ICall& call,
     mMegaChatApi->fireOnChatCallUpdate(chatCall.get());
 }
 
+void MegaChatCallHandler::onActiveSpeakersChanged(const rtcModule::ICall& call)
+{
+    auto chatCall = std::make_unique<MegaChatCallPrivate>(call);
+    chatCall->setChange(MegaChatCall::CHANGE_TYPE_ACTIVE_SPEAKERS);
+    mMegaChatApi->fireOnChatCallUpdate(chatCall.get());
+}
+
 void MegaChatCallHandler::onNewSession(rtcModule::ISession& sess, const rtcModule::ICall &call)
 {
     MegaChatSessionHandler *sessionHandler = new MegaChatSessionHandler(mMegaChatApi, call);
@@ -12079,6 +12500,48 @@ bool MegaChatPresenceConfigPrivate::isLastGreenVisible() const
     return lastGreenVisible;
 }
 
+MegaChatPresenceListPrivate::MegaChatPresenceListPrivate(const std::vector<presenced::PresenceUpdate>& updates)
+{
+    mList.reserve(updates.size());
+    for (const presenced::PresenceUpdate& update: updates)
+    {
+        mList.push_back({update.userid.val,
+                         update.presenceChanged ? update.pres.status() : -1,
+                         update.lastGreenChanged ? update.lastGreen : -1,
+                         update.presenceChanged && update.stale});
+    }
+}
+
+MegaChatPresenceList *MegaChatPresenceListPrivate::copy() const
+{
+    return new MegaChatPresenceListPrivate(*this);
+}
+
+MegaChatHandle MegaChatPresenceListPrivate::getUserHandle(unsigned int i) const
+{
+    return (i < mList.size()) ? mList[i].userid : MEGACHAT_INVALID_HANDLE;
+}
+
+int MegaChatPresenceListPrivate::getStatus(unsigned int i) const
+{
+    return (i < mList.size()) ? mList[i].status : -1;
+}
+
+int MegaChatPresenceListPrivate::getLastGreen(unsigned int i) const
+{
+    return (i < mList.size()) ? mList[i].lastGreen : -1;
+}
+
+bool MegaChatPresenceListPrivate::isStale(unsigned int i) const
+{
+    return (i < mList.size()) ? mList[i].stale : false;
+}
+
+unsigned int MegaChatPresenceListPrivate::size() const
+{
+    return static_cast<unsigned int>(mList.size());
+}
+
 MegaChatAttachedUser::MegaChatAttachedUser(MegaChatHandle contactId, const std::string &email, const std::string& name)
     : mHandle(contactId)
     , mEmail(email)
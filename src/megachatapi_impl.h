@@ -42,10 +42,13 @@
 #include <sdkApi.h>
 #include <karereCommon.h>
 #include <logger.h>
+#include <mpscQueue.h>
 #include <stdint.h>
 #include "net/libwebsocketsIO.h"
 #include "waiter/libuvWaiter.h"
 #include <bitset>
+#include <shared_mutex>
+#include <thread>
 
 #ifdef _WIN32
 #pragma warning(push)
@@ -102,6 +105,7 @@ public:
     virtual int getParamType();
     virtual MegaChatScheduledMeetingList* getMegaChatScheduledMeetingList() const;
     virtual MegaChatScheduledMeetingOccurrList* getMegaChatScheduledMeetingOccurrList() const;
+    virtual mega::MegaStringMap *getMegaStringMap() const;
 
     bool hasPerformRequest() const { return mPerformRequest != nullptr; }
     int performRequest() const { assert(hasPerformRequest()); return mPerformRequest(); }
@@ -125,8 +129,12 @@ public:
     void setMegaNodeList(mega::MegaNodeList *nodelist);
     void setMegaHandleList(const mega::MegaHandleList* handlelist);
     void setMegaHandleListByChat(MegaChatHandle chatid, mega::MegaHandleList *handlelist);
+    void setMegaStringMap(const mega::MegaStringMap* stringMap);
     void setParamType(int paramType);
 
+    // link of ChatRequestQueue, not copied along with the request
+    MegaChatRequestPrivate* mNextQueued = nullptr;
+
 private:
     mega::MegaHandleList *doGetMegaHandleListByChat(MegaChatHandle chatid);
     // Perform the request by executing this function, instead of adding code to sendPendingRequests()
@@ -152,6 +160,7 @@ protected:
     std::map<MegaChatHandle, mega::MegaHandleList*> mMegaHandleListMap;
     std::unique_ptr<MegaChatScheduledMeetingList> mScheduledMeetingList;
     std::unique_ptr<MegaChatScheduledMeetingOccurrList> mScheduledMeetingOccurrList;
+    std::unique_ptr<mega::MegaStringMap> mStringMap;
     int mParamType;
 };
 
@@ -179,6 +188,29 @@ private:
     bool lastGreenVisible;
 };
 
+class MegaChatPresenceListPrivate : public MegaChatPresenceList
+{
+public:
+    MegaChatPresenceListPrivate(const std::vector<presenced::PresenceUpdate>& updates);
+    MegaChatPresenceList *copy() const override;
+
+    MegaChatHandle getUserHandle(unsigned int i) const override;
+    int getStatus(unsigned int i) const override;
+    int getLastGreen(unsigned int i) const override;
+    bool isStale(unsigned int i) const override;
+    unsigned int size() const override;
+
+private:
+    struct Entry
+    {
+        MegaChatHandle userid;
+        int status;
+        int lastGreen;
+        bool stale;
+    };
+    std::vector<Entry> mList;
+};
+
 
 #ifndef KARERE_DISABLE_WEBRTC
 
@@ -210,6 +242,7 @@ public:
     virtual int getTermCode() const override;
     virtual bool hasChanged(int changeType) const override;
     virtual bool isAudioDetected() const override;
+    virtual int getAudioLevel() const override;
     virtual bool canRecvVideoHiRes() const override;
     virtual bool canRecvVideoLowRes() const override;
     virtual bool isModerator() const override;
@@ -232,6 +265,7 @@ private:
     int mTermCode = MegaChatSession::SESS_TERM_CODE_INVALID;
     int mChanged = MegaChatSession::CHANGE_TYPE_NO_CHANGES;
     bool mAudioDetected = false;
+    int mAudioLevel = MegaChatSession::AUDIO_LEVEL_SILENCE;
     bool mHasHiResTrack = false;
     bool mHasLowResTrack = false;
     bool mIsModerator = false;
@@ -279,6 +313,7 @@ public:
     virtual mega::MegaHandleList *getPeeridParticipants() const override;
     virtual const mega::MegaHandleList* getModerators() const override;
     virtual const mega::MegaHandleList* getRaiseHandsList() const override;
+    const mega::MegaHandleList* getActiveSpeakers() const override;
     virtual bool isIgnored() const override;
     virtual bool isIncoming() const override;
     virtual bool isOutgoing() const override;
@@ -345,6 +380,7 @@ protected:
     std::unique_ptr<::mega::MegaHandleList> mSpeakersList;
     std::unique_ptr<::mega::MegaHandleList> mSpeakRequestsList;
     std::unique_ptr<::mega::MegaHandleList> mRaiseHandsList;
+    std::unique_ptr<::mega::MegaHandleList> mActiveSpeakers;
     std::unique_ptr<MegaChatWaitingRoom> mMegaChatWaitingRoom;
 
     int mTermCode = MegaChatCall::TERM_CODE_INVALID;
@@ -425,6 +461,27 @@ private:
     std::unique_ptr<rtcModule::KarereWaitingRoom> mWaitingRoomUsers;
 };
 
+class MegaChatVideoFrameI420Private : public MegaChatVideoFrameI420
+{
+public:
+    // takes the ownership of frame
+    MegaChatVideoFrameI420Private(rtcModule::IVideoFrameI420* frame);
+    MegaChatVideoFrameI420* copy() const override;
+    int getWidth() const override;
+    int getHeight() const override;
+    const unsigned char* getDataY() const override;
+    const unsigned char* getDataU() const override;
+    const unsigned char* getDataV() const override;
+    int getStrideY() const override;
+    int getStrideU() const override;
+    int getStrideV() const override;
+    int getRotation() const override;
+
+private:
+    std::unique_ptr<rtcModule::IVideoFrameI420> mFrame;
+};
+
+class MegaChatVideoFramePool;
 class MegaChatVideoFrame
 {
 public:
@@ -432,6 +489,38 @@ public:
     int width;
     int height;
     int sourceType;
+    size_t size() const { return static_cast<size_t>(width) * height * 4; } // in format ARGB: 4 bytes per pixel
+
+    // references held by the receiver and by listeners that hold video buffers (protected by MegaChatApiImpl::videoMutex)
+    int refs = 0;
+    std::weak_ptr<MegaChatVideoFramePool> pool;
+
+    /** @brief Returns the frame to its pool, or deletes it if the pool doesn't exist anymore */
+    static void release(MegaChatVideoFrame* frame);
+    ~MegaChatVideoFrame() { delete [] buffer; }
+};
+
+/**
+ * @brief Pool of frame buffers of a MegaChatVideoReceiver
+ *
+ * Only buffers for the latest resolution are kept, so they are dropped when the resolution
+ * of the video changes. Frames may outlive the pool when the app holds them, see
+ * MegaChatVideoListener::holdsVideoBuffers.
+ */
+class MegaChatVideoFramePool : public std::enable_shared_from_this<MegaChatVideoFramePool>
+{
+public:
+    ~MegaChatVideoFramePool();
+    MegaChatVideoFrame* acquire(int width, int height, int sourceType);
+    void recycle(MegaChatVideoFrame* frame);
+
+protected:
+    static constexpr size_t kMaxFreeFrames = 4;
+    std::mutex mMutex;
+    int mWidth = 0;
+    int mHeight = 0;
+    std::vector<MegaChatVideoFrame*> mFreeFrames;
+    void clearFreeFrames();
 };
 
 class MegaChatVideoReceiver : public rtcModule::IVideoRenderer
@@ -447,6 +536,9 @@ public:
     // rtcModule::IVideoRenderer implementation
     virtual void* getImageBuffer(unsigned short width, unsigned short height, int sourceType, void*& userData);
     virtual void frameComplete(void* userData);
+    bool wantsArgbFrames(int sourceType) override;
+    bool wantsI420Frames(int sourceType) override;
+    void onI420Frame(const rtcModule::IVideoFrameI420& frame, int sourceType) override;
     virtual void onVideoAttach();
     virtual void onVideoDetach();
     virtual void clearViewport();
@@ -457,6 +549,8 @@ protected:
     MegaChatHandle mChatid;
     rtcModule::VideoResolution mVideoResolution;
     uint32_t mClientId;
+    std::shared_ptr<MegaChatVideoFramePool> mFramePool;
+    rtcModule::VideoResolution videoResolution() const;
 };
 
 #endif
@@ -748,6 +842,7 @@ public:
     void onCallDeny(const rtcModule::ICall& call, const std::string& cmd, const std::string& msg) override;
     void onUserSpeakStatusUpdate(const rtcModule::ICall& call, const karere::Id& userid, const bool add) override;
     void onRaiseHandAddedRemoved(const rtcModule::ICall& call, const karere::Id& userid, const bool add) override;
+    void onActiveSpeakersChanged(const rtcModule::ICall& call) override;
     void onSpeakRequest(const rtcModule::ICall& call, const karere::Id& userid, const bool add) override;
 
 private:
@@ -1189,10 +1284,69 @@ class MegaChatAttachedUser;
 class MegaChatRichPreviewPrivate;
 class MegaChatContainsMetaPrivate;
 
+/**
+ * @brief Immutable part of a MegaChatMessage, parsed from a chatd::Message
+ *
+ * The snapshot of a message is cached in chatd::Message::appSnapshot, so every
+ * MegaChatMessagePrivate created for the same message (and all their copies) shares it,
+ * and the content, attachments and metadata are parsed and copied only once. It's rebuilt
+ * only when the message changes (ie. it's edited, decrypted or confirmed), which is
+ * detected by comparing the fields of the message it was built from (see matches()).
+ */
+class MegaChatMessageSnapshot
+{
+public:
+    explicit MegaChatMessageSnapshot(const chatd::Message &msg);
+    ~MegaChatMessageSnapshot();
+
+    /** @brief Returns the snapshot of the message, building it if it's missing or outdated.
+     * It must be called from the karere thread, or with the sdkMutex locked */
+    static std::shared_ptr<const MegaChatMessageSnapshot> get(const chatd::Message &msg);
+
+    /** @brief Returns true if the snapshot was built from a message with the same id, sender,
+     * timestamps, type, encryption state and content as \c msg */
+    bool matches(const chatd::Message &msg) const;
+
+    /** @brief Returns an estimation of the RAM used by the snapshot */
+    size_t memoryUsage() const;
+
+    // fields of the message the snapshot was built from, see matches()
+    karere::Id mSourceId;
+    karere::Id mSourceUserid;
+    bool mSourceIsSending;
+    uint32_t mSourceTs;
+    uint16_t mSourceUpdated;
+    unsigned char mSourceType;
+    uint8_t mSourceEncrypted;
+    std::string mSourceContent;
+
+    int type;
+    MegaChatHandle msgId;   // definitive unique ID given by server
+    MegaChatHandle uh;
+    MegaChatHandle hAction;// certain messages need additional handle: such us priv changes, revoke attachment
+    int64_t ts;
+    const char *mMsg = NULL;
+    bool edited;
+    bool deleted;
+    int priv;               // certain messages need additional info, like priv changes
+    int mCode;              // additional information parsed from the message (ie. term code of calls)
+    std::vector<MegaChatAttachedUser> *megaChatUsers = NULL;
+    mega::MegaNodeList *megaNodeList = NULL;
+    mega::MegaHandleList *megaHandleList = NULL;
+    const MegaChatContainsMeta *mContainsMeta = NULL;
+    std::unique_ptr<::mega::MegaStringList> mStringList;
+    std::unique_ptr<::mega::MegaStringListMap> mStringListMap;
+    std::unique_ptr<MegaChatScheduledRules> mScheduledRules;
+
+private:
+    MegaChatMessageSnapshot(const MegaChatMessageSnapshot&) = delete;
+    MegaChatMessageSnapshot& operator=(const MegaChatMessageSnapshot&) = delete;
+};
+
 class MegaChatMessagePrivate : public MegaChatMessage
 {
 public:
-    MegaChatMessagePrivate(const MegaChatMessage *msg);
+    MegaChatMessagePrivate(const MegaChatMessagePrivate &msg) = default;
     MegaChatMessagePrivate(const chatd::Message &msg, chatd::Message::Status status, chatd::Idx index);
 
     virtual ~MegaChatMessagePrivate();
@@ -1250,56 +1404,44 @@ public:
 private:
     bool isGiphy() const;
 
-    int changed;
+    // shared by all the copies of the message
+    std::shared_ptr<const MegaChatMessageSnapshot> mSnapshot;
 
-    int type;
+    int changed;
     int mStatus;
-    MegaChatHandle msgId;   // definitive unique ID given by server
     MegaChatHandle mTempId;  // used until it's given a definitive ID by server
     MegaChatHandle rowId;   // used to identify messages in the manual-sending queue
-    MegaChatHandle uh;
-    MegaChatHandle hAction;// certain messages need additional handle: such us priv changes, revoke attachment
     int mIndex;              // position within the history buffer
-    int64_t ts;
-    const char *mMsg;
-    bool edited;
-    bool deleted;
-    int priv;               // certain messages need additional info, like priv changes
     int mCode;               // generic field for additional information (ie. the reason of manual sending)
     bool mHasReactions;
-    std::vector<MegaChatAttachedUser> *megaChatUsers = NULL;
-    mega::MegaNodeList *megaNodeList = NULL;
-    mega::MegaHandleList *megaHandleList = NULL;
-    const MegaChatContainsMeta *mContainsMeta = NULL;
-    std::unique_ptr<::mega::MegaStringList> mStringList;
-    std::unique_ptr<::mega::MegaStringListMap> mStringListMap;
-    std::unique_ptr<MegaChatScheduledRules> mScheduledRules;
 };
 
 //Thread safe request queue
+// Thread safe (lock-free) request queue. Requests are pushed from any thread, and only
+// the thread of MegaChatApiImpl pops them (see karere::MpscQueue)
 class ChatRequestQueue
 {
     protected:
-        std::deque<MegaChatRequestPrivate *> requests;
-        std::mutex mutex;
+        karere::MpscQueue<MegaChatRequestPrivate, &MegaChatRequestPrivate::mNextQueued> requests;
 
     public:
         void push(MegaChatRequestPrivate *request);
-        void push_front(MegaChatRequestPrivate *request);
         MegaChatRequestPrivate * pop();
+
+        // It must be called from the thread of MegaChatApiImpl, or with the sdkMutex locked
         void removeListener(MegaChatRequestListener *listener);
 };
 
-//Thread safe transfer queue
+// Thread safe (lock-free) event queue. Events are pushed from any thread, and only
+// the thread of MegaChatApiImpl pops them (see karere::MpscQueue)
 class EventQueue
 {
 protected:
-    std::deque<megaMessage*> events;
-    std::mutex mutex;
+    karere::MpscQueue<megaMessage, &megaMessage::next> events;
 
 public:
-    void push(megaMessage* event);
-    void push_front(megaMessage* event);
+    // returns true if the queue was empty, so the thread of MegaChatApiImpl must be woken up
+    bool push(megaMessage* event);
     megaMessage *pop();
     bool isEmpty();
     size_t size();
@@ -1314,11 +1456,21 @@ public:
     MegaChatApiImpl(MegaChatApi *chatApi, mega::MegaApi *megaApi);
     virtual ~MegaChatApiImpl();
 
-    using SdkMutexGuard = std::unique_lock<std::recursive_mutex>;   // (equivalent to typedef)
-    mutable std::recursive_mutex sdkMutex;
-    std::recursive_mutex videoMutex;
+    // it measures contention (see logLockStats()), and it's shared with the websockets layer
+    using SdkMutex = WebsocketsIO::Mutex;
+    using SdkMutexGuard = std::unique_lock<SdkMutex>;   // (equivalent to typedef)
+    mutable SdkMutex sdkMutex;
+    SdkMutex videoMutex;
+#ifndef KARERE_DISABLE_WEBRTC
+    // frames held by video listeners, indexed by their buffer (protected by videoMutex)
+    std::map<const char*, MegaChatVideoFrame*> mHeldVideoFrames;
+#endif
     mega::Waiter *waiter;
+
+    // runs all the timers of karere (see karere::setTimeout())
+    karere::TimerWheel& timerWheel() { return *mTimerWheel; }
 private:
+    std::unique_ptr<karere::TimerWheel> mTimerWheel;
     MegaChatApi *mChatApi;
     mega::MegaApi *mMegaApi;
     WebsocketsIO *mWebsocketsIO;
@@ -1326,10 +1478,37 @@ private:
     bool mTerminating;
 
     mega::MegaThread thread;
+    std::thread::id mThreadId;
     int threadExit;
     static void *threadEntryPoint(void *param);
     void loop();
 
+    // State published by the thread of MegaChatApiImpl for the most frequent getters, so
+    // other threads can read it under mPublishedMutex, without waiting for the sdkMutex.
+    // Entries are refreshed before the updates are notified to listeners, so a getter called
+    // after a notification always sees the notified state. They are only modified with the
+    // sdkMutex locked. The thread of MegaChatApiImpl reads the karere state directly.
+    enum { kLockStatsInterval = 60 };  // seconds between reports of lock contention
+    mutable std::shared_mutex mPublishedMutex;
+    bool mPublishedValid = false;
+    int mPublishedUnreadChats = 0;
+    // one entry per room. Items are built on first request: entries of rooms whose item
+    // hasn't been requested yet are empty
+    std::map<MegaChatHandle, std::unique_ptr<MegaChatListItemPrivate>> mPublishedItems;
+#ifndef KARERE_DISABLE_WEBRTC
+    std::map<MegaChatHandle, std::unique_ptr<MegaChatCallPrivate>> mPublishedCalls;
+    std::set<MegaChatHandle> mDirtyCalls;
+#endif
+    time_t mLockStatsTs = 0;
+
+    // true if the published state must be used by the calling thread
+    bool usePublishedState() const;
+    void publishChatListItem(MegaChatHandle chatid);
+    void publishChatCall(MegaChatHandle chatid);
+    // refreshes the calls marked as dirty, and the entries of the rooms added or removed
+    void publishState();
+    void logLockStats();
+
     void init(MegaChatApi *chatApi, mega::MegaApi *megaApi);
 
     static LoggerHandler *loggerHandler;
@@ -1369,6 +1548,8 @@ private:
     static int convertInitState(int state);
     static int convertDbError(int errCode);
     bool isChatroomFromType(const karere::ChatRoom& chat, int type) const;
+    MegaChatListItemList* getChatListItemsFromIndex(uint8_t flagsMask, uint8_t flagsValue, size_t offset = 0,
+                                                    size_t count = std::numeric_limits<size_t>::max()) const;
 
     int performRequest_retryPendingConnections(MegaChatRequestPrivate* request);
     int performRequest_signalActivity(MegaChatRequestPrivate* request);
@@ -1403,6 +1584,7 @@ private:
     int performRequest_manageReaction(MegaChatRequestPrivate* request);
     int performRequest_importMessages(MegaChatRequestPrivate* request);
     int performRequest_sendTypingNotification(MegaChatRequestPrivate* request);
+    int performRequest_searchMessages(MegaChatRequestPrivate* request);
 #ifndef KARERE_DISABLE_WEBRTC
     int performRequest_startChatCall(MegaChatRequestPrivate* request);
     int performRequest_answerChatCall(MegaChatRequestPrivate* request);
@@ -1447,6 +1629,8 @@ public:
     void createKarereClient();
     void resetClientid();
     int getInitState();
+    // for internal tools only (i.e. tests/chatd_replay), sdkMutex must be locked to use it
+    karere::Client* getKarereClient() const { return mClient; }
 
     void importMessages(const char *externalDbPath, MegaChatRequestListener *listener);
 
@@ -1465,7 +1649,13 @@ public:
 #endif
 
     static void setCatchException(bool enable);
+    static void setDecryptionThreads(unsigned int numThreads);
     static bool hasUrl(const char* text);
+
+    // translate the types and filters of chats into conditions on the flags of karere::ChatRoomIndex
+    static bool chatTypeToIndexFlags(int type, uint8_t& flagsMask, uint8_t& flagsValue);
+    static bool chatFilterToIndexFlags(int mask, int filter, uint8_t& flagsMask, uint8_t& flagsValue);
+
     bool openNodeHistory(MegaChatHandle chatid, MegaChatNodeHistoryListener *listener);
     bool closeNodeHistory(MegaChatHandle chatid, MegaChatNodeHistoryListener *listener);
     void addNodeHistoryListener(MegaChatHandle chatid, MegaChatNodeHistoryListener *listener);
@@ -1513,7 +1703,14 @@ public:
     void fireOnChatSessionUpdate(MegaChatHandle chatid, MegaChatHandle callid, MegaChatSessionPrivate *session);
 
     // MegaChatVideoListener callbacks
-    void fireOnChatVideoData(MegaChatHandle chatid, uint32_t clientId, int width, int height, int sourceType, char*buffer, rtcModule::VideoResolution videoResolution);
+    void fireOnChatVideoData(MegaChatHandle chatid, uint32_t clientId, MegaChatVideoFrame* frame, rtcModule::VideoResolution videoResolution);
+    void fireOnChatVideoFrameI420(MegaChatHandle chatid, uint32_t clientId, int sourceType, const rtcModule::IVideoFrameI420& frame, rtcModule::VideoResolution videoResolution);
+    // returns true if there are listeners for that video that want frames in I420 format (or ARGB, if i420 is false)
+    bool hasVideoListeners(MegaChatHandle chatid, uint32_t clientId, int sourceType, rtcModule::VideoResolution videoResolution, bool i420);
+    // videoMutex must be locked while the returned set is used
+    const MegaChatVideoListener_set* getVideoListeners(MegaChatHandle chatid, uint32_t clientId, int sourceType, rtcModule::VideoResolution videoResolution);
+    void releaseVideoBuffer(const char* buffer);
+    void holdVideoFrame(MegaChatVideoListener* listener, MegaChatVideoFrame* frame);
 #endif
 
     // MegaChatListener callbacks (specific ones)
@@ -1522,6 +1719,7 @@ public:
     void fireOnChatOnlineStatusUpdate(MegaChatHandle userhandle, int status, bool inProgress);
     void fireOnChatPresenceConfigUpdate(MegaChatPresenceConfig *config);
     void fireOnChatPresenceLastGreenUpdated(MegaChatHandle userhandle, int lastGreen);
+    void fireOnChatPresenceBatch(MegaChatPresenceList *presences);
     void fireOnChatConnectionStateUpdate(MegaChatHandle chatid, int newState);
     void fireOnDbError(int error, const char* msg);
 
@@ -1552,6 +1750,7 @@ public:
     bool isSignalActivityRequired();
 
     int getUserOnlineStatus(MegaChatHandle userhandle);
+    bool isUserOnlineStatusStale(MegaChatHandle userhandle);
     void setBackgroundStatus(bool background, MegaChatRequestListener *listener = NULL);
     int getBackgroundStatus();
 
@@ -1580,6 +1779,8 @@ public:
     MegaChatRoom *getChatRoomByUser(MegaChatHandle userhandle);
     MegaChatListItemList* getChatListItems(const int mask, const int filter) const;
     MegaChatListItemList *getChatListItems() const;
+    MegaChatListItemList* getChatListItemsPage(const int mask, const int filter, unsigned int offset, unsigned int count) const;
+    unsigned int getChatListItemsCount(const int mask, const int filter) const;
     MegaChatListItemList* getChatListItemsByType(int type);
     MegaChatListItemList *getChatListItemsByPeers(MegaChatPeerList *peers);
     MegaChatListItem *getChatListItem(MegaChatHandle chatid);
@@ -1645,9 +1846,12 @@ public:
 
     int loadMessages(MegaChatHandle chatid, int count);
     bool isFullHistoryLoaded(MegaChatHandle chatid);
+    void setHistoryMemoryBudget(int64_t chatBudget, int64_t totalBudget);
+    int64_t getHistoryMemoryUsage(MegaChatHandle chatid);
     void manageReaction(MegaChatHandle chatid, MegaChatHandle msgid, const char *reaction, bool add, MegaChatRequestListener *listener = NULL);
     MegaChatMessage *getMessage(MegaChatHandle chatid, MegaChatHandle msgid);
     MegaChatMessage *getMessageFromNodeHistory(MegaChatHandle chatid, MegaChatHandle msgid);
+    void searchMessages(MegaChatHandle chatid, const char *query, int limit, long long cursor, MegaChatRequestListener *listener = NULL);
     MegaChatMessage *getManualSendingMessage(MegaChatHandle chatid, MegaChatHandle rowid);
     MegaChatMessage *sendMessage(MegaChatHandle chatid, const char* msg, size_t msgLen, int type = MegaChatMessage::TYPE_NORMAL);
     MegaChatMessage *attachContacts(MegaChatHandle chatid, mega::MegaHandleList* contacts);
@@ -1739,6 +1943,7 @@ public:
     void onPresenceChanged(karere::Id userid, karere::Presence pres, bool inProgress) override;
     void onPresenceConfigChanged(const presenced::Config& state, bool pending) override;
     void onPresenceLastGreenUpdated(karere::Id userid, uint16_t lastGreen) override;
+    void onPresenceBatch(const std::vector<presenced::PresenceUpdate>& updates) override;
     void onInitStateChange(int newState) override;
     void onChatNotification(karere::Id chatid, const chatd::Message &msg, chatd::Message::Status status, chatd::Idx idx) override;
     void onDbError(int error, const std::string &msg) override;
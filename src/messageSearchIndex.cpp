@@ -0,0 +1,284 @@
+#include "messageSearchIndex.h"
+#include "chatd.h"
+#include "base/timers.hpp"
+#include <algorithm>
+
+namespace karere
+{
+namespace
+{
+// rows of history that are indexed: decrypted text of normal messages (not deleted, not special).
+// The prefix selects the values of the row in triggers ("new.")
+std::string indexedCondition(const std::string& prefix)
+{
+    return prefix + "type = " + std::to_string(chatd::Message::kMsgNormal)
+            + " and " + prefix + "is_encrypted = " + std::to_string(chatd::Message::kNotEncrypted)
+            + " and length(" + prefix + "data) > 0 and substr(" + prefix + "data, 1, 1) != x'00'";
+}
+
+const char* kBackfillVar = "search_backfill_next";
+}
+
+MessageSearchIndex::MessageSearchIndex(SqliteDb& db, void* appCtx)
+    : mDb(db), mAppCtx(appCtx)
+{
+}
+
+MessageSearchIndex::~MessageSearchIndex()
+{
+    if (mBackfillTimer)
+    {
+        cancelTimeout(mBackfillTimer, mAppCtx);
+        mBackfillTimer = 0;
+    }
+}
+
+bool MessageSearchIndex::exists()
+{
+    SqliteStmt stmt(mDb, "select count(*) from sqlite_master where type = 'table' and name = 'history_fts'");
+    stmt.stepMustHaveData("MessageSearchIndex::exists");
+    return stmt.integralCol<int>(0) > 0;
+}
+
+void MessageSearchIndex::createTriggers()
+{
+    std::string insertNew = "insert or replace into history_fts(rowid, text, chatid, msgid) "
+            "select new.rowid, cast(new.data as text), new.chatid, new.msgid";
+
+    mDb.simpleQuery(("create trigger if not exists history_fts_ai after insert on history when "
+                     + indexedCondition("new.") + " begin " + insertNew + "; end").c_str());
+
+    mDb.simpleQuery("create trigger if not exists history_fts_ad after delete on history begin "
+                    "delete from history_fts where rowid = old.rowid; end");
+
+    // the message may have been decrypted, edited or deleted by the update
+    mDb.simpleQuery(("create trigger if not exists history_fts_au after update of type, is_encrypted, data on history begin "
+                     "delete from history_fts where rowid = old.rowid; "
+                     + insertNew + " where " + indexedCondition("new.") + "; end").c_str());
+}
+
+bool MessageSearchIndex::enable()
+{
+    if (mEnabled)
+    {
+        return true;
+    }
+
+    try
+    {
+        bool rebuild = !exists();
+        if (!rebuild)
+        {
+            SqliteStmt stmt(mDb, "select count(*) from sqlite_master where type = 'trigger' and name like 'history_fts_%'");
+            stmt.stepMustHaveData("MessageSearchIndex::enable");
+            if (stmt.integralCol<int>(0) < 3)
+            {
+                // history has been recreated by a migration, and the index may have missed changes
+                KR_LOG_WARNING("MessageSearchIndex: the index is not in sync with history, rebuilding it");
+                mDb.simpleQuery("drop table history_fts");
+                rebuild = true;
+            }
+        }
+
+        if (rebuild)
+        {
+            mDb.simpleQuery("create virtual table history_fts using fts5(text, chatid unindexed, msgid unindexed)");
+            createTriggers();
+
+            // rows inserted from now on are indexed by the triggers, the previous ones by the backfill
+            SqliteStmt stmt(mDb, "select ifnull(max(rowid), 0) from history");
+            stmt.stepMustHaveData("MessageSearchIndex::enable");
+            mBackfillNext = stmt.integralCol<int64_t>(0) + 1;
+            saveBackfillProgress();
+            KR_LOG_DEBUG("MessageSearchIndex: index created, backfill of history pending");
+        }
+        else
+        {
+            SqliteStmt stmt(mDb, "select value from vars where name = ?");
+            stmt << kBackfillVar;
+            mBackfillNext = stmt.step() ? stmt.integralCol<int64_t>(0) : 0;
+        }
+    }
+    catch (std::exception& e)
+    {
+        KR_LOG_ERROR("MessageSearchIndex: can't enable the index (FTS5 may be not available): %s", e.what());
+        return false;
+    }
+
+    mEnabled = true;
+    scheduleBackfill();
+    return true;
+}
+
+void MessageSearchIndex::resume()
+{
+    try
+    {
+        if (!exists())
+        {
+            return;
+        }
+    }
+    catch (std::exception& e)
+    {
+        KR_LOG_ERROR("MessageSearchIndex: error checking the index: %s", e.what());
+        return;
+    }
+
+    enable();
+}
+
+void MessageSearchIndex::saveBackfillProgress()
+{
+    mDb.query("insert or replace into vars(name, value) values(?, ?)", kBackfillVar, mBackfillNext);
+}
+
+void MessageSearchIndex::scheduleBackfill()
+{
+    if (!mBackfillNext || mBackfillTimer)
+    {
+        return;
+    }
+
+    auto wptr = weakHandle();
+    mBackfillTimer = setTimeout([this, wptr]()
+    {
+        if (wptr.deleted())
+        {
+            return;
+        }
+
+        mBackfillTimer = 0;
+        backfillStep();
+    }, kBackfillInterval, mAppCtx);
+}
+
+void MessageSearchIndex::backfillStep()
+{
+    try
+    {
+        // lowest rowid of the next batch, going from the most recent messages to the oldest ones
+        int64_t low = 0;
+        {
+            SqliteStmt stmt(mDb, "select rowid from history where rowid < ? order by rowid desc limit 1 offset ?");
+            stmt << mBackfillNext << static_cast<int>(kBackfillBatchRows - 1);
+            if (stmt.step())
+            {
+                low = stmt.integralCol<int64_t>(0);
+            }
+        }
+
+        std::string sql = "insert or replace into history_fts(rowid, text, chatid, msgid) "
+                "select rowid, cast(data as text), chatid, msgid from history "
+                "where rowid >= ? and rowid < ? and " + indexedCondition("");
+        mDb.query(sql.c_str(), low, mBackfillNext);
+
+        mBackfillNext = low;
+        saveBackfillProgress();
+    }
+    catch (std::exception& e)
+    {
+        KR_LOG_ERROR("MessageSearchIndex: error indexing history, backfill aborted: %s", e.what());
+        return;
+    }
+
+    if (!mBackfillNext)
+    {
+        KR_LOG_DEBUG("MessageSearchIndex: backfill completed");
+        return;
+    }
+
+    scheduleBackfill();
+}
+
+std::string MessageSearchIndex::toMatchExpression(const std::string& query)
+{
+    // every word is quoted, so FTS5 operators and punctuation typed by the user are just text
+    std::string expression;
+    size_t pos = 0;
+    while (pos < query.size())
+    {
+        size_t start = query.find_first_not_of(" \t\r\n", pos);
+        if (start == std::string::npos)
+        {
+            break;
+        }
+
+        size_t end = query.find_first_of(" \t\r\n", start);
+        if (end == std::string::npos)
+        {
+            end = query.size();
+        }
+
+        if (!expression.empty())
+        {
+            expression.push_back(' ');
+        }
+        expression.push_back('"');
+        for (size_t i = start; i < end; i++)
+        {
+            if (query[i] == '"')
+            {
+                expression.push_back('"');
+            }
+            expression.push_back(query[i]);
+        }
+        expression.push_back('"');
+        pos = end;
+    }
+
+    if (!expression.empty())
+    {
+        expression.push_back('*');   // the last word may be incomplete
+    }
+    return expression;
+}
+
+int64_t MessageSearchIndex::search(Id chatid, const std::string& query, unsigned limit, int64_t cursor, std::vector<Result>& results)
+{
+    assert(mEnabled);
+    std::string expression = toMatchExpression(query);
+    if (expression.empty() || !limit)
+    {
+        return 0;
+    }
+    limit = std::min<unsigned>(limit, kMaxResults);
+
+    std::string sql = "select rowid, chatid, msgid, snippet(history_fts, 0, '', '', '...', "
+            + std::to_string(kSnippetTokens) + ") from history_fts where history_fts match ?";
+    if (chatid.isValid())
+    {
+        sql.append(" and chatid = ?");
+    }
+    if (cursor)
+    {
+        sql.append(" and rowid < ?");
+    }
+    sql.append(" order by rowid desc limit ?");
+
+    SqliteStmt stmt(mDb, sql);
+    stmt << expression;
+    if (chatid.isValid())
+    {
+        stmt << chatid.val;
+    }
+    if (cursor)
+    {
+        stmt << cursor;
+    }
+    stmt << limit + 1;   // one more, to know if there are more results
+
+    int64_t lastRowid = 0;
+    while (stmt.step())
+    {
+        if (results.size() == limit)
+        {
+            return lastRowid;
+        }
+
+        lastRowid = stmt.integralCol<int64_t>(0);
+        results.push_back({ stmt.integralCol<uint64_t>(1), stmt.integralCol<uint64_t>(2), stmt.stringCol(3) });
+    }
+    return 0;
+}
+}
@@ -0,0 +1,98 @@
+#ifndef MESSAGESEARCHINDEX_H
+#define MESSAGESEARCHINDEX_H
+
+#include "db.h"
+#include "karereId.h"
+#include "base/trackDelete.h"
+
+#include <string>
+#include <vector>
+
+namespace karere
+{
+/**
+ * @brief Local full-text index over the decrypted messages stored in the \c history table
+ *
+ * The index is a SQLite FTS5 table (history_fts) whose rowids are the rowids of history.
+ * It's kept in sync by triggers on history, so every path that writes history (new and
+ * confirmed messages, decryption of old ones, edits, deletions, truncation, retention
+ * time and clearing of history) updates it in the same transaction. Only normal text
+ * messages that are already decrypted are indexed.
+ *
+ * The index is optional: it's created by the first call to enable() (the first search),
+ * and only if the SQLite library has been built with FTS5. Messages that were in history
+ * before that moment are indexed by a backfill job, in small batches scheduled with
+ * timers, so the event loop is never blocked for long. The progress of the backfill is
+ * stored in the \c vars table, and it's resumed by resume() when the client restarts.
+ *
+ * All methods must be called from the karere thread.
+ */
+class MessageSearchIndex: public DeleteTrackable
+{
+public:
+    struct Result
+    {
+        Id chatid;
+        Id msgid;
+        std::string snippet;
+    };
+
+    enum
+    {
+        kBackfillBatchRows = 512,       // rowids of history indexed per backfill step
+        kBackfillInterval = 20,         // ms between backfill steps
+        kSnippetTokens = 16,            // approximate length of snippets, in tokens
+        kMaxResults = 1000              // maximum results returned by a single search
+    };
+
+    MessageSearchIndex(SqliteDb& db, void* appCtx);
+    ~MessageSearchIndex();
+
+    /** @brief Creates the index (if needed) and starts the backfill of existing history.
+     * Returns false if the index is not supported by the SQLite library */
+    bool enable();
+
+    /** @brief Resumes the backfill of an index created in a previous session. It doesn't
+     * create the index if it doesn't exist */
+    void resume();
+
+    bool isEnabled() const { return mEnabled; }
+
+    /** @brief Returns true when all the history that existed before the index was created
+     * has been indexed, so searches are complete */
+    bool isBackfillComplete() const { return mEnabled && !mBackfillNext; }
+
+    /**
+     * @brief Searches messages that contain all the words in \c query (the last one as a prefix)
+     *
+     * Results are sorted from the most recently stored row in history to the oldest one.
+     *
+     * @param chatid Chat where to search, or Id::inval() to search all chats
+     * @param query Words to search, separated by spaces
+     * @param limit Maximum number of results (up to kMaxResults)
+     * @param cursor Zero for the first page of results, or the value returned by the previous call
+     * @param results Found messages
+     * @return Cursor to get the next page of results, or zero if there are no more results
+     */
+    int64_t search(Id chatid, const std::string& query, unsigned limit, int64_t cursor, std::vector<Result>& results);
+
+    /** @brief Converts words typed by the user into an FTS5 query that can't have syntax errors */
+    static std::string toMatchExpression(const std::string& query);
+
+protected:
+    SqliteDb& mDb;
+    void* mAppCtx;
+    bool mEnabled = false;
+
+    // history rowids below this value are pending to be indexed (zero when the backfill is complete)
+    int64_t mBackfillNext = 0;
+    megaHandle mBackfillTimer = 0;
+
+    bool exists();
+    void createTriggers();
+    void scheduleBackfill();
+    void backfillStep();
+    void saveBackfillProgress();
+};
+}
+#endif // MESSAGESEARCHINDEX_H
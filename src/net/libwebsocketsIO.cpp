@@ -221,19 +221,58 @@ bool LibwebsocketsClient::wsSendMessage(char *msg, size_t len)
         assert(false);
         return false;
     }
-    
-    if (!sendbuffer.size())
+
+    if (disconnecting)
+    {
+        WEBSOCKETS_LOG_WARNING("Discarding %lu bytes to send: the socket is being closed", len);
+        return false;
+    }
+
+    size_t highWaterMark = client->wsSendQueueHighWaterMark();
+    if (mSendStats.queuedBytes + len > highWaterMark * WebsocketsClient::kSendQueueHardLimitFactor)
+    {
+        // the command can't be queued, and the server would miss it (JOIN, NEWMSG, SEEN...), so
+        // the connection is closed: the client reconnects and resyncs its state with the server
+        WEBSOCKETS_LOG_ERROR("Send queue is full: %lu bytes queued, can't add %lu more. Closing the socket",
+                             mSendStats.queuedBytes, len);
+        disconnecting = true;
+        // the socket may not become writable soon, so close it from the event loop without waiting
+        // for it (LWS_CALLBACK_CLIENT_CLOSED notifies the client by wsCloseCb())
+        lws_set_timeout(wsi, PENDING_TIMEOUT_CLOSE_SEND, LWS_TO_KILL_ASYNC);
+        return false;
+    }
+
+    // text messages (JSON) can't be concatenated, so only binary ones share a frame
+    if (mSendQueue.empty() || !client->isWriteBinary()
+            || mSendQueue.back().buf.size() - LWS_PRE + len > kMaxSendChunkSize)
+    {
+        mSendQueue.emplace_back();
+        SendChunk &chunk = mSendQueue.back();
+        chunk.buf.reserve(LWS_PRE + len);
+        chunk.buf.resize(LWS_PRE);
+        chunk.queuedTs = std::chrono::steady_clock::now();
+        mSendStats.queuedFrames++;
+    }
+    mSendQueue.back().buf.append(msg, len);
+
+    mSendStats.queuedBytes += len;
+    if (mSendStats.queuedBytes > mSendStats.peakQueuedBytes)
     {
-        sendbuffer.reserve(LWS_PRE + len);
-        sendbuffer.resize(LWS_PRE);
+        mSendStats.peakQueuedBytes = mSendStats.queuedBytes;
     }
-    sendbuffer.append(msg, len);
 
     if (lws_callback_on_writable(wsi) <= 0)
     {
         WEBSOCKETS_LOG_ERROR("lws_callback_on_writable() failed");
         return false;
     }
+
+    if (!mBackpressured && mSendStats.queuedBytes >= highWaterMark)
+    {
+        mBackpressured = true;
+        mSendStats.backpressureCount++;
+        wsBackpressureCb(true);
+    }
     return true;
 }
 
@@ -322,19 +361,39 @@ bool LibwebsocketsClient::wsIsConnected()
     return wsi != NULL;
 }
 
-const char *LibwebsocketsClient::getOutputBuffer()
+bool LibwebsocketsClient::popOutputChunk(SendChunk &chunk)
 {
-    return sendbuffer.size() ? sendbuffer.data() + LWS_PRE : NULL;
-}
+    if (mSendQueue.empty())
+    {
+        return false;
+    }
 
-size_t LibwebsocketsClient::getOutputBufferLength()
-{
-    return sendbuffer.size() ? sendbuffer.size() - LWS_PRE : 0;
+    chunk = std::move(mSendQueue.front());
+    mSendQueue.pop_front();
+    mSendStats.queuedBytes -= chunk.buf.size() - LWS_PRE;
+    mSendStats.queuedFrames--;
+    return true;
 }
 
-void LibwebsocketsClient::resetOutputBuffer()
+bool LibwebsocketsClient::onOutputChunkWritten(const SendChunk &chunk)
 {
-    sendbuffer.clear();
+    uint64_t latencyUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   std::chrono::steady_clock::now() - chunk.queuedTs).count());
+    mSendStats.sentBytes += chunk.buf.size() - LWS_PRE;
+    mSendStats.sentFrames++;
+    mSendStats.lastWriteLatencyUs = latencyUs;
+    mSendStats.totalWriteLatencyUs += latencyUs;
+    if (latencyUs > mSendStats.maxWriteLatencyUs)
+    {
+        mSendStats.maxWriteLatencyUs = latencyUs;
+    }
+
+    if (mBackpressured && mSendStats.queuedBytes < client->wsSendQueueHighWaterMark() / 2)
+    {
+        mBackpressured = false;
+        return true;
+    }
+    return false;
 }
 
 #if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined (LIBRESSL_VERSION_NUMBER)
@@ -556,20 +615,51 @@ int LibwebsocketsClient::wsCallback(struct lws *wsi, enum lws_callback_reasons r
                 return -1;
             }
             
-            data = (void *)client->getOutputBuffer();
-            len = client->getOutputBufferLength();
-            if (len && data)
+            // the previous frame was not fully written to the socket yet, and it's
+            // buffered by libwebsockets: wait until it's sent before writing more
+            if (lws_partial_buffered(wsi))
+            {
+                lws_callback_on_writable(wsi);
+                break;
+            }
+
+            SendChunk chunk;
+            if (!client->popOutputChunk(chunk))
             {
-                enum lws_write_protocol writeProtocol = client->client->isWriteBinary() ?
-                            LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+                break;
+            }
 
-                lws_write(wsi, (unsigned char *)data, len, writeProtocol);
-                client->wsSendMsgCb((const char *)data, len);
-                client->resetOutputBuffer();
+            enum lws_write_protocol writeProtocol = client->client->isWriteBinary() ?
+                        LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+
+            unsigned char *buf = (unsigned char *)&chunk.buf[LWS_PRE];
+            len = chunk.buf.size() - LWS_PRE;
+            if (lws_write(wsi, buf, len, writeProtocol) < 0)
+            {
+                WEBSOCKETS_LOG_ERROR("lws_write() failed to write %lu bytes", len);
+                return -1;
+            }
+
+            bool relieved = client->onOutputChunkWritten(chunk);
+            bool drained = client->mSendQueue.empty();
+            if (!drained)
+            {
+                lws_callback_on_writable(wsi);
+            }
+            else
+            {
+                // all the data queued so far has been written
+                client->wsSendMsgCb((const char *)buf, len);
 
                 // This cb will only be implemented in those clients that require messages to be sent individually
                 client->wsProcessNextMsgCb();
             }
+
+            // the callbacks above may have disconnected (and deleted) the client
+            if (relieved && lws_wsi_user(wsi) == client)
+            {
+                client->wsBackpressureCb(false);
+            }
             break;
         }
         default:
@@ -5,6 +5,8 @@
 #include <openssl/ssl.h>
 #include <iostream>
 #include <functional>
+#include <chrono>
+#include <deque>
 
 #include "net/websocketsIO.h"
 #include <uv.h>
@@ -55,17 +57,31 @@ public:
     bool connectViaClientInfo(const char *ip, const char *host, int port, const char *path, bool ssl, lws_context *wscontext);
 
 private:
+    // Outgoing data is written in chunks of up to this size (a bigger message gets its own chunk),
+    // so a single write never hands too much data to libwebsockets to buffer
+    static constexpr size_t kMaxSendChunkSize = 32 * 1024;
+
+    // A websocket frame waiting to be written. The buffer starts with LWS_PRE bytes
+    // of padding, required by lws_write()
+    struct SendChunk
+    {
+        std::string buf;
+        std::chrono::steady_clock::time_point queuedTs;
+    };
+
     std::string recbuffer;
-    std::string sendbuffer;
+    std::deque<SendChunk> mSendQueue;
 
     void appendMessageFragment(char *data, size_t len, size_t remaining);
     bool hasFragments();
     const char *getMessage();
     size_t getMessageLength();
     void resetMessage();
-    const char *getOutputBuffer();
-    size_t getOutputBufferLength();
-    void resetOutputBuffer();
+
+    // Removes the next chunk from the send queue. Returns false if the queue is empty
+    bool popOutputChunk(SendChunk &chunk);
+    // Updates the stats after writing a chunk. Returns true if it relieved the backpressure
+    bool onOutputChunkWritten(const SendChunk &chunk);
     
     bool wsSendMessage(char *msg, size_t len) override;
     void wsDisconnect(bool immediate) override;
@@ -68,6 +68,20 @@ void WebsocketsClientImpl::wsProcessNextMsgCb()
     client->wsProcessNextMsgCb();
 }
 
+void WebsocketsClientImpl::wsBackpressureCb(bool backpressured)
+{
+    WebsocketsIO::MutexGuard lock(this->mutex);
+    if (backpressured)
+    {
+        WEBSOCKETS_LOG_WARNING("Send queue is backpressured: %lu bytes queued", mSendStats.queuedBytes);
+    }
+    else
+    {
+        WEBSOCKETS_LOG_DEBUG("Send queue is no longer backpressured: %lu bytes queued", mSendStats.queuedBytes);
+    }
+    client->wsBackpressureCb(backpressured);
+}
+
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
 bool WebsocketsClientImpl::wsSSLsessionUpdateCb(const CachedSession &sess)
 {
@@ -192,6 +206,26 @@ bool WebsocketsClient::isWriteBinary() const
     return mWriteBinary;
 }
 
+void WebsocketsClient::wsSetSendQueueHighWaterMark(size_t bytes)
+{
+    mSendQueueHighWaterMark = bytes;
+}
+
+size_t WebsocketsClient::wsSendQueueHighWaterMark() const
+{
+    return mSendQueueHighWaterMark;
+}
+
+bool WebsocketsClient::wsIsBackpressured()
+{
+    return ctx && ctx->wsIsBackpressured();
+}
+
+WebsocketsSendStats WebsocketsClient::wsSendStats()
+{
+    return ctx ? ctx->wsSendStats() : WebsocketsSendStats();
+}
+
 DNScache::DNScache(SqliteDb &db, int chatdVersion)
     : mDb(db),
       mChatdVersion(chatdVersion),
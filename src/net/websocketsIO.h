@@ -8,6 +8,7 @@
 #include <mega/waiter.h>
 #include <mega/thread.h>
 #include "base/logger.h"
+#include "base/instrumentedMutex.h"
 #include "sdkApi.h"
 #include "buffer.h"
 #include "db.h"
@@ -153,7 +154,7 @@ private:
 class WebsocketsIO : public ::mega::EventTrigger
 {
 public:
-    using Mutex = std::recursive_mutex;
+    using Mutex = karere::InstrumentedMutex<std::recursive_mutex>;
     using MutexGuard = std::lock_guard<Mutex>;
 
     WebsocketsIO(Mutex &mutex, ::mega::MegaApi *megaApi, void *ctx);
@@ -195,6 +196,20 @@ protected:
 };
 
 
+// Statistics of the send queue of a websocket connection
+struct WebsocketsSendStats
+{
+    size_t queuedBytes = 0;             // bytes waiting to be written to the socket
+    size_t queuedFrames = 0;            // frames waiting to be written to the socket
+    size_t peakQueuedBytes = 0;         // maximum value reached by queuedBytes
+    uint64_t sentBytes = 0;
+    uint64_t sentFrames = 0;
+    uint64_t lastWriteLatencyUs = 0;    // time since the data of the last frame was queued until it was written
+    uint64_t maxWriteLatencyUs = 0;
+    uint64_t totalWriteLatencyUs = 0;   // divide by sentFrames to get the average latency
+    unsigned int backpressureCount = 0; // number of times the high-water mark was reached
+};
+
 // Abstract class that allows to manage a websocket connection.
 // It's needed to subclass this class in order to receive callbacks
 
@@ -207,7 +222,17 @@ private:
     // chatd/presenced use binary protocol, while SFU use text-based protocol (JSON)
     bool mWriteBinary = true;
 
+    // bytes queued for sending above which the connection is considered backpressured
+    size_t mSendQueueHighWaterMark = kDefaultSendQueueHighWaterMark;
+
 public:
+    // Default high-water mark of the send queue
+    static constexpr size_t kDefaultSendQueueHighWaterMark = 1024 * 1024;
+
+    // wsSendMessage() fails if the queued bytes would exceed the high-water mark by this factor,
+    // and the connection is closed, so wsCloseCb() is called and the client reconnects
+    static constexpr size_t kSendQueueHardLimitFactor = 4;
+
     WebsocketsClient(bool writeBinary = true);
     virtual ~WebsocketsClient();
     bool wsResolveDNS(WebsocketsIO *websocketIO, const char *hostname, std::function<void(int, const std::vector<std::string>&, const std::vector<std::string>&)> f);
@@ -221,6 +246,15 @@ public:
 
     bool isWriteBinary() const;
 
+    // The send queue is backpressured when the bytes waiting to be written to the socket reach
+    // the high-water mark. It stops being backpressured when they drop below half of that mark.
+    void wsSetSendQueueHighWaterMark(size_t bytes);
+    size_t wsSendQueueHighWaterMark() const;
+    bool wsIsBackpressured();
+
+    // Returns the statistics of the send queue for the current connection (empty if not connected)
+    WebsocketsSendStats wsSendStats();
+
     virtual void wsConnectCb() = 0;
     virtual void wsCloseCb(int errcode, int errtype, const char *preason, size_t reason_len) = 0;
     virtual void wsHandleMsgCb(char *data, size_t len) = 0;
@@ -229,6 +263,10 @@ public:
     // Called after sending a message through the socket
     // (it may be implemented by clients that require messages to be sent individually and sequentially)
     virtual void wsProcessNextMsgCb() {}
+
+    // Called when the send queue becomes backpressured (true) and when it's relieved (false),
+    // so clients sending lots of data can stop producing it until the queue drains
+    virtual void wsBackpressureCb(bool) {}
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
     virtual bool wsSSLsessionUpdateCb(const CachedSession &) { return false; }
 #endif
@@ -243,6 +281,8 @@ protected:
     WebsocketsClient *client;
     WebsocketsIO::Mutex &mutex;
     bool disconnecting;
+    bool mBackpressured = false;
+    WebsocketsSendStats mSendStats;
 
 public:
     WebsocketsClientImpl(WebsocketsIO::Mutex &mutex, WebsocketsClient *client);
@@ -252,10 +292,14 @@ public:
     void wsHandleMsgCb(char *data, size_t len);
     void wsSendMsgCb(const char *data, size_t len);
     void wsProcessNextMsgCb();
+    void wsBackpressureCb(bool backpressured);
 #if WEBSOCKETS_TLS_SESSION_CACHE_ENABLED
     bool wsSSLsessionUpdateCb(const CachedSession &sess);
 #endif
 
+    bool wsIsBackpressured() const { return mBackpressured; }
+    const WebsocketsSendStats &wsSendStats() const { return mSendStats; }
+
     virtual bool wsSendMessage(char *msg, size_t len) = 0;
     virtual void wsDisconnect(bool immediate) = 0;
     virtual bool wsIsConnected() = 0;
@@ -326,6 +326,195 @@ bool Client::updateLastGreen(const Id& userid, time_t lastGreen)
     return false;
 }
 
+// snapshot format: version (1 byte), then per peer: userid (8 bytes), presence (1 byte), last-green ts (4 bytes)
+static const uint8_t kSnapshotVersion = 1;
+static const size_t kSnapshotEntrySize = sizeof(uint64_t) + sizeof(Presence::Code) + sizeof(uint32_t);
+
+void Client::restoreSnapshot(const StaticBuffer& snapshot)
+{
+    if (snapshot.empty())
+    {
+        return;
+    }
+
+    if (snapshot.read<uint8_t>(0) != kSnapshotVersion
+            || (snapshot.dataSize() - sizeof(uint8_t)) % kSnapshotEntrySize)
+    {
+        PRESENCED_LOG_WARNING("Discarding presence snapshot of unknown format (%zu bytes)", snapshot.dataSize());
+        return;
+    }
+
+    beginPresenceBatch();
+    for (size_t pos = sizeof(uint8_t); pos < snapshot.dataSize(); pos += kSnapshotEntrySize)
+    {
+        uint64_t userid = snapshot.read<uint64_t>(pos);
+        Presence pres(snapshot.read<Presence::Code>(pos + sizeof(uint64_t)));
+        time_t lastGreen = snapshot.read<uint32_t>(pos + sizeof(uint64_t) + sizeof(Presence::Code));
+
+        // apps are notified regardless of mContacts, which is not loaded yet: only notifiable peers are
+        // exported, and the ones that are not contacts anymore are discarded later (see discardSnapshotNonContacts())
+        if (pres.isValid() && mPeersPresence.emplace(userid, pres).second)
+        {
+            mStalePeers.insert(userid);
+            PresenceUpdate& update = presenceBatchEntry(userid);
+            update.pres = pres;
+            update.presenceChanged = true;
+            update.stale = true;
+        }
+        if (lastGreen && mPeersLastGreen.emplace(userid, lastGreen).second)
+        {
+            presenceBatchEntry(userid).lastGreenChanged = true;
+        }
+    }
+    mSnapshotRestored = mStalePeers.size();
+    mSnapshotChanged = 0;
+    PRESENCED_LOG_DEBUG("Restored presence snapshot: %zu peers", mSnapshotRestored);
+    endPresenceBatch();
+}
+
+bool Client::exportSnapshot(Buffer& snapshot)
+{
+    if (!mSnapshotDirty)
+    {
+        return false;
+    }
+
+    std::map<uint64_t, std::pair<Presence::Code, uint32_t>> peers;
+    for (const auto& it: mPeersPresence)
+    {
+        uint64_t userid = it.first;
+        if (it.second.isValid()
+                && (mStalePeers.count(userid) || userid == mKarereClient->myHandle()
+                    || (isContact(userid) && !isExContact(userid))))
+        {
+            peers[userid].first = it.second.raw();
+        }
+    }
+    for (const auto& it: mPeersLastGreen)
+    {
+        // until the contacts are loaded, the last-green restored from the previous snapshot is kept
+        if (it.second && (!mLastScsn.isValid() || (isContact(it.first) && !isExContact(it.first))))
+        {
+            auto pair = peers.emplace(it.first, std::pair<Presence::Code, uint32_t>(Presence::kUnknown, 0));
+            pair.first->second.second = static_cast<uint32_t>(it.second);
+        }
+    }
+
+    snapshot.clear();
+    snapshot.reserve(sizeof(uint8_t) + peers.size() * kSnapshotEntrySize);
+    snapshot.append<uint8_t>(kSnapshotVersion);
+    for (const auto& it: peers)
+    {
+        snapshot.append<uint64_t>(it.first);
+        snapshot.append<Presence::Code>(it.second.first);
+        snapshot.append<uint32_t>(it.second.second);
+    }
+    mSnapshotDirty = false;
+    return true;
+}
+
+void Client::confirmStalePeer(const karere::Id& peer, karere::Presence pres)
+{
+    if (!mStalePeers.erase(peer.val))
+    {
+        return;
+    }
+
+    if (peerPresence(peer).status() != pres.status())
+    {
+        mSnapshotChanged++;
+    }
+    else
+    {
+        // updatePeerPresence() won't notify an unchanged presence, but apps need to know it's not stale anymore
+        beginPresenceBatch();
+        PresenceUpdate& update = presenceBatchEntry(peer);
+        update.pres = pres;
+        update.presenceChanged = true;
+        endPresenceBatch();
+    }
+    if (mStalePeers.empty())
+    {
+        reconcileSnapshot();
+    }
+}
+
+void Client::reconcileSnapshot()
+{
+    if (mReconcileTimer)
+    {
+        cancelTimeout(mReconcileTimer, mKarereClient->appCtx);
+        mReconcileTimer = 0;
+    }
+
+    // presenced didn't report these peers, so their restored presence can't be trusted anymore
+    beginPresenceBatch();
+    for (uint64_t userid: mStalePeers)
+    {
+        auto it = mPeersPresence.find(userid);
+        if (it != mPeersPresence.end() && it->second.isValid())
+        {
+            it->second = Presence::kUnknown;
+            PresenceUpdate& update = presenceBatchEntry(userid);
+            update.pres = Presence::kUnknown;
+            update.presenceChanged = true;
+            mSnapshotChanged++;
+        }
+    }
+    size_t unconfirmed = mStalePeers.size();
+    mStalePeers.clear();
+    mSnapshotDirty = true;
+    endPresenceBatch();
+
+    PRESENCED_LOG_DEBUG("Presence snapshot reconciled: %zu peers restored, %zu changed (%zu not reported)",
+                        mSnapshotRestored, mSnapshotChanged, unconfirmed);
+}
+
+void Client::discardSnapshotNonContacts()
+{
+    // the snapshot may include peers that stopped being contacts after it was saved
+    beginPresenceBatch();
+    size_t discarded = 0;
+    for (auto it = mStalePeers.begin(); it != mStalePeers.end();)
+    {
+        uint64_t userid = *it;
+        if (userid == mKarereClient->myHandle() || (isContact(userid) && !isExContact(userid)))
+        {
+            it++;
+            continue;
+        }
+
+        it = mStalePeers.erase(it);
+        mPeersPresence.erase(userid);
+        PresenceUpdate& update = presenceBatchEntry(userid);
+        update.pres = Presence::kUnknown;
+        update.presenceChanged = true;
+        discarded++;
+    }
+    for (auto it = mPeersLastGreen.begin(); it != mPeersLastGreen.end();)
+    {
+        if (isContact(it->first) && !isExContact(it->first))
+        {
+            it++;
+        }
+        else
+        {
+            it = mPeersLastGreen.erase(it);
+        }
+    }
+    mSnapshotDirty = true;
+    endPresenceBatch();
+
+    if (discarded)
+    {
+        PRESENCED_LOG_DEBUG("Discarded %zu peers of the presence snapshot that are not contacts", discarded);
+    }
+    if (mStalePeers.empty() && mReconcileTimer)
+    {
+        reconcileSnapshot();
+    }
+}
+
 void Client::resetConnSuceededAttempts(const time_t &t)
 {
     mTsConnSuceeded = t;
@@ -781,6 +970,7 @@ void Client::onEvent(::mega::MegaApi *api, ::mega::MegaEvent *event)
                 int visibility = user->getVisibility();
                 mContacts[userid] = visibility; // add ex-contacts to identify them
             }
+            discardSnapshotNonContacts();
 
             // finally send to presenced the initial set of peers
             pushPeers();
@@ -1230,7 +1420,43 @@ void Client::wsHandleMsgCb(char *data, size_t len)
 {
     mTsLastRecv = time(NULL);
     mTsLastPingSent = 0;
+
+    // upon login, presenced sends the status of every contact in a few frames
+    beginPresenceBatch();
     handleMessage(StaticBuffer(data, len));
+    endPresenceBatch();
+}
+
+void Client::beginPresenceBatch()
+{
+    mPresenceBatchDepth++;
+}
+
+void Client::endPresenceBatch()
+{
+    assert(mPresenceBatchDepth);
+    if (--mPresenceBatchDepth || mPresenceBatch.empty())
+    {
+        return;
+    }
+
+    // the listener may change presences again
+    std::vector<PresenceUpdate> updates;
+    updates.swap(mPresenceBatch);
+    mPresenceBatchPos.clear();
+
+    PRESENCED_LOG_DEBUG("Notifying %zu presence updates", updates.size());
+    CALL_LISTENER(onPresenceBatch, updates);
+}
+
+PresenceUpdate& Client::presenceBatchEntry(const karere::Id& userid)
+{
+    auto result = mPresenceBatchPos.emplace(userid.val, mPresenceBatch.size());
+    if (result.second)
+    {
+        mPresenceBatch.emplace_back(userid);
+    }
+    return mPresenceBatch[result.first->second];
 }
 
 // inbound command processing
@@ -1262,7 +1488,9 @@ void Client::handleMessage(const StaticBuffer& buf)
                 READ_ID(userid, 1);
                 PRESENCED_LOG_DEBUG("recv PEERSTATUS - user '%s' with presence %s",
                     ID_CSTR(userid), Presence::toString(pres));
+                confirmStalePeer(userid, pres);
                 updatePeerPresence(userid, pres);
+                mSnapshotDirty = true;
                 break;
             }
             case OP_PREFS:
@@ -1322,8 +1550,9 @@ void Client::handleMessage(const StaticBuffer& buf)
                 // convert the received minutes into a UNIX timestamp
                 time_t lastGreenTs = time(NULL) - (lastGreen * 60);
                 mPeersLastGreen[userid] = lastGreenTs;
+                mSnapshotDirty = true;
 
-                CALL_LISTENER(onPresenceLastGreenUpdated, userid);
+                presenceBatchEntry(userid).lastGreenChanged = true;
                 break;
             }
             default:
@@ -1397,12 +1626,42 @@ void Client::setConnState(ConnState newState)
             }, kConnectTimeout * 1000, mKarereClient->appCtx);
         }
 
+        // the peers restored from the snapshot are reconciled upon next login
+        if (mReconcileTimer)
+        {
+            cancelTimeout(mReconcileTimer, mKarereClient->appCtx);
+            mReconcileTimer = 0;
+        }
+
         // if disconnected, we don't really know the presence status anymore
+        // (restored presences are kept, since they are already stale)
+        beginPresenceBatch();
         for (auto it = mContacts.begin(); it != mContacts.end(); it++)
         {
-            updatePeerPresence(it->first, Presence::kUnknown);
+            if (!mStalePeers.count(it->first))
+            {
+                updatePeerPresence(it->first, Presence::kUnknown);
+            }
+        }
+        if (!mStalePeers.count(mKarereClient->myHandle()))
+        {
+            updatePeerPresence(mKarereClient->myHandle(), Presence::kUnknown);
         }
-        updatePeerPresence(mKarereClient->myHandle(), Presence::kUnknown);
+        endPresenceBatch();
+    }
+    else if (mConnState == kLoggedIn && !mStalePeers.empty())
+    {
+        // presenced reports the peers right after login, give up on the ones missing after a while
+        auto wptr = weakHandle();
+        mReconcileTimer = setTimeout([this, wptr]()
+        {
+            if (wptr.deleted())
+                return;
+
+            mReconcileTimer = 0;
+            reconcileSnapshot();
+
+        }, kSnapshotReconcileTimeout * 1000, mKarereClient->appCtx);
     }
     else if (mConnState == kConnected)
     {
@@ -1463,6 +1722,7 @@ void Client::removePeers(const std::vector<karere::Id> &peers)
     Command cmd(OP_SNDELPEERS, static_cast<uint8_t>(totalSize));
     cmd.append<uint64_t>(mLastScsn.val);
     cmd.append<uint32_t>(static_cast<uint32_t>(peers.size()));
+    beginPresenceBatch();
     for (size_t i = 0; i < peers.size(); i++)
     {
 #ifndef NDEBUG
@@ -1470,9 +1730,12 @@ void Client::removePeers(const std::vector<karere::Id> &peers)
         assert (it == mContacts.end() || it->second == ::mega::MegaUser::VISIBILITY_HIDDEN);
 #endif
         mPeersLastGreen.erase(peers.at(i).val); // Remove peer from mPeersLastGreen map if exists
+        mStalePeers.erase(peers.at(i).val);
         cmd.append<uint64_t>(peers.at(i).val);
         updatePeerPresence(peers.at(i), Presence::kUnknown);
     }
+    endPresenceBatch();
+    mSnapshotDirty = true;
     sendCommand(std::move(cmd));
 }
 
@@ -1499,7 +1762,16 @@ void Client::updatePeerPresence(const karere::Id& peer, karere::Presence pres)
             || (contact && !exContact)
             || (exContact && pres.status() == Presence::kUnknown))
     {
-        CALL_LISTENER(onPresenceChange, peer, pres);
+        if (mPresenceBatchDepth)
+        {
+            PresenceUpdate& update = presenceBatchEntry(peer);
+            update.pres = pres;
+            update.presenceChanged = true;
+        }
+        else
+        {
+            CALL_LISTENER(onPresenceChange, peer, pres);
+        }
     }
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <set>
 #include <buffer.h>
 #include <base/promise.h>
 #include <base/timers.hpp>
@@ -81,6 +82,7 @@ enum {
     kKeepaliveSendInterval = 25,
     kKeepaliveReplyTimeout = 15,
     kConnectTimeout = 30,
+    kSnapshotReconcileTimeout = 10,  // (in seconds) time after login for presenced to report the peers restored from the snapshot
     kMaxConnSucceededTimeframe = 30 // (in seconds) timeout after we will re-fetch a fresh URL if successful connections has exceeded kMaxConnSuceeded
 };
 enum: uint8_t
@@ -309,6 +311,19 @@ public:
 
 class Listener;
 
+/** @brief Changes of the presence and/or the last-green of a user, see Listener::onPresenceBatch() */
+struct PresenceUpdate
+{
+    karere::Id userid;
+    karere::Presence pres;              // valid only if presenceChanged
+    bool presenceChanged = false;
+    bool lastGreenChanged = false;
+    bool stale = false;                 // presence restored from the snapshot, not confirmed by presenced yet
+    uint16_t lastGreen = 0;             // minutes since the user was green, set by karere::Client if lastGreenChanged
+
+    PresenceUpdate(const karere::Id& aUserid): userid(aUserid) {}
+};
+
 class Client: public karere::DeleteTrackable, public WebsocketsClient,
         public ::mega::MegaGlobalListener
 {
@@ -410,6 +425,24 @@ protected:
     /** Sequence-number for the list of peers and contacts above (initialized upon completion of catch-up phase) */
     karere::Id mLastScsn = karere::Id::inval();
 
+    /** Changes of presence and last-green not notified yet, coalesced per user (see beginPresenceBatch()) */
+    std::vector<PresenceUpdate> mPresenceBatch;
+    std::map<uint64_t, size_t> mPresenceBatchPos;   // userid -> position in mPresenceBatch
+    unsigned mPresenceBatchDepth = 0;
+
+    /** Peers restored from the snapshot whose presence has not been reported by presenced yet */
+    std::set<uint64_t> mStalePeers;
+
+    /** Number of peers restored from the snapshot, and how many of them changed upon reconciliation */
+    size_t mSnapshotRestored = 0;
+    size_t mSnapshotChanged = 0;
+
+    /** True if presences have changed since the snapshot was exported last time */
+    bool mSnapshotDirty = false;
+
+    /** Handler of the timeout to give up on the peers not reported after login (see reconcileSnapshot()) */
+    megaHandle mReconcileTimer = 0;
+
     void setConnState(ConnState newState);
 
     void wsConnectCb() override;
@@ -444,6 +477,11 @@ protected:
     bool isExContact(uint64_t userid);
     bool isContact(uint64_t userid);
 
+    // snapshot management
+    void confirmStalePeer(const karere::Id& peer, karere::Presence pres);
+    void reconcileSnapshot();
+    void discardSnapshotNonContacts();
+
     // mega::MegaGlobalListener interface, called by worker thread
     void onUsersUpdate(::mega::MegaApi*, ::mega::MegaUserList* users) override;
     void onEvent(::mega::MegaApi* api, ::mega::MegaEvent* event) override;
@@ -494,6 +532,14 @@ public:
      */
     void notifyUserStatus();
 
+    /**
+     * @brief Changes of presence and last-green are collected from now on, and notified
+     * together by endPresenceBatch(). Calls can be nested.
+     */
+    void beginPresenceBatch();
+    void endPresenceBatch();
+    PresenceUpdate& presenceBatchEntry(const karere::Id& userid);
+
     // peers management
     void updatePeerPresence(const karere::Id& peer, karere::Presence pres);
     karere::Presence peerPresence(const karere::Id& peer) const;
@@ -502,6 +548,25 @@ public:
     bool updateLastGreen(const karere::Id& userid, time_t lastGreen);
     time_t getLastGreen(const karere::Id& userid);
 
+    /**
+     * @brief Restores the presence and last-green of the peers saved by exportSnapshot() in
+     * a previous session, so they are available before presenced is reached. The restored
+     * presences are notified as stale (see PresenceUpdate::stale) until presenced reports them
+     * again after login, and then notified again even if they haven't changed. Peers not reported
+     * within kSnapshotReconcileTimeout are set to unknown, and the ones that are not contacts
+     * anymore are discarded once the contacts are loaded.
+     */
+    void restoreSnapshot(const StaticBuffer& snapshot);
+
+    /**
+     * @brief Serializes the presence and last-green of the peers into \c snapshot.
+     * Returns false if nothing changed since the last export.
+     */
+    bool exportSnapshot(Buffer& snapshot);
+
+    /** @brief Returns true if the presence of the peer comes from the snapshot and is not confirmed yet */
+    bool isPeerPresenceStale(const karere::Id& peer) const { return mStalePeers.count(peer.val); }
+
     /** @brief reset number of succeeded connection attempts and update ts for last check **/
     void resetConnSuceededAttempts(const time_t &t);
 
@@ -515,6 +580,26 @@ public:
     virtual void onPresenceChange(karere::Id userid, karere::Presence pres, bool inProgress = false) = 0;
     virtual void onPresenceConfigChanged(const Config& Config, bool pending) = 0;
     virtual void onPresenceLastGreenUpdated(karere::Id userid) = 0;
+
+    /**
+     * @brief Called with the changes of presence and last-green of peers received together,
+     * i.e. in the same frame from presenced, with a single entry per user.
+     * The default implementation notifies every change separately.
+     */
+    virtual void onPresenceBatch(const std::vector<PresenceUpdate>& updates)
+    {
+        for (const PresenceUpdate& update: updates)
+        {
+            if (update.presenceChanged)
+            {
+                onPresenceChange(update.userid, update.pres);
+            }
+            if (update.lastGreenChanged)
+            {
+                onPresenceLastGreenUpdated(update.userid);
+            }
+        }
+    }
     virtual void onDestroy(){}
 };
 
@@ -1,7 +1,32 @@
 #ifndef IVIDEORENDERER_H
 #define IVIDEORENDERER_H
+#include <stdint.h>
 namespace rtcModule
 {
+/**
+ * @brief Read-only video frame in planar I420 format, as decoded by webrtc. The planes are
+ * not copied: the frame keeps a reference to the decoded buffer while it exists.
+ */
+class IVideoFrameI420
+{
+public:
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual const uint8_t* dataY() const = 0;
+    virtual const uint8_t* dataU() const = 0;
+    virtual const uint8_t* dataV() const = 0;
+    virtual int strideY() const = 0;
+    virtual int strideU() const = 0;
+    virtual int strideV() const = 0;
+
+    /** Clockwise rotation in degrees (0, 90, 180 or 270) to apply in order to display the frame */
+    virtual int rotation() const = 0;
+
+    /** Returns a new reference to the same frame, the planes are not copied */
+    virtual IVideoFrameI420* copy() const = 0;
+    virtual ~IVideoFrameI420() {}
+};
+
 /**
  * @brief This is the interface that is used to pass frames from the webrtc module to the
  * application for rendering in the GUI, or other purposes. For each frame, getImageBuffer()
@@ -37,6 +62,26 @@ public:
      */
     virtual void frameComplete(void* userData) = 0;
 
+    /**
+     * @brief Returns true if frames from \c sourceType have to be converted to ARGB and
+     * delivered via \c getImageBuffer() and \c frameComplete()
+     */
+    virtual bool wantsArgbFrames(int /*sourceType*/) { return true; }
+
+    /**
+     * @brief Returns true if frames from \c sourceType have to be delivered via
+     * \c onI420Frame(), without any conversion
+     */
+    virtual bool wantsI420Frames(int /*sourceType*/) { return false; }
+
+    /**
+     * @brief onI420Frame Called for every frame when \c wantsI420Frames() returns true.
+     * The frame is not rotated, its rotation is reported by \c IVideoFrameI420::rotation().
+     * @param frame The frame, valid until this call returns. Use \c IVideoFrameI420::copy()
+     * to keep it longer.
+     */
+    virtual void onI420Frame(const IVideoFrameI420& /*frame*/, int /*sourceType*/) {}
+
     /**
      * @brief onVideoAttach Called when a video stream is attached to the player component
      * Frames can be expected after that point
@@ -0,0 +1,113 @@
+#include <rtcModule/audioLevelMeter.h>
+
+#include <algorithm>
+#include <math.h>
+
+namespace rtcModule
+{
+namespace
+{
+// time constants of the exponential smoothing (ms)
+constexpr float kLevelAttackMs = 20.0f;
+constexpr float kLevelReleaseMs = 300.0f;
+constexpr float kNoiseFallMs = 50.0f;
+constexpr float kNoiseRiseMs = 4000.0f;
+
+constexpr float kFullScale = 32768.0f;
+
+// weight of a new value for a time constant of \c tauMs, given the length of the block
+float smoothingFactor(unsigned blockMs, float tauMs)
+{
+    return 1.0f - expf(-static_cast<float>(blockMs) / tauMs);
+}
+
+float toDb(float ratio)
+{
+    return (ratio > 0.0f) ? std::max(20.0f * log10f(ratio), AudioLevelMeter::kSilenceDb) : AudioLevelMeter::kSilenceDb;
+}
+}
+
+void AudioLevelMeter::measure(const int16_t* samples, size_t count, uint64_t& sumSquares, int32_t& peak)
+{
+    constexpr size_t kLanes = 8;
+    uint64_t laneSum[kLanes] = {};
+    int32_t lanePeak[kLanes] = {};
+
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes)
+    {
+        for (size_t j = 0; j < kLanes; j++)
+        {
+            int32_t value = samples[i + j];
+            laneSum[j] += static_cast<uint32_t>(value * value);   // at most 2^30
+            int32_t absValue = value < 0 ? -value : value;
+            lanePeak[j] = lanePeak[j] > absValue ? lanePeak[j] : absValue;
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        int32_t value = samples[i];
+        laneSum[0] += static_cast<uint32_t>(value * value);
+        lanePeak[0] = std::max(lanePeak[0], value < 0 ? -value : value);
+    }
+
+    sumSquares = 0;
+    peak = 0;
+    for (size_t j = 0; j < kLanes; j++)
+    {
+        sumSquares += laneSum[j];
+        peak = std::max(peak, lanePeak[j]);
+    }
+}
+
+bool AudioLevelMeter::process(const int16_t* samples, size_t count, unsigned blockMs)
+{
+    if (!count || !blockMs)
+    {
+        return false;
+    }
+
+    uint64_t sumSquares;
+    int32_t peak;
+    measure(samples, count, sumSquares, peak);
+
+    float rmsDb = toDb(sqrtf(static_cast<float>(static_cast<double>(sumSquares) / static_cast<double>(count))) / kFullScale);
+    mPeakDb = toDb(static_cast<float>(peak) / kFullScale);
+
+    float levelFactor = smoothingFactor(blockMs, rmsDb > mLevelDb ? kLevelAttackMs : kLevelReleaseMs);
+    mLevelDb += (rmsDb - mLevelDb) * levelFactor;
+
+    float noiseFactor = smoothingFactor(blockMs, rmsDb < mNoiseFloorDb ? kNoiseFallMs : kNoiseRiseMs);
+    mNoiseFloorDb = std::min(mNoiseFloorDb + (rmsDb - mNoiseFloorDb) * noiseFactor, kNoiseFloorMaxDb);
+
+    bool voice = rmsDb > kVoiceMinDb && rmsDb > mNoiseFloorDb + kVoiceMarginDb;
+    if (voice)
+    {
+        mVoiceMs = std::min(mVoiceMs + blockMs, kVoiceOnsetMs);
+        mSilenceMs = 0;
+    }
+    else
+    {
+        mSilenceMs = std::min(mSilenceMs + blockMs, kVoiceHangoverMs);
+        mVoiceMs = 0;
+    }
+
+    bool voiceActive = mVoiceActive
+            ? mSilenceMs < kVoiceHangoverMs
+            : mVoiceMs >= kVoiceOnsetMs;
+
+    if (voiceActive == mVoiceActive)
+    {
+        return false;
+    }
+
+    mVoiceActive = voiceActive;
+    return true;
+}
+
+void AudioLevelMeter::reset()
+{
+    *this = AudioLevelMeter();
+}
+}
@@ -0,0 +1,64 @@
+#ifndef AUDIOLEVELMETER_H
+#define AUDIOLEVELMETER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rtcModule
+{
+/**
+ * @brief Measures the level of an audio stream and detects voice activity on it
+ *
+ * It's fed with every block of 16-bit PCM samples delivered by webrtc (normally 10 ms).
+ * For every block it computes the RMS and peak levels, in dBFS (0 dBFS is full scale),
+ * and smooths the RMS level with a fast attack and a slow release, so it can be used to
+ * compare how loud the participants of a call are.
+ *
+ * Voice activity is a heuristic: a block is considered voice if it's above an absolute
+ * threshold and clearly above the background noise, which is tracked as a floor that
+ * drops quickly and rises slowly. Voice becomes active after kVoiceOnsetMs of voice blocks
+ * and stays active until kVoiceHangoverMs without them, to ignore clicks and short pauses.
+ *
+ * This class isn't thread safe: process() and the getters must be called from the same thread.
+ */
+class AudioLevelMeter
+{
+public:
+    static constexpr float kSilenceDb = -127.0f;        // level reported for digital silence
+    static constexpr float kVoiceMinDb = -55.0f;        // voice is never quieter than this
+    static constexpr float kVoiceMarginDb = 9.0f;       // minimum distance of voice from the noise floor
+    static constexpr float kNoiseFloorMaxDb = -40.0f;   // the floor doesn't adapt to long speeches
+    static constexpr unsigned kVoiceOnsetMs = 30;
+    static constexpr unsigned kVoiceHangoverMs = 400;
+
+    /**
+     * @brief Processes a block of interleaved samples, lasting \c blockMs
+     * @return true if the voice activity state has changed with this block
+     */
+    bool process(const int16_t* samples, size_t count, unsigned blockMs);
+
+    float getLevelDb() const { return mLevelDb; }
+    float getPeakDb() const { return mPeakDb; }
+    float getNoiseFloorDb() const { return mNoiseFloorDb; }
+    bool isVoiceActive() const { return mVoiceActive; }
+    void reset();
+
+    /**
+     * @brief Computes the sum of the squares and the absolute peak of a block of samples
+     *
+     * The loop works on independent lanes with plain integer arithmetic, so the compiler
+     * can vectorize it for any target without intrinsics or fast-math.
+     */
+    static void measure(const int16_t* samples, size_t count, uint64_t& sumSquares, int32_t& peak);
+
+private:
+    float mLevelDb = kSilenceDb;        // smoothed RMS level
+    float mPeakDb = kSilenceDb;         // peak of the last block
+    float mNoiseFloorDb = kVoiceMinDb;
+    unsigned mVoiceMs = 0;              // consecutive time with voice blocks
+    unsigned mSilenceMs = 0;            // consecutive time without voice blocks
+    bool mVoiceActive = false;
+};
+}
+
+#endif // AUDIOLEVELMETER_H
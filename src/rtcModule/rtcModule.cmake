@@ -1,5 +1,6 @@
 
 set(CHATLIB_RTCM_HEADERS
+    rtcModule/audioLevelMeter.h
     rtcModule/IVideoRenderer.h
     rtcModule/rtcmPrivate.h
     rtcModule/rtcStats.h
@@ -9,6 +10,7 @@ set(CHATLIB_RTCM_HEADERS
 )
 
 set(CHATLIB_RTCM_SOURCES
+    rtcModule/audioLevelMeter.cpp
     rtcModule/rtcStats.cpp
     rtcModule/webrtcAdapter.cpp
     rtcModule/webrtc.cpp
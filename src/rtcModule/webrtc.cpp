@@ -6,6 +6,8 @@
 #include <api/video/i420_buffer.h>
 #include <libyuv/convert.h>
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 
@@ -77,6 +79,7 @@ Call::Call(const karere::Id& callid, const karere::Id& chatid, const karere::Id&
 Call::~Call()
 {
     disableStats();
+    disableActiveSpeakers();
 
     if (mTermCode == kInvalidTermCode)
     {
@@ -397,6 +400,16 @@ std::set<Cid_t> Call::enableAudioLevelMonitor(const bool enable)
             cidsFailed.emplace(itSession.first);
         }
     }
+
+    if (enable)
+    {
+        enableActiveSpeakers();
+    }
+    else
+    {
+        disableActiveSpeakers();
+        updateActiveSpeakers(); // monitors have been reset, so the list becomes empty
+    }
     return cidsFailed;
 }
 
@@ -879,6 +892,11 @@ const std::vector<karere::Id>& Call::getRaiseHandsList() const
     return mRaiseHands;
 }
 
+const std::vector<Cid_t>& Call::getActiveSpeakers() const
+{
+    return mActiveSpeakers;
+}
+
 std::set<karere::Id> Call::getSpeakersList() const
 {
     return mSpeakers;
@@ -3801,6 +3819,76 @@ void Call::updateNetworkQuality(int networkQuality)
     mCallHandler.onNetworkQualityChanged(*this);
 }
 
+void Call::enableActiveSpeakers()
+{
+    if (mActiveSpeakersTimer)
+    {
+        return;
+    }
+
+    auto wptr = weakHandle();
+    mActiveSpeakersTimer = karere::setInterval([this, wptr]()
+    {
+        if (wptr.deleted())
+        {
+            return;
+        }
+
+        updateActiveSpeakers();
+    }, RtcConstant::kActiveSpeakersInterval, mRtc.getAppCtx());
+}
+
+void Call::disableActiveSpeakers()
+{
+    if (mActiveSpeakersTimer)
+    {
+        karere::cancelInterval(mActiveSpeakersTimer, mRtc.getAppCtx());
+        mActiveSpeakersTimer = 0;
+    }
+}
+
+void Call::updateActiveSpeakers()
+{
+    // pairs of ranking level and client id
+    std::vector<std::pair<int, Cid_t>> ranking;
+    for (const auto& itSession : mSessions)
+    {
+        const Session& session = *itSession.second;
+        if (!session.isAudioDetected())
+        {
+            continue;
+        }
+
+        // current speakers keep their position, unless other speaker is clearly louder
+        int level = session.getAudioLevel();
+        if (std::find(mActiveSpeakers.begin(), mActiveSpeakers.end(), itSession.first) != mActiveSpeakers.end())
+        {
+            level += RtcConstant::kActiveSpeakersHysteresis;
+        }
+        ranking.emplace_back(level, itSession.first);
+    }
+
+    std::stable_sort(ranking.begin(), ranking.end(), [](const auto& a, const auto& b)
+    {
+        return a.first > b.first;
+    });
+
+    std::vector<Cid_t> activeSpeakers;
+    activeSpeakers.reserve(ranking.size());
+    for (const auto& item : ranking)
+    {
+        activeSpeakers.push_back(item.second);
+    }
+
+    if (activeSpeakers == mActiveSpeakers)
+    {
+        return;
+    }
+
+    mActiveSpeakers.swap(activeSpeakers);
+    mCallHandler.onActiveSpeakersChanged(*this);
+}
+
 void Call::adjustSvcByStats()
 {
     if (mStats.mSamples.mRoundTripTime.empty())
@@ -4858,8 +4946,20 @@ void VideoSink::processFrame(const webrtc::VideoFrame& frame,
     }
 
     assert(render != nullptr);
-    void* userData = NULL;
+    // ToI420() doesn't convert nor copy buffers that are already in I420 format
     auto buffer = frame.video_frame_buffer()->ToI420(); // smart ptr type changed
+    if (render->wantsI420Frames(sourceType))
+    {
+        VideoFrameI420 i420Frame(buffer, frame.rotation());
+        render->onI420Frame(i420Frame, sourceType);
+    }
+
+    if (!render->wantsArgbFrames(sourceType))
+    {
+        return;
+    }
+
+    void* userData = NULL;
     if (frame.rotation() != webrtc::kVideoRotation_0)
     {
         buffer = webrtc::I420Buffer::Rotate(*buffer, frame.rotation());
@@ -4989,10 +5089,18 @@ bool RemoteAudioSlot::enableAudioMonitor(const bool enable)
         mAudioLevelMonitorEnabled = false;
         mAudioLevelMonitor->onAudioDetected(false);
         audioTrack->RemoveSink(mAudioLevelMonitor.get()); // disable AudioLevelMonitor
+        mAudioLevelMonitor->resetLevel();
     }
     return true;
 }
 
+int RemoteAudioSlot::getAudioLevel() const
+{
+    return (mAudioLevelMonitor && mAudioLevelMonitorEnabled)
+            ? mAudioLevelMonitor->getAudioLevel()
+            : static_cast<int>(AudioLevelMeter::kSilenceDb);
+}
+
 void RemoteAudioSlot::createDecryptor(Cid_t cid, IvStatic_t iv)
 {
     RemoteSlot::createDecryptor(cid, iv);
@@ -5236,62 +5344,67 @@ bool Session::isAudioDetected() const
     return mAudioDetected;
 }
 
+int Session::getAudioLevel() const
+{
+    return mAudioSlot ? mAudioSlot->getAudioLevel() : static_cast<int>(AudioLevelMeter::kSilenceDb);
+}
+
 AudioLevelMonitor::AudioLevelMonitor(Call &call, void* appCtx, int32_t cid)
     : mCall(call), mCid(cid), mAppCtx(appCtx)
 {
 }
 
-void AudioLevelMonitor::OnData(const void *audio_data, int bits_per_sample, int /*sample_rate*/, size_t number_of_channels, size_t number_of_frames, absl::optional<int64_t> /*absolute_capture_timestamp_ms*/)
+void AudioLevelMonitor::OnData(const void *audio_data, int bits_per_sample, int sample_rate, size_t number_of_channels, size_t number_of_frames, absl::optional<int64_t> /*absolute_capture_timestamp_ms*/)
 {
     assert(bits_per_sample == 16);
-    time_t nowTime = time(NULL);
-    if (nowTime - mPreviousTime > 2) // Two seconds between samples
+    unsigned blockMs = (sample_rate > 0)
+            ? static_cast<unsigned>(number_of_frames * 1000 / static_cast<size_t>(sample_rate))
+            : 10;   // webrtc delivers 10 ms blocks
+
+    bool changed = mMeter.process(static_cast<const int16_t*>(audio_data), number_of_channels * number_of_frames, blockMs);
+    mAudioLevel.store(static_cast<int>(std::lround(mMeter.getLevelDb())), std::memory_order_relaxed);
+    if (!changed)
     {
-        mPreviousTime = nowTime;
-        size_t valueCount = number_of_channels * number_of_frames;
-        int16_t *data = (int16_t*)audio_data;
-        int16_t audioMaxValue = data[0];
-        int16_t audioMinValue = data[0];
-        for (size_t i = 1; i < valueCount; i++)
-        {
-            if (data[i] > audioMaxValue)
-            {
-                audioMaxValue = data[i];
-            }
+        return;
+    }
 
-            if (data[i] < audioMinValue)
-            {
-                audioMinValue = data[i];
-            }
+    // onset and hangover of voice detection limit the rate of these calls
+    bool audioDetected = mMeter.isVoiceActive();
+    auto wptr = weakHandle();
+    karere::marshallCall([wptr, this, audioDetected]()
+    {
+        if (wptr.deleted())
+        {
+            return;
         }
 
-        bool audioDetected = (abs(audioMaxValue) + abs(audioMinValue) > kAudioThreshold);
-
-        auto wptr = weakHandle();
-        karere::marshallCall([wptr, this, audioDetected]()
+        if (!hasAudio())
         {
-            if (wptr.deleted())
+            if (mAudioDetected)
             {
-                return;
+                onAudioDetected(false);
             }
 
-            if (!hasAudio())
-            {
-                if (mAudioDetected)
-                {
-                    onAudioDetected(false);
-                }
+            return;
+        }
 
-                return;
-            }
+        if (audioDetected != mAudioDetected)
+        {
+            onAudioDetected(audioDetected);
+        }
 
-            if (audioDetected != mAudioDetected)
-            {
-                onAudioDetected(audioDetected);
-            }
+    }, mAppCtx);
+}
 
-        }, mAppCtx);
-    }
+int AudioLevelMonitor::getAudioLevel() const
+{
+    return mAudioLevel.load(std::memory_order_relaxed);
+}
+
+void AudioLevelMonitor::resetLevel()
+{
+    mMeter.reset();
+    mAudioLevel.store(static_cast<int>(AudioLevelMeter::kSilenceDb), std::memory_order_relaxed);
 }
 
 bool AudioLevelMonitor::hasAudio()
@@ -136,6 +136,7 @@ public:
     virtual karere::AvFlags getAvFlags() const = 0;
     virtual SessionState getState() const = 0;
     virtual bool isAudioDetected() const = 0;
+    virtual int getAudioLevel() const = 0;
     virtual TermCode getTermcode() const = 0;
     virtual void setTermcode(TermCode termcode) = 0;
     virtual void setSessionHandler(SessionHandler* sessionHandler) = 0;
@@ -176,6 +177,7 @@ public:
     virtual void onUserSpeakStatusUpdate(const rtcModule::ICall& call, const karere::Id& userid, const bool add) = 0;
     virtual void onSpeakRequest(const rtcModule::ICall& call, const karere::Id& userid, const bool add) = 0;
     virtual void onRaiseHandAddedRemoved(const rtcModule::ICall& call, const karere::Id& userid, const bool add) = 0;
+    virtual void onActiveSpeakersChanged(const rtcModule::ICall& call) = 0;
 
 };
 
@@ -247,6 +249,7 @@ public:
     virtual std::set<karere::Id> getModerators() const = 0;
     virtual std::vector<Cid_t> getSessionsCids() const = 0;
     virtual const std::vector<karere::Id>& getRaiseHandsList() const = 0;
+    virtual const std::vector<Cid_t>& getActiveSpeakers() const = 0;
     virtual ISession* getIsession(Cid_t cid) const = 0;
     virtual bool isOutgoing() const = 0;
     virtual int64_t getCallInitialTimeStamp() const = 0;
@@ -378,6 +381,8 @@ static constexpr int kHiResHeight = 540; // px
 static constexpr int kHiResMaxFPS = 30;
 static constexpr int kVthumbWidth = 160; // px
 static constexpr int kAudioMonitorTimeout = 2000; // ms
+static constexpr int kActiveSpeakersInterval = 250; // ms
+static constexpr int kActiveSpeakersHysteresis = 3; // dB, advantage of current speakers over louder ones, to avoid reordering
 static constexpr int kStatsInterval = 1000; // ms
 static constexpr int kTxSpatialLayerCount = 3;
 static constexpr int kRotateKeyUseDelay = 100; // ms
@@ -400,8 +405,6 @@ typedef enum
     kNetworkQualityGood         = 1,    // Good network quality detected
 } netWorkQuality;
 
-static const int kAudioThreshold = 100;             // Threshold to consider a user is speaking
-
 RtcModule* createRtcModule(MyMegaApi& megaApi, CallHandler &callhandler, DNScache &dnsCache,
                            WebsocketsIO& websocketIO, void *appCtx,
                            rtcModule::RtcCryptoMeetings* rRtcCryptoMeetings);
@@ -438,10 +438,41 @@ RtcCipher::RtcCipher(const sfu::Peer &peer, std::shared_ptr<rtcModule::IRtcCrypt
 
 }
 
-void RtcCipher::setKey(const std::string &key)
+void RtcCipher::setKey(Keyid_t keyId, const std::string &key)
 {
-    const unsigned char *newKey = reinterpret_cast<const unsigned char*>(key.data());
-    mSymCipher.setkey(newKey);
+    CachedKey* slot = nullptr;
+    for (CachedKey& cachedKey: mCachedKeys)
+    {
+        if (cachedKey.cipher && cachedKey.keyId == keyId && cachedKey.key == key)
+        {
+            // key schedule already expanded for this key
+            slot = &cachedKey;
+            break;
+        }
+
+        if (!slot || cachedKey.lastUse < slot->lastUse)
+        {
+            slot = &cachedKey; // least recently used so far
+        }
+    }
+
+    if (!slot->cipher || slot->keyId != keyId || slot->key != key)
+    {
+        if (!slot->cipher)
+        {
+            slot->cipher = createCipher();
+        }
+
+        // GCM requires an IV to set the key, but the actual one is provided for every frame
+        static const byte zeroIv[FRAME_IV_LENGTH] = {};
+        assert(key.size() >= CryptoPP::AES::DEFAULT_KEYLENGTH);
+        slot->cipher->SetKeyWithIV(reinterpret_cast<const byte*>(key.data()), CryptoPP::AES::DEFAULT_KEYLENGTH, zeroIv, FRAME_IV_LENGTH);
+        slot->keyId = keyId;
+        slot->key = key;
+    }
+
+    slot->lastUse = ++mKeyUseCount;
+    mCipher = slot->cipher.get();
 }
 
 void RtcCipher::setTerminating()
@@ -450,12 +481,10 @@ void RtcCipher::setTerminating()
 }
 
 /* frame IV format: <frameIv.12> = <frameCtr.4> <staticIv.8> */
-std::unique_ptr<byte []> RtcCipher::generateFrameIV()
+void RtcCipher::generateFrameIV(byte *iv) const
 {
-    std::unique_ptr<byte []> iv(new byte[FRAME_IV_LENGTH]);
-    memcpy(iv.get(), &mCtr, FRAME_CTR_LENGTH);
-    memcpy(iv.get() + FRAME_CTR_LENGTH, &mIv, FRAME_IV_LENGTH - FRAME_CTR_LENGTH);
-    return iv;
+    memcpy(iv, &mCtr, FRAME_CTR_LENGTH);
+    memcpy(iv + FRAME_CTR_LENGTH, &mIv, FRAME_IV_LENGTH - FRAME_CTR_LENGTH);
 }
 
 MegaEncryptor::MegaEncryptor(const sfu::Peer& peer, std::shared_ptr<::rtcModule::IRtcCryptoMeetings>cryptoMeetings, IvStatic_t iv, uint32_t mid)
@@ -521,7 +550,7 @@ int MegaEncryptor::Encrypt(cricket::MediaType media_type, uint32_t /*ssrc*/, rtc
                              currentKeyId, mPeer.getCid(), mPeer.getPeerid().toString().c_str(), mCtr);
             return kRecoverable;
         }
-        setKey(encryptionKey);
+        setKey(currentKeyId, encryptionKey);
 
         if (!mInitialized)
         {
@@ -530,26 +559,37 @@ int MegaEncryptor::Encrypt(cricket::MediaType media_type, uint32_t /*ssrc*/, rtc
     }
 
     // generate frame iv
-    mega::unique_ptr<byte []> iv = generateFrameIV();
+    byte iv[FRAME_IV_LENGTH];
+    generateFrameIV(iv);
 
     // generate header and store in encrypted_frame
     generateHeader(encrypted_frame.data());
 
-    // encrypt frame and store it in encrypted_frame
-    std::string encryptedFrame;
-    size_t encSize = encrypted_frame.size()-FRAME_HEADER_LENGTH;
-    bool result = mSymCipher.gcm_encrypt_add(frame.data(), frame.size(),
-                                           encrypted_frame.data(), FRAME_HEADER_LENGTH,
-                                           iv.get(), FRAME_IV_LENGTH,
-                                           FRAME_GCM_TAG_LENGTH, encryptedFrame, encSize);
+    // encrypt frame straight into encrypted_frame, followed by the GCM tag
+    bool result = encrypted_frame.size() == FRAME_HEADER_LENGTH + frame.size() + FRAME_GCM_TAG_LENGTH;
+    if (result)
+    {
+        try
+        {
+            mCipher->EncryptAndAuthenticate(encrypted_frame.data() + FRAME_HEADER_LENGTH,
+                                            encrypted_frame.data() + FRAME_HEADER_LENGTH + frame.size(), FRAME_GCM_TAG_LENGTH,
+                                            iv, FRAME_IV_LENGTH,
+                                            encrypted_frame.data(), FRAME_HEADER_LENGTH,
+                                            frame.data(), frame.size());
+        }
+        catch (const CryptoPP::Exception& e)
+        {
+            RTCM_LOG_WARNING("Encrypt: exception: %s", e.what());
+            result = false;
+        }
+    }
 
-    if (!result || encryptedFrame.size() != encSize)
+    if (!result)
     {
         RTCM_LOG_WARNING("Failed gcm_encrypt_aad encryption with additional authenticated data: MyCid: %u, MyPeerId: %s, KeyId: %u, frameCtr: %u",
                          mPeer.getCid(), mPeer.getPeerid().toString().c_str(), mKeyId, mCtr - 1);
         return kRecoverable;
     }
-    memcpy(encrypted_frame.data() + FRAME_HEADER_LENGTH, encryptedFrame.data(), encSize);
 
     // set bytes_written to the number of bytes, written in encrypted_frame
     assert(GetMaxCiphertextByteSize(media_type, frame.size()) == encrypted_frame.size());
@@ -567,6 +607,11 @@ int MegaEncryptor::Encrypt(cricket::MediaType media_type, uint32_t /*ssrc*/, rtc
     return kOk;
 }
 
+std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> MegaEncryptor::createCipher() const
+{
+    return std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher>(new CryptoPP::GCM<CryptoPP::AES>::Encryption());
+}
+
 size_t MegaEncryptor::GetMaxCiphertextByteSize(cricket::MediaType /*media_type*/, size_t frame_size)
 {
     // header size + frame size + GCM authentication tag size
@@ -625,7 +670,7 @@ int MegaDecryptor::validateAndProcessHeader(rtc::ArrayView<const uint8_t> header
         }
 
         mKeyId = auxKeyId;
-        setKey(decryptionKey);
+        setKey(auxKeyId, decryptionKey);
 
         if (!mInitialized)
         {
@@ -668,14 +713,29 @@ webrtc::FrameDecryptorInterface::Result MegaDecryptor::Decrypt(cricket::MediaTyp
     }
 
     // re-build frame iv with staticIv and frame CTR
-    std::unique_ptr<byte []> iv = generateFrameIV();
+    byte iv[FRAME_IV_LENGTH];
+    generateFrameIV(iv);
 
     // decrypt frame and store it in frame
-    if (!mSymCipher.gcm_decrypt_aad(data.data(), static_cast<unsigned int>(data.size()),
-                                     header.data(), FRAME_HEADER_LENGTH,
-                                     gcmTag.data(), FRAME_GCM_TAG_LENGTH,
-                                     iv.get(), FRAME_IV_LENGTH,
-                                     frame.data(), frame.size()))
+    bool result = frame.size() >= data.size();
+    if (result)
+    {
+        try
+        {
+            result = mCipher->DecryptAndVerify(frame.data(),
+                                               gcmTag.data(), FRAME_GCM_TAG_LENGTH,
+                                               iv, FRAME_IV_LENGTH,
+                                               header.data(), FRAME_HEADER_LENGTH,
+                                               data.data(), data.size());
+        }
+        catch (const CryptoPP::Exception& e)
+        {
+            RTCM_LOG_WARNING("Decrypt: exception: %s", e.what());
+            result = false;
+        }
+    }
+
+    if (!result)
     {
         RTCM_LOG_WARNING("Failed gcm_decrypt_aad decryption with additional authenticated data: mid: %u Cid: %u, PeerId: %s, KeyId: %u, frameCtr: %u",
                          mMid, mPeer.getCid(), mPeer.getPeerid().toString().c_str(), mKeyId, mCtr);
@@ -694,6 +754,11 @@ webrtc::FrameDecryptorInterface::Result MegaDecryptor::Decrypt(cricket::MediaTyp
     return Result(Status::kOk, frame.size());
 }
 
+std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> MegaDecryptor::createCipher() const
+{
+    return std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher>(new CryptoPP::GCM<CryptoPP::AES>::Decryption());
+}
+
 size_t MegaDecryptor::GetMaxPlaintextByteSize(cricket::MediaType /*media_type*/, size_t encrypted_frame_size)
 {
     return encrypted_frame_size - FRAME_HEADER_LENGTH - FRAME_GCM_TAG_LENGTH;
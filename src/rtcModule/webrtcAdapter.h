@@ -30,6 +30,9 @@
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
+#include <cryptopp/aes.h>
+#include <cryptopp/gcm.h>
+#include <array>
 #include "sfu.h"
 
 
@@ -320,22 +323,41 @@ public:
     RtcCipher(const sfu::Peer& peer, std::shared_ptr<::rtcModule::IRtcCryptoMeetings> cryptoMeetings, IvStatic_t iv, uint32_t mid);
     virtual ~RtcCipher() {}
 
-    // set a key for SymmCipher
-    void setKey(const std::string &key);
+    // arms the cipher with the key for keyId, reusing its expanded key schedule if it's still cached
+    void setKey(Keyid_t keyId, const std::string &key);
 
-    // generates an IV for a new frame
-    std::unique_ptr<byte []> generateFrameIV();
+    // generates the IV for current frame, iv must be FRAME_IV_LENGTH bytes long
+    void generateFrameIV(byte *iv) const;
 
     void setTerminating();
 
 protected:
-    // symmetric cipher
-    mega::SymmCipher mSymCipher;
+    // max number of keys whose AES-GCM state is kept, so frames from the previous key
+    // that arrive after a key rotation don't require to expand its key schedule again
+    static constexpr size_t kMaxCachedKeys = 4;
+
+    struct CachedKey
+    {
+        Keyid_t keyId = 0;
+        std::string key;
+        std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> cipher;
+        uint64_t lastUse = 0;
+    };
+
+    // creates the AES-GCM cipher (encryption or decryption) used by this object
+    virtual std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> createCipher() const = 0;
+
+    // AES-GCM state for the keys used recently
+    std::array<CachedKey, kMaxCachedKeys> mCachedKeys;
+    uint64_t mKeyUseCount = 0;
+
+    // AES-GCM state for the key currently armed (owned by an element of mCachedKeys)
+    CryptoPP::AuthenticatedSymmetricCipher* mCipher = nullptr;
 
     // sequential number of the packet
     Ctr_t mCtr = 0;
 
-    // keyId of current key armed in SymCipher
+    // keyId of current key armed in mCipher
     Keyid_t mKeyId = 0;
 
     // own peer for encryption, any peer for decryption (ownership belongs to Call, whose lifetime is longer than this object)
@@ -381,6 +403,9 @@ public:
                         size_t* bytes_written) override;
     // returns the encrypted_frame size for a given frame
     size_t GetMaxCiphertextByteSize(cricket::MediaType media_type, size_t frame_size) override;
+
+protected:
+    std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> createCipher() const override;
 };
 
 class MegaDecryptor
@@ -404,6 +429,9 @@ public:
                    rtc::ArrayView<uint8_t> frame) override;
     // returns the plain_frame size for a given encrypted frame
     size_t GetMaxPlaintextByteSize(cricket::MediaType media_type, size_t encrypted_frame_size) override;
+
+protected:
+    std::unique_ptr<CryptoPP::AuthenticatedSymmetricCipher> createCipher() const override;
 };
 
 class LocalStreamHandle
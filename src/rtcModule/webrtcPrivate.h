@@ -5,9 +5,11 @@
 #include <rtcModule/webrtcAdapter.h>
 #include <rtcModule/webrtc.h>
 #include <rtcModule/rtcStats.h>
+#include <rtcModule/audioLevelMeter.h>
 #include <sfu.h>
 #include <IVideoRenderer.h>
 
+#include <atomic>
 #include <map>
 #include <variant>
 
@@ -30,11 +32,20 @@ class AudioLevelMonitor : public webrtc::AudioTrackSinkInterface, public karere:
     bool hasAudio();
     void onAudioDetected(bool audioDetected);
 
+    // smoothed level of the audio received (dBFS), it can be called from any thread
+    int getAudioLevel() const;
+
+    // resets the meter, it must be called while the monitor is not receiving audio data
+    void resetLevel();
+
 private:
-    time_t mPreviousTime = 0;
     Call &mCall;
     bool mAudioDetected = false;
 
+    // only used from the webrtc audio thread (OnData)
+    AudioLevelMeter mMeter;
+    std::atomic<int> mAudioLevel { static_cast<int>(AudioLevelMeter::kSilenceDb) };
+
     // Note that currently max CID allowed by this class is 65535
     int32_t mCid;
     void* mAppCtx;
@@ -94,6 +105,28 @@ private:
     void enableTrack(bool enable, TrackDirection direction);
 };
 
+/** I420 frame delivered to IVideoRenderer, holding a reference to the webrtc buffer */
+class VideoFrameI420 : public IVideoFrameI420
+{
+public:
+    VideoFrameI420(const rtc::scoped_refptr<webrtc::I420BufferInterface>& buffer, webrtc::VideoRotation rotation)
+        : mBuffer(buffer), mRotation(rotation) {}
+    int width() const override { return mBuffer->width(); }
+    int height() const override { return mBuffer->height(); }
+    const uint8_t* dataY() const override { return mBuffer->DataY(); }
+    const uint8_t* dataU() const override { return mBuffer->DataU(); }
+    const uint8_t* dataV() const override { return mBuffer->DataV(); }
+    int strideY() const override { return mBuffer->StrideY(); }
+    int strideU() const override { return mBuffer->StrideU(); }
+    int strideV() const override { return mBuffer->StrideV(); }
+    int rotation() const override { return static_cast<int>(mRotation); }
+    IVideoFrameI420* copy() const override { return new VideoFrameI420(mBuffer, mRotation); }
+
+private:
+    rtc::scoped_refptr<webrtc::I420BufferInterface> mBuffer;
+    webrtc::VideoRotation mRotation;
+};
+
 class VideoSink : public rtc::VideoSinkInterface<webrtc::VideoFrame>, public karere::DeleteTrackable
 {
 public:
@@ -144,6 +177,7 @@ public:
     RemoteAudioSlot(Call& call, rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver, void* appCtx);
     void assignAudioSlot(Cid_t cid, IvStatic_t iv);
     bool enableAudioMonitor(const bool enable);
+    int getAudioLevel() const;
     void createDecryptor(Cid_t cid, IvStatic_t iv) override;
     void release() override;
 
@@ -191,6 +225,7 @@ public:
     SessionState getState() const override;
     karere::AvFlags getAvFlags() const override;
     bool isAudioDetected() const override;
+    int getAudioLevel() const override;
     TermCode getTermcode() const override;
     void setTermcode(TermCode termcode) override;
     void setSessionHandler(SessionHandler* sessionHandler) override;
@@ -359,6 +394,7 @@ public:
     std::set<karere::Id> getSpeakersList () const override;
     std::set<karere::Id> getModerators() const override;
     const std::vector<karere::Id> &getRaiseHandsList() const override;
+    const std::vector<Cid_t>& getActiveSpeakers() const override;
     std::set<karere::Id> getParticipants() const override;
     std::vector<Cid_t> getSessionsCids() const override;
     ISession* getIsession(Cid_t cid) const override;
@@ -554,6 +590,10 @@ protected:
     // users in this list only indicates that he wants to speak
     std::vector<karere::Id> mRaiseHands;
 
+    // client ids of the sessions where voice is detected, ranked by their audio level (loudest first)
+    // it's only updated while audio level monitor is enabled
+    std::vector<Cid_t> mActiveSpeakers;
+
     // list of user handles of all users that have been given speak permission (moderators not included)
     std::set<karere::Id> mSpeakers;
 
@@ -604,6 +644,9 @@ protected:
     // timer to check stats in order to detect local audio level (for remote audio level, audio monitor does it)
     megaHandle mVoiceDetectionTimer = 0;
 
+    // timer to rank the active speakers, while audio level monitor is enabled
+    megaHandle mActiveSpeakersTimer = 0;
+
     // The timestamp of the setted end time for the current call
     mega::m_time_t mCallWillEndTs = mega::mega_invalid_timestamp;
 
@@ -734,6 +777,9 @@ protected:
     void initStatsValues();
     void enableStats();
     void disableStats();
+    void enableActiveSpeakers();
+    void disableActiveSpeakers();
+    void updateActiveSpeakers();
     void adjustSvcByStats();
     void collectNonRTCStats();
     // ask the SFU to get higher/lower (spatial + temporal) quality of HighRes video (thanks to SVC), automatically due to network quality
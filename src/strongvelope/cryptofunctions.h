@@ -129,4 +129,17 @@ static inline std::string aesCTRDecrypt(const std::string& ciphertext,
     return text;
 }
 
+/** Decrypts \c ciphertext straight into \c output, which must have the same data size.
+ * Unlike the std::string version, it doesn't allocate any intermediate buffer */
+static inline void aesCTRDecrypt(const StaticBuffer& ciphertext,
+                            const StaticBuffer& derivedkey, const StaticBuffer& iv, StaticBuffer& output)
+{
+    assert(iv.dataSize() == CryptoPP::AES::BLOCKSIZE);
+    assert(derivedkey.dataSize() == CryptoPP::AES::BLOCKSIZE);
+    assert(output.dataSize() == ciphertext.dataSize());
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption decryptor;
+    decryptor.SetKeyWithIV(derivedkey.ubuf(), derivedkey.dataSize(), iv.ubuf());
+    decryptor.ProcessData(output.ubuf(), ciphertext.ubuf(), ciphertext.dataSize());
+}
+
 }
@@ -0,0 +1,174 @@
+#include "decryptWorkerPool.h"
+
+namespace strongvelope
+{
+DecryptWorkerPool& DecryptWorkerPool::instance()
+{
+    static DecryptWorkerPool pool;
+    return pool;
+}
+
+DecryptWorkerPool::~DecryptWorkerPool()
+{
+    std::lock_guard<std::mutex> configLock(mConfigMutex);
+    stopThreads();
+}
+
+void DecryptWorkerPool::setThreadCount(unsigned count)
+{
+    // mMutex can't be held while the threads are joined, since the workers need it to finish
+    std::lock_guard<std::mutex> configLock(mConfigMutex);
+    if (count == mThreadCount)
+    {
+        return;
+    }
+
+    stopThreads();
+    if (!count)
+    {
+        // jobs already queued must complete, or their messages would never be decrypted
+        std::deque<Job> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            jobs.swap(mJobs);
+            for (auto& job: jobs)
+            {
+                mRunning.insert(job.owner);
+            }
+        }
+        for (auto& job: jobs)
+        {
+            runJob(job);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mThreadCount = count;
+    }
+    for (unsigned i = 0; i < count; i++)
+    {
+        mThreads.emplace_back(&DecryptWorkerPool::workerLoop, this);
+    }
+}
+
+void DecryptWorkerPool::post(const void* owner, std::function<void()>&& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mThreadCount)
+        {
+            mJobs.push_back(Job{owner, std::move(job)});
+            job = nullptr;
+        }
+        else
+        {
+            mRunning.insert(owner);
+        }
+    }
+
+    if (job)
+    {
+        // the pool has been disabled meanwhile
+        Job syncJob{owner, std::move(job)};
+        runJob(syncJob);
+        return;
+    }
+    mCondition.notify_one();
+}
+
+void DecryptWorkerPool::cancel(const void* owner)
+{
+    // released after unlocking, in the calling thread
+    std::vector<Job> released;
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCancelled.insert(owner);
+    for (auto it = mJobs.begin(); it != mJobs.end();)
+    {
+        if (it->owner == owner)
+        {
+            released.push_back(std::move(*it));
+            it = mJobs.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    mJobDone.wait(lock, [this, owner]() { return !mRunning.count(owner); });
+    mCancelled.erase(owner);
+    for (auto it = mRetired.begin(); it != mRetired.end();)
+    {
+        if (it->owner == owner)
+        {
+            released.push_back(std::move(*it));
+            it = mRetired.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    lock.unlock();
+}
+
+bool DecryptWorkerPool::isCancelled(const void* owner)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCancelled.count(owner);
+}
+
+void DecryptWorkerPool::runJob(Job& job)
+{
+    job.run();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRunning.erase(mRunning.find(job.owner));
+    if (mCancelled.count(job.owner))
+    {
+        // the job may still hold data of the owner, which must be released by its thread
+        mRetired.push_back(std::move(job));
+    }
+    mJobDone.notify_all();
+}
+
+void DecryptWorkerPool::stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for (auto& thread: mThreads)
+    {
+        thread.join();
+    }
+    mThreads.clear();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mThreadCount = 0;
+    mStopping = false;
+}
+
+void DecryptWorkerPool::workerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+            if (mStopping)
+            {
+                return;
+            }
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+            mRunning.insert(job.owner);
+        }
+        runJob(job);
+    }
+}
+}
@@ -0,0 +1,98 @@
+#ifndef DECRYPTWORKERPOOL_H
+#define DECRYPTWORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace strongvelope
+{
+/**
+ * @brief Process-wide pool of worker threads for the CPU-bound part of message
+ * decryption (signature verification and payload decryption).
+ *
+ * Jobs must not touch any object owned by the app thread, except through data that
+ * they own (i.e. shared pointers captured by value). Results are passed back to the
+ * app thread by the job itself, via karere::marshallCall(), but only after checking
+ * that its owner has not been cancelled (see isCancelled()).
+ *
+ * Every job belongs to an owner, which must call cancel() before it is destroyed:
+ * afterwards no job of the owner runs or marshals anything to its app context.
+ *
+ * The pool is disabled by default (zero threads), in which case messages are
+ * decrypted synchronously in the app thread.
+ */
+class DecryptWorkerPool
+{
+public:
+    static DecryptWorkerPool& instance();
+
+    /**
+     * @brief Sets the number of worker threads. Zero disables the pool.
+     *
+     * Changing the number of threads waits for the running jobs to finish. Jobs that
+     * are queued but not started yet are kept and run by the new threads, or by the
+     * calling thread if the pool is being disabled. It can be called from any thread:
+     * concurrent calls are serialized.
+     */
+    void setThreadCount(unsigned count);
+    unsigned threadCount() const { return mThreadCount; }
+
+    /** @brief Queues \c job of \c owner to be run by a worker thread. If the pool is
+     * disabled, \c job is run by the calling thread */
+    void post(const void* owner, std::function<void()>&& job);
+
+    /**
+     * @brief Drops the queued jobs of \c owner and waits for its running jobs to finish.
+     *
+     * The jobs that were dropped, or that returned without handing their data back to the
+     * app thread because of the cancellation, are released by the calling thread.
+     */
+    void cancel(const void* owner);
+
+    /** @brief Returns true if cancel() is in progress for \c owner. Jobs must check it
+     * before marshalling their results */
+    bool isCancelled(const void* owner);
+
+    ~DecryptWorkerPool();
+
+protected:
+    struct Job
+    {
+        const void* owner;
+        std::function<void()> run;
+    };
+
+    DecryptWorkerPool() {}
+    void workerLoop();
+    // requires mConfigMutex
+    void stopThreads();
+    // runs a job that has been accounted in mRunning
+    void runJob(Job& job);
+
+    // serializes the changes of the number of threads (protects mThreads)
+    std::mutex mConfigMutex;
+
+    // protects mJobs, mRunning, mCancelled, mRetired and mStopping, and the changes of mThreadCount
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    // signaled every time a job finishes, for cancel()
+    std::condition_variable mJobDone;
+    std::deque<Job> mJobs;
+    // owners of the jobs being run, once per job
+    std::multiset<const void*> mRunning;
+    // owners for which cancel() is in progress
+    std::set<const void*> mCancelled;
+    // jobs that finished while their owner was being cancelled, released by cancel()
+    std::vector<Job> mRetired;
+    std::vector<std::thread> mThreads;
+    std::atomic<unsigned> mThreadCount{0};
+    bool mStopping = false;
+};
+}
+#endif // DECRYPTWORKERPOOL_H
@@ -1,11 +1,13 @@
 set(CHATLIB_STRV_HEADERS
     strongvelope/cryptofunctions.h
+    strongvelope/decryptWorkerPool.h
     strongvelope/strongvelope.h
     strongvelope/tlvstore.h
 )
 
 set(CHATLIB_STRV_SOURCES
     strongvelope/strongvelope.cpp
+    strongvelope/decryptWorkerPool.cpp
 )
 
 target_sources(CHATlib
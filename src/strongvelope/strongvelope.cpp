@@ -21,6 +21,7 @@
 #include <ctime>
 #include "sodium.h"
 #include "tlvstore.h"
+#include "decryptWorkerPool.h"
 #include <userAttrCache.h>
 #include <mega.h>
 #include <megaapi.h>
@@ -107,13 +108,23 @@ EncryptedMessage::EncryptedMessage(const Message& msg, const StaticBuffer& aKey)
  */
 void ParsedMessage::symmetricDecrypt(const StaticBuffer& key, Message& outMsg)
 {
+    if (!payload.empty())
+    {
+        Id chatid = mProtoHandler.chatid;   // for the log below
+        STRONGVELOPE_LOG_DEBUG("Decrypting msg %s", outMsg.id().toString().c_str());
+    }
+    Buffer cleartext(0);
+    decryptPayload(key, cleartext);
+    setDecryptedPayload(cleartext, outMsg);
+}
+
+void ParsedMessage::decryptPayload(const StaticBuffer& key, Buffer& cleartext) const
+{
+    cleartext.clear();
     if (payload.empty())
     {
-        outMsg.clear();
         return;
     }
-    Id chatid = mProtoHandler.chatid;   // for the log below
-    STRONGVELOPE_LOG_DEBUG("Decrypting msg %s", outMsg.id().toString().c_str());
     Key<32> derivedNonce;
     // deriveNonceSecret() needs at least 32 bytes output buffer
     deriveNonceSecret(nonce, derivedNonce);
@@ -121,12 +132,31 @@ void ParsedMessage::symmetricDecrypt(const StaticBuffer& key, Message& outMsg)
     // For AES CRT mode, we take the first 12 bytes as the nonce,
     // and the remaining 4 bytes as the counter, which is initialized to zero
     *reinterpret_cast<uint32_t*>(derivedNonce.buf()+SVCRYPTO_NONCE_SIZE) = 0;
-    std::string cleartext = aesCTRDecrypt(std::string(payload.buf(), payload.dataSize()),
-        key, derivedNonce);
-    parsePayload(StaticBuffer(cleartext, false), outMsg);
+    cleartext.writePtr(0, payload.dataSize());
+    aesCTRDecrypt(payload, key, derivedNonce, cleartext);
+}
+
+void ParsedMessage::setDecryptedPayload(const StaticBuffer& cleartext, Message& outMsg)
+{
+    if (payload.empty())
+    {
+        outMsg.clear();
+        return;
+    }
+    parsePayload(cleartext, outMsg);
     outMsg.setEncrypted(Message::kNotEncrypted);
 }
 
+void DecryptJob::run()
+{
+    if (verifySignature && !parsedMsg->verifySignature(edKey, sendKey))
+    {
+        signatureValid = false;
+        return;
+    }
+    parsedMsg->decryptPayload(sendKey, cleartext);
+}
+
 /**
  * Derive the nonce to use for an encryption for a particular recipient
  * or message payload encryption.
@@ -222,6 +252,7 @@ void deriveSharedKey(const StaticBuffer& sharedSecret, SendKey& output, const st
 
 ParsedMessage::ParsedMessage(const Message& binaryMessage, ProtocolHandler& protoHandler)
 : mProtoHandler(protoHandler)
+, mRaw(binaryMessage.buf(), binaryMessage.dataSize())
 {
     if(binaryMessage.empty())
     {
@@ -247,19 +278,24 @@ ParsedMessage::ParsedMessage(const Message& binaryMessage, ProtocolHandler& prot
         callEndedInfo.reset(new chatd::Message::CallEndedInfo());
     }
 
-    TlvParser tlv(binaryMessage, offset);
-    TlvRecord record(binaryMessage);
+    TlvParser tlv(mRaw, offset);
+    TlvRecord record(mRaw);
+    // the names of the records are only needed for the debug log below
+    bool logRecordNames = (krLogLevelDebug <= krLoggerChannels[krLogChannel_strongvelope].logLevel);
     std::string recordNames;
     while (tlv.getRecord(record))
     {
-        recordNames.append(tlvTypeToString(record.type))+=", ";
+        if (logRecordNames)
+        {
+            recordNames.append(tlvTypeToString(record.type))+=", ";
+        }
         switch (record.type)
         {
             case TLV_TYPE_SIGNATURE:
             {
                 signature.assign(record.buf(), record.dataLen);
                 auto nextOffset = record.dataOffset+record.dataLen;
-                signedContent.assign(binaryMessage.buf()+nextOffset, binaryMessage.dataSize()-nextOffset);
+                signedContent.assign(mRaw.buf()+nextOffset, mRaw.dataSize()-nextOffset);
                 break;
             }
             case TLV_TYPE_NONCE:
@@ -376,7 +412,7 @@ ParsedMessage::ParsedMessage(const Message& binaryMessage, ProtocolHandler& prot
             //===
             case TLV_TYPE_PAYLOAD:
             {
-                payload.assign(binaryMessage.buf()+record.dataOffset, record.dataLen);
+                payload.assign(record.buf(), record.dataLen);
                 break;
             }
             case TLV_TYPE_OPENMODE:
@@ -604,6 +640,12 @@ ProtocolHandler::ProtocolHandler(const karere::Id& ownHandle,
     }
 }
 
+ProtocolHandler::~ProtocolHandler()
+{
+    // no job of this handler can be running or marshalling to appCtx once it's gone
+    DecryptWorkerPool::instance().cancel(this);
+}
+
 std::shared_ptr<Buffer>
 ProtocolHandler::reactionEncrypt(const Message &msg, const std::string &reaction)
 {
@@ -1058,6 +1100,8 @@ ProtocolHandler::msgEncrypt(Message* msg, const SetOfIds &recipients, MsgCommand
 void ProtocolHandler::onHistoryReload()
 {
     mCacheVersion++;
+    mDecryptJobs.clear();
+    mDecryptBatch.clear();
 }
 
 promise::Promise<Message*> ProtocolHandler::handleManagementMessage(
@@ -1171,6 +1215,20 @@ Promise<Message*> ProtocolHandler::msgDecrypt(Message* message)
             return Promise<Message*>(message);
         }
 
+        // message may have been already posted to the worker pool by msgDecryptPrefetch()
+        auto jobIt = mDecryptJobs.find(message->id());
+        if (jobIt != mDecryptJobs.end())
+        {
+            std::shared_ptr<DecryptJob> job = jobIt->second;
+            mDecryptJobs.erase(jobIt);
+            msgDecryptFlush();  // the job might not have been posted yet
+            if (job->parsedMsg->mRaw.dataEquals(*message)) // discard it if message was edited meanwhile
+            {
+                message->type = job->parsedMsg->type;
+                return completeDecryptJob(job, message);
+            }
+        }
+
         // Get type
         auto parsedMsg = std::make_shared<ParsedMessage>(*message, *this);
         message->type = parsedMsg->type;
@@ -1245,6 +1303,13 @@ Promise<Message*> ProtocolHandler::msgDecrypt(Message* message)
                 return ::promise::Error("msgDecrypt: history was reloaded, ignore message", EINVAL, SVCRYPTO_ENOMSG);
             }
 
+            if (DecryptWorkerPool::instance().threadCount())
+            {
+                auto job = createDecryptJob(parsedMsg, *ctx->sendKey, ctx->edKey);
+                postDecryptJobs({job});
+                return completeDecryptJob(job, message);
+            }
+
             if (!isPublicChat())
             {
                 if (!parsedMsg->verifySignature(ctx->edKey, *ctx->sendKey))
@@ -1267,6 +1332,157 @@ Promise<Message*> ProtocolHandler::msgDecrypt(Message* message)
     }
 }
 
+void ProtocolHandler::msgDecryptPrefetch(const Message& message)
+{
+    if (!DecryptWorkerPool::instance().threadCount()
+            || message.empty()
+            || message.userid == karere::Id::COMMANDER()
+            || mDecryptJobs.size() >= kMaxDecryptJobs
+            || mDecryptJobs.find(message.id()) != mDecryptJobs.end())
+    {
+        return;
+    }
+
+    // only messages whose keys are already available are prefetched, msgDecrypt() handles the rest
+    std::shared_ptr<SendKey> sendKey;
+    if (message.keyid == CHATD_KEYID_INVALID)
+    {
+        if (!mHasUnifiedKey || !mUnifiedKeyDecrypted.succeeded())
+        {
+            return;
+        }
+        sendKey = mUnifiedKeyDecrypted.value();
+    }
+    else
+    {
+        auto kit = mKeys.find(UserKeyId(message.userid, message.keyid));
+        if (kit == mKeys.end() || !kit->second.key)
+        {
+            return;
+        }
+        sendKey = kit->second.key;
+    }
+
+    std::shared_ptr<ParsedMessage> parsedMsg;
+    try
+    {
+        parsedMsg = std::make_shared<ParsedMessage>(message, *this);
+    }
+    catch(std::runtime_error&)
+    {
+        return; // msgDecrypt() will report the error
+    }
+
+    if (parsedMsg->type >= Message::kMsgManagementLowest && parsedMsg->type <= Message::kMsgManagementHighest)
+    {
+        return;
+    }
+
+    // the signing key is the sender's, as in msgDecrypt(): it may differ from message.userid (TLV_TYPE_INVITOR)
+    EcKey edKey;
+    if (!isPublicChat())
+    {
+        const Buffer* key = mUserAttrCache.getDataFromCache(parsedMsg->sender, ::mega::MegaApi::USER_ATTR_ED25519_PUBLIC_KEY);
+        if (!key || key->dataSize() != edKey.dataSize())
+        {
+            return;
+        }
+        edKey.assign(key->buf(), key->dataSize());
+    }
+
+    auto job = createDecryptJob(parsedMsg, *sendKey, edKey);
+    mDecryptJobs[message.id()] = job;
+    mDecryptBatch.push_back(job);
+    if (mDecryptBatch.size() >= kDecryptBatchSize)
+    {
+        msgDecryptFlush();
+    }
+}
+
+void ProtocolHandler::msgDecryptFlush()
+{
+    if (mDecryptBatch.empty())
+    {
+        return;
+    }
+
+    std::vector<std::shared_ptr<DecryptJob>> jobs;
+    jobs.swap(mDecryptBatch);
+    postDecryptJobs(std::move(jobs));
+}
+
+std::shared_ptr<DecryptJob> ProtocolHandler::createDecryptJob(const std::shared_ptr<ParsedMessage>& parsedMsg,
+    const SendKey& sendKey, const EcKey& edKey)
+{
+    auto job = std::make_shared<DecryptJob>();
+    job->parsedMsg = parsedMsg;
+    job->sendKey.assign(sendKey.buf(), sendKey.dataSize());
+    job->edKey.assign(edKey.buf(), edKey.dataSize());
+    job->verifySignature = !isPublicChat();
+    return job;
+}
+
+void ProtocolHandler::postDecryptJobs(std::vector<std::shared_ptr<DecryptJob>>&& jobs)
+{
+    auto batch = std::make_shared<std::vector<std::shared_ptr<DecryptJob>>>(std::move(jobs));
+    void* ctx = appCtx;
+    const void* owner = this;
+    DecryptWorkerPool::instance().post(owner, [batch, ctx, owner]() mutable
+    {
+        // Signatures are verified one by one, not with a batch equation: libsodium has no
+        // multi-scalar multiplication, and a batch verifier built from its primitives is about
+        // 2x slower than crypto_sign_verify_detached() (see tests/sig_verify_bench)
+        for (auto& job: *batch)
+        {
+            job->run();
+        }
+
+        if (DecryptWorkerPool::instance().isCancelled(owner))
+        {
+            // the handler is being destroyed, and ctx may be gone soon after it. The pool
+            // releases the batch in the thread of the handler
+            return;
+        }
+
+        // move the reference, so the jobs are always released in the app thread
+        karere::marshallCall([batch = std::move(batch)]()
+        {
+            for (auto& job: *batch)
+            {
+                job->completed.resolve();
+            }
+        }, ctx);
+    });
+}
+
+Promise<Message*> ProtocolHandler::completeDecryptJob(const std::shared_ptr<DecryptJob>& job, Message* message)
+{
+    unsigned int cacheVersion = mCacheVersion;
+    auto wptr = weakHandle();
+    return job->completed
+    .then([this, wptr, job, message, cacheVersion]() -> promise::Promise<Message*>
+    {
+        if (wptr.deleted())
+        {
+            return ::promise::Error("msgDecrypt: strongvelop deleted, ignore message", EINVAL, SVCRYPTO_EEXPIRED);
+        }
+
+        if (cacheVersion != mCacheVersion)
+        {
+            return ::promise::Error("msgDecrypt: history was reloaded, ignore message", EINVAL, SVCRYPTO_ENOMSG);
+        }
+
+        if (!job->signatureValid)
+        {
+            return ::promise::Error("Signature invalid for message "+
+                                  message->id().toString(), EINVAL, SVCRYPTO_ESIGNATURE);
+        }
+
+        job->parsedMsg->setDecryptedPayload(job->cleartext, *message);
+        return message;
+    });
+}
+
 void ProtocolHandler::onKeyReceived(KeyId keyid, Id sender, Id receiver,
                                     const char* data, uint16_t dataLen, bool isEncrypted)
 {
@@ -164,12 +164,15 @@ class ProtocolHandler;
 struct ParsedMessage: public karere::DeleteTrackable
 {
     ProtocolHandler& mProtoHandler;
+    /** Single copy of the binary message. The payload, signed content and signature
+     * are slices of it, so they are not copied again while parsing */
+    Buffer mRaw;
     uint8_t protocolVersion;
     karere::Id sender;
     Key<32> nonce;
-    Buffer payload;
-    Buffer signedContent;
-    Buffer signature;
+    StaticBuffer payload = StaticBuffer(nullptr, 0);
+    StaticBuffer signedContent = StaticBuffer(nullptr, 0);
+    StaticBuffer signature = StaticBuffer(nullptr, 0);
     unsigned char type;
     karere::Id mActionId;
 
@@ -179,19 +182,45 @@ struct ParsedMessage: public karere::DeleteTrackable
 
     uint32_t keyId;
     uint32_t prevKeyId;
-    Buffer encryptedKey; //may contain also the prev key, concatenated
+    Buffer encryptedKey = Buffer(0); //may contain also the prev key, concatenated
 
     std::unique_ptr<chatd::Message::ManagementInfo> managementInfo;
     std::unique_ptr<chatd::Message::CallEndedInfo> callEndedInfo;
 
     ParsedMessage(const chatd::Message& src, ProtocolHandler& protoHandler);
+    // the slices would point to the buffers of the original
+    ParsedMessage(const ParsedMessage&) = delete;
+    ParsedMessage& operator=(const ParsedMessage&) = delete;
     bool verifySignature(const StaticBuffer& pubKey, const SendKey& sendKey);
     void parsePayload(const StaticBuffer& data, chatd::Message& msg);
     void parsePayloadWithUtfBackrefs(const StaticBuffer& data, chatd::Message& msg);
     void symmetricDecrypt(const StaticBuffer& key, chatd::Message& outMsg);
+    /** Decrypts the payload into \c cleartext. It doesn't access anything but this
+     * object, so it can be run by a worker thread */
+    void decryptPayload(const StaticBuffer& key, Buffer& cleartext) const;
+    /** Sets the content of \c outMsg from the decrypted payload */
+    void setDecryptedPayload(const StaticBuffer& cleartext, chatd::Message& outMsg);
     promise::Promise<chatd::Message*> decryptChatTitle(chatd::Message* msg, bool msgCanBeDeleted);
 };
 
+/** Signature verification and decryption of a message, run by the DecryptWorkerPool.
+ * The worker thread only writes the results, and the app thread reads them once
+ * \c completed has been resolved */
+struct DecryptJob
+{
+    std::shared_ptr<ParsedMessage> parsedMsg;
+    SendKey sendKey;
+    EcKey edKey;
+    bool verifySignature = false;
+
+    // results
+    bool signatureValid = true;
+    Buffer cleartext = Buffer(0);
+
+    promise::Promise<void> completed;
+    void run();
+};
+
 
 enum
 {
@@ -322,6 +351,13 @@ protected:
     promise::Promise<std::shared_ptr<UnifiedKey>> mUnifiedKeyDecrypted;
     bool mHasUnifiedKey; // indicates if chat has unified key (although it's pending to be decrypted)
 
+    // jobs started by msgDecryptPrefetch(), not yet requested by msgDecrypt()
+    std::map<karere::Id, std::shared_ptr<DecryptJob>> mDecryptJobs;
+    static constexpr size_t kMaxDecryptJobs = 256;
+    // prefetched jobs not posted yet, they are posted together as a single worker task
+    std::vector<std::shared_ptr<DecryptJob>> mDecryptBatch;
+    static constexpr size_t kDecryptBatchSize = 32;
+
 public:
     karere::Id chatid;
     karere::Id mPh = karere::Id::inval();     // it's only valid during preview mode (required to fetch user-attributes)
@@ -333,6 +369,7 @@ public:
         karere::UserAttrCache& userAttrCache,
         SqliteDb& db, const karere::Id& aChatId, bool isPublic, std::shared_ptr<std::string> unifiedKey,
         int isUnifiedKeyEncrypted, const karere::Id& ph, void *ctx);
+    ~ProtocolHandler() override;
 
     promise::Promise<std::shared_ptr<SendKey>> //must be public to access from ParsedMessage
         decryptKey(std::shared_ptr<Buffer>& key, const karere::Id& sender, const karere::Id& receiver);
@@ -395,6 +432,16 @@ protected:
     promise::Promise<chatd::Message*> handleManagementMessage(
         const std::shared_ptr<ParsedMessage>& parsedMsg, chatd::Message* msg);
 
+    std::shared_ptr<DecryptJob> createDecryptJob(const std::shared_ptr<ParsedMessage>& parsedMsg,
+        const SendKey& sendKey, const EcKey& edKey);
+
+    /** Posts \c jobs to the DecryptWorkerPool as a single task. All of them are
+     * completed at once, with a single call marshalled back to the app thread */
+    void postDecryptJobs(std::vector<std::shared_ptr<DecryptJob>>&& jobs);
+
+    /** Returns a promise resolved once \c job has completed and its result has been set in \c msg */
+    promise::Promise<chatd::Message*> completeDecryptJob(const std::shared_ptr<DecryptJob>& job, chatd::Message* msg);
+
     /**
      * @brief Getter method to local static variable for temporal.
      *
@@ -407,6 +454,8 @@ public:
     promise::Promise<std::pair<chatd::MsgCommand*, chatd::KeyCommand*>>
     msgEncrypt(chatd::Message *message, const karere::SetOfIds &recipients, chatd::MsgCommand* msgCmd) override;
     promise::Promise<chatd::Message*> msgDecrypt(chatd::Message* message) override;
+    void msgDecryptPrefetch(const chatd::Message& message) override;
+    void msgDecryptFlush() override;
     void onKeyReceived(chatd::KeyId keyid, karere::Id sender,
         karere::Id receiver, const char* data, uint16_t dataLen, bool isEncrypted) override;
     void onKeyConfirmed(chatd::KeyId localkeyid, chatd::KeyId keyid) override;
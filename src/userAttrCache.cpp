@@ -90,6 +90,10 @@ Buffer* getDataNotImpl(const ::mega::MegaRequest& /*req*/)
 
 UserAttrCache::~UserAttrCache()
 {
+    if (mFetchTimer)
+    {
+        cancelTimeout(mFetchTimer, mClient.appCtx);
+    }
     mClient.api.sdk.removeGlobalListener(this);
 }
 
@@ -199,8 +203,13 @@ UserAttrCache::UserAttrCache(Client& aClient): mClient(aClient)
         std::unique_ptr<Buffer> data(new Buffer((size_t)sqlite3_column_bytes(stmt, 2)));
         stmt.blobCol(2, *data);
         UserAttrPair key(stmt.integralCol<uint64_t>(0), stmt.integralCol<uint8_t>(1));
-        emplace(std::make_pair(key, std::make_shared<UserAttrCacheItem>(
-                *this, data.release(), kCacheFetchNotPending)));
+        auto item = std::make_shared<UserAttrCacheItem>(*this, data.release(), kCacheFetchNotPending);
+        if (sqlite3_column_type(stmt, 2) == SQLITE_NULL)
+        {
+            // the time it was not found is not persisted, wait a full TTL from now
+            item->notFoundTs = time(NULL);
+        }
+        emplace(std::make_pair(key, item));
 //        UACACHE_LOG_DEBUG("loaded attr %s", key.toString().c_str());
     }
     UACACHE_LOG_DEBUG("loaded %zu entries from db", size());
@@ -299,6 +308,7 @@ void UserAttrCacheItem::notify()
 void UserAttrCacheItem::resolve(UserAttrPair key)
 {
     pending = kCacheFetchNotPending;
+    notFoundTs = 0;
     UACACHE_LOG_DEBUG("Attr %s fetched, writing to db and doing callbacks...", key.toString().c_str());
     parent.dbWrite(key, *data);
     notify();
@@ -306,6 +316,7 @@ void UserAttrCacheItem::resolve(UserAttrPair key)
 void UserAttrCacheItem::resolveNoDb(UserAttrPair key)
 {
     pending = kCacheFetchNotPending;
+    notFoundTs = 0;
     UACACHE_LOG_DEBUG("Attr %s fetched but not writing to db, doing callbacks...", key.toString().c_str());
     notify();
 }
@@ -313,6 +324,7 @@ void UserAttrCacheItem::error(UserAttrPair key, int errCode)
 {
     pending = kCacheFetchNotPending;
     data.reset();
+    notFoundTs = (errCode == ::mega::API_ENOENT) ? time(NULL) : 0;
     if (errCode == ::mega::API_ENOENT)
     {
         parent.dbWriteNull(key);
@@ -393,6 +405,18 @@ UserAttrCache::Handle UserAttrCache::getAttr(uint64_t userHandle, unsigned type,
     auto it = find(key);
     if (it != end())
     {
+        auto& cached = *it->second;
+        if (fetch && cached.pending == kCacheFetchNotPending && cached.notFoundTs
+                && time(NULL) - cached.notFoundTs >= kNotFoundTtl)
+        {
+            // the attribute didn't exist a while ago, it may exist now
+            UACACHE_LOG_DEBUG("Attr %s not found on server %ld seconds ago, fetching again",
+                key.toString().c_str(), static_cast<long>(time(NULL) - cached.notFoundTs));
+            cached.notFoundTs = 0;
+            cached.pending = kCacheFetchNewPending;
+            fetchAttr(key, it->second);
+        }
+
         if (cb)
         {
             auto& item = *it->second;
@@ -467,6 +491,87 @@ void UserAttrCache::fetchAttr(UserAttrPair key, std::shared_ptr<UserAttrCacheIte
 }
 void UserAttrCache::fetchStandardAttr(UserAttrPair key, std::shared_ptr<UserAttrCacheItem>& item)
 {
+    auto inFlight = mFetchesInFlight.find(key);
+    if (inFlight != mFetchesInFlight.end())
+    {
+        // the result in flight may be outdated, fetch it again when it arrives
+        UACACHE_LOG_DEBUG("Attr %s already being fetched, will fetch it again upon completion", key.toString().c_str());
+        inFlight->second = true;
+        return;
+    }
+
+    // collect the attributes requested within kFetchBatchDelay, so their requests reach the
+    // SDK together and it can send them to the API in the same batch of commands
+    mFetchQueue[key] = item;
+    if (!mFetchTimer)
+    {
+        auto wptr = weakHandle();
+        mFetchTimer = setTimeout([this, wptr]()
+        {
+            if (wptr.deleted())
+                return;
+
+            mFetchTimer = 0;
+            flushFetchQueue();
+        }, kFetchBatchDelay, mClient.appCtx);
+    }
+}
+
+void UserAttrCache::flushFetchQueue()
+{
+    std::map<UserAttrPair, std::shared_ptr<UserAttrCacheItem>> queue;
+    queue.swap(mFetchQueue);
+    if (!mIsLoggedIn && !mClient.anonymousMode())
+    {
+        // still pending, they will be fetched by onLogin()
+        return;
+    }
+
+    size_t users = 0;
+    Id lastUser = Id::inval();
+    for (auto& it: queue)
+    {
+        if (it.first.user.val != lastUser.val)
+        {
+            lastUser = it.first.user;
+            users++;
+        }
+        requestStandardAttr(it.first, it.second);
+    }
+    UACACHE_LOG_DEBUG("Requested %zu attributes of %zu users", queue.size(), users);
+}
+
+bool UserAttrCache::onStandardAttrFetched(UserAttrPair key)
+{
+    auto it = mFetchesInFlight.find(key);
+    if (it == mFetchesInFlight.end())
+    {
+        return false;
+    }
+
+    bool refetch = it->second;
+    mFetchesInFlight.erase(it);
+    return refetch;
+}
+
+void UserAttrCache::refetchAttr(UserAttrPair key)
+{
+    auto it = find(key);
+    if (it == end() || it->second->pending == kCacheNotFetchUntilUse)
+    {
+        return;
+    }
+
+    if (it->second->pending == kCacheFetchNotPending)
+    {
+        it->second->pending = kCacheFetchUpdatePending;
+    }
+    fetchAttr(it->first, it->second);
+}
+
+void UserAttrCache::requestStandardAttr(UserAttrPair key, std::shared_ptr<UserAttrCacheItem> item)
+{
+    mFetchesInFlight[key] = false;
     auto wptr = weakHandle();
 
     // We need to create an aux var to store ph in heap instead of stack in order to avoid stack-use-after-scope
@@ -475,17 +580,27 @@ void UserAttrCache::fetchStandardAttr(UserAttrPair key, std::shared_ptr<UserAttr
 
     mClient.api.call(&::mega::MegaApi::getChatUserAttribute,
         key.user.toString().c_str(), (int)key.attrType, ph)
-    .then([wptr, key, item](ReqResult result)
+    .then([this, wptr, key, item](ReqResult result)
     {
         wptr.throwIfDeleted();
+        bool refetch = onStandardAttrFetched(key);
         auto& desc = gUserAttrDescsMap.at(key.attrType);
         item->data.reset(desc.getData(*result));
         item->resolve(key);
+        if (refetch)
+        {
+            refetchAttr(key);
+        }
     })
-    .fail([wptr, key, item](const ::promise::Error& err)
+    .fail([this, wptr, key, item](const ::promise::Error& err)
     {
         wptr.throwIfDeleted();
+        bool refetch = onStandardAttrFetched(key);
         item->error(key, err.code());
+        if (refetch)
+        {
+            refetchAttr(key);
+        }
         return err;
     });
 }
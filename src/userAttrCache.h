@@ -6,6 +6,7 @@
 #include <list>
 #include "base/promise.h"
 #include <base/trackDelete.h>
+#include <base/timers.hpp>
 
 #define UACACHE_LOG_DEBUG(fmtString,...) KARERE_LOG_DEBUG(krLogChannel_uacache, fmtString, ##__VA_ARGS__)
 #define UACACHE_LOG_WARNING(fmtString,...) KARERE_LOG_WARNING(krLogChannel_uacache, fmtString, ##__VA_ARGS__)
@@ -110,6 +111,8 @@ struct UserAttrCacheItem
     std::unique_ptr<Buffer> data;
     std::list<UserAttrReqCb> cbs;
     unsigned char pending;
+    /** When the attribute was last reported as not existing (ENOENT) by the API, zero otherwise */
+    time_t notFoundTs = 0;
     UserAttrCacheItem(UserAttrCache& aParent ,Buffer* buf, unsigned char aPending)
         : parent(aParent), data(buf), pending(aPending){}
     UserAttrReqCb::WeakRefHandle addCb(UserAttrReqCbFunc cb, void* userp, bool oneShot=false);
@@ -126,8 +129,24 @@ class UserAttrCache: public std::map<UserAttrPair, std::shared_ptr<UserAttrCache
                      public ::mega::MegaGlobalListener, public karere::DeleteTrackable
 {
 protected:
+    enum
+    {
+        kFetchBatchDelay = 20,  /// Time to collect attributes to fetch before requesting them together (ms)
+        kNotFoundTtl = 3600     /// Time before an attribute that didn't exist is fetched again (s)
+    };
+
     Client& mClient;
     bool mIsLoggedIn = false;
+
+    /** Standard attributes waiting to be requested, sorted by user (see fetchStandardAttr()) */
+    std::map<UserAttrPair, std::shared_ptr<UserAttrCacheItem>> mFetchQueue;
+
+    /** Standard attributes requested to the SDK (key), and whether they must be fetched again upon completion (value) */
+    std::map<UserAttrPair, bool> mFetchesInFlight;
+
+    /** Handler of the timer that flushes mFetchQueue */
+    megaHandle mFetchTimer = 0;
+
     void dbWrite(UserAttrPair key, const Buffer& data);
     void dbWriteNull(UserAttrPair key);
     void dbInvalidateItem(UserAttrPair item);
@@ -138,6 +157,10 @@ protected:
     void fetchStandardAttr(UserAttrPair key, std::shared_ptr<UserAttrCacheItem>& item);
     void fetchEmail(UserAttrPair key, std::shared_ptr<UserAttrCacheItem>& item);
 //==
+    void flushFetchQueue();
+    void requestStandardAttr(UserAttrPair key, std::shared_ptr<UserAttrCacheItem> item);
+    bool onStandardAttrFetched(UserAttrPair key);
+    void refetchAttr(UserAttrPair key);
     void onUserAttrChange(uint64_t userid, uint64_t changed);
     void onUserAttrChange(::mega::MegaUser& user);
     void onLogin();
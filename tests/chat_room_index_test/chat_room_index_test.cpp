@@ -0,0 +1,345 @@
+/**
+ * @file chat_room_index_test.cpp
+ * @brief Differential test of karere::ChatRoomIndex against the scans of the chat list it replaced.
+ *
+ * A random set of rooms is added to the index, updated and removed, and after every few
+ * changes the index is queried with every combination of the mask and filter of
+ * MegaChatApi::getChatListItems(), every chat type of getChatListItemsByType(), the fixed
+ * filters of getActive/Inactive/Archived/UnreadChatListItems() and getUnreadChats(), and
+ * some peer lists of getChatListItemsByPeers(). For each query, the rooms selected by
+ * ChatRoomIndex::select() (also paginated), count() and selectByPeers() must be the ones
+ * that the previous implementation selected by checking every room, in last-activity order.
+ *
+ * Usage: megachat_chat_room_index_test [seed]
+ */
+
+#include "megachatapi_impl.h"
+#include "chatRoomIndex.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using megachat::MegaChatApi;
+using megachat::MegaChatApiImpl;
+using karere::ChatRoomIndex;
+
+namespace
+{
+int gFailures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; gFailures++; } } while (0)
+
+// the properties of a room that the chat list filters use
+struct Room
+{
+    uint64_t chatid = 0;
+    bool group = false;
+    bool publicChat = false;
+    bool meeting = false;
+    bool archived = false;
+    bool active = true;
+    bool unread = false;
+    bool preview = false;
+    int64_t lastTs = 0;
+    std::vector<uint64_t> peers;    // sorted
+};
+
+ChatRoomIndex::Entry entryOf(const Room& room)
+{
+    ChatRoomIndex::Entry entry;
+    entry.flags = static_cast<uint8_t>((room.group ? ChatRoomIndex::kGroup : 0)
+            | (room.publicChat ? ChatRoomIndex::kPublic : 0)
+            | (room.meeting ? ChatRoomIndex::kMeeting : 0)
+            | (room.archived ? ChatRoomIndex::kArchived : 0)
+            | (room.active ? ChatRoomIndex::kActive : 0)
+            | (room.unread ? ChatRoomIndex::kUnread : 0)
+            | (room.preview ? ChatRoomIndex::kPreview : 0));
+    entry.lastTs = room.lastTs;
+    entry.peers = room.peers;
+    return entry;
+}
+
+// MegaChatApiImpl::isChatroomFromType() before the index
+bool isChatroomFromType(const Room& room, int type)
+{
+    switch (type)
+    {
+        case MegaChatApi::CHAT_TYPE_ALL:            return true;
+        case MegaChatApi::CHAT_TYPE_INDIVIDUAL:     return !room.group;
+        case MegaChatApi::CHAT_TYPE_GROUP:          return room.group && !room.meeting;
+        case MegaChatApi::CHAT_TYPE_GROUP_PRIVATE:  return room.group && !room.publicChat;
+        case MegaChatApi::CHAT_TYPE_GROUP_PUBLIC:   return room.group && room.publicChat && !room.meeting;
+        case MegaChatApi::CHAT_TYPE_MEETING_ROOM:   return room.meeting;
+        case MegaChatApi::CHAT_TYPE_NON_MEETING:    return !room.meeting;
+    }
+    return false;
+}
+
+// filter of MegaChatApiImpl::getChatListItems(mask, filter) before the index
+bool passFilter(const Room& room, int mask, int filter)
+{
+    std::bitset<6> bsMask(static_cast<unsigned long long>(mask));
+    std::bitset<6> bsFilter(static_cast<unsigned long long>(filter));
+    if (bsMask[0] && !isChatroomFromType(room, bsFilter[0] ? MegaChatApi::CHAT_TYPE_INDIVIDUAL : MegaChatApi::CHAT_TYPE_GROUP))
+    {
+        return false;
+    }
+    if (bsMask[1] && !isChatroomFromType(room, bsFilter[1] ? MegaChatApi::CHAT_TYPE_GROUP_PUBLIC : MegaChatApi::CHAT_TYPE_GROUP_PRIVATE))
+    {
+        return false;
+    }
+    if (bsMask[2] && !isChatroomFromType(room, bsFilter[2] ? MegaChatApi::CHAT_TYPE_MEETING_ROOM : MegaChatApi::CHAT_TYPE_NON_MEETING))
+    {
+        return false;
+    }
+    if (bsMask[3] && bsFilter[3] != room.archived)
+    {
+        return false;
+    }
+    if (bsMask[4] && bsFilter[4] != room.active)
+    {
+        return false;
+    }
+    if (bsMask[5] && bsFilter[5] == room.unread)
+    {
+        return false;
+    }
+    return true;
+}
+
+// filter of MegaChatApiImpl::getChatListItemsByPeers() before the index
+bool hasPeers(const Room& room, const std::vector<uint64_t>& peers)
+{
+    if (!room.group)
+    {
+        return peers.size() == 1 && room.peers.front() == peers.front();
+    }
+    if (room.peers.size() != peers.size())
+    {
+        return false;
+    }
+    return std::all_of(peers.begin(), peers.end(), [&room](uint64_t peer)
+    {
+        return std::find(room.peers.begin(), room.peers.end(), peer) != room.peers.end();
+    });
+}
+
+template <class F>
+std::vector<uint64_t> scan(const std::map<uint64_t, Room>& rooms, F&& pass)
+{
+    std::vector<const Room*> selected;
+    for (const auto& it: rooms)
+    {
+        if (pass(it.second))
+        {
+            selected.push_back(&it.second);
+        }
+    }
+
+    // most recent first, as ChatRoomIndex
+    std::sort(selected.begin(), selected.end(), [](const Room* a, const Room* b)
+    {
+        return (a->lastTs != b->lastTs) ? (a->lastTs > b->lastTs) : (a->chatid > b->chatid);
+    });
+
+    std::vector<uint64_t> chatids;
+    for (const Room* room: selected)
+    {
+        chatids.push_back(room->chatid);
+    }
+    return chatids;
+}
+
+void checkSelect(const ChatRoomIndex& index, uint8_t flagsMask, uint8_t flagsValue, const std::vector<uint64_t>& expected)
+{
+    CHECK(index.select(flagsMask, flagsValue) == expected);
+    CHECK(index.count(flagsMask, flagsValue) == expected.size());
+
+    // a few pages, including one past the end
+    for (size_t offset: {size_t(0), size_t(1), expected.size() / 2, expected.size()})
+    {
+        for (size_t count: {size_t(1), size_t(7)})
+        {
+            std::vector<uint64_t> page = index.select(flagsMask, flagsValue, offset, count);
+            size_t first = std::min(offset, expected.size());
+            size_t last = std::min(offset + count, expected.size());
+            CHECK(page == std::vector<uint64_t>(expected.begin() + static_cast<std::ptrdiff_t>(first),
+                                                expected.begin() + static_cast<std::ptrdiff_t>(last)));
+        }
+    }
+}
+
+void checkQueries(const ChatRoomIndex& index, const std::map<uint64_t, Room>& rooms, std::mt19937_64& rng)
+{
+    CHECK(index.size() == rooms.size());
+
+    // getChatListItems(mask, filter), with every mask and filter
+    for (int mask = 0; mask < 64; mask++)
+    {
+        for (int filter = 0; filter < 64; filter++)
+        {
+            uint8_t flagsMask = 0;
+            uint8_t flagsValue = 0;
+            std::vector<uint64_t> expected = scan(rooms, [mask, filter](const Room& room) { return passFilter(room, mask, filter); });
+            if (!MegaChatApiImpl::chatFilterToIndexFlags(mask, filter, flagsMask, flagsValue))
+            {
+                // contradictory conditions on the type
+                CHECK(expected.empty());
+                continue;
+            }
+            checkSelect(index, flagsMask, flagsValue, expected);
+        }
+    }
+
+    // getChatListItemsByType(type), which filters out archived rooms
+    for (int type = MegaChatApi::CHAT_TYPE_ALL - 1; type <= MegaChatApi::CHAT_TYPE_NON_MEETING + 1; type++)
+    {
+        uint8_t flagsMask = ChatRoomIndex::kArchived;
+        uint8_t flagsValue = 0;
+        bool valid = MegaChatApiImpl::chatTypeToIndexFlags(type, flagsMask, flagsValue);
+        CHECK(valid == (type >= MegaChatApi::CHAT_TYPE_ALL && type <= MegaChatApi::CHAT_TYPE_NON_MEETING));
+        if (valid)
+        {
+            checkSelect(index, flagsMask, flagsValue,
+                        scan(rooms, [type](const Room& room) { return !room.archived && isChatroomFromType(room, type); }));
+        }
+    }
+
+    // getChatListItems(), getActive/Inactive/Archived/UnreadChatListItems() and getUnreadChats()
+    checkSelect(index, ChatRoomIndex::kArchived, 0,
+                scan(rooms, [](const Room& room) { return !room.archived; }));
+    checkSelect(index, ChatRoomIndex::kArchived | ChatRoomIndex::kActive, ChatRoomIndex::kActive,
+                scan(rooms, [](const Room& room) { return !room.archived && room.active; }));
+    checkSelect(index, ChatRoomIndex::kArchived | ChatRoomIndex::kActive, 0,
+                scan(rooms, [](const Room& room) { return !room.archived && !room.active; }));
+    checkSelect(index, ChatRoomIndex::kArchived, ChatRoomIndex::kArchived,
+                scan(rooms, [](const Room& room) { return room.archived; }));
+    checkSelect(index, ChatRoomIndex::kArchived | ChatRoomIndex::kUnread, ChatRoomIndex::kUnread,
+                scan(rooms, [](const Room& room) { return !room.archived && room.unread; }));
+    CHECK(index.count(ChatRoomIndex::kArchived | ChatRoomIndex::kPreview | ChatRoomIndex::kUnread, ChatRoomIndex::kUnread)
+          == scan(rooms, [](const Room& room) { return !room.archived && !room.preview && room.unread; }).size());
+
+    // getChatListItemsByPeers(), with the peers of some rooms, shuffled or not, and random ones
+    std::vector<std::vector<uint64_t>> peerLists = { {} };
+    for (const auto& it: rooms)
+    {
+        if (rng() % 8 == 0)
+        {
+            peerLists.push_back(it.second.peers);
+            std::shuffle(peerLists.back().begin(), peerLists.back().end(), rng);
+        }
+    }
+    peerLists.push_back({ rng() % 16 + 1, rng() % 16 + 1 });
+    peerLists.push_back({ rng() % 16 + 1 });
+    for (const std::vector<uint64_t>& peers: peerLists)
+    {
+        CHECK(index.selectByPeers(peers) == scan(rooms, [&peers](const Room& room) { return hasPeers(room, peers); }));
+    }
+}
+
+Room randomRoom(uint64_t chatid, std::mt19937_64& rng)
+{
+    Room room;
+    room.chatid = chatid;
+    room.group = rng() % 3 != 0;
+    if (room.group)
+    {
+        room.publicChat = rng() % 2;
+        room.meeting = room.publicChat && rng() % 3 == 0;     // private groupchats can't be meeting rooms
+        room.active = rng() % 5 != 0;
+        room.preview = room.publicChat && rng() % 10 == 0;
+        size_t peerCount = rng() % 4;
+        for (size_t i = 0; i < peerCount; i++)
+        {
+            room.peers.push_back(rng() % 16 + 1);    // few users, so peer lists repeat
+        }
+        std::sort(room.peers.begin(), room.peers.end());
+        room.peers.erase(std::unique(room.peers.begin(), room.peers.end()), room.peers.end());
+    }
+    else
+    {
+        room.peers.push_back(rng() % 16 + 1);
+    }
+    room.archived = rng() % 6 == 0;
+    room.unread = rng() % 4 == 0;
+    room.lastTs = static_cast<int64_t>(rng() % 1000);     // ties are broken by chatid
+    return room;
+}
+
+void testRandom(unsigned seed)
+{
+    std::mt19937_64 rng(seed);
+    ChatRoomIndex index;
+    std::map<uint64_t, Room> rooms;
+
+    for (int step = 0; step < 3000; step++)
+    {
+        uint64_t chatid = rng() % 400 + 1;
+        unsigned op = static_cast<unsigned>(rng() % 100);
+        auto it = rooms.find(chatid);
+        if (op < 10)
+        {
+            index.remove(chatid);
+            rooms.erase(chatid);
+        }
+        else if (op < 60 || it == rooms.end())
+        {
+            Room room = randomRoom(chatid, rng);
+            index.update(chatid, entryOf(room));
+            rooms[chatid] = room;
+        }
+        else
+        {
+            // change one property, as ChatRoom::updateListIndex() does
+            Room& room = it->second;
+            switch (rng() % 5)
+            {
+                case 0: room.archived = !room.archived; break;
+                case 1: room.unread = !room.unread; break;
+                case 2: room.active = !room.active; break;
+                case 3: room.lastTs += static_cast<int64_t>(rng() % 100); break;
+                case 4: room.preview = room.publicChat && !room.preview; break;
+            }
+            ChatRoomIndex::Entry entry = entryOf(room);
+            index.update(chatid, std::move(entry));
+            CHECK(!index.update(chatid, entryOf(room)));   // unchanged
+        }
+
+        if (step % 250 == 0)
+        {
+            checkQueries(index, rooms, rng);
+        }
+        if (gFailures)
+        {
+            std::cerr << "seed " << seed << ", step " << step << std::endl;
+            return;
+        }
+    }
+    checkQueries(index, rooms, rng);
+
+    index.clear();
+    rooms.clear();
+    checkQueries(index, rooms, rng);
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned seed = (argc > 1) ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 1;
+
+    testRandom(seed);
+
+    if (gFailures)
+    {
+        std::cerr << gFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
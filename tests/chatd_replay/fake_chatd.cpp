@@ -0,0 +1,235 @@
+/**
+ * @file fake_chatd.cpp
+ * @brief Local websocket server that plays back a chatd capture to the clients.
+ *
+ * Serves a capture recorded with KRCHATD_CAPTURE (see chatd::FrameCapture) over plain
+ * websockets, so a client can be tested against real chatd traffic without servers.
+ * Every connection gets the frames recorded for one shard, which is taken from the path
+ * of the URL (ws://127.0.0.1:<port>/<shard>). Playback starts when the client sends its
+ * first command (usually HELLO or JOIN). The opcodes received from the client are logged.
+ *
+ * Usage: megachat_fake_chatd <capture-file> [port] [--realtime]
+ *  --realtime: keep the original delays between frames, instead of sending them as fast
+ *  as the client reads them.
+ */
+
+#include "chatdCapture.h"
+#include "chatdMsg.h"
+
+#include <libwebsockets.h>
+#include <signal.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+struct Frame
+{
+    int shard = 0;
+    uint64_t usec = 0;
+    std::vector<unsigned char> buf; // LWS_PRE bytes of padding, followed by the frame
+};
+
+struct Session
+{
+    int shard = 0;
+    bool started = false;
+    size_t next = 0;
+    uint64_t firstUsec = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+std::vector<Frame> gFrames;
+bool gRealtime = false;
+volatile sig_atomic_t gInterrupted = 0;
+
+void onSignal(int)
+{
+    gInterrupted = 1;
+}
+
+// returns the index of the next frame for the session's shard, or gFrames.size()
+size_t nextFrame(const Session& session)
+{
+    size_t i = session.next;
+    while (i < gFrames.size() && gFrames[i].shard != session.shard)
+    {
+        i++;
+    }
+    return i;
+}
+
+int callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len)
+{
+    Session* session = static_cast<Session*>(user);
+    switch (reason)
+    {
+        case LWS_CALLBACK_ESTABLISHED:
+        {
+            new (session) Session();
+            char uri[128] = {};
+            if (lws_hdr_copy(wsi, uri, sizeof(uri), WSI_TOKEN_GET_URI) > 0)
+            {
+                session->shard = atoi(uri + (uri[0] == '/' ? 1 : 0));
+            }
+            std::cout << "Client connected for shard " << session->shard << std::endl;
+            break;
+        }
+
+        case LWS_CALLBACK_RECEIVE:
+        {
+            if (len)
+            {
+                uint8_t opcode = static_cast<const uint8_t*>(in)[0];
+                std::cout << "shard " << session->shard << ": recv " << chatd::Command::opcodeToStr(opcode)
+                          << " (" << len << " bytes)" << std::endl;
+            }
+
+            if (!session->started)
+            {
+                session->started = true;
+                session->start = std::chrono::steady_clock::now();
+                session->next = nextFrame(*session);
+                if (session->next < gFrames.size())
+                {
+                    session->firstUsec = gFrames[session->next].usec;
+                }
+                lws_callback_on_writable(wsi);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_TIMER:
+        {
+            lws_callback_on_writable(wsi);
+            break;
+        }
+
+        case LWS_CALLBACK_SERVER_WRITEABLE:
+        {
+            session->next = nextFrame(*session);
+            if (session->next >= gFrames.size())
+            {
+                std::cout << "shard " << session->shard << ": playback completed" << std::endl;
+                break;
+            }
+
+            Frame& frame = gFrames[session->next];
+            if (gRealtime)
+            {
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - session->start).count();
+                int64_t due = static_cast<int64_t>(frame.usec - session->firstUsec);
+                if (due > elapsed)
+                {
+                    lws_set_timer_usecs(wsi, static_cast<lws_usec_t>(due - elapsed));
+                    break;
+                }
+            }
+
+            size_t frameLen = frame.buf.size() - LWS_PRE;
+            if (lws_write(wsi, frame.buf.data() + LWS_PRE, frameLen, LWS_WRITE_BINARY) < static_cast<int>(frameLen))
+            {
+                return -1;
+            }
+            session->next++;
+            lws_callback_on_writable(wsi);
+            break;
+        }
+
+        case LWS_CALLBACK_CLOSED:
+        {
+            std::cout << "Client disconnected from shard " << session->shard << std::endl;
+            session->~Session();
+            break;
+        }
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+struct lws_protocols protocols[] =
+{
+    {
+        "MEGAchat",
+        callback,
+        sizeof(Session),
+        128 * 1024, // Rx buffer size
+        0, nullptr, 0,
+    },
+    {} /* terminator */
+};
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture-file> [port] [--realtime]" << std::endl;
+        return 1;
+    }
+
+    int port = 8080;
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--realtime"))
+        {
+            gRealtime = true;
+        }
+        else
+        {
+            port = atoi(argv[i]);
+        }
+    }
+
+    chatd::FrameCaptureReader reader(argv[1]);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Can't open capture file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    chatd::FrameCapture::Record record;
+    while (reader.next(record))
+    {
+        if (record.type != chatd::FrameCapture::kRecordFrame)
+        {
+            continue;
+        }
+
+        Frame frame;
+        frame.shard = record.shard;
+        frame.usec = record.usec;
+        frame.buf.resize(LWS_PRE + record.data.size());
+        memcpy(frame.buf.data() + LWS_PRE, record.data.data(), record.data.size());
+        gFrames.emplace_back(std::move(frame));
+    }
+    std::cout << "Loaded " << gFrames.size() << " frames" << std::endl;
+
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+    info.port = port;
+    info.protocols = protocols;
+    info.gid = -1;
+    info.uid = -1;
+    lws_set_log_level(LLL_ERR | LLL_WARN, NULL);
+    struct lws_context* context = lws_create_context(&info);
+    if (!context)
+    {
+        std::cerr << "Failed to create the websocket server" << std::endl;
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    std::cout << "Listening on ws://127.0.0.1:" << port << "/<shard>" << std::endl;
+    while (!gInterrupted && lws_service(context, 0) >= 0)
+    {
+    }
+
+    lws_context_destroy(context);
+    return 0;
+}
@@ -0,0 +1,345 @@
+/**
+ * @file replay_bench.cpp
+ * @brief Offline throughput benchmark of the chatd inbound pipeline.
+ *
+ * Replays a capture recorded with KRCHATD_CAPTURE, by a build configured with
+ * ENABLE_CHATD_FRAME_CAPTURE (see chatd::FrameCapture), into a chatd::Client backed by
+ * a temporary SQLite database, without any network access, and reports:
+ *  - messages/sec (messages notified to the chat listeners / time spent processing frames)
+ *  - p50/p99 of the time to process a frame (command parsing, message handling and DB writes)
+ *  - heap allocations per frame
+ *  - bytes written to the database
+ *
+ * The messages can't be decrypted, since the keys of the recording account aren't
+ * available. A pass-through crypto module stores the ciphertext as the message content,
+ * so decryption is not part of the measurement.
+ *
+ * Usage: megachat_replay_bench <capture-file> [iterations]
+ */
+
+#include "megachatapi_impl.h"
+#include "chatClient.h"
+#include "chatdCapture.h"
+#include "chatdDb.h"
+#include "chatdICrypto.h"
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// Counters of heap allocations, for all the threads of the process
+static std::atomic<uint64_t> gAllocCount{0};
+
+void* operator new(size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+class ReplayCrypto: public chatd::ICrypto
+{
+public:
+    ReplayCrypto(karere::Client& client) : chatd::ICrypto(client.appCtx), mClient(client) {}
+
+    void setUsers(karere::SetOfIds*) override {}
+
+    promise::Promise<std::pair<chatd::MsgCommand*, chatd::KeyCommand*>>
+    msgEncrypt(chatd::Message*, const karere::SetOfIds&, chatd::MsgCommand*) override
+    {
+        return ::promise::Error("Sending is not supported while replaying");
+    }
+
+    promise::Promise<chatd::Message*> msgDecrypt(chatd::Message* msg) override
+    {
+        // the keys of the recording account are not available: keep the ciphertext as content
+        msg->setEncrypted(chatd::Message::kNotEncrypted);
+        return msg;
+    }
+
+    void onKeyReceived(chatd::KeyId, karere::Id, karere::Id, const char*, uint16_t, bool) override {}
+    void onKeyConfirmed(chatd::KeyId, chatd::KeyId) override {}
+    void onKeyRejected() override {}
+    void resetSendKey() override {}
+    void randomBytes(void* buf, size_t bufsize) const override { memset(buf, 0, bufsize); }
+
+    promise::Promise<std::shared_ptr<Buffer>> encryptChatTitle(const std::string&, uint64_t, bool) override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    promise::Promise<chatd::KeyCommand*> encryptUnifiedKeyForAllParticipants(uint64_t) override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    promise::Promise<std::string> decryptChatTitleFromApi(const Buffer&) override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    promise::Promise<std::string> encryptUnifiedKeyToUser(const karere::Id&) override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    promise::Promise<std::string> decryptUnifiedKey(std::shared_ptr<Buffer>&, uint64_t, uint64_t) override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    promise::Promise<std::shared_ptr<std::string>> getUnifiedKey() override
+    {
+        return ::promise::Error("Not supported while replaying");
+    }
+
+    bool previewMode() override { return false; }
+    bool isPublicChat() const override { return false; }
+    void setPrivateChatMode() override {}
+    void onHistoryReload() override {}
+    uint64_t getPublicHandle() const override { return karere::Id::inval(); }
+    void setPublicHandle(const uint64_t) override {}
+    karere::UserAttrCache& userAttrCache() override { return mClient.userAttrCache(); }
+
+    std::shared_ptr<Buffer> reactionEncrypt(const chatd::Message&, const std::string& reaction) override
+    {
+        return std::make_shared<Buffer>(reaction.data(), reaction.size());
+    }
+
+    promise::Promise<std::shared_ptr<Buffer>> reactionDecrypt(const karere::Id&, const karere::Id&, const chatd::KeyId&, const std::string& reaction) override
+    {
+        return std::make_shared<Buffer>(reaction.data(), reaction.size());
+    }
+
+    void fetchUserKeys(karere::Id) override {}
+
+protected:
+    karere::Client& mClient;
+};
+
+class ReplayListener: public chatd::Listener
+{
+public:
+    ReplayListener(karere::Client& client, uint64_t& msgCount)
+        : mClient(client), mMsgCount(msgCount) {}
+
+    void init(chatd::Chat& chat, chatd::DbInterface*& dbIntf) override
+    {
+        dbIntf = new ChatdSqliteDb(chat, mClient.db);
+    }
+
+    void onRecvNewMessage(chatd::Idx, chatd::Message&, chatd::Message::Status) override { mMsgCount++; }
+    void onRecvHistoryMessage(chatd::Idx, chatd::Message&, chatd::Message::Status, bool isLocal) override
+    {
+        if (!isLocal)
+        {
+            mMsgCount++;
+        }
+    }
+    void onOnlineStateChange(chatd::ChatState) override {}
+    void onReceived(chatd::Message*, chatd::Idx) override {}
+    void onLoaded(chatd::Message*, chatd::Idx) override {}
+    void onDeleted(karere::Id) override {}
+    void onTruncated(karere::Id) override {}
+
+protected:
+    karere::Client& mClient;
+    uint64_t& mMsgCount;
+};
+
+// Listeners and crypto modules of the replayed chats, must outlive the chat client
+struct ReplayChats
+{
+    std::vector<std::unique_ptr<ReplayListener>> listeners;
+    std::vector<std::unique_ptr<ReplayCrypto>> cryptos;
+};
+
+struct ReplayStats
+{
+    uint64_t frames = 0;
+    uint64_t messages = 0;
+    uint64_t allocations = 0;
+    uint64_t dbBytesWritten = 0;
+    std::chrono::nanoseconds totalTime{0};
+    std::vector<uint64_t> frameNs;
+};
+
+uint64_t dbBytesWritten(SqliteDb& db)
+{
+    int pagesWritten = 0;
+    int highwater = 0;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &pagesWritten, &highwater, 0);
+
+    int pageSize = 0;
+    SqliteStmt stmt(db, "PRAGMA page_size");
+    if (stmt.step())
+    {
+        pageSize = stmt.integralCol<int>(0);
+    }
+    return static_cast<uint64_t>(pagesWritten) * static_cast<uint64_t>(pageSize);
+}
+
+bool replayCapture(megachat::MegaChatApiImpl& api, const std::string& capturePath, ReplayChats& chats, ReplayStats& stats)
+{
+    chatd::FrameCaptureReader reader(capturePath);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Can't open capture file " << capturePath << std::endl;
+        return false;
+    }
+
+    std::vector<chatd::FrameCapture::Record> frames;
+
+    megachat::MegaChatApiImpl::SdkMutexGuard g(api.sdkMutex);
+    karere::Client& client = *api.getKarereClient();
+    chatd::Client& chatdClient = *client.mChatdClient;
+
+    chatd::FrameCapture::Record record;
+    while (reader.next(record))
+    {
+        if (record.type == chatd::FrameCapture::kRecordFrame)
+        {
+            frames.emplace_back(std::move(record));
+            continue;
+        }
+
+        karere::Id chatid;
+        bool isGroup = false;
+        uint32_t creationTs = 0;
+        if (!chatd::FrameCapture::parseChat(record, chatid, isGroup, creationTs))
+        {
+            continue;
+        }
+
+        client.db.query("insert or replace into chats(chatid, shard, own_priv, ts_created) values(?,?,?,?)",
+                        chatid, record.shard, chatd::PRIV_MODERATOR, creationTs);
+        chats.listeners.emplace_back(new ReplayListener(client, stats.messages));
+        chats.cryptos.emplace_back(new ReplayCrypto(client));
+        chatdClient.createChat(chatid, record.shard, chats.listeners.back().get(), karere::SetOfIds(),
+                               chats.cryptos.back().get(), creationTs, isGroup);
+    }
+
+    stats.frameNs.reserve(frames.size());
+    uint64_t dbBytesBefore = dbBytesWritten(client.db);
+    for (chatd::FrameCapture::Record& frame: frames)
+    {
+        uint64_t allocsBefore = gAllocCount.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        chatdClient.replayFrame(frame.shard, frame.data.data(), frame.data.size());
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        stats.allocations += gAllocCount.load(std::memory_order_relaxed) - allocsBefore;
+
+        stats.totalTime += elapsed;
+        stats.frameNs.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        stats.frames++;
+    }
+    client.db.commit();
+    stats.dbBytesWritten = dbBytesWritten(client.db) - dbBytesBefore;
+    return true;
+}
+
+uint64_t percentile(std::vector<uint64_t>& values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t pos = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(pos), values.end());
+    return values[pos];
+}
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture-file> [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::string capturePath = argv[1];
+    int iterations = (argc > 2) ? std::max(1, atoi(argv[2])) : 1;
+
+    megachat::MegaChatApi::setLogLevel(megachat::MegaChatApi::LOG_LEVEL_ERROR);
+    for (int i = 0; i < iterations; i++)
+    {
+        // every iteration starts with an empty database
+        char workDir[] = "/tmp/megachat_replay_XXXXXX";
+        if (!mkdtemp(workDir))
+        {
+            std::cerr << "Can't create temporary directory" << std::endl;
+            return 1;
+        }
+
+        ReplayStats stats;
+        ReplayChats chats;
+        bool ok = false;
+        {
+            mega::MegaApi megaApi("MBoVFSyZ", workDir, "MEGAchat replay benchmark");
+            megachat::MegaChatApiImpl api(nullptr, &megaApi);
+            if (api.initAnonymous() == megachat::MegaChatApi::INIT_ERROR)
+            {
+                std::cerr << "Failed to initialize the chat client" << std::endl;
+                return 1;
+            }
+            ok = replayCapture(api, capturePath, chats, stats);
+        }
+
+        std::error_code ec;
+        std::filesystem::remove_all(workDir, ec);
+
+        if (!ok)
+        {
+            return 1;
+        }
+
+        double seconds = std::chrono::duration<double>(stats.totalTime).count();
+        std::cout << "iteration " << (i + 1) << ": "
+                  << stats.frames << " frames, "
+                  << stats.messages << " messages, "
+                  << (seconds > 0 ? static_cast<uint64_t>(static_cast<double>(stats.messages) / seconds) : 0) << " messages/sec, "
+                  << "p50 " << percentile(stats.frameNs, 0.5) / 1000 << " us/frame, "
+                  << "p99 " << percentile(stats.frameNs, 0.99) / 1000 << " us/frame, "
+                  << (stats.frames ? stats.allocations / stats.frames : 0) << " allocations/frame, "
+                  << stats.dbBytesWritten << " DB bytes written" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file event_queue_bench.cpp
+ * @brief Stress benchmark of the event queue of MegaChatApiImpl.
+ *
+ * Several producer threads post marshalled lambdas (karere::marshallCall) to the thread
+ * of MegaChatApiImpl, the same path used by timers, websocket callbacks and the webrtc
+ * threads. Two phases are measured:
+ *  - throughput: every producer posts its calls as fast as possible. Reports calls/sec and
+ *    the latency from posting a call until it's executed (p50/p99/max).
+ *  - wakeup: a single producer posts a call and waits for it to be executed before posting
+ *    the next one, so every call has to wake up the idle thread. Reports its latency.
+ *
+ * Usage: megachat_event_queue_bench [producers] [calls-per-producer]
+ */
+
+#include "megachatapi_impl.h"
+#include "gcmpp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Latencies of the executed calls. Only written by the thread of MegaChatApiImpl
+struct Samples
+{
+    std::vector<uint64_t> latencyNs;
+    std::atomic<size_t> executed{0};
+    Clock::time_point lastExecution;
+};
+
+void post(megachat::MegaChatApiImpl& api, Samples& samples)
+{
+    Clock::time_point posted = Clock::now();
+    karere::marshallCall([posted, &samples]()
+    {
+        Clock::time_point now = Clock::now();
+        samples.latencyNs.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - posted).count()));
+        samples.lastExecution = now;
+        samples.executed.fetch_add(1, std::memory_order_release);
+    }, &api);
+}
+
+void waitExecuted(const Samples& samples, size_t count)
+{
+    while (samples.executed.load(std::memory_order_acquire) < count)
+    {
+        std::this_thread::yield();
+    }
+}
+
+uint64_t percentile(std::vector<uint64_t>& values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t pos = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(pos), values.end());
+    return values[pos];
+}
+
+void printLatencies(std::vector<uint64_t>& latencyNs)
+{
+    uint64_t maxNs = latencyNs.empty() ? 0 : *std::max_element(latencyNs.begin(), latencyNs.end());
+    std::cout << "p50 " << percentile(latencyNs, 0.5) / 1000 << " us, "
+              << "p99 " << percentile(latencyNs, 0.99) / 1000 << " us, "
+              << "max " << maxNs / 1000 << " us" << std::endl;
+}
+
+void runThroughput(megachat::MegaChatApiImpl& api, unsigned producers, size_t callsPerProducer)
+{
+    size_t total = producers * callsPerProducer;
+    Samples samples;
+    samples.latencyNs.reserve(total);
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < producers; i++)
+    {
+        threads.emplace_back([&api, &samples, &go, callsPerProducer]()
+        {
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (size_t j = 0; j < callsPerProducer; j++)
+            {
+                post(api, samples);
+            }
+        });
+    }
+
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& t: threads)
+    {
+        t.join();
+    }
+    waitExecuted(samples, total);
+
+    double seconds = std::chrono::duration<double>(samples.lastExecution - start).count();
+    std::cout << "throughput: " << producers << " producers, " << total << " calls, "
+              << (seconds > 0 ? static_cast<uint64_t>(static_cast<double>(total) / seconds) : 0) << " calls/sec, latency ";
+    printLatencies(samples.latencyNs);
+}
+
+void runWakeup(megachat::MegaChatApiImpl& api, size_t calls)
+{
+    Samples samples;
+    samples.latencyNs.reserve(calls);
+    for (size_t i = 0; i < calls; i++)
+    {
+        // let the thread go back to sleep
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        post(api, samples);
+        waitExecuted(samples, i + 1);
+    }
+
+    std::cout << "wakeup: " << calls << " calls, latency ";
+    printLatencies(samples.latencyNs);
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned producers = (argc > 1) ? static_cast<unsigned>(std::max(1, atoi(argv[1]))) : 4;
+    size_t callsPerProducer = (argc > 2) ? static_cast<size_t>(std::max(1, atoi(argv[2]))) : 250000;
+
+    megachat::MegaChatApi::setLogLevel(megachat::MegaChatApi::LOG_LEVEL_ERROR);
+
+    char workDir[] = "/tmp/megachat_event_queue_XXXXXX";
+    if (!mkdtemp(workDir))
+    {
+        std::cerr << "Can't create temporary directory" << std::endl;
+        return 1;
+    }
+
+    {
+        mega::MegaApi megaApi("MBoVFSyZ", workDir, "MEGAchat event queue benchmark");
+        megachat::MegaChatApiImpl api(nullptr, &megaApi);
+        runThroughput(api, producers, callsPerProducer);
+        runWakeup(api, 10000);
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(workDir, ec);
+    return 0;
+}
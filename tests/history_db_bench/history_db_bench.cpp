@@ -0,0 +1,258 @@
+/**
+ * @file history_db_bench.cpp
+ * @brief Benchmark of the loading of history pages and their reactions from the local db.
+ *
+ * A db with the schema of the app is seeded with a chat of [messages] messages, every
+ * [reacted-ratio]-th one with a few reactions, plus some pending reactions. Then the whole
+ * history is walked backwards in pages of 32 messages, as Chat::getHistoryFromDb does, in
+ * two ways:
+ *  - per-message: one query for the page, one query per message for its reactions, and one
+ *    query for the pending reactions of the chat on every page.
+ *  - ranged: one query for the page, one ranged query for the reactions of the whole page,
+ *    and the pending reactions loaded only along with the first page.
+ * Reports the queries issued and the time per page of both.
+ *
+ * Usage: megachat_history_db_bench [messages] [reacted-ratio]
+ */
+
+#include "karereCommon.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t kChatId = 0x1234;
+constexpr int kPageSize = 32;
+
+struct Stmt
+{
+    sqlite3_stmt* mStmt = nullptr;
+    Stmt(sqlite3* db, const char* sql)
+    {
+        if (sqlite3_prepare_v2(db, sql, -1, &mStmt, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Can't prepare query: " << sqlite3_errmsg(db) << std::endl;
+            exit(1);
+        }
+    }
+    ~Stmt()
+    {
+        sqlite3_finalize(mStmt);
+    }
+    // ready to be executed again, as a statement returned by the cache of SqliteDb
+    sqlite3_stmt* reset()
+    {
+        sqlite3_reset(mStmt);
+        sqlite3_clear_bindings(mStmt);
+        return mStmt;
+    }
+};
+
+void exec(sqlite3* db, const char* sql)
+{
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "Query failed: " << (err ? err : "") << std::endl;
+        sqlite3_free(err);
+        exit(1);
+    }
+}
+
+void seed(sqlite3* db, int messages, int reactedRatio)
+{
+    exec(db, karere::gDbSchema);
+    exec(db, "BEGIN TRANSACTION");
+
+    Stmt chat(db, "insert into chats(chatid, shard, own_priv) values(?, 0, 3)");
+    sqlite3_bind_int64(chat.reset(), 1, kChatId);
+    sqlite3_step(chat.mStmt);
+
+    Stmt msg(db, "insert into history(idx, chatid, msgid, userid, keyid, type, updated, ts, is_encrypted, data, backrefid)"
+                 " values(?, ?, ?, ?, 0, 1, 0, ?, 0, ?, 0)");
+    Stmt reaction(db, "insert into chat_reactions(chatid, msgid, userid, reaction) values(?, ?, ?, ?)");
+    Stmt pending(db, "insert into chat_pending_reactions(chatid, msgid, reaction, encReaction, status) values(?, ?, ?, ?, 0)");
+    std::string data(160, 'x');
+    const char* emojis[] = { "\xF0\x9F\x91\x8D", "\xF0\x9F\x98\x82", "\xE2\x9D\xA4" };
+    for (int i = 0; i < messages; i++)
+    {
+        int64_t msgid = 1000000 + i;
+        sqlite3_stmt* stmt = msg.reset();
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_bind_int64(stmt, 2, kChatId);
+        sqlite3_bind_int64(stmt, 3, msgid);
+        sqlite3_bind_int64(stmt, 4, 1 + i % 8);
+        sqlite3_bind_int(stmt, 5, 1600000000 + i);
+        sqlite3_bind_blob(stmt, 6, data.data(), static_cast<int>(data.size()), SQLITE_STATIC);
+        sqlite3_step(stmt);
+
+        if (reactedRatio && i % reactedRatio == 0)
+        {
+            for (int user = 1; user <= 3; user++)
+            {
+                stmt = reaction.reset();
+                sqlite3_bind_int64(stmt, 1, kChatId);
+                sqlite3_bind_int64(stmt, 2, msgid);
+                sqlite3_bind_int64(stmt, 3, user);
+                sqlite3_bind_text(stmt, 4, emojis[user - 1], -1, SQLITE_STATIC);
+                sqlite3_step(stmt);
+            }
+        }
+        if (i % 1000 == 0)
+        {
+            stmt = pending.reset();
+            sqlite3_bind_int64(stmt, 1, kChatId);
+            sqlite3_bind_int64(stmt, 2, msgid);
+            sqlite3_bind_text(stmt, 3, emojis[0], -1, SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, 4, emojis[0], 4, SQLITE_STATIC);
+            sqlite3_step(stmt);
+        }
+    }
+    exec(db, "COMMIT TRANSACTION");
+}
+
+struct Result
+{
+    uint64_t queries = 0;
+    uint64_t reactions = 0;
+    uint64_t pages = 0;
+    double seconds = 0;
+};
+
+// Loads a page, as ChatdSqliteDb::loadMessages does. Returns the msgids, from newest to oldest
+std::vector<int64_t> loadPage(Stmt& page, int idx, Result& result)
+{
+    std::vector<int64_t> msgids;
+    sqlite3_stmt* stmt = page.reset();
+    sqlite3_bind_int64(stmt, 1, kChatId);
+    sqlite3_bind_int(stmt, 2, idx);
+    sqlite3_bind_int(stmt, 3, kPageSize);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        msgids.push_back(sqlite3_column_int64(stmt, 0));
+    }
+    result.queries++;
+    return msgids;
+}
+
+void loadPending(Stmt& pending, Result& result)
+{
+    sqlite3_stmt* stmt = pending.reset();
+    sqlite3_bind_int64(stmt, 1, kChatId);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+    }
+    result.queries++;
+}
+
+const char* kPageQuery = "select msgid, userid, ts, type, data, idx, keyid, backrefid, updated, is_encrypted from history"
+                         " where chatid = ?1 and idx <= ?2 order by idx desc limit ?3";
+const char* kPendingQuery = "select _rowid_, reaction, encReaction, msgid, status from chat_pending_reactions"
+                            " where chatid = ? ORDER BY `_rowid_` ASC";
+
+Result runPerMessage(sqlite3* db, int messages)
+{
+    Stmt page(db, kPageQuery);
+    Stmt reactions(db, "select _rowid_, reaction, userid from chat_reactions where chatid = ? and msgid = ? ORDER BY `_rowid_` ASC");
+    Stmt pending(db, kPendingQuery);
+
+    Result result;
+    Clock::time_point start = Clock::now();
+    for (int idx = messages - 1; idx >= 0; idx -= kPageSize)
+    {
+        for (int64_t msgid: loadPage(page, idx, result))
+        {
+            sqlite3_stmt* stmt = reactions.reset();
+            sqlite3_bind_int64(stmt, 1, kChatId);
+            sqlite3_bind_int64(stmt, 2, msgid);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                result.reactions++;
+            }
+            result.queries++;
+        }
+        loadPending(pending, result);
+        result.pages++;
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+Result runRanged(sqlite3* db, int messages)
+{
+    Stmt page(db, kPageQuery);
+    Stmt reactions(db, "select r.msgid, r.reaction, r.userid from history h"
+                       " join chat_reactions r on r.chatid = h.chatid and r.msgid = h.msgid"
+                       " where h.chatid = ?1 and h.idx between ?2 and ?3 ORDER BY r.`_rowid_` ASC");
+    Stmt pending(db, kPendingQuery);
+
+    Result result;
+    Clock::time_point start = Clock::now();
+    for (int idx = messages - 1; idx >= 0; idx -= kPageSize)
+    {
+        std::vector<int64_t> msgids = loadPage(page, idx, result);
+        std::map<int64_t, std::vector<std::pair<std::string, int64_t>>> byMsg;
+        if (!msgids.empty())
+        {
+            sqlite3_stmt* stmt = reactions.reset();
+            sqlite3_bind_int64(stmt, 1, kChatId);
+            sqlite3_bind_int(stmt, 2, idx - static_cast<int>(msgids.size()) + 1);
+            sqlite3_bind_int(stmt, 3, idx);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                byMsg[sqlite3_column_int64(stmt, 0)].emplace_back(
+                            reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_int64(stmt, 2));
+                result.reactions++;
+            }
+            result.queries++;
+        }
+        if (!result.pages)
+        {
+            loadPending(pending, result);
+        }
+        result.pages++;
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+void print(const char* name, const Result& result)
+{
+    std::cout << name << ": " << result.pages << " pages, " << result.reactions << " reactions, "
+              << result.queries << " queries, "
+              << (result.pages ? static_cast<uint64_t>(result.seconds * 1e6 / static_cast<double>(result.pages)) : 0)
+              << " us/page" << std::endl;
+}
+}
+
+int main(int argc, char **argv)
+{
+    int messages = (argc > 1) ? std::max(1, atoi(argv[1])) : 100000;
+    int reactedRatio = (argc > 2) ? std::max(0, atoi(argv[2])) : 10;
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK)
+    {
+        std::cerr << "Can't open db" << std::endl;
+        return 1;
+    }
+
+    seed(db, messages, reactedRatio);
+    Result perMessage = runPerMessage(db, messages);
+    Result ranged = runRanged(db, messages);
+    print("per-message", perMessage);
+    print("ranged", ranged);
+
+    sqlite3_close(db);
+    return (perMessage.reactions == ranged.reactions) ? 0 : 1;
+}
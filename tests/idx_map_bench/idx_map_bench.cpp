@@ -0,0 +1,137 @@
+/**
+ * @file idx_map_bench.cpp
+ * @brief Benchmark of chatd::IdxMap against std::map, with 10k, 100k and 1M entries.
+ *
+ * For every size, both maps are used as the history buffer of chatd uses them, and the
+ * time per operation is reported:
+ *  - set: the ids of the messages are added with consecutive indexes
+ *  - find: lookups of ids that are in the map, and of ids that are not
+ *  - eraseUpTo: the oldest messages are evicted, 1% of the entries at a time
+ *
+ * Usage: megachat_idx_map_bench [iterations]
+ */
+
+#include "chatdIdxMap.h"
+#include "karereId.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+typedef int32_t Idx;    // as chatd::Idx
+
+struct Timings
+{
+    double setNs = 0;
+    double findNs = 0;
+    double missNs = 0;
+    double eraseNs = 0;
+};
+
+template <class Clock = std::chrono::steady_clock>
+double nsPerOp(typename Clock::time_point start, size_t ops)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    return static_cast<double>(elapsed.count()) / static_cast<double>(ops ? ops : 1);
+}
+
+void eraseUpTo(std::map<karere::Id, Idx>& map, Idx idx)
+{
+    // like chatd did before IdxMap: a full scan of the map
+    for (auto it = map.begin(); it != map.end();)
+    {
+        it = (it->second <= idx) ? map.erase(it) : std::next(it);
+    }
+}
+
+void eraseUpTo(chatd::IdxMap<karere::Id, Idx>& map, Idx idx)
+{
+    map.eraseUpTo(idx);
+}
+
+template <class Map>
+Timings run(const std::vector<karere::Id>& ids, const std::vector<karere::Id>& lookups,
+            const std::vector<karere::Id>& misses, uint64_t& checksum)
+{
+    Timings timings;
+    Map map;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        map.emplace(ids[i], static_cast<Idx>(i));
+    }
+    timings.setNs = nsPerOp(start, ids.size());
+
+    start = std::chrono::steady_clock::now();
+    for (const karere::Id& id: lookups)
+    {
+        auto it = map.find(id);
+        checksum += (it != map.end()) ? static_cast<uint64_t>(it->second) : 0;
+    }
+    timings.findNs = nsPerOp(start, lookups.size());
+
+    start = std::chrono::steady_clock::now();
+    for (const karere::Id& id: misses)
+    {
+        checksum += (map.find(id) != map.end()) ? 1 : 0;
+    }
+    timings.missNs = nsPerOp(start, misses.size());
+
+    size_t step = std::max<size_t>(1, ids.size() / 100);
+    start = std::chrono::steady_clock::now();
+    for (size_t idx = step; idx <= ids.size(); idx += step)
+    {
+        eraseUpTo(map, static_cast<Idx>(idx - 1));
+    }
+    timings.eraseNs = nsPerOp(start, ids.size());
+    checksum += map.size();
+    return timings;
+}
+
+void print(const char* name, size_t count, const Timings& t)
+{
+    std::cout << "  " << name << " (" << count << "): "
+              << "set " << t.setNs << " ns, "
+              << "find " << t.findNs << " ns, "
+              << "find missing " << t.missNs << " ns, "
+              << "eraseUpTo " << t.eraseNs << " ns per entry" << std::endl;
+}
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? std::max(1, atoi(argv[1])) : 1;
+    std::mt19937_64 rng(1);
+    uint64_t checksum = 0;
+
+    for (size_t count: {size_t(10000), size_t(100000), size_t(1000000)})
+    {
+        std::vector<karere::Id> ids(count);
+        std::vector<karere::Id> misses(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            ids[i] = rng() | 1;
+            misses[i] = rng() | 1;
+        }
+        std::vector<karere::Id> lookups(ids);
+        std::shuffle(lookups.begin(), lookups.end(), rng);
+
+        for (int i = 0; i < iterations; i++)
+        {
+            std::cout << count << " entries, iteration " << (i + 1) << ":" << std::endl;
+            print("IdxMap  ", count, run<chatd::IdxMap<karere::Id, Idx>>(ids, lookups, misses, checksum));
+            print("std::map", count, run<std::map<karere::Id, Idx>>(ids, lookups, misses, checksum));
+        }
+    }
+
+    // keeps the lookups from being optimized away
+    std::cout << "checksum " << checksum << std::endl;
+    return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file idx_map_test.cpp
+ * @brief Differential test of chatd::IdxMap against std::map.
+ *
+ * Applies the same sequence of random operations (set, emplace, erase, eraseUpTo and clear)
+ * to an IdxMap and to the std::map it replaced, and checks that both always contain the
+ * same entries. Ids are drawn from a small pool, so they are set again with another index,
+ * and indexes from a narrow window, so several ids share an index.
+ *
+ * Usage: megachat_idx_map_test [seed]
+ */
+
+#include "chatdIdxMap.h"
+#include "karereId.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+int gFailures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; gFailures++; } } while (0)
+
+typedef int32_t Idx;    // as chatd::Idx
+typedef chatd::IdxMap<karere::Id, Idx> TestMap;
+typedef std::map<karere::Id, Idx> RefMap;
+
+void checkEqual(const TestMap& map, const RefMap& ref, const std::vector<karere::Id>& ids)
+{
+    CHECK(map.size() == ref.size());
+    for (const karere::Id& id: ids)
+    {
+        auto it = map.find(id);
+        auto refIt = ref.find(id);
+        if (refIt == ref.end())
+        {
+            CHECK(it == map.end());
+        }
+        else
+        {
+            CHECK(it != map.end() && it->first == id && it->second == refIt->second);
+        }
+    }
+}
+
+void eraseUpTo(RefMap& ref, Idx idx)
+{
+    for (auto it = ref.begin(); it != ref.end();)
+    {
+        it = (it->second <= idx) ? ref.erase(it) : std::next(it);
+    }
+}
+
+void testSharedIndex()
+{
+    TestMap map;
+    map.set(karere::Id(1), 10);
+    map.set(karere::Id(2), 10);
+    map.set(karere::Id(3), 10);
+    CHECK(map.size() == 3);
+    CHECK(map.find(karere::Id(1)) != map.end());
+    CHECK(map.find(karere::Id(2)) != map.end());
+
+    // the id in the ordered list is removed, another one with the same index takes its place
+    map.erase(karere::Id(1));
+    CHECK(map.size() == 2);
+    map.eraseUpTo(9);
+    CHECK(map.size() == 2);
+    map.eraseUpTo(10);
+    CHECK(map.empty());
+    CHECK(map.find(karere::Id(2)) == map.end());
+    CHECK(map.find(karere::Id(3)) == map.end());
+}
+
+void testRandom(unsigned seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<karere::Id> ids;
+    for (int i = 0; i < 512; i++)
+    {
+        ids.emplace_back(rng() | 1);    // the null id can't be a key
+    }
+
+    TestMap map;
+    RefMap ref;
+    Idx low = 0;
+    for (int step = 0; step < 200000; step++)
+    {
+        const karere::Id& id = ids[rng() % ids.size()];
+        Idx idx = low + static_cast<Idx>(rng() % 128) - 16;
+        unsigned op = static_cast<unsigned>(rng() % 100);
+        if (op < 45)
+        {
+            map.set(id, idx);
+            ref[id] = idx;
+        }
+        else if (op < 65)
+        {
+            bool added = map.emplace(id, idx).second;
+            CHECK(added == ref.emplace(id, idx).second);
+        }
+        else if (op < 90)
+        {
+            map.erase(id);
+            ref.erase(id);
+        }
+        else if (op < 99)
+        {
+            // the history buffer is truncated from its oldest messages
+            low += static_cast<Idx>(rng() % 8);
+            map.eraseUpTo(low);
+            eraseUpTo(ref, low);
+        }
+        else
+        {
+            map.clear();
+            ref.clear();
+        }
+
+        CHECK(map.size() == ref.size());
+        if (step % 1000 == 0)
+        {
+            checkEqual(map, ref, ids);
+        }
+        if (gFailures)
+        {
+            std::cerr << "seed " << seed << ", step " << step << std::endl;
+            return;
+        }
+    }
+    checkEqual(map, ref, ids);
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned seed = (argc > 1) ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 1;
+
+    testSharedIndex();
+    testRandom(seed);
+
+    if (gFailures)
+    {
+        std::cerr << gFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
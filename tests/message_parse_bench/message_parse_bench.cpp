@@ -0,0 +1,259 @@
+/**
+ * @file message_parse_bench.cpp
+ * @brief Microbenchmark of the parsing of the messages received from chatd.
+ *
+ * Replays a capture recorded with KRCHATD_CAPTURE (see chatd::FrameCapture) into a
+ * chatd::Client, whose crypto modules parse every received message with
+ * strongvelope::ParsedMessage instead of decrypting it (the keys of the recording account
+ * aren't available). The capture is replayed twice:
+ *  - heap: every message is allocated in the heap.
+ *  - arena: the messages are allocated in the arena of their chat (see
+ *    chatd::Client::setMessageArena()).
+ * In both modes, every message owns a copy of its content, and its ParsedMessage another one.
+ * and for each mode it reports the heap allocations per message, of the whole processing of
+ * the frames and of the parsing alone, and the time to parse a message.
+ *
+ * Allocations are counted by wrapping malloc(), so they are only reported with glibc.
+ *
+ * Usage: megachat_message_parse_bench <capture-file>
+ */
+
+#include "megachatapi_impl.h"
+#include "chatClient.h"
+#include "chatdCapture.h"
+#include "chatdDb.h"
+#include "strongvelope/strongvelope.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// Counter of heap allocations, for all the threads of the process
+static std::atomic<uint64_t> gAllocCount{0};
+
+#ifdef __GLIBC__
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+namespace
+{
+struct ParseStats
+{
+    uint64_t messages = 0;
+    uint64_t parseErrors = 0;
+    uint64_t parseAllocations = 0;
+    uint64_t frameAllocations = 0;
+    std::chrono::nanoseconds parseTime{0};
+};
+
+/** Crypto module that only parses the messages: keys are neither fetched nor decrypted */
+class ParseCrypto: public strongvelope::ProtocolHandler
+{
+public:
+    ParseCrypto(karere::Client& client, const karere::Id& chatid, ParseStats& stats)
+        : strongvelope::ProtocolHandler(client.myHandle(), StaticBuffer(kNullKey, 32), StaticBuffer(kNullKey, 32),
+                                        client.userAttrCache(), client.db, chatid, false, nullptr,
+                                        strongvelope::kDecrypted, karere::Id::inval(), client.appCtx)
+        , mStats(stats)
+    {}
+
+    promise::Promise<chatd::Message*> msgDecrypt(chatd::Message* msg) override
+    {
+        if (!msg->empty())
+        {
+            uint64_t allocsBefore = gAllocCount.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            try
+            {
+                // the type is not set, since the content is not replaced by the decrypted one
+                auto parsedMsg = std::make_shared<strongvelope::ParsedMessage>(*msg, *this);
+            }
+            catch (std::exception&)
+            {
+                mStats.parseErrors++;
+            }
+            mStats.parseTime += std::chrono::steady_clock::now() - start;
+            mStats.parseAllocations += gAllocCount.load(std::memory_order_relaxed) - allocsBefore;
+            mStats.messages++;
+        }
+
+        // keep the ciphertext as content
+        msg->setEncrypted(chatd::Message::kNotEncrypted);
+        return msg;
+    }
+
+    void msgDecryptPrefetch(const chatd::Message&) override {}
+    void onKeyReceived(chatd::KeyId, karere::Id, karere::Id, const char*, uint16_t, bool) override {}
+    void fetchUserKeys(karere::Id) override {}
+
+    promise::Promise<std::shared_ptr<Buffer>> reactionDecrypt(const karere::Id&, const karere::Id&, const chatd::KeyId&, const std::string& reaction) override
+    {
+        return std::make_shared<Buffer>(reaction.data(), reaction.size());
+    }
+
+protected:
+    static constexpr char kNullKey[32] = {};
+    ParseStats& mStats;
+};
+
+class ParseListener: public chatd::Listener
+{
+public:
+    ParseListener(karere::Client& client) : mClient(client) {}
+
+    void init(chatd::Chat& chat, chatd::DbInterface*& dbIntf) override
+    {
+        dbIntf = new ChatdSqliteDb(chat, mClient.db);
+    }
+
+    void onRecvNewMessage(chatd::Idx, chatd::Message&, chatd::Message::Status) override {}
+    void onRecvHistoryMessage(chatd::Idx, chatd::Message&, chatd::Message::Status, bool) override {}
+    void onOnlineStateChange(chatd::ChatState) override {}
+    void onReceived(chatd::Message*, chatd::Idx) override {}
+    void onLoaded(chatd::Message*, chatd::Idx) override {}
+    void onDeleted(karere::Id) override {}
+    void onTruncated(karere::Id) override {}
+
+protected:
+    karere::Client& mClient;
+};
+
+// Listeners of the replayed chats, must outlive the chat client. The crypto modules are owned by the chats
+struct ParseChats
+{
+    std::vector<std::unique_ptr<ParseListener>> listeners;
+};
+
+bool replayCapture(megachat::MegaChatApiImpl& api, const std::vector<chatd::FrameCapture::Record>& records,
+                   bool msgArena, ParseChats& chats, ParseStats& stats)
+{
+    megachat::MegaChatApiImpl::SdkMutexGuard g(api.sdkMutex);
+    karere::Client& client = *api.getKarereClient();
+    chatd::Client& chatdClient = *client.mChatdClient;
+    chatdClient.setMessageArena(msgArena);
+
+    for (const chatd::FrameCapture::Record& record: records)
+    {
+        if (record.type == chatd::FrameCapture::kRecordFrame)
+        {
+            uint64_t allocsBefore = gAllocCount.load(std::memory_order_relaxed);
+            chatdClient.replayFrame(record.shard, record.data.data(), record.data.size());
+            stats.frameAllocations += gAllocCount.load(std::memory_order_relaxed) - allocsBefore;
+            continue;
+        }
+
+        karere::Id chatid;
+        bool isGroup = false;
+        uint32_t creationTs = 0;
+        if (!chatd::FrameCapture::parseChat(record, chatid, isGroup, creationTs))
+        {
+            continue;
+        }
+
+        client.db.query("insert or replace into chats(chatid, shard, own_priv, ts_created) values(?,?,?,?)",
+                        chatid, record.shard, chatd::PRIV_MODERATOR, creationTs);
+        chats.listeners.emplace_back(new ParseListener(client));
+        chatdClient.createChat(chatid, record.shard, chats.listeners.back().get(), karere::SetOfIds(),
+                               new ParseCrypto(client, chatid, stats), creationTs, isGroup);
+    }
+    client.db.commit();
+    return true;
+}
+
+bool runMode(const std::vector<chatd::FrameCapture::Record>& records, bool msgArena)
+{
+    char workDir[] = "/tmp/megachat_parse_XXXXXX";
+    if (!mkdtemp(workDir))
+    {
+        std::cerr << "Can't create temporary directory" << std::endl;
+        return false;
+    }
+
+    ParseStats stats;
+    ParseChats chats;
+    bool ok = false;
+    {
+        mega::MegaApi megaApi("MBoVFSyZ", workDir, "MEGAchat parse benchmark");
+        megachat::MegaChatApiImpl api(nullptr, &megaApi);
+        if (api.initAnonymous() != megachat::MegaChatApi::INIT_ERROR)
+        {
+            ok = replayCapture(api, records, msgArena, chats, stats);
+        }
+        else
+        {
+            std::cerr << "Failed to initialize the chat client" << std::endl;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(workDir, ec);
+    if (!ok)
+    {
+        return false;
+    }
+
+    double messages = static_cast<double>(stats.messages ? stats.messages : 1);
+    std::cout << (msgArena ? "arena: " : "heap:  ")
+              << stats.messages << " messages (" << stats.parseErrors << " not parsed), "
+              << static_cast<double>(stats.frameAllocations) / messages << " allocations/message, "
+              << static_cast<double>(stats.parseAllocations) / messages << " of them parsing, "
+              << static_cast<double>(stats.parseTime.count()) / messages << " ns/message parsing" << std::endl;
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture-file>" << std::endl;
+        return 1;
+    }
+
+    chatd::FrameCaptureReader reader(argv[1]);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Can't open capture file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<chatd::FrameCapture::Record> records;
+    chatd::FrameCapture::Record record;
+    while (reader.next(record))
+    {
+        records.emplace_back(std::move(record));
+    }
+
+#ifndef __GLIBC__
+    std::cout << "Allocations are not counted in this platform" << std::endl;
+#endif
+
+    megachat::MegaChatApi::setLogLevel(megachat::MegaChatApi::LOG_LEVEL_ERROR);
+    return (runMode(records, false) && runMode(records, true)) ? 0 : 1;
+}
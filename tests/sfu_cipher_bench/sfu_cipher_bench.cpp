@@ -0,0 +1,221 @@
+/**
+ * @file sfu_cipher_bench.cpp
+ * @brief Per-frame microbenchmark of the encryption and decryption of media frames in calls.
+ *
+ * Frames of the sizes of an audio packet and of small and large video frames are encrypted
+ * with artc::MegaEncryptor and decrypted with artc::MegaDecryptor, and compared against the
+ * previous implementation (mega::SymmCipher re-armed on every key change, the frame IV
+ * allocated for every frame and the ciphertext built in a temporary string). Cases:
+ *  - encrypt, steady key
+ *  - decrypt, steady key
+ *  - decrypt, key rotation: frames of the previous and the new key arrive interleaved, as
+ *    happens for a while after a peer rotates its key, so the key changes on every frame
+ * The decrypted frames are checked against the original ones.
+ *
+ * Usage: megachat_sfu_cipher_bench [frames]
+ */
+
+#include "rtcModule/webrtcAdapter.h"
+#include <mega/crypto/cryptopp.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr Cid_t kCid = 42;
+constexpr IvStatic_t kIvStatic = 0x0123456789abcdefULL;
+
+typedef std::vector<uint8_t> Frame;
+
+// frame encryption and decryption as MegaEncryptor / MegaDecryptor did before caching the GCM keys
+class LegacyCipher
+{
+public:
+    bool encrypt(const sfu::Peer& peer, const Frame& frame, Frame& encryptedFrame)
+    {
+        armKey(peer, peer.getCurrentKeyId());
+
+        std::unique_ptr<byte []> iv = generateFrameIV();
+        Keyid_t keyId = peer.getCurrentKeyId();
+        Cid_t cid = peer.getCid();
+        memcpy(encryptedFrame.data(), &keyId, FRAME_KEYID_LENGTH);
+        memcpy(encryptedFrame.data() + FRAME_KEYID_LENGTH, &cid, FRAME_CID_LENGTH);
+        memcpy(encryptedFrame.data() + FRAME_KEYID_LENGTH + FRAME_CID_LENGTH, &mCtr, FRAME_CTR_LENGTH);
+
+        std::string encrypted;
+        size_t encSize = encryptedFrame.size() - FRAME_HEADER_LENGTH;
+        bool result = mSymCipher.gcm_encrypt_add(frame.data(), frame.size(),
+                                                 encryptedFrame.data(), FRAME_HEADER_LENGTH,
+                                                 iv.get(), FRAME_IV_LENGTH,
+                                                 FRAME_GCM_TAG_LENGTH, encrypted, encSize);
+        if (!result || encrypted.size() != encSize)
+        {
+            return false;
+        }
+        memcpy(encryptedFrame.data() + FRAME_HEADER_LENGTH, encrypted.data(), encSize);
+        mCtr++;
+        return true;
+    }
+
+    bool decrypt(const sfu::Peer& peer, const Frame& encryptedFrame, Frame& frame)
+    {
+        const uint8_t* header = encryptedFrame.data();
+        Keyid_t keyId = 0;
+        memcpy(&keyId, header, FRAME_KEYID_LENGTH);
+        memcpy(&mCtr, header + FRAME_KEYID_LENGTH + FRAME_CID_LENGTH, FRAME_CTR_LENGTH);
+        armKey(peer, keyId);
+
+        std::unique_ptr<byte []> iv = generateFrameIV();
+        size_t dataSize = encryptedFrame.size() - FRAME_HEADER_LENGTH - FRAME_GCM_TAG_LENGTH;
+        return mSymCipher.gcm_decrypt_aad(header + FRAME_HEADER_LENGTH, static_cast<unsigned int>(dataSize),
+                                          header, FRAME_HEADER_LENGTH,
+                                          header + FRAME_HEADER_LENGTH + dataSize, FRAME_GCM_TAG_LENGTH,
+                                          iv.get(), FRAME_IV_LENGTH,
+                                          frame.data(), frame.size());
+    }
+
+protected:
+    void armKey(const sfu::Peer& peer, Keyid_t keyId)
+    {
+        if (keyId != mKeyId || !mInitialized)
+        {
+            std::string key = peer.getKey(keyId);
+            mSymCipher.setkey(reinterpret_cast<const unsigned char*>(key.data()));
+            mKeyId = keyId;
+            mInitialized = true;
+        }
+    }
+
+    std::unique_ptr<byte []> generateFrameIV()
+    {
+        std::unique_ptr<byte []> iv(new byte[FRAME_IV_LENGTH]);
+        memcpy(iv.get(), &mCtr, FRAME_CTR_LENGTH);
+        memcpy(iv.get() + FRAME_CTR_LENGTH, &kIvStatic, FRAME_IV_LENGTH - FRAME_CTR_LENGTH);
+        return iv;
+    }
+
+    mega::SymmCipher mSymCipher;
+    Ctr_t mCtr = 0;
+    Keyid_t mKeyId = 0;
+    bool mInitialized = false;
+};
+
+std::string randomKey(std::mt19937& rng)
+{
+    std::string key(CryptoPP::AES::DEFAULT_KEYLENGTH, '\0');
+    for (char& c: key)
+    {
+        c = static_cast<char>(rng());
+    }
+    return key;
+}
+
+template <class F>
+double nsPerFrame(size_t frames, F&& process)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames; i++)
+    {
+        if (!process(i))
+        {
+            std::cerr << "Failed to process frame " << i << std::endl;
+            exit(1);
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(elapsed.count()) / static_cast<double>(frames);
+}
+
+void print(const char* name, double cachedNs, double legacyNs)
+{
+    std::cout << "  " << name << ": " << cachedNs << " ns/frame (legacy " << legacyNs << " ns/frame)" << std::endl;
+}
+
+void runSize(size_t frameSize, size_t frames, std::mt19937& rng)
+{
+    std::string oldKey = randomKey(rng);
+    std::string newKey = randomKey(rng);
+
+    // sender with the old key armed, and with the new one; the receiver knows both
+    sfu::Peer oldSender(karere::Id(1), sfu::SfuProtocol::SFU_PROTO_PROD, 0, nullptr, kCid);
+    oldSender.addKey(0, oldKey);
+    sfu::Peer newSender(karere::Id(1), sfu::SfuProtocol::SFU_PROTO_PROD, 0, nullptr, kCid);
+    newSender.addKey(0, oldKey);
+    newSender.addKey(1, newKey);
+    const sfu::Peer& receiver = newSender;
+
+    Frame plain(frameSize);
+    for (uint8_t& b: plain)
+    {
+        b = static_cast<uint8_t>(rng());
+    }
+    Frame encrypted(FRAME_HEADER_LENGTH + frameSize + FRAME_GCM_TAG_LENGTH);
+    Frame decrypted(frameSize);
+
+    rtc::scoped_refptr<artc::MegaEncryptor> encryptor(new artc::MegaEncryptor(newSender, nullptr, kIvStatic, 0));
+    LegacyCipher legacyEncryptor;
+    double encryptNs = nsPerFrame(frames, [&](size_t)
+    {
+        size_t written = 0;
+        return encryptor->Encrypt(cricket::MediaType::MEDIA_TYPE_VIDEO, 0, rtc::ArrayView<const uint8_t>(),
+                                  plain, encrypted, &written) == artc::MegaEncryptor::kOk;
+    });
+    double legacyEncryptNs = nsPerFrame(frames, [&](size_t)
+    {
+        return legacyEncryptor.encrypt(newSender, plain, encrypted);
+    });
+
+    // frames to decrypt: all with the new key, and alternating the old and the new key
+    rtc::scoped_refptr<artc::MegaEncryptor> oldEncryptor(new artc::MegaEncryptor(oldSender, nullptr, kIvStatic, 0));
+    std::vector<Frame> steadyFrames(frames, encrypted);
+    std::vector<Frame> rotationFrames(frames, encrypted);
+    for (size_t i = 0; i < frames; i++)
+    {
+        size_t written = 0;
+        encryptor->Encrypt(cricket::MediaType::MEDIA_TYPE_VIDEO, 0, rtc::ArrayView<const uint8_t>(), plain, steadyFrames[i], &written);
+        artc::MegaEncryptor& sender = (i % 2) ? *encryptor : *oldEncryptor;
+        sender.Encrypt(cricket::MediaType::MEDIA_TYPE_VIDEO, 0, rtc::ArrayView<const uint8_t>(), plain, rotationFrames[i], &written);
+    }
+
+    rtc::scoped_refptr<artc::MegaDecryptor> decryptor(new artc::MegaDecryptor(receiver, nullptr, kIvStatic, 0));
+    LegacyCipher legacyDecryptor;
+    auto decrypt = [&](const std::vector<Frame>& input, size_t i)
+    {
+        auto result = decryptor->Decrypt(cricket::MediaType::MEDIA_TYPE_VIDEO, std::vector<uint32_t>(),
+                                         rtc::ArrayView<const uint8_t>(), input[i], decrypted);
+        return result.IsOk() && decrypted == plain;
+    };
+    auto legacyDecrypt = [&](const std::vector<Frame>& input, size_t i)
+    {
+        return legacyDecryptor.decrypt(receiver, input[i], decrypted) && decrypted == plain;
+    };
+
+    double decryptNs = nsPerFrame(frames, [&](size_t i) { return decrypt(steadyFrames, i); });
+    double legacyDecryptNs = nsPerFrame(frames, [&](size_t i) { return legacyDecrypt(steadyFrames, i); });
+    double rotationNs = nsPerFrame(frames, [&](size_t i) { return decrypt(rotationFrames, i); });
+    double legacyRotationNs = nsPerFrame(frames, [&](size_t i) { return legacyDecrypt(rotationFrames, i); });
+
+    std::cout << frameSize << " bytes/frame, " << frames << " frames:" << std::endl;
+    print("encrypt, steady key     ", encryptNs, legacyEncryptNs);
+    print("decrypt, steady key     ", decryptNs, legacyDecryptNs);
+    print("decrypt, key rotation   ", rotationNs, legacyRotationNs);
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t frames = (argc > 1) ? static_cast<size_t>(std::max(1, atoi(argv[1]))) : 20000;
+    std::mt19937 rng(1);
+
+    // audio packet, small and large video frames
+    for (size_t frameSize: {size_t(160), size_t(1200), size_t(12000)})
+    {
+        runSize(frameSize, frames, rng);
+    }
+    return 0;
+}
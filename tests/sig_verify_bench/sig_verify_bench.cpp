@@ -0,0 +1,218 @@
+/**
+ * @file sig_verify_bench.cpp
+ * @brief Benchmark of per-message against batched Ed25519 verification of strongvelope
+ * signatures, over 1k and 10k messages.
+ *
+ * The messages are built and signed like strongvelope does, by a few senders. A capture
+ * can't be used, since it doesn't include the public keys of the senders. Compared methods:
+ *  - per-message: crypto_sign_verify_detached(), as ParsedMessage::verifySignature()
+ *  - batched: the messages of a chunk (32, as ProtocolHandler::kDecryptBatchSize, or 256, as
+ *    a page of history) are checked together with a random linear combination of their
+ *    verification equations, built with the Ed25519 primitives of libsodium:
+ *      sum(z_i * R_i) + sum_A(sum(z_i * h_i) * A) == sum(z_i * S_i) * B
+ *    If a batch fails, its messages are verified one by one, so a bad signature is isolated.
+ * Every method runs with all the signatures valid, and with one bad signature every 1000.
+ *
+ * Usage: megachat_sig_verify_bench
+ */
+
+#include <sodium.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+const std::string kSigPrefix = "strongvelopesig";
+constexpr size_t kSenders = 8;
+
+struct SignedMessage
+{
+    std::vector<unsigned char> signedData;  // as built by ParsedMessage::verifySignature()
+    unsigned char signature[crypto_sign_BYTES];
+    const unsigned char* pubKey;
+};
+
+struct Sender
+{
+    unsigned char pubKey[crypto_sign_PUBLICKEYBYTES];
+    unsigned char secKey[crypto_sign_SECRETKEYBYTES];
+};
+
+std::vector<SignedMessage> buildMessages(const std::vector<Sender>& senders, size_t count, bool withBadSignatures)
+{
+    std::vector<SignedMessage> messages(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        SignedMessage& msg = messages[i];
+        const Sender& sender = senders[randombytes_uniform(static_cast<uint32_t>(senders.size()))];
+
+        // <prefix> <version.1> <type.1> <sendKey.16> <signed content>
+        unsigned char content[16 + 150];
+        randombytes_buf(content, sizeof(content));
+        msg.signedData.assign(kSigPrefix.begin(), kSigPrefix.end());
+        msg.signedData.push_back(3);
+        msg.signedData.push_back(1);
+        msg.signedData.insert(msg.signedData.end(), content, content + sizeof(content));
+
+        crypto_sign_detached(msg.signature, nullptr, msg.signedData.data(), msg.signedData.size(), sender.secKey);
+        msg.pubKey = sender.pubKey;
+        if (withBadSignatures && i % 1000 == 500)
+        {
+            msg.signature[40] ^= 1;
+        }
+    }
+    return messages;
+}
+
+bool verifyOne(const SignedMessage& msg)
+{
+    return crypto_sign_verify_detached(msg.signature, msg.signedData.data(), msg.signedData.size(), msg.pubKey) == 0;
+}
+
+// Random linear combination of the verification equations of the messages in [first, last)
+bool verifyBatch(const SignedMessage* first, const SignedMessage* last)
+{
+    unsigned char sumS[crypto_core_ed25519_SCALARBYTES] = {};
+    std::map<std::string, std::vector<unsigned char>> sumHByKey;
+    unsigned char sum[crypto_core_ed25519_BYTES];
+    bool haveSum = false;
+    std::vector<unsigned char> hashInput;
+
+    for (const SignedMessage* msg = first; msg != last; msg++)
+    {
+        // 128-bit random coefficient
+        unsigned char z[crypto_core_ed25519_SCALARBYTES] = {};
+        randombytes_buf(z, 16);
+
+        // h = SHA512(R || A || M) mod l
+        hashInput.assign(msg->signature, msg->signature + 32);
+        hashInput.insert(hashInput.end(), msg->pubKey, msg->pubKey + 32);
+        hashInput.insert(hashInput.end(), msg->signedData.begin(), msg->signedData.end());
+        unsigned char hash[crypto_hash_sha512_BYTES];
+        crypto_hash_sha512(hash, hashInput.data(), hashInput.size());
+        unsigned char h[crypto_core_ed25519_SCALARBYTES];
+        crypto_core_ed25519_scalar_reduce(h, hash);
+
+        unsigned char tmp[crypto_core_ed25519_SCALARBYTES];
+        crypto_core_ed25519_scalar_mul(tmp, z, msg->signature + 32);
+        crypto_core_ed25519_scalar_add(sumS, sumS, tmp);
+
+        std::vector<unsigned char>& sumH = sumHByKey[std::string(reinterpret_cast<const char*>(msg->pubKey), 32)];
+        sumH.resize(crypto_core_ed25519_SCALARBYTES);
+        crypto_core_ed25519_scalar_mul(tmp, z, h);
+        crypto_core_ed25519_scalar_add(sumH.data(), sumH.data(), tmp);
+
+        // rejects non-canonical and small-order R
+        unsigned char zR[crypto_core_ed25519_BYTES];
+        if (crypto_scalarmult_ed25519_noclamp(zR, z, msg->signature) != 0)
+        {
+            return false;
+        }
+        if (haveSum)
+        {
+            crypto_core_ed25519_add(sum, sum, zR);
+        }
+        else
+        {
+            memcpy(sum, zR, sizeof(sum));
+            haveSum = true;
+        }
+    }
+
+    // one scalar multiplication per sender
+    for (const auto& keySum: sumHByKey)
+    {
+        unsigned char hA[crypto_core_ed25519_BYTES];
+        if (crypto_scalarmult_ed25519_noclamp(hA, keySum.second.data(),
+                reinterpret_cast<const unsigned char*>(keySum.first.data())) != 0)
+        {
+            return false;
+        }
+        crypto_core_ed25519_add(sum, sum, hA);
+    }
+
+    unsigned char sB[crypto_core_ed25519_BYTES];
+    if (crypto_scalarmult_ed25519_base_noclamp(sB, sumS) != 0)
+    {
+        return false;
+    }
+    return haveSum && sodium_memcmp(sum, sB, sizeof(sum)) == 0;
+}
+
+size_t runPerMessage(const std::vector<SignedMessage>& messages)
+{
+    size_t valid = 0;
+    for (const SignedMessage& msg: messages)
+    {
+        valid += verifyOne(msg) ? 1 : 0;
+    }
+    return valid;
+}
+
+size_t runBatched(const std::vector<SignedMessage>& messages, size_t batchSize)
+{
+    size_t valid = 0;
+    for (size_t i = 0; i < messages.size(); i += batchSize)
+    {
+        const SignedMessage* first = &messages[i];
+        const SignedMessage* last = first + std::min(batchSize, messages.size() - i);
+        if (verifyBatch(first, last))
+        {
+            valid += static_cast<size_t>(last - first);
+            continue;
+        }
+
+        // isolate the bad signatures
+        for (const SignedMessage* msg = first; msg != last; msg++)
+        {
+            valid += verifyOne(*msg) ? 1 : 0;
+        }
+    }
+    return valid;
+}
+
+template <class F>
+void report(const char* name, size_t count, F&& verify)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t valid = verify();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "  " << name << ": " << us / static_cast<double>(count) << " us/message, "
+              << valid << " valid" << std::endl;
+}
+}
+
+int main()
+{
+    if (sodium_init() < 0)
+    {
+        std::cerr << "Failed to initialize libsodium" << std::endl;
+        return 1;
+    }
+
+    std::vector<Sender> senders(kSenders);
+    for (Sender& sender: senders)
+    {
+        crypto_sign_keypair(sender.pubKey, sender.secKey);
+    }
+
+    for (size_t count: {size_t(1000), size_t(10000)})
+    {
+        for (bool withBadSignatures: {false, true})
+        {
+            std::vector<SignedMessage> messages = buildMessages(senders, count, withBadSignatures);
+            std::cout << count << " messages, " << (withBadSignatures ? "1 bad signature every 1000" : "all signatures valid")
+                      << ", " << kSenders << " senders:" << std::endl;
+            report("per-message", count, [&messages]() { return runPerMessage(messages); });
+            report("batched (32)", count, [&messages]() { return runBatched(messages, 32); });
+            report("batched (256)", count, [&messages]() { return runBatched(messages, 256); });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file timer_wheel_test.cpp
+ * @brief Unit test of karere::TimerWheel.
+ *
+ * The clock of the wheel is driven by the test, so expirations are checked at exact ticks,
+ * without libuv nor waiting. Covers:
+ *  - stale handles: canceling the handle of a timer that already fired never cancels a
+ *    later timer that reuses its entry of the pool, however many times it's reused.
+ *  - repeat timers: called every period until canceled.
+ *  - cascading: timers in every level of the wheel fire at their tick, not earlier.
+ *  - cancel from a callback: of the timer itself and of another expired timer.
+ *
+ * Usage: megachat_timer_wheel_test
+ */
+
+#include "timerWheel.h"
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+int gFailures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; gFailures++; } } while (0)
+
+// arming from outside the loop thread posts a message to the app, which is not needed here
+void ignorePost(megaMessage*, void*)
+{
+}
+
+class TestWheel: public karere::TimerWheel
+{
+public:
+    uint64_t mFakeNow = 0;
+
+    TestWheel(): TimerWheel(nullptr, nullptr) {}
+
+    // advances the wheel up to \c tick and calls the expired timers
+    void run(uint64_t tick)
+    {
+        std::unique_lock<std::recursive_mutex> lock(mMutex);
+        mFakeNow = tick;
+        runExpired(lock, tick);
+    }
+
+    // runs every tick up to \c tick, as the libuv timer of the app does
+    void step(uint64_t tick)
+    {
+        while (mFakeNow < tick)
+        {
+            run(mFakeNow + 1);
+        }
+    }
+
+    static uint32_t indexOf(megaHandle handle)
+    {
+        return static_cast<uint32_t>(handle & kIndexMask);
+    }
+
+protected:
+    uint64_t nowTick() const override
+    {
+        return mFakeNow;
+    }
+};
+
+void testStaleHandle()
+{
+    TestWheel wheel;
+    int fired = 0;
+    megaHandle stale = wheel.add([&fired]() { fired++; }, 10, false);
+    wheel.run(10);
+    CHECK(fired == 1);
+    CHECK(!wheel.cancel(stale));
+
+    // reuse the entry of the stale timer well beyond any per-entry counter of 16 bits
+    unsigned reuses = 0;
+    bool reusedFired = false;
+    while (reuses < 20000)
+    {
+        megaHandle handle = wheel.add([&reusedFired]() { reusedFired = true; }, 5, false);
+        if (TestWheel::indexOf(handle) == TestWheel::indexOf(stale))
+        {
+            reuses++;
+            CHECK(handle != stale);
+            if (handle == stale || wheel.cancel(stale))
+            {
+                break;
+            }
+        }
+        CHECK(wheel.cancel(handle));
+    }
+    CHECK(reuses == 20000);
+
+    // the last timer armed in the entry is not affected by the stale handle
+    int last = 0;
+    megaHandle handle = wheel.add([&last]() { last++; }, 5, false);
+    CHECK(!wheel.cancel(stale));
+    wheel.run(wheel.mFakeNow + 5);
+    CHECK(last == 1);
+    CHECK(!reusedFired);
+    CHECK(!wheel.cancel(handle));
+}
+
+void testRepeat()
+{
+    TestWheel wheel;
+    int fired = 0;
+    megaHandle handle = wheel.add([&fired]() { fired++; }, 5, true);
+    wheel.step(4);
+    CHECK(fired == 0);
+    wheel.step(5);
+    CHECK(fired == 1);
+    wheel.step(9);
+    CHECK(fired == 1);
+    wheel.step(10);
+    CHECK(fired == 2);
+    wheel.step(15);
+    CHECK(fired == 3);
+    CHECK(wheel.cancel(handle));
+    wheel.step(100);
+    CHECK(fired == 3);
+    CHECK(!wheel.cancel(handle));
+}
+
+void testCascade()
+{
+    TestWheel wheel;
+    // both ends of every level (64 slots per level), and beyond the last one
+    std::vector<unsigned> timeouts = { 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+                                       16777216, 16777300, 1073741824, 1073741825 };
+    std::vector<uint64_t> firedAt(timeouts.size(), 0);
+    for (size_t i = 0; i < timeouts.size(); i++)
+    {
+        wheel.add([&wheel, &firedAt, i]() { firedAt[i] = wheel.mFakeNow; }, timeouts[i], false);
+    }
+
+    for (size_t i = 0; i < timeouts.size(); i++)
+    {
+        wheel.run(timeouts[i] - 1);
+        CHECK(!firedAt[i]);
+        wheel.run(timeouts[i]);
+        CHECK(firedAt[i] == timeouts[i]);
+    }
+
+    // a timer armed once the wheel has advanced cascades from its current position
+    int fired = 0;
+    uint64_t start = wheel.mFakeNow;
+    wheel.add([&fired]() { fired++; }, 5000, false);
+    wheel.run(start + 4999);
+    CHECK(fired == 0);
+    wheel.run(start + 5000);
+    CHECK(fired == 1);
+}
+
+void testCancelFromCallback()
+{
+    TestWheel wheel;
+
+    // a repeat timer canceling itself
+    int selfFired = 0;
+    megaHandle self = 0;
+    self = wheel.add([&wheel, &selfFired, &self]()
+    {
+        if (++selfFired == 2)
+        {
+            CHECK(wheel.cancel(self));
+        }
+    }, 10, true);
+
+    // a timer canceling another one that expires at the same tick
+    int otherFired = 0;
+    megaHandle other = 0;
+    wheel.add([&wheel, &other]() { CHECK(wheel.cancel(other)); }, 30, false);
+    other = wheel.add([&otherFired]() { otherFired++; }, 30, false);
+
+    // a one-shot timer canceling itself, and arming a new timer
+    int armedFired = 0;
+    megaHandle oneShot = 0;
+    oneShot = wheel.add([&wheel, &oneShot, &armedFired]()
+    {
+        CHECK(wheel.cancel(oneShot));
+        wheel.add([&armedFired]() { armedFired++; }, 10, false);
+    }, 15, false);
+
+    wheel.step(100);
+    CHECK(selfFired == 2);
+    CHECK(!wheel.cancel(self));
+    CHECK(otherFired == 0);
+    CHECK(!wheel.cancel(other));
+    CHECK(!wheel.cancel(oneShot));
+    CHECK(armedFired == 1);
+}
+}
+
+int main()
+{
+    megaPostMessageToGui = &ignorePost;
+
+    testStaleHandle();
+    testRepeat();
+    testCascade();
+    testCancelFromCallback();
+
+    if (gFailures)
+    {
+        std::cerr << gFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file url_scan_bench.cpp
+ * @brief Benchmark of the URL detection of chatd::Message::hasUrl() over a corpus of chat messages.
+ *
+ * The corpus is generated from fragments of typical chat messages: short replies, sentences
+ * with punctuation, non-ASCII text and emojis, pasted text, email addresses, MEGA links and
+ * http(s) URLs, in roughly the proportions seen in chats. Every message is scanned with:
+ *  - legacy: the scanner that hasUrl() used before, which copied every token and compiled
+ *    the regular expressions for every token with a '.'
+ *  - scalar: chatd::findUrl() classifying the text with a lookup table
+ *  - vectorized: chatd::findUrl() classifying the text in blocks of 16 bytes (SSE2 or NEON)
+ * The three must find the same URLs, otherwise the benchmark fails.
+ *
+ * Usage: megachat_url_scan_bench [messages] [seed]
+ */
+
+#include "chatdUrlScan.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Message::hasUrl() / parseUrl() / isValidEmail() before chatd::findUrl()
+namespace legacy
+{
+bool isValidEmail(const std::string& buf)
+{
+    std::regex regularExpresion("^[a-z0-9A-Z._%+-]+@[a-z0-9A-Z.-]+[.][a-zA-Z]{2,6}");
+    return regex_match(buf, regularExpresion);
+}
+
+bool parseUrl(const std::string& url)
+{
+    if (url.find('.') == std::string::npos)
+    {
+        return false;
+    }
+
+    if (isValidEmail(url))
+    {
+        return false;
+    }
+
+    std::string urlToParse = url;
+    std::string::size_type position = urlToParse.find("://");
+    if (position != std::string::npos)
+    {
+        std::regex expresion("^(http://|https://)(.+)");
+        if (regex_match(urlToParse, expresion))
+        {
+            urlToParse = urlToParse.substr(position + 3);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    std::regex megaUrlExpression("((WWW.|www.)?mega.+(nz/|co.nz/)).*((#F!|#!|C!|chat/|file/|folder/)[a-z0-9A-Z-._~:/?#!$&'()*+,;= \\-@]+)$");
+    if (regex_match(urlToParse, megaUrlExpression))
+    {
+        return false;
+    }
+
+    std::regex regularExpresion("((^([0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}[.]{1}[0-9]{1,3}))|((^(WWW.|www.))?([a-z0-9A-Z]+)([a-z0-9A-Z-._~?#!$&'()*+,;=])*([a-z0-9A-Z]+)([.]{1}[a-zA-Z]{2,5}){1,2}))([:]{1}[0-9]{1,5})?([/]{1}[a-z0-9A-Z-._~:?#/@!$&'()*+,;=]*)?$");
+    return regex_match(urlToParse, regularExpresion);
+}
+
+void trim(std::string& buf)
+{
+    static const std::string trimmedChars = ".,:?!;";
+    while (!buf.empty() && trimmedChars.find(buf.front()) != std::string::npos)
+    {
+        buf.erase(0, 1);
+    }
+    while (!buf.empty() && trimmedChars.find(buf.back()) != std::string::npos)
+    {
+        buf.erase(buf.size() - 1);
+    }
+}
+
+bool hasUrl(const std::string& text, std::string& url)
+{
+    std::string partialString;
+    for (std::string::size_type position = 0; position <= text.size(); position++)
+    {
+        char character = (position < text.size()) ? text[position] : ' ';
+        if ((character >= 33 && character <= 126)
+                && character != '"'
+                && character != '\''
+                && character != '\\'
+                && character != '<'
+                && character != '>'
+                && character != '{'
+                && character != '}'
+                && character != '|')
+        {
+            partialString.push_back(character);
+            continue;
+        }
+
+        if (!partialString.empty())
+        {
+            trim(partialString);
+            if (parseUrl(partialString))
+            {
+                url = partialString;
+                return true;
+            }
+        }
+        partialString.clear();
+    }
+    return false;
+}
+}
+
+const char* const kWords[] = { "ok", "yes", "no", "thanks", "see", "you", "tomorrow", "the", "meeting", "is",
+                               "at", "lunch", "call", "me", "later", "sure", "sounds", "good", "what", "about",
+                               "file", "folder", "sent", "upload", "done", "haha", "great", "let's", "check",
+                               "maybe", "next", "week", "\xc3\xa9t\xc3\xa9", "gr\xc3\xbc\xc3\x9f" "e",
+                               "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "\xf0\x9f\x98\x82",
+                               "\xf0\x9f\x91\x8d", "\xe4\xbd\xa0\xe5\xa5\xbd" };
+const char* const kPunctuation[] = { "", "", "", ",", ".", "!", "?", "...", ":)", ";" };
+const char* const kUrls[] = { "https://example.com", "http://www.example.org/path/to/page.html",
+                              "www.news-site.co.uk/article?id=12345&ref=chat", "github.com/meganz/MEGAchat",
+                              "https://docs.example.io:8443/a/b/c#section", "192.168.1.20:8080/status",
+                              "ftp://files.example.com/x.zip" };
+const char* const kNotUrls[] = { "john.doe@example.com", "https://mega.nz/file/AbCdEfGh#0123456789abcdef",
+                                 "mega.nz/chat/XyZ123#key", "v1.2.3", "e.g.", "i.e.", "3.14", "..." };
+
+std::vector<std::string> buildCorpus(size_t count, std::mt19937& rng)
+{
+    auto pick = [&rng](const auto& array) -> const char*
+    {
+        return array[rng() % (sizeof(array) / sizeof(array[0]))];
+    };
+
+    std::vector<std::string> corpus(count);
+    for (std::string& text: corpus)
+    {
+        unsigned kind = static_cast<unsigned>(rng() % 100);
+        size_t words = (kind < 40) ? 1 + rng() % 4        // short reply
+                     : (kind < 90) ? 5 + rng() % 20       // sentences
+                                   : 80 + rng() % 200;    // pasted text
+        for (size_t i = 0; i < words; i++)
+        {
+            if (!text.empty())
+            {
+                text += (rng() % 20) ? " " : "\n";
+            }
+            text += pick(kWords);
+            text += pick(kPunctuation);
+        }
+
+        unsigned extra = static_cast<unsigned>(rng() % 100);
+        if (extra < 8)
+        {
+            text.insert(rng() % 2 ? text.size() : 0, std::string(pick(kUrls)) + " ");
+        }
+        else if (extra < 14)
+        {
+            text += std::string(" ") + pick(kNotUrls);
+        }
+        else if (extra < 16)
+        {
+            text += std::string(" (") + pick(kUrls) + ").";
+        }
+    }
+    return corpus;
+}
+
+template <class F>
+double nsPerMessage(const std::vector<std::string>& corpus, std::vector<std::string>& urls, F&& scan)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        scan(corpus[i], urls[i]);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(elapsed.count()) / static_cast<double>(corpus.size());
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? static_cast<size_t>(std::max(1, atoi(argv[1]))) : 100000;
+    unsigned seed = (argc > 2) ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 1;
+    std::mt19937 rng(seed);
+    std::vector<std::string> corpus = buildCorpus(count, rng);
+
+    size_t bytes = 0;
+    for (const std::string& text: corpus)
+    {
+        bytes += text.size();
+    }
+
+    std::vector<std::string> legacyUrls(count);
+    std::vector<std::string> scalarUrls(count);
+    std::vector<std::string> vectorizedUrls(count);
+    double legacyNs = nsPerMessage(corpus, legacyUrls, [](const std::string& text, std::string& url)
+    {
+        legacy::hasUrl(text, url);
+    });
+    double scalarNs = nsPerMessage(corpus, scalarUrls, [](const std::string& text, std::string& url)
+    {
+        std::string_view found = chatd::findUrl(text, false);
+        url.assign(found.data(), found.size());
+    });
+    double vectorizedNs = nsPerMessage(corpus, vectorizedUrls, [](const std::string& text, std::string& url)
+    {
+        std::string_view found = chatd::findUrl(text, true);
+        url.assign(found.data(), found.size());
+    });
+
+    size_t found = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        found += legacyUrls[i].empty() ? 0 : 1;
+        if (scalarUrls[i] != legacyUrls[i] || vectorizedUrls[i] != legacyUrls[i])
+        {
+            if (!mismatches)
+            {
+                std::cerr << "Mismatch in \"" << corpus[i] << "\": legacy \"" << legacyUrls[i] << "\", scalar \""
+                          << scalarUrls[i] << "\", vectorized \"" << vectorizedUrls[i] << "\"" << std::endl;
+            }
+            mismatches++;
+        }
+    }
+
+    std::cout << count << " messages, " << static_cast<double>(bytes) / static_cast<double>(count)
+              << " bytes/message, " << found << " with a URL" << std::endl;
+    std::cout << "  legacy:     " << legacyNs << " ns/message" << std::endl;
+    std::cout << "  scalar:     " << scalarNs << " ns/message" << std::endl;
+    std::cout << "  vectorized: " << vectorizedNs << " ns/message" << std::endl;
+    if (mismatches)
+    {
+        std::cerr << mismatches << " messages with different results" << std::endl;
+        return 1;
+    }
+    return 0;
+}